@@ -0,0 +1,174 @@
+/// @file
+///
+/// @brief Measures how much memory generating a large program takes, depending on how the code is written out.
+///
+/// @details A program of long string literals, whose generated code is several megabytes, is parsed and analyzed
+///          once. Then it is generated and written to /dev/null, once in each of these ways:
+///
+///          - string: the code is joined into one string, which is written to an output stream.
+///          - chunked: the chunks of the code are written straight to a file descriptor, with writev.
+///
+///          Allocations are counted from just before generating until the code has been written and freed. The peak
+///          is the most heap memory that was in use at any one time, on top of what was in use before.
+
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "codegen/generator.h"
+#include "console.h"
+#include "frontend.h"
+#include "memory_usage.h"
+#include "source_generator.h"
+
+namespace {
+
+enum class Mode
+{
+  string,
+  chunked
+};
+
+constexpr Mode modes[]{ Mode::string, Mode::chunked };
+
+[[nodiscard]] auto
+mode_name(const Mode mode) -> const char*
+{
+  switch (mode) {
+    case Mode::string:
+      return "string";
+    case Mode::chunked:
+      return "chunked";
+  }
+  return "";
+}
+
+struct Result final
+{
+  uint64_t output_bytes{ 0 };
+
+  uint64_t peak_bytes{ 0 };
+
+  uint64_t allocated_bytes{ 0 };
+
+  double ms{ 0 };
+
+  bool written{ false };
+};
+
+[[nodiscard]] auto
+generate(const nabla::TranslationUnit& unit, const Mode mode) -> Result
+{
+  nabla::AllocationCounter counter;
+
+  Result result;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  {
+    const nabla::ScopedAllocationHook hook(&counter);
+
+    nabla::codegen::Options options;
+    options.filename = unit.filename;
+
+    auto generator = nabla::codegen::Generator::create("c++", &unit.annotations, options);
+
+    generator->generate(unit.tree);
+
+    result.output_bytes = generator->output().size();
+
+    if (mode == Mode::string) {
+      std::ofstream file("/dev/null", std::ios::binary);
+      file << generator->source();
+      result.written = file.good();
+    } else {
+      const auto fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+      result.written = (fd != -1) && generator->output().write_to(fd);
+      if (fd != -1) {
+        close(fd);
+      }
+    }
+  }
+
+  result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  result.peak_bytes = counter.peak_live_bytes();
+
+  result.allocated_bytes = counter.totals().allocated_bytes;
+
+  return result;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  size_t size{ 20000 };
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    if (arg.substr(0, 7) == "--size=") {
+      const auto value = arg.substr(7);
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), size);
+      if ((result.ptr != (value.data() + value.size())) || (size == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return EXIT_FAILURE;
+      }
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  nabla::TranslationUnit unit;
+
+  unit.filename = "strings.nabla";
+
+  unit.source = nabla::bench::generate_source(nabla::bench::Workload::strings, size);
+
+  if (!nabla::parse_unit(unit, *console) || !nabla::analyze_unit(unit, *console)) {
+    return EXIT_FAILURE;
+  }
+
+  constexpr double mb = 1024.0 * 1024.0;
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << std::left << std::setw(10) << "mode" << std::right << std::setw(12) << "output MB" << std::setw(12)
+            << "peak MB" << std::setw(14) << "allocated MB" << std::setw(12) << "peak/out" << std::setw(10) << "ms"
+            << '\n';
+
+  auto success{ true };
+
+  for (const auto mode : modes) {
+    const auto result = generate(unit, mode);
+
+    if (!result.written) {
+      console->print_error(std::string("failed to write the code in ") + mode_name(mode) + " mode");
+      success = false;
+    }
+
+    const auto output_mb = static_cast<double>(result.output_bytes) / mb;
+
+    const auto peak_mb = static_cast<double>(result.peak_bytes) / mb;
+
+    std::cout << std::left << std::setw(10) << mode_name(mode) << std::right << std::setw(12) << output_mb
+              << std::setw(12) << peak_mb << std::setw(14) << (static_cast<double>(result.allocated_bytes) / mb)
+              << std::setw(12) << (peak_mb / output_mb) << std::setw(10) << result.ms << '\n';
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
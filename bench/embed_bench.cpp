@@ -0,0 +1,296 @@
+/// @file
+///
+/// @brief Measures how many calls per second a host that embeds nabla gets, on one thread and on several.
+///
+/// @details A kernel is compiled once, and the compiled module is shared by every thread. Each thread has an execution
+///          context of its own, and calls it over and over with a different input each time, for the given time. The
+///          output goes to a runtime that discards it. Calls per second per thread stay the same as threads are
+///          added, as long as there are cores for them, unless the threads get in each other's way.
+///
+///          Before anything is timed, every thread checks that its context prints what a context of the main thread
+///          does for the same input.
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+
+#include "buffered_runtime.h"
+#include "console.h"
+#include "engine.h"
+#include "source_generator.h"
+
+namespace {
+
+struct Settings final
+{
+  /// @brief The number of declarations in the kernel.
+  size_t size{ 64 };
+
+  size_t max_threads{ std::max<size_t>(std::thread::hardware_concurrency(), 1) };
+
+  std::chrono::milliseconds min_time{ 500 };
+
+  nabla::Backend backend{ nabla::Backend::interpreter };
+};
+
+class StringSink final : public nabla::ByteSink
+{
+public:
+  void write(const char* data, const size_t size) override { data_.append(data, size); }
+
+  [[nodiscard]] auto data() const -> const std::string& { return data_; }
+
+private:
+  std::string data_;
+};
+
+class NullSink final : public nabla::ByteSink
+{
+public:
+  void write(const char*, size_t) override {}
+};
+
+/// @brief The input of a call, which differs from call to call but stays in the range that the kernel is made for.
+[[nodiscard]] auto
+input_of(const uint64_t call) -> float
+{
+  return 1.0f + (static_cast<float>(call % 64) * 0.125f);
+}
+
+/// @brief Gets what a new context prints for a call.
+[[nodiscard]] auto
+output_of(const std::shared_ptr<const nabla::CompiledModule>& m,
+          const size_t slot,
+          const uint64_t call,
+          const Settings& settings) -> std::string
+{
+  StringSink sink;
+
+  {
+    nabla::BufferedRuntime runtime(&sink);
+    nabla::InterpreterOptions options;
+    options.backend = settings.backend;
+    nabla::ExecutionContext context(m, &runtime, options);
+    context.set_input(slot, input_of(call));
+    context.run();
+  }
+
+  return sink.data();
+}
+
+struct Measurement final
+{
+  uint64_t calls{ 0 };
+
+  double seconds{ 0 };
+
+  bool matched{ true };
+};
+
+/// @brief Calls the module on a number of threads at once, until the time is up.
+[[nodiscard]] auto
+measure(const std::shared_ptr<const nabla::CompiledModule>& m,
+        const size_t slot,
+        const size_t num_threads,
+        const Settings& settings) -> Measurement
+{
+  const auto expected = output_of(m, slot, 1, settings);
+
+  std::atomic<size_t> ready{ 0 };
+
+  std::atomic<bool> start{ false };
+
+  std::atomic<bool> stop{ false };
+
+  std::atomic<uint64_t> calls{ 0 };
+
+  std::atomic<bool> matched{ true };
+
+  std::vector<std::thread> threads;
+
+  for (size_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([&, i]() {
+      if (output_of(m, slot, 1, settings) != expected) {
+        matched = false;
+      }
+
+      NullSink sink;
+      nabla::BufferedRuntime runtime(&sink);
+      nabla::InterpreterOptions options;
+      options.backend = settings.backend;
+      nabla::ExecutionContext context(m, &runtime, options);
+
+      // The first call is left out, since that is when storage is allocated and the JIT compiles.
+      context.run();
+
+      ready++;
+
+      while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+
+      uint64_t count{ 0 };
+
+      // Threads start from different inputs, as separate requests would.
+      for (auto call = i * 7; !stop.load(std::memory_order_relaxed); call++) {
+        context.set_input(slot, input_of(call));
+        context.run();
+        count++;
+      }
+
+      calls += count;
+    });
+  }
+
+  while (ready.load() < num_threads) {
+    std::this_thread::yield();
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+
+  start.store(true, std::memory_order_release);
+
+  std::this_thread::sleep_for(settings.min_time);
+
+  stop = true;
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // Threads finish the call that they are in, which is counted, so the time is taken after they have all finished.
+  const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  return Measurement{ calls.load(), seconds, matched.load() };
+}
+
+/// @return False if there is no backend by this name.
+[[nodiscard]] auto
+parse_backend(const std::string_view& name, nabla::Backend& backend) -> bool
+{
+  const std::pair<const char*, nabla::Backend> backends[]{ { "interpreter", nabla::Backend::interpreter },
+                                                           { "jit", nabla::Backend::jit },
+                                                           { "parallel", nabla::Backend::parallel },
+                                                           { "batch", nabla::Backend::batch } };
+
+  for (const auto& [backend_name, value] : backends) {
+    if (name == backend_name) {
+      backend = value;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  Settings settings;
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    const auto parse_count = [&console, &arg](const std::string_view& value, size_t& count) {
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), count);
+      if ((result.ptr != (value.data() + value.size())) || (count == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return false;
+      }
+      return true;
+    };
+    if (arg.substr(0, 7) == "--size=") {
+      if (!parse_count(arg.substr(7), settings.size)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 10) == "--threads=") {
+      if (!parse_count(arg.substr(10), settings.max_threads)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 11) == "--min-time=") {
+      size_t ms{ 0 };
+      if (!parse_count(arg.substr(11), ms)) {
+        return EXIT_FAILURE;
+      }
+      settings.min_time = std::chrono::milliseconds(ms);
+    } else if (arg.substr(0, 10) == "--backend=") {
+      if (!parse_backend(arg.substr(10), settings.backend)) {
+        console->print_error("unknown backend in '" + std::string(arg) + "'");
+        return EXIT_FAILURE;
+      }
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto source = nabla::bench::generate_kernel(nabla::bench::Kernel::float_chain, settings.size);
+
+  nabla::EngineOptions engine_options;
+
+  engine_options.inputs = nabla::bench::kernel_inputs(nabla::bench::Kernel::float_chain, settings.size);
+
+  const auto m = nabla::Engine::create(engine_options)->compile("float_chain.nabla", source, *console);
+
+  if (!m) {
+    return EXIT_FAILURE;
+  }
+
+  const auto slot = m->find_input(engine_options.inputs.at(0));
+
+  auto success{ true };
+
+  std::cout << std::fixed << std::setprecision(0);
+
+  std::cout << std::left << std::setw(10) << "threads" << std::right << std::setw(16) << "calls/s" << std::setw(16)
+            << "calls/s/core" << std::setw(12) << "scaling" << '\n';
+
+  // Powers of two, and then the most threads, even if it is not one.
+  std::vector<size_t> thread_counts;
+
+  for (size_t num_threads = 1; num_threads < settings.max_threads; num_threads *= 2) {
+    thread_counts.emplace_back(num_threads);
+  }
+
+  thread_counts.emplace_back(settings.max_threads);
+
+  double single_thread{ 0 };
+
+  for (const auto num_threads : thread_counts) {
+    const auto measurement = measure(m, slot, num_threads, settings);
+
+    if (!measurement.matched) {
+      console->print_error("a context printed something different on another thread");
+      success = false;
+    }
+
+    const auto calls_per_second = static_cast<double>(measurement.calls) / measurement.seconds;
+
+    const auto per_core = calls_per_second / static_cast<double>(num_threads);
+
+    if (num_threads == 1) {
+      single_thread = per_core;
+    }
+
+    std::cout << std::left << std::setw(10) << num_threads << std::right << std::setw(16) << calls_per_second
+              << std::setw(16) << per_core << std::setw(11) << std::setprecision(2) << (per_core / single_thread)
+              << 'x' << std::setprecision(0) << '\n';
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
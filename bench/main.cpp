@@ -0,0 +1,412 @@
+/// @file
+///
+/// @brief Measures the throughput of each phase of the compiler on generated programs.
+///
+/// @details Every workload is compiled at two sizes, the second twice the first, and each phase is timed with the same
+///          scopes as the time report of the compiler. The fastest of several runs is kept. Time that more than
+///          doubles along with the program points to something quadratic, and is flagged.
+///
+///          Results can be saved with --output, as tab-separated values, and compared against with --baseline, in
+///          which case phases that got slower than allowed make the benchmark fail.
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <stdlib.h>
+
+#include "codegen/generator.h"
+#include "console.h"
+#include "engine.h"
+#include "frontend.h"
+#include "source_generator.h"
+#include "time_trace.h"
+
+namespace {
+
+using Phase = nabla::TimeTrace::Phase;
+
+/// @brief The phases that are measured, in the order that they run.
+constexpr Phase phases[]{ Phase::lex,      Phase::parse,     Phase::annotate,
+                          Phase::validate, Phase::build_ast, Phase::codegen };
+
+/// @brief The size of each workload at a scale of one, which takes a few milliseconds to compile.
+[[nodiscard]] auto
+base_size(const nabla::bench::Workload workload) -> size_t
+{
+  switch (workload) {
+    case nabla::bench::Workload::let_chain:
+      return 1000;
+    case nabla::bench::Workload::wide_expr:
+      return 1000;
+    case nabla::bench::Workload::structs:
+      return 2000;
+    case nabla::bench::Workload::functions:
+      return 1000;
+    case nabla::bench::Workload::comments:
+      return 2000;
+    case nabla::bench::Workload::strings:
+      return 2000;
+  }
+  return 0;
+}
+
+/// @brief Whether programs of a workload can be built into an AST. The AST builder rejects function calls, so the
+///        functions workload stops after validation and code generation.
+[[nodiscard]] auto
+builds_ast(const nabla::bench::Workload workload) -> bool
+{
+  return workload != nabla::bench::Workload::functions;
+}
+
+/// @brief The fastest time of a phase on one program.
+struct Result final
+{
+  std::string workload;
+
+  std::string phase;
+
+  size_t size{ 0 };
+
+  /// @brief The length of the source.
+  size_t bytes{ 0 };
+
+  /// @brief The tokens that the lexer produced, or the syntax tree nodes that other phases went through.
+  size_t items{ 0 };
+
+  uint64_t ns{ 0 };
+};
+
+using ResultKey = std::tuple<std::string, std::string, size_t>;
+
+[[nodiscard]] auto
+key_of(const Result& result) -> ResultKey
+{
+  return ResultKey(result.workload, result.phase, result.size);
+}
+
+/// @brief Compiles a program, keeping the fastest time of each phase in the results.
+///
+/// @param build_ast Whether the AST is built, which is left out of the results if it is not.
+///
+/// @return False if the program has errors, which is a bug in the generator.
+[[nodiscard]] auto
+measure(const std::string& name,
+        const std::string& source,
+        const bool build_ast,
+        nabla::Console& console,
+        std::map<Phase, Result>& results) -> bool
+{
+  nabla::TimeTrace trace;
+
+  nabla::TranslationUnit unit;
+
+  unit.filename = name + ".nabla";
+
+  unit.source = source;
+
+  if (!nabla::parse_unit(unit, console, &trace) || !nabla::analyze_unit(unit, console, &trace)) {
+    return false;
+  }
+
+  const auto num_nodes = nabla::count_nodes(unit.tree);
+
+  {
+    nabla::TimeTrace::Scope scope(&trace, Phase::codegen, unit.filename);
+    scope.set_nodes(num_nodes);
+    nabla::codegen::Options options;
+    options.filename = unit.filename;
+    auto generator = nabla::codegen::Generator::create("c++", &unit.annotations, options);
+    generator->generate(unit.tree);
+  }
+
+  // The engine annotates the unit again, so only the AST is taken from its trace.
+  nabla::TimeTrace engine_trace;
+
+  if (build_ast) {
+    auto engine_unit = std::make_shared<nabla::TranslationUnit>();
+    engine_unit->filename = unit.filename;
+    engine_unit->source = source;
+    if (!nabla::parse_unit(*engine_unit, console)) {
+      return false;
+    }
+    nabla::EngineOptions options;
+    options.optimize = false;
+    options.trace = &engine_trace;
+    auto engine = nabla::Engine::create(options);
+    if (!engine->compile(std::move(engine_unit), console)) {
+      return false;
+    }
+  }
+
+  auto totals = trace.phase_totals();
+
+  totals[Phase::build_ast] = engine_trace.phase_totals()[Phase::build_ast];
+
+  for (const auto phase : phases) {
+    if ((phase == Phase::build_ast) && !build_ast) {
+      continue;
+    }
+    const auto& phase_totals = totals[phase];
+    auto& result = results[phase];
+    if ((result.ns == 0) || (phase_totals.wall_time < result.ns)) {
+      result.ns = phase_totals.wall_time;
+    }
+    result.items = (phase == Phase::lex) ? phase_totals.tokens : phase_totals.nodes;
+  }
+
+  return true;
+}
+
+/// @brief Formats a number of things per second, such as "1.25M".
+[[nodiscard]] auto
+format_rate(const double rate) -> std::string
+{
+  std::ostringstream stream;
+
+  stream << std::fixed << std::setprecision(2);
+
+  if (rate >= 1e6) {
+    stream << (rate / 1e6) << 'M';
+  } else if (rate >= 1e3) {
+    stream << (rate / 1e3) << 'k';
+  } else {
+    stream << rate;
+  }
+
+  return stream.str();
+}
+
+[[nodiscard]] auto
+write_results(const std::vector<Result>& results, const std::string& path, nabla::Console& console) -> bool
+{
+  std::ofstream file(path);
+
+  file << "workload\tphase\tsize\tbytes\titems\tns\n";
+
+  for (const auto& result : results) {
+    file << result.workload << '\t' << result.phase << '\t' << result.size << '\t' << result.bytes << '\t'
+         << result.items << '\t' << result.ns << '\n';
+  }
+
+  if (!file.good()) {
+    console.print_file_error(path, "failed to write results");
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Reads results written by @ref write_results.
+[[nodiscard]] auto
+read_results(const std::string& path, nabla::Console& console, std::vector<Result>& results) -> bool
+{
+  std::ifstream file(path);
+
+  if (!file.good()) {
+    console.print_file_error(path, "failed to open baseline");
+    return false;
+  }
+
+  std::string line;
+
+  // The first line names the columns.
+  std::getline(file, line);
+
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    Result result;
+    if (!std::getline(fields, result.workload, '\t') || !std::getline(fields, result.phase, '\t') ||
+        !(fields >> result.size >> result.bytes >> result.items >> result.ns)) {
+      console.print_file_error(path, "invalid result '" + line + "'");
+      return false;
+    }
+    results.emplace_back(std::move(result));
+  }
+
+  return true;
+}
+
+/// @return False if any phase got slower than allowed.
+[[nodiscard]] auto
+compare(const std::vector<Result>& baseline, const std::vector<Result>& results, const double max_slowdown) -> bool
+{
+  std::map<ResultKey, const Result*> previous;
+
+  for (const auto& result : baseline) {
+    previous[key_of(result)] = &result;
+  }
+
+  auto success{ true };
+
+  std::cout << '\n'
+            << std::left << std::setw(12) << "workload" << std::setw(12) << "phase" << std::right << std::setw(8)
+            << "size" << std::setw(14) << "baseline ms" << std::setw(12) << "now ms" << std::setw(10) << "change"
+            << '\n';
+
+  for (const auto& result : results) {
+    const auto it = previous.find(key_of(result));
+    if ((it == previous.end()) || (it->second->ns == 0)) {
+      continue;
+    }
+    const auto change = (static_cast<double>(result.ns) / static_cast<double>(it->second->ns)) - 1.0;
+    std::cout << std::left << std::setw(12) << result.workload << std::setw(12) << result.phase << std::right
+              << std::setw(8) << result.size << std::setw(14) << (static_cast<double>(it->second->ns) / 1e6)
+              << std::setw(12) << (static_cast<double>(result.ns) / 1e6) << std::setw(9) << (change * 100.0) << '%';
+    // Phases that take microseconds are too noisy to compare.
+    if ((change > max_slowdown) && ((result.ns - it->second->ns) > 100000)) {
+      std::cout << "  slower";
+      success = false;
+    }
+    std::cout << '\n';
+  }
+
+  return success;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  size_t scale{ 1 };
+
+  size_t repeat{ 5 };
+
+  std::vector<std::string> only;
+
+  std::string output_path;
+
+  std::string baseline_path;
+
+  double max_slowdown_percent{ 10 };
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    const auto parse_count = [&console, &arg](const std::string_view& value, size_t& count) {
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), count);
+      if ((result.ptr != (value.data() + value.size())) || (count == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return false;
+      }
+      return true;
+    };
+    if (arg.substr(0, 8) == "--scale=") {
+      if (!parse_count(arg.substr(8), scale)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 9) == "--repeat=") {
+      if (!parse_count(arg.substr(9), repeat)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 11) == "--workload=") {
+      only.emplace_back(arg.substr(11));
+    } else if (arg.substr(0, 9) == "--output=") {
+      output_path = arg.substr(9);
+    } else if (arg.substr(0, 11) == "--baseline=") {
+      baseline_path = arg.substr(11);
+    } else if (arg.substr(0, 15) == "--max-slowdown=") {
+      const auto value = arg.substr(15);
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), max_slowdown_percent);
+      if ((result.ptr != (value.data() + value.size())) || (max_slowdown_percent < 0)) {
+        console->print_error("invalid slowdown '" + std::string(value) + "'");
+        return EXIT_FAILURE;
+      }
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<Result> results;
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << std::left << std::setw(12) << "workload" << std::setw(12) << "phase" << std::right << std::setw(8)
+            << "size" << std::setw(10) << "ms" << std::setw(10) << "2x ms" << std::setw(10) << "MB/s" << std::setw(18)
+            << "throughput" << std::setw(8) << "growth" << '\n';
+
+  for (const auto workload : nabla::bench::workloads) {
+    const std::string name = nabla::bench::workload_name(workload);
+
+    if (!only.empty() && (std::find(only.begin(), only.end(), name) == only.end())) {
+      continue;
+    }
+
+    const auto size = base_size(workload) * scale;
+
+    std::map<Phase, Result> at_size[2];
+
+    for (size_t i = 0; i < 2; i++) {
+      const auto source = nabla::bench::generate_source(workload, size << i);
+      for (size_t j = 0; j < repeat; j++) {
+        if (!measure(name, source, builds_ast(workload), *console, at_size[i])) {
+          console->print_error("the generated " + name + " program has errors");
+          return EXIT_FAILURE;
+        }
+      }
+      for (auto& [phase, result] : at_size[i]) {
+        result.workload = name;
+        result.phase = nabla::TimeTrace::phase_name(phase);
+        result.size = size << i;
+        result.bytes = source.size();
+        results.emplace_back(result);
+      }
+    }
+
+    for (const auto phase : phases) {
+      if (at_size[1].count(phase) == 0) {
+        continue;
+      }
+      const auto& small = at_size[0][phase];
+      const auto& large = at_size[1][phase];
+      const auto seconds = static_cast<double>(large.ns) / 1e9;
+      std::cout << std::left << std::setw(12) << name << std::setw(12) << large.phase << std::right << std::setw(8)
+                << size << std::setw(10) << (static_cast<double>(small.ns) / 1e6) << std::setw(10)
+                << (static_cast<double>(large.ns) / 1e6) << std::setw(10)
+                << ((large.ns > 0) ? (static_cast<double>(large.bytes) / seconds / 1e6) : 0.0) << std::setw(18)
+                << (format_rate((large.ns > 0) ? (static_cast<double>(large.items) / seconds) : 0.0) +
+                    ((phase == Phase::lex) ? " tokens/s" : " nodes/s"));
+      // How the time grows with the size of the program, which is one for linear time and two for quadratic.
+      if ((small.ns > 0) && (large.ns > 0)) {
+        const auto growth = std::log2(static_cast<double>(large.ns) / static_cast<double>(small.ns));
+        std::cout << std::setw(8) << growth;
+        // Short phases are too noisy to tell.
+        if ((growth > 1.5) && (large.ns > 1000000)) {
+          std::cout << "  superlinear";
+        }
+      }
+      std::cout << '\n';
+    }
+  }
+
+  if (!output_path.empty() && !write_results(results, output_path, *console)) {
+    return EXIT_FAILURE;
+  }
+
+  if (!baseline_path.empty()) {
+    std::vector<Result> baseline;
+    if (!read_results(baseline_path, *console, baseline)) {
+      return EXIT_FAILURE;
+    }
+    if (!compare(baseline, results, max_slowdown_percent / 100.0)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
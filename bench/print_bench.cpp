@@ -0,0 +1,270 @@
+/// @file
+///
+/// @brief Measures how fast the runtimes print, on a program that does little besides printing.
+///
+/// @details The program prints lines of integers, floats and strings, and is executed by the interpreter until it has
+///          printed at least the given number of lines. The runtimes are:
+///
+///          - ostream: the base runtime, which prints to std::cout and flushes it at the end of every line.
+///          - buffered: BufferedRuntime writing to standard output, which it only does when its buffer fills up.
+///          - buffered-sink: BufferedRuntime writing to a sink that discards the output, which leaves only formatting.
+///
+///          Standard output is sent to a file for the length of the benchmark, which is /dev/null unless --output
+///          says otherwise. The runtimes are first checked to print exactly the same thing.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "buffered_runtime.h"
+#include "console.h"
+#include "engine.h"
+#include "process.h"
+#include "source_generator.h"
+
+namespace {
+
+struct Settings final
+{
+  size_t lines{ 1000000 };
+
+  /// @brief The number of print statements in the program.
+  size_t size{ 1000 };
+
+  size_t repeat{ 3 };
+
+  std::string output_path{ "/dev/null" };
+};
+
+class NullSink final : public nabla::ByteSink
+{
+public:
+  void write(const char*, size_t) override {}
+};
+
+/// @brief The runtimes, each of which prints to standard output except for the one that discards everything.
+enum class Mode
+{
+  ostream,
+  buffered,
+  buffered_sink
+};
+
+constexpr Mode modes[]{ Mode::ostream, Mode::buffered, Mode::buffered_sink };
+
+[[nodiscard]] auto
+mode_name(const Mode mode) -> const char*
+{
+  switch (mode) {
+    case Mode::ostream:
+      return "ostream";
+    case Mode::buffered:
+      return "buffered";
+    case Mode::buffered_sink:
+      return "buffered-sink";
+  }
+  return "";
+}
+
+/// @brief Executes the program a number of times with a new runtime, which is flushed before the time is taken.
+///
+/// @return The time it took, in seconds.
+[[nodiscard]] auto
+run(const std::shared_ptr<const nabla::CompiledModule>& m, const Mode mode, const size_t executions) -> double
+{
+  NullSink sink;
+
+  std::unique_ptr<nabla::Runtime> runtime;
+
+  switch (mode) {
+    case Mode::ostream:
+      runtime = std::make_unique<nabla::Runtime>();
+      break;
+    case Mode::buffered:
+      runtime = std::make_unique<nabla::BufferedRuntime>(STDOUT_FILENO);
+      break;
+    case Mode::buffered_sink:
+      runtime = std::make_unique<nabla::BufferedRuntime>(&sink);
+      break;
+  }
+
+  nabla::ExecutionContext context(m, runtime.get());
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < executions; i++) {
+    context.run();
+  }
+
+  // Destroying the runtime writes what is left in its buffer.
+  runtime.reset();
+
+  std::cout.flush();
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// @brief Sends standard output to a file until the object is destroyed.
+class StdoutRedirect final
+{
+public:
+  explicit StdoutRedirect(const std::string& path)
+    : saved_(dup(STDOUT_FILENO))
+  {
+    std::cout.flush();
+    const auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    valid_ = (saved_ != -1) && (fd != -1) && (dup2(fd, STDOUT_FILENO) != -1);
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+
+  StdoutRedirect(const StdoutRedirect&) = delete;
+
+  auto operator=(const StdoutRedirect&) -> StdoutRedirect& = delete;
+
+  ~StdoutRedirect()
+  {
+    std::cout.flush();
+    if (saved_ != -1) {
+      dup2(saved_, STDOUT_FILENO);
+      close(saved_);
+    }
+  }
+
+  [[nodiscard]] auto valid() const -> bool { return valid_; }
+
+private:
+  int saved_{ -1 };
+
+  bool valid_{ false };
+};
+
+/// @brief Checks that the runtimes that print to standard output print the same thing, by printing to files.
+[[nodiscard]] auto
+check_outputs(const std::shared_ptr<const nabla::CompiledModule>& m, nabla::Console& console) -> bool
+{
+  const auto dir = std::filesystem::temp_directory_path();
+
+  std::string expected;
+
+  for (const auto mode : { Mode::ostream, Mode::buffered }) {
+    const auto path = (dir / (std::string("nabla-print-bench-") + mode_name(mode) + ".txt")).string();
+    {
+      const StdoutRedirect redirect(path);
+      if (!redirect.valid()) {
+        console.print_file_error(path, "failed to redirect standard output");
+        return false;
+      }
+      (void)run(m, mode, 1);
+    }
+    auto output = nabla::bench::read_file(path);
+    std::filesystem::remove(path);
+    if (mode == Mode::ostream) {
+      expected = std::move(output);
+    } else if (output != expected) {
+      console.print_error(std::string("the ") + mode_name(mode) + " runtime printed something different");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  Settings settings;
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    const auto parse_count = [&console, &arg](const std::string_view& value, size_t& count) {
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), count);
+      if ((result.ptr != (value.data() + value.size())) || (count == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return false;
+      }
+      return true;
+    };
+    if (arg.substr(0, 8) == "--lines=") {
+      if (!parse_count(arg.substr(8), settings.lines)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 7) == "--size=") {
+      if (!parse_count(arg.substr(7), settings.size)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 9) == "--repeat=") {
+      if (!parse_count(arg.substr(9), settings.repeat)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 9) == "--output=") {
+      settings.output_path = arg.substr(9);
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  const auto source = nabla::bench::generate_kernel(nabla::bench::Kernel::print_heavy, settings.size);
+
+  const auto m = nabla::Engine::create()->compile("print_heavy.nabla", source, *console);
+
+  if (!m || !check_outputs(m, *console)) {
+    return EXIT_FAILURE;
+  }
+
+  // Each print statement of the kernel prints one line.
+  const auto executions = (settings.lines + settings.size - 1) / settings.size;
+
+  const auto lines = static_cast<double>(executions * settings.size);
+
+  std::vector<std::pair<Mode, double>> results;
+
+  {
+    const StdoutRedirect redirect(settings.output_path);
+
+    if (!redirect.valid()) {
+      console->print_file_error(settings.output_path, "failed to redirect standard output");
+      return EXIT_FAILURE;
+    }
+
+    for (const auto mode : modes) {
+      auto seconds = run(m, mode, executions);
+      for (size_t i = 1; i < settings.repeat; i++) {
+        seconds = std::min(seconds, run(m, mode, executions));
+      }
+      results.emplace_back(mode, seconds);
+    }
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << std::left << std::setw(16) << "runtime" << std::right << std::setw(14) << "lines/s" << std::setw(12)
+            << "ns/line" << std::setw(10) << "speedup" << '\n';
+
+  for (const auto& [mode, seconds] : results) {
+    std::cout << std::left << std::setw(16) << mode_name(mode) << std::right << std::setw(14) << std::setprecision(0)
+              << (lines / seconds) << std::setw(12) << std::setprecision(2) << ((seconds * 1e9) / lines)
+              << std::setw(9) << (results.front().second / seconds) << 'x' << '\n';
+  }
+
+  return EXIT_SUCCESS;
+}
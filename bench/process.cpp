@@ -0,0 +1,72 @@
+#include "process.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace nabla::bench {
+
+auto
+start_program(const std::vector<std::string>& args,
+              const std::filesystem::path& stdout_path,
+              const std::filesystem::path& stderr_path) -> pid_t
+{
+  std::vector<char*> argv;
+
+  for (const auto& arg : args) {
+    argv.emplace_back(const_cast<char*>(arg.c_str()));
+  }
+
+  argv.emplace_back(nullptr);
+
+  posix_spawn_file_actions_t actions;
+
+  posix_spawn_file_actions_init(&actions);
+
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, stdout_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, stderr_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  pid_t pid{ -1 };
+
+  const auto spawned = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ) == 0;
+
+  posix_spawn_file_actions_destroy(&actions);
+
+  return spawned ? pid : -1;
+}
+
+auto
+wait_program(const pid_t pid) -> bool
+{
+  int status{ 0 };
+
+  return (waitpid(pid, &status, 0) == pid) && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+auto
+run_program(const std::vector<std::string>& args,
+            const std::filesystem::path& stdout_path,
+            const std::filesystem::path& stderr_path) -> bool
+{
+  const auto pid = start_program(args, stdout_path, stderr_path);
+
+  return (pid != -1) && wait_program(pid);
+}
+
+auto
+read_file(const std::filesystem::path& path) -> std::string
+{
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+
+} // namespace nabla::bench
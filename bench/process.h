@@ -0,0 +1,36 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace nabla::bench {
+
+/// @brief Starts a program, with its standard output and error written to files.
+///
+/// @return The process ID, or -1 if the program could not be started.
+[[nodiscard]] auto
+start_program(const std::vector<std::string>& args,
+              const std::filesystem::path& stdout_path,
+              const std::filesystem::path& stderr_path) -> pid_t;
+
+/// @brief Waits for a program that was started with @ref start_program.
+///
+/// @return False if the program did not succeed.
+[[nodiscard]] auto
+wait_program(pid_t pid) -> bool;
+
+/// @brief Runs a program and waits for it.
+///
+/// @return False if the program could not be started or did not succeed.
+[[nodiscard]] auto
+run_program(const std::vector<std::string>& args,
+            const std::filesystem::path& stdout_path,
+            const std::filesystem::path& stderr_path) -> bool;
+
+[[nodiscard]] auto
+read_file(const std::filesystem::path& path) -> std::string;
+
+} // namespace nabla::bench
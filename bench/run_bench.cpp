@@ -0,0 +1,591 @@
+/// @file
+///
+/// @brief Measures how fast each backend executes generated programs, and checks that they all print the same thing.
+///
+/// @details Every kernel is compiled once and then executed repeatedly by each backend, until that takes long enough to
+///          time. The native backend is the generated C++, built with the system compiler into a program that executes
+///          the kernel as often as it is told to and times itself, so that starting the process is not measured. Since
+///          the native compiler sees every value of a kernel, it may compute them at compile time, which the other
+///          backends have no way to do.
+///
+///          Allocations are counted on a separate pass, since counting them slows allocation down. They are not
+///          counted for the native backend, which runs in a process of its own.
+///
+///          With --rows=N, the operands of each kernel are made inputs, and each execution computes N rows of them,
+///          which is what the batch backend is for. Times are then per row. The native backend is left out, since the
+///          generated code has no inputs.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "buffered_runtime.h"
+#include "codegen/generator.h"
+#include "console.h"
+#include "engine.h"
+#include "frontend.h"
+#include "memory_usage.h"
+#include "native_build.h"
+#include "process.h"
+#include "source_generator.h"
+
+namespace {
+
+using nabla::bench::read_file;
+using nabla::bench::run_program;
+
+struct BackendInfo final
+{
+  const char* name;
+
+  /// @brief The backend, or nothing for the native one.
+  std::optional<nabla::Backend> backend;
+};
+
+/// @brief Every backend, with the one that the others are compared against first.
+const BackendInfo backends[]{ { "interpreter", nabla::Backend::interpreter },
+                              { "jit", nabla::Backend::jit },
+                              { "parallel", nabla::Backend::parallel },
+                              { "batch", nabla::Backend::batch },
+                              { "native", std::nullopt } };
+
+/// @brief What the benchmark was asked to do.
+struct Settings final
+{
+  size_t size{ 1000 };
+
+  size_t repeat{ 3 };
+
+  /// @brief The number of rows of inputs that each execution computes.
+  size_t rows{ 1 };
+
+  /// @brief How long a measurement must take for its time to count.
+  std::chrono::nanoseconds min_time{ std::chrono::milliseconds(100) };
+
+  std::vector<std::string> only_kernels;
+
+  std::vector<std::string> only_backends;
+
+  std::string output_path;
+
+  nabla::NativeBuildOptions native_build_options;
+};
+
+struct Result final
+{
+  std::string kernel;
+
+  std::string backend;
+
+  /// @brief The time to execute the kernel for one row of inputs.
+  double ns_per_op{ 0 };
+
+  /// @brief Per row. Negative if allocations were not counted.
+  double allocs_per_op{ -1 };
+};
+
+class StringSink final : public nabla::ByteSink
+{
+public:
+  void write(const char* data, const size_t size) override { data_.append(data, size); }
+
+  [[nodiscard]] auto data() const -> const std::string& { return data_; }
+
+private:
+  std::string data_;
+};
+
+/// @brief Times a number of executions, returning false if they failed.
+using Timer = std::function<bool(uint64_t iterations, uint64_t& ns)>;
+
+/// @brief Finds the time per execution, raising the number of executions until they take long enough to time. The
+///        fastest of several measurements is kept.
+[[nodiscard]] auto
+measure(const Timer& timer, const Settings& settings, double& ns_per_op) -> bool
+{
+  const auto min_ns = static_cast<uint64_t>(settings.min_time.count());
+
+  uint64_t iterations{ 1 };
+
+  uint64_t ns{ 0 };
+
+  for (;;) {
+    if (!timer(iterations, ns)) {
+      return false;
+    }
+    if ((ns >= min_ns) || (iterations >= (uint64_t(1) << 32))) {
+      break;
+    }
+    // Aim for a bit over the minimum time, but don't trust a very short measurement to say how far off it is.
+    const auto target = (ns > 0) ? ((iterations * min_ns * 5) / (ns * 4)) : (iterations * 100);
+    iterations = std::clamp<uint64_t>(target, iterations * 2, iterations * 100);
+  }
+
+  ns_per_op = static_cast<double>(ns) / static_cast<double>(iterations);
+
+  for (size_t i = 1; i < settings.repeat; i++) {
+    if (!timer(iterations, ns)) {
+      return false;
+    }
+    ns_per_op = std::min(ns_per_op, static_cast<double>(ns) / static_cast<double>(iterations));
+  }
+
+  return true;
+}
+
+[[nodiscard]] auto
+elapsed_ns(const std::chrono::steady_clock::time_point start) -> uint64_t
+{
+  return static_cast<uint64_t>(
+    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/// @brief Makes the rows of inputs that each execution computes. Each row differs a little from the default values, so
+///        that the values stay in the range that the kernel was generated for.
+[[nodiscard]] auto
+make_rows(const nabla::ast::Module& m, const size_t num_rows) -> std::vector<nabla::ast::Scalar>
+{
+  std::vector<nabla::ast::Scalar> rows;
+
+  rows.reserve(num_rows * m.inputs.size());
+
+  for (size_t row = 0; row < num_rows; row++) {
+    const auto offset = static_cast<int>(row % 16);
+    for (const auto& input : m.inputs) {
+      auto value = input.default_value;
+      if (input.type == nabla::ast::ScalarType::int_) {
+        value.int_value += offset;
+      } else {
+        value.float_value += static_cast<float>(offset) * 0.25f;
+      }
+      rows.emplace_back(value);
+    }
+  }
+
+  return rows;
+}
+
+/// @brief Executes a kernel in this process.
+///
+/// @param rows The inputs of each row, or null to execute with the default inputs.
+///
+/// @param output Where the output of a single execution is put, for comparing backends.
+[[nodiscard]] auto
+run_in_process(const std::shared_ptr<const nabla::CompiledModule>& m,
+               const nabla::Backend backend,
+               const nabla::ast::Scalar* rows,
+               const Settings& settings,
+               std::string& output) -> Result
+{
+  nabla::InterpreterOptions options;
+  options.backend = backend;
+
+  const auto num_rows = settings.rows;
+
+  {
+    StringSink sink;
+    nabla::BufferedRuntime runtime(&sink);
+    nabla::ExecutionContext context(m, &runtime, options);
+    context.run_batch(rows, num_rows);
+    runtime.flush();
+    output = sink.data();
+  }
+
+  // Output is formatted and written the same way as when printing to a terminal, but it goes nowhere.
+  const auto null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+  nabla::BufferedRuntime runtime(null_fd);
+
+  nabla::ExecutionContext context(m, &runtime, options);
+
+  // The first execution is left out, since that is when the JIT compiles and storage is allocated.
+  context.run_batch(rows, num_rows);
+
+  Result result;
+
+  const Timer timer = [&context, rows, num_rows](const uint64_t iterations, uint64_t& ns) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iterations; i++) {
+      context.run_batch(rows, num_rows);
+    }
+    ns = elapsed_ns(start);
+    return true;
+  };
+
+  (void)measure(timer, settings, result.ns_per_op);
+
+  result.ns_per_op /= static_cast<double>(num_rows);
+
+  // About a hundred rows are enough to count, and executions of many rows take long.
+  const uint64_t counted_iterations = std::max<uint64_t>(100 / num_rows, 1);
+
+  nabla::AllocationCounter counter;
+
+  {
+    const nabla::ScopedAllocationHook hook(&counter);
+    for (uint64_t i = 0; i < counted_iterations; i++) {
+      context.run_batch(rows, num_rows);
+    }
+  }
+
+  result.allocs_per_op =
+    static_cast<double>(counter.totals().allocations) / static_cast<double>(counted_iterations * num_rows);
+
+  runtime.flush();
+
+  close(null_fd);
+
+  return result;
+}
+
+/// @brief Builds a kernel with the system compiler, into a program that takes the number of times to execute it and
+///        writes how many nanoseconds that took to standard error.
+[[nodiscard]] auto
+build_native(nabla::TranslationUnit& unit,
+             const std::string& name,
+             const Settings& settings,
+             nabla::Console& console,
+             std::filesystem::path& program) -> bool
+{
+  const auto unit_namespace = "nabla_kernel_" + name;
+
+  nabla::codegen::Options options;
+  options.filename = unit.filename;
+  options.unit_namespace = unit_namespace;
+
+  auto generator = nabla::codegen::Generator::create("c++", &unit.annotations, options);
+
+  generator->generate(unit.tree);
+
+  nabla::NativeBuild build(settings.native_build_options);
+
+  const auto header = generator->take_header();
+
+  if (!header.empty()) {
+    build.add_header(unit_namespace + ".h", header.str());
+  }
+
+  const auto units = generator->take_units();
+
+  for (size_t i = 0; i < units.size(); i++) {
+    build.add_unit(unit_namespace + "_" + std::to_string(i), units[i].str());
+  }
+
+  std::ostringstream main_source;
+
+  main_source << "#include \"nabla_rt.h\"\n\n#include <chrono>\n#include <cstdio>\n#include <cstdlib>\n\n";
+  main_source << "namespace " << unit_namespace << " {\nvoid\nentry();\n}\n\n";
+  main_source << "int\nmain(int argc, char** argv)\n{\n";
+  main_source << "  const auto iterations = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1;\n";
+  main_source << "  const auto start = std::chrono::steady_clock::now();\n";
+  main_source << "  for (unsigned long long i = 0; i < iterations; i++) {\n";
+  main_source << "    " << unit_namespace << "::entry();\n";
+  main_source << "  }\n";
+  main_source << "  nabla::rt::flush();\n";
+  main_source << "  const auto end = std::chrono::steady_clock::now();\n";
+  main_source << "  std::fprintf(stderr, \"%lld\\n\", static_cast<long long>(";
+  main_source << "std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()));\n";
+  main_source << "  return 0;\n}\n";
+
+  build.add_unit("main_" + name, main_source.str());
+
+  program = settings.native_build_options.build_dir / name;
+
+  return build.link(program, console);
+}
+
+/// @brief Builds a kernel with the system compiler and executes it.
+///
+/// @return Nothing if the kernel could not be built or failed.
+[[nodiscard]] auto
+run_native(nabla::TranslationUnit& unit,
+           const std::string& name,
+           const Settings& settings,
+           nabla::Console& console,
+           std::string& output) -> std::optional<Result>
+{
+  std::filesystem::path program;
+
+  if (!build_native(unit, name, settings, console, program)) {
+    return std::nullopt;
+  }
+
+  const auto output_path = program.string() + ".out";
+
+  const auto time_path = program.string() + ".time";
+
+  if (!run_program({ program.string(), "1" }, output_path, time_path)) {
+    console.print_file_error(program.string(), "failed to run");
+    return std::nullopt;
+  }
+
+  output = read_file(output_path);
+
+  const Timer timer = [&program, &time_path](const uint64_t iterations, uint64_t& ns) {
+    if (!run_program({ program.string(), std::to_string(iterations) }, "/dev/null", time_path)) {
+      return false;
+    }
+    std::istringstream stream(read_file(time_path));
+    return static_cast<bool>(stream >> ns);
+  };
+
+  Result result;
+
+  if (!measure(timer, settings, result.ns_per_op)) {
+    console.print_file_error(program.string(), "failed to run");
+    return std::nullopt;
+  }
+
+  return result;
+}
+
+/// @brief Whether the system compiler can be run, without which there is no native backend.
+[[nodiscard]] auto
+has_native_compiler(const Settings& settings) -> bool
+{
+  return run_program({ settings.native_build_options.compiler, "--version" }, "/dev/null", "/dev/null");
+}
+
+/// @return The line that two outputs first differ on, counting from one.
+[[nodiscard]] auto
+first_difference(const std::string& a, const std::string& b) -> size_t
+{
+  const auto mismatch = std::mismatch(a.begin(), a.end(), b.begin(), b.end());
+  return static_cast<size_t>(std::count(a.begin(), mismatch.first, '\n')) + 1;
+}
+
+[[nodiscard]] auto
+selected(const std::vector<std::string>& only, const std::string& name) -> bool
+{
+  return only.empty() || (std::find(only.begin(), only.end(), name) != only.end());
+}
+
+[[nodiscard]] auto
+write_results(const std::vector<Result>& results, const std::string& path, nabla::Console& console) -> bool
+{
+  std::ofstream file(path);
+
+  file << "kernel\tbackend\tns_per_op\tallocs_per_op\trows_per_s\n";
+
+  for (const auto& result : results) {
+    file << result.kernel << '\t' << result.backend << '\t' << result.ns_per_op << '\t' << result.allocs_per_op
+         << '\t' << (1e9 / result.ns_per_op) << '\n';
+  }
+
+  if (!file.good()) {
+    console.print_file_error(path, "failed to write results");
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  Settings settings;
+
+  settings.native_build_options.build_dir = std::filesystem::temp_directory_path() / "nabla-run-bench";
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    const auto parse_count = [&console, &arg](const std::string_view& value, size_t& count) {
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), count);
+      if ((result.ptr != (value.data() + value.size())) || (count == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return false;
+      }
+      return true;
+    };
+    if (arg.substr(0, 7) == "--size=") {
+      if (!parse_count(arg.substr(7), settings.size)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 7) == "--rows=") {
+      if (!parse_count(arg.substr(7), settings.rows)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 9) == "--repeat=") {
+      if (!parse_count(arg.substr(9), settings.repeat)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 11) == "--min-time=") {
+      size_t ms{ 0 };
+      if (!parse_count(arg.substr(11), ms)) {
+        return EXIT_FAILURE;
+      }
+      settings.min_time = std::chrono::milliseconds(ms);
+    } else if (arg.substr(0, 9) == "--kernel=") {
+      settings.only_kernels.emplace_back(arg.substr(9));
+    } else if (arg.substr(0, 10) == "--backend=") {
+      settings.only_backends.emplace_back(arg.substr(10));
+    } else if (arg.substr(0, 9) == "--output=") {
+      settings.output_path = arg.substr(9);
+    } else if (arg.substr(0, 12) == "--build-dir=") {
+      settings.native_build_options.build_dir = arg.substr(12);
+    } else if (arg.substr(0, 6) == "--cxx=") {
+      settings.native_build_options.compiler = arg.substr(6);
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto native = selected(settings.only_backends, "native");
+
+  if (native && (settings.rows > 1)) {
+    std::cerr << "no native backend, since the generated code can't take rows of inputs" << std::endl;
+    native = false;
+  }
+
+  if (native && !has_native_compiler(settings)) {
+    std::cerr << "no native backend, since '" << settings.native_build_options.compiler << "' could not be run"
+              << std::endl;
+    native = false;
+  }
+
+  std::vector<Result> results;
+
+  auto success{ true };
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << std::left << std::setw(14) << "kernel" << std::setw(14) << "backend" << std::right << std::setw(16)
+            << "ns/op" << std::setw(12) << "allocs/op" << std::setw(14) << "rows/s" << std::setw(10) << "speedup"
+            << '\n';
+
+  for (const auto kernel : nabla::bench::kernels) {
+    const std::string name = nabla::bench::kernel_name(kernel);
+
+    if (!selected(settings.only_kernels, name)) {
+      continue;
+    }
+
+    const auto source = nabla::bench::generate_kernel(kernel, settings.size);
+
+    auto unit = std::make_shared<nabla::TranslationUnit>();
+
+    unit->filename = name + ".nabla";
+
+    unit->source = source;
+
+    if (!nabla::parse_unit(*unit, *console)) {
+      return EXIT_FAILURE;
+    }
+
+    // The native backend generates code from a unit of its own, since the engine takes ownership of this one.
+    nabla::TranslationUnit native_unit;
+
+    native_unit.filename = unit->filename;
+
+    native_unit.source = source;
+
+    if (!nabla::parse_unit(native_unit, *console) || !nabla::analyze_unit(native_unit, *console)) {
+      return EXIT_FAILURE;
+    }
+
+    nabla::EngineOptions engine_options;
+
+    if (settings.rows > 1) {
+      engine_options.inputs = nabla::bench::kernel_inputs(kernel, settings.size);
+    }
+
+    const auto m = nabla::Engine::create(engine_options)->compile(std::move(unit), *console);
+
+    if (!m) {
+      return EXIT_FAILURE;
+    }
+
+    const auto rows = make_rows(m->module(), settings.rows);
+
+    const auto* rows_data = (settings.rows > 1) ? rows.data() : nullptr;
+
+    // What the first backend printed, which every other backend has to print exactly.
+    std::optional<std::string> expected;
+
+    std::string expected_backend;
+
+    std::optional<double> baseline_ns;
+
+    for (const auto& backend : backends) {
+      if (!selected(settings.only_backends, backend.name) || (!backend.backend && !native)) {
+        continue;
+      }
+
+      std::string output;
+
+      std::optional<Result> result;
+
+      if (backend.backend) {
+        result = run_in_process(m, *backend.backend, rows_data, settings, output);
+      } else {
+        result = run_native(native_unit, name, settings, *console, output);
+      }
+
+      if (!result) {
+        success = false;
+        continue;
+      }
+
+      result->kernel = name;
+
+      result->backend = backend.name;
+
+      std::cout << std::left << std::setw(14) << name << std::setw(14) << backend.name << std::right << std::setw(16)
+                << result->ns_per_op << std::setw(12);
+
+      if (result->allocs_per_op >= 0) {
+        std::cout << result->allocs_per_op;
+      } else {
+        std::cout << "-";
+      }
+
+      std::cout << std::setw(14) << std::setprecision(0) << (1e9 / result->ns_per_op) << std::setprecision(2);
+
+      if (!baseline_ns) {
+        baseline_ns = result->ns_per_op;
+      }
+
+      std::cout << std::setw(9) << (*baseline_ns / result->ns_per_op) << 'x' << '\n';
+
+      if (!expected) {
+        expected = output;
+        expected_backend = backend.name;
+      } else if (output != *expected) {
+        console->print_error(name + ": the " + backend.name + " backend printed something different from what the " +
+                             expected_backend + " backend did, starting on line " +
+                             std::to_string(first_difference(*expected, output)));
+        success = false;
+      }
+
+      results.emplace_back(std::move(*result));
+    }
+  }
+
+  if (!settings.output_path.empty() && !write_results(results, settings.output_path, *console)) {
+    return EXIT_FAILURE;
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,278 @@
+/// @file
+///
+/// @brief Measures how long a client waits for a compile server to build a program, against running the compiler cold.
+///
+/// @details A program of generated files is written to src/ and deps/ of a directory, and built there over and over by
+///          running the compiler, the way a build system does. Each build is timed from starting the process to its
+///          exit, so process startup and finding the files are measured along with compiling them. The modes are:
+///
+///          - cold: the compiler with no cache, which compiles every file.
+///          - cached: the compiler with its disk cache, which has every file from a previous build.
+///          - server: a client of a server that has every file in memory from a previous request.
+///          - server-edit: the same, but one file is changed before each build, which the server has to notice.
+///
+///          The generated code is discarded. Takes the path of the compiler with --nabla, which defaults to the one
+///          next to this program.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "console.h"
+#include "process.h"
+#include "source_generator.h"
+
+namespace {
+
+struct Settings final
+{
+  /// @brief The number of files in each of src/ and deps/.
+  size_t files{ 16 };
+
+  size_t size{ 500 };
+
+  size_t runs{ 20 };
+
+  std::filesystem::path nabla;
+
+  std::filesystem::path dir;
+};
+
+struct Result final
+{
+  std::string mode;
+
+  double min_ms{ 0 };
+
+  double median_ms{ 0 };
+};
+
+/// @brief Gets the path of a generated file, which is named after its workload.
+[[nodiscard]] auto
+source_path(const Settings& settings, const char* subdir, const size_t i) -> std::filesystem::path
+{
+  const auto workload = nabla::bench::workloads[i % std::size(nabla::bench::workloads)];
+
+  const auto name = std::string(nabla::bench::workload_name(workload)) + "_" + std::to_string(i) + ".nabla";
+
+  return settings.dir / subdir / name;
+}
+
+[[nodiscard]] auto
+write_file(const std::filesystem::path& path, const std::string& content) -> bool
+{
+  std::ofstream file(path, std::ios::binary);
+  file << content;
+  return file.good();
+}
+
+/// @brief Writes the program, cycling through the workloads so that every part of the compiler gets some of it.
+[[nodiscard]] auto
+write_program(const Settings& settings, nabla::Console& console) -> bool
+{
+  std::error_code error;
+
+  std::filesystem::remove_all(settings.dir, error);
+
+  for (const auto* subdir : { "src", "deps" }) {
+    const auto dir = settings.dir / subdir;
+    std::filesystem::create_directories(dir, error);
+    if (error) {
+      console.print_file_error(dir.string(), "failed to create directory: " + error.message());
+      return false;
+    }
+    for (size_t i = 0; i < settings.files; i++) {
+      const auto workload = nabla::bench::workloads[i % std::size(nabla::bench::workloads)];
+      const auto path = source_path(settings, subdir, i);
+      if (!write_file(path, nabla::bench::generate_source(workload, settings.size, i + 1))) {
+        console.print_file_error(path.string(), "failed to write file");
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// @brief Runs builds and times them.
+///
+/// @param before Called before each build, outside of the time.
+template<typename Before>
+[[nodiscard]] auto
+measure(const std::string& mode,
+        const std::vector<std::string>& args,
+        const Settings& settings,
+        nabla::Console& console,
+        Before before) -> std::optional<Result>
+{
+  std::vector<double> times;
+
+  for (size_t i = 0; i < settings.runs; i++) {
+    before(i);
+    const auto start = std::chrono::steady_clock::now();
+    if (!nabla::bench::run_program(args, "/dev/null", settings.dir / "stderr.txt")) {
+      console.print_file_error(args.at(0), "build failed in " + mode + " mode");
+      std::cerr << nabla::bench::read_file(settings.dir / "stderr.txt");
+      return std::nullopt;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    times.emplace_back(std::chrono::duration<double, std::milli>(elapsed).count());
+  }
+
+  std::sort(times.begin(), times.end());
+
+  return Result{ mode, times.front(), times[times.size() / 2] };
+}
+
+/// @brief Waits for a server to create its socket, since a client that finds no server compiles by itself.
+[[nodiscard]] auto
+wait_for_socket(const std::filesystem::path& path) -> bool
+{
+  constexpr auto timeout = std::chrono::seconds(10);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  while (!std::filesystem::exists(path)) {
+    if ((std::chrono::steady_clock::now() - start) > timeout) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(argv[0]);
+
+  Settings settings;
+
+  settings.nabla = std::filesystem::read_symlink("/proc/self/exe").parent_path() / "nabla";
+
+  settings.dir = std::filesystem::temp_directory_path() / "nabla-server-bench";
+
+  for (auto i = 1; i < argc; i++) {
+    const std::string_view arg(argv[i]);
+    const auto parse_count = [&console, &arg](const std::string_view& value, size_t& count) {
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), count);
+      if ((result.ptr != (value.data() + value.size())) || (count == 0)) {
+        console->print_error("invalid count in '" + std::string(arg) + "'");
+        return false;
+      }
+      return true;
+    };
+    if (arg.substr(0, 8) == "--files=") {
+      if (!parse_count(arg.substr(8), settings.files)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 7) == "--size=") {
+      if (!parse_count(arg.substr(7), settings.size)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 7) == "--runs=") {
+      if (!parse_count(arg.substr(7), settings.runs)) {
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 8) == "--nabla=") {
+      settings.nabla = std::filesystem::absolute(arg.substr(8));
+    } else if (arg.substr(0, 6) == "--dir=") {
+      settings.dir = std::filesystem::absolute(arg.substr(6));
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!write_program(settings, *console)) {
+    return EXIT_FAILURE;
+  }
+
+  // The compiler looks for the program in its working directory, and the server moves into that of the client.
+  std::filesystem::current_path(settings.dir);
+
+  const auto nabla = settings.nabla.string();
+
+  const auto socket = (settings.dir / "server.sock").string();
+
+  const auto no_op = [](size_t) {};
+
+  std::vector<Result> results;
+
+  auto success{ true };
+
+  const auto add_result = [&results, &success](std::optional<Result> result) {
+    if (result) {
+      results.emplace_back(std::move(*result));
+    } else {
+      success = false;
+    }
+  };
+
+  add_result(measure("cold", { nabla, "--no-cache" }, settings, *console, no_op));
+
+  // The first build fills the cache.
+  if (nabla::bench::run_program({ nabla }, "/dev/null", "/dev/null")) {
+    add_result(measure("cached", { nabla }, settings, *console, no_op));
+  } else {
+    console->print_error("failed to fill the cache");
+    success = false;
+  }
+
+  const auto server = nabla::bench::start_program({ nabla, "--server=" + socket }, "/dev/null", "server.txt");
+
+  if ((server == -1) || !wait_for_socket(socket)) {
+    console->print_error("failed to start the server");
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<std::string> client{ nabla, "--connect=" + socket, "--no-cache" };
+
+  // The first request fills the server.
+  if (nabla::bench::run_program(client, "/dev/null", "/dev/null")) {
+    add_result(measure("server", client, settings, *console, no_op));
+    const auto edited = source_path(settings, "src", 0);
+    const auto original = nabla::bench::read_file(edited);
+    add_result(measure("server-edit", client, settings, *console, [&edited, &original](const size_t i) {
+      (void)write_file(edited, original + "// edit " + std::to_string(i) + "\n");
+    }));
+  } else {
+    console->print_error("the server failed to build the program");
+    success = false;
+  }
+
+  kill(server, SIGTERM);
+
+  (void)nabla::bench::wait_program(server);
+
+  std::cout << std::fixed << std::setprecision(2);
+
+  std::cout << std::left << std::setw(14) << "mode" << std::right << std::setw(12) << "min ms" << std::setw(12)
+            << "median ms" << std::setw(10) << "speedup" << '\n';
+
+  for (const auto& result : results) {
+    std::cout << std::left << std::setw(14) << result.mode << std::right << std::setw(12) << result.min_ms
+              << std::setw(12) << result.median_ms << std::setw(9) << (results.front().median_ms / result.median_ms)
+              << 'x' << '\n';
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
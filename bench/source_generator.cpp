@@ -0,0 +1,389 @@
+#include "source_generator.h"
+
+#include <algorithm>
+
+namespace nabla::bench {
+
+namespace {
+
+/// @brief SplitMix64, which is used rather than the generators of the standard library since their distributions may
+///        give different numbers on different platforms.
+class Random final
+{
+public:
+  explicit Random(const uint64_t seed)
+    : state_(seed)
+  {
+  }
+
+  [[nodiscard]] auto next() -> uint64_t
+  {
+    state_ += 0x9e3779b97f4a7c15ULL;
+    auto z = state_;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  /// @return A number from zero to the bound, excluding the bound.
+  [[nodiscard]] auto below(const uint64_t bound) -> uint64_t { return next() % bound; }
+
+  /// @return A number from the first to the last, including both.
+  [[nodiscard]] auto between(const uint64_t first, const uint64_t last) -> uint64_t
+  {
+    return first + below(last - first + 1);
+  }
+
+private:
+  uint64_t state_{ 0 };
+};
+
+[[nodiscard]] auto
+float_literal(Random& random) -> std::string
+{
+  return std::to_string(random.below(1000)) + "." + std::to_string(random.between(1, 9));
+}
+
+/// @brief Words of lowercase letters, for comments and string literals.
+void
+append_words(std::string& out, Random& random, const size_t length)
+{
+  const auto start = out.size();
+
+  while ((out.size() - start) < length) {
+    if (out.size() > start) {
+      out += ' ';
+    }
+    const auto word_length = random.between(1, 10);
+    for (uint64_t i = 0; i < word_length; i++) {
+      out += static_cast<char>('a' + random.below(26));
+    }
+  }
+}
+
+void
+generate_let_chain(std::string& out, Random& random, const size_t size)
+{
+  out += "let x0 = 1.5;\n";
+
+  for (size_t i = 1; i < size; i++) {
+    const auto id = std::to_string(i);
+    out += "let x" + id + " = x" + std::to_string(i - 1) + " * 0.5 + " + float_literal(random) + ";\n";
+  }
+}
+
+void
+generate_wide_expr(std::string& out, Random& random, const size_t size)
+{
+  constexpr size_t num_operands = 16;
+
+  constexpr size_t num_exprs = 8;
+
+  constexpr size_t terms_per_line = 8;
+
+  for (size_t i = 0; i < num_operands; i++) {
+    out += "let d" + std::to_string(i) + " = " + float_literal(random) + ";\n";
+  }
+
+  const auto num_terms = std::max<size_t>(size / num_exprs, 1);
+
+  for (size_t i = 0; i < num_exprs; i++) {
+    out += "let w" + std::to_string(i) + " =";
+    for (size_t j = 0; j < num_terms; j++) {
+      if (j > 0) {
+        out += ((j % terms_per_line) == 0) ? "\n  +" : " +";
+      }
+      out += " d" + std::to_string(random.below(num_operands)) + " * " + float_literal(random);
+    }
+    out += ";\n";
+  }
+}
+
+void
+generate_structs(std::string& out, Random& random, const size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    out += "struct s" + std::to_string(i) + " {\n";
+    const auto num_fields = random.between(1, 6);
+    for (uint64_t j = 0; j < num_fields; j++) {
+      out += "  f" + std::to_string(j) + ": " + (random.below(2) ? "f32" : "i32");
+      out += ((j + 1) < num_fields) ? ",\n" : "\n";
+    }
+    out += "}\n";
+  }
+}
+
+void
+generate_functions(std::string& out, Random& random, const size_t size)
+{
+  constexpr size_t max_call_distance = 8;
+
+  for (size_t i = 0; i < size; i++) {
+    out += "fn f" + std::to_string(i) + "(a: f32, b: f32) {\n";
+    out += "  let t = " + float_literal(random) + " * 2.0 + " + float_literal(random) + ";\n";
+    if (i == 0) {
+      out += "  return t;\n";
+    } else {
+      const auto callee = random.between((i > max_call_distance) ? (i - max_call_distance) : 0, i - 1);
+      out += "  return f" + std::to_string(callee) + "(a, b);\n";
+    }
+    out += "}\n";
+  }
+
+  out += "let r = f" + std::to_string(std::max<size_t>(size, 1) - 1) + "(1.0, 2.0);\n";
+}
+
+void
+generate_comments(std::string& out, Random& random, const size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    out += "// ";
+    append_words(out, random, random.between(40, 100));
+    out += '\n';
+    if ((i % 4) == 0) {
+      out += "/*\n";
+      for (int line = 0; line < 3; line++) {
+        out += " * ";
+        append_words(out, random, random.between(40, 100));
+        out += '\n';
+      }
+      out += " */\n";
+    }
+    out += "let c" + std::to_string(i) + " = " + float_literal(random) + "; // ";
+    append_words(out, random, random.between(10, 40));
+    out += '\n';
+  }
+}
+
+void
+generate_strings(std::string& out, Random& random, const size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    out += "let s" + std::to_string(i) + " = \"";
+    append_words(out, random, random.between(32, 512));
+    out += "\";\n";
+  }
+}
+
+/// @brief Small integer declarations that kernels compute from.
+void
+generate_int_operands(std::string& out, Random& random, const size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    out += "let n" + std::to_string(i) + " = " + std::to_string(random.below(1000)) + ";\n";
+  }
+}
+
+void
+generate_int_chain(std::string& out, Random& random, const size_t size)
+{
+  constexpr size_t num_operands = 16;
+
+  constexpr size_t print_every = 64;
+
+  // Each step adds at most a few thousand, and the chain starts over this often, so values never get near overflowing.
+  constexpr size_t restart_every = 1024;
+
+  generate_int_operands(out, random, num_operands);
+
+  out += "let i0 = n0;\n";
+
+  for (size_t i = 1; i < size; i++) {
+    const auto id = std::to_string(i);
+    out += "let i" + id + " = ";
+    if ((i % restart_every) != 0) {
+      out += "i" + std::to_string(i - 1) + " + ";
+    }
+    out += "n" + std::to_string(random.below(num_operands)) + " * 3 + " + std::to_string(random.below(100)) + ";\n";
+    if ((i % print_every) == 0) {
+      out += "print(i" + id + ");\n";
+    }
+  }
+
+  out += "print(i" + std::to_string(std::max<size_t>(size, 1) - 1) + ");\n";
+}
+
+void
+generate_float_chain(std::string& out, Random& random, const size_t size)
+{
+  constexpr size_t print_every = 64;
+
+  // Halving the previous value keeps the values bounded.
+  out += "let x0 = 1.5;\n";
+
+  for (size_t i = 1; i < size; i++) {
+    const auto id = std::to_string(i);
+    out += "let x" + id + " = x" + std::to_string(i - 1) + " * 0.5 + " + float_literal(random) + ";\n";
+    if ((i % print_every) == 0) {
+      out += "print(x" + id + ");\n";
+    }
+  }
+
+  out += "print(x" + std::to_string(std::max<size_t>(size, 1) - 1) + ");\n";
+}
+
+void
+generate_wide_kernel(std::string& out, Random& random, const size_t size)
+{
+  constexpr size_t num_operands = 16;
+
+  constexpr size_t num_terms = 16;
+
+  for (size_t i = 0; i < num_operands; i++) {
+    out += "let d" + std::to_string(i) + " = " + float_literal(random) + ";\n";
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    const auto id = std::to_string(i);
+    out += "let w" + id + " =";
+    for (size_t j = 0; j < num_terms; j++) {
+      out += (j > 0) ? " + d" : " d";
+      out += std::to_string(random.below(num_operands)) + " * " + float_literal(random);
+    }
+    out += ";\nprint(w" + id + ");\n";
+  }
+}
+
+void
+generate_print_heavy(std::string& out, Random& random, const size_t size)
+{
+  for (size_t i = 0; i < size; i++) {
+    const auto id = std::to_string(i);
+    out += "let v" + id + " = " + std::to_string(random.below(100000)) + ";\n";
+    out += "let f" + id + " = " + float_literal(random) + ";\n";
+    out += "print(\"row " + id + ": \", v" + id + " * 2 + 1, \" \", f" + id + " * 0.5 + 1.25, \" \", \"";
+    append_words(out, random, random.between(8, 32));
+    out += "\");\n";
+  }
+}
+
+} // namespace
+
+auto
+workload_name(const Workload workload) -> const char*
+{
+  switch (workload) {
+    case Workload::let_chain:
+      return "let_chain";
+    case Workload::wide_expr:
+      return "wide_expr";
+    case Workload::structs:
+      return "structs";
+    case Workload::functions:
+      return "functions";
+    case Workload::comments:
+      return "comments";
+    case Workload::strings:
+      return "strings";
+  }
+  return "";
+}
+
+auto
+generate_source(const Workload workload, const size_t size, const uint64_t seed) -> std::string
+{
+  // Each workload draws from its own sequence, so that adding one does not change the others.
+  Random random(seed ^ (static_cast<uint64_t>(workload) << 32));
+
+  std::string out;
+
+  switch (workload) {
+    case Workload::let_chain:
+      generate_let_chain(out, random, size);
+      break;
+    case Workload::wide_expr:
+      generate_wide_expr(out, random, size);
+      break;
+    case Workload::structs:
+      generate_structs(out, random, size);
+      break;
+    case Workload::functions:
+      generate_functions(out, random, size);
+      break;
+    case Workload::comments:
+      generate_comments(out, random, size);
+      break;
+    case Workload::strings:
+      generate_strings(out, random, size);
+      break;
+  }
+
+  return out;
+}
+
+auto
+kernel_name(const Kernel kernel) -> const char*
+{
+  switch (kernel) {
+    case Kernel::int_chain:
+      return "int_chain";
+    case Kernel::float_chain:
+      return "float_chain";
+    case Kernel::wide_expr:
+      return "wide_expr";
+    case Kernel::print_heavy:
+      return "print_heavy";
+  }
+  return "";
+}
+
+auto
+generate_kernel(const Kernel kernel, const size_t size, const uint64_t seed) -> std::string
+{
+  // Kernels draw from other sequences than the workloads do.
+  Random random(seed ^ ((static_cast<uint64_t>(kernel) + 1) << 48));
+
+  std::string out;
+
+  switch (kernel) {
+    case Kernel::int_chain:
+      generate_int_chain(out, random, size);
+      break;
+    case Kernel::float_chain:
+      generate_float_chain(out, random, size);
+      break;
+    case Kernel::wide_expr:
+      generate_wide_kernel(out, random, size);
+      break;
+    case Kernel::print_heavy:
+      generate_print_heavy(out, random, size);
+      break;
+  }
+
+  return out;
+}
+
+auto
+kernel_inputs(const Kernel kernel, const size_t size) -> std::vector<std::string>
+{
+  // These are the operands declared by the generators above.
+  constexpr size_t num_operands = 16;
+
+  std::vector<std::string> names;
+
+  const auto add_names = [&names](const char* prefix, const size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      names.emplace_back(prefix + std::to_string(i));
+    }
+  };
+
+  switch (kernel) {
+    case Kernel::int_chain:
+      add_names("n", num_operands);
+      break;
+    case Kernel::float_chain:
+      add_names("x", 1);
+      break;
+    case Kernel::wide_expr:
+      add_names("d", num_operands);
+      break;
+    case Kernel::print_heavy:
+      add_names("v", size);
+      add_names("f", size);
+      break;
+  }
+
+  return names;
+}
+
+} // namespace nabla::bench
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla::bench {
+
+/// @brief A kind of generated program, each of which leans on a different part of the compiler.
+enum class Workload
+{
+  /// @brief Declarations that each refer to the one before them.
+  let_chain,
+  /// @brief A few declarations with very long expressions, whose syntax trees are as deep as they are long.
+  wide_expr,
+  /// @brief Many struct declarations.
+  structs,
+  /// @brief Many functions that call earlier ones, so that return types are deduced through long chains of calls.
+  functions,
+  /// @brief Declarations with more comments than code, which the lexer has to skip over.
+  comments,
+  /// @brief Declarations of long string literals.
+  strings
+};
+
+/// @brief Every workload, in the order that they are reported in.
+constexpr Workload workloads[]{ Workload::let_chain, Workload::wide_expr, Workload::structs,
+                                Workload::functions, Workload::comments,  Workload::strings };
+
+[[nodiscard]] auto
+workload_name(Workload workload) -> const char*;
+
+/// @brief Generates a valid program.
+///
+/// @param size What the program is made of, such as declarations or terms. The length of the program grows linearly
+///             with it, so that time that grows faster than that points to something quadratic.
+///
+/// @return The same program for the same arguments, on any platform.
+[[nodiscard]] auto
+generate_source(Workload workload, size_t size, uint64_t seed = 1) -> std::string;
+
+/// @brief A generated program that is meant to be executed, so it only uses what every backend can execute.
+enum class Kernel
+{
+  /// @brief Integer declarations that each build on the one before them.
+  int_chain,
+  /// @brief Float declarations that each build on the one before them, with products that can be fused into adds.
+  float_chain,
+  /// @brief Float declarations with long sums of products.
+  wide_expr,
+  /// @brief More printing than computing, of integers, floats and strings.
+  print_heavy
+};
+
+/// @brief Every kernel, in the order that they are reported in.
+constexpr Kernel kernels[]{ Kernel::int_chain, Kernel::float_chain, Kernel::wide_expr, Kernel::print_heavy };
+
+[[nodiscard]] auto
+kernel_name(Kernel kernel) -> const char*;
+
+/// @brief Generates a program that prints what it computes, so that backends can be checked against each other.
+///
+/// @param size The number of declarations. Values stay well within range at any size.
+///
+/// @return The same program for the same arguments, on any platform.
+[[nodiscard]] auto
+generate_kernel(Kernel kernel, size_t size, uint64_t seed = 1) -> std::string;
+
+/// @brief Gets the names of the declarations of a kernel that everything else is computed from, which can be made
+///        inputs so that the kernel computes something different for each row of inputs.
+[[nodiscard]] auto
+kernel_inputs(Kernel kernel, size_t size) -> std::vector<std::string>;
+
+} // namespace nabla::bench
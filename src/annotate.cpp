@@ -154,6 +154,8 @@ public:
   void visit(const StructNode&) override {}
 
   void visit(const ReturnNode&) override {}
+
+  void visit(const ImportNode&) override {}
 };
 
 } // namespace
@@ -63,6 +63,8 @@ protected:
 
   void visit(const ReturnNode&) override {}
 
+  void visit(const ImportNode&) override {}
+
   void visit(const IntLiteralExpr&) override {}
 
   void visit(const FloatLiteralExpr&) override {}
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include <stddef.h>
+#include <stdint.h>
 
 namespace nabla {
 
@@ -19,6 +21,12 @@ class AddExpr;
 template<typename A, typename B>
 class MulExpr;
 
+template<typename T>
+class MulAddExpr;
+
+template<typename T>
+class InputExpr;
+
 class ExprVisitor
 {
 public:
@@ -39,6 +47,14 @@ public:
   virtual void visit(const MulExpr<int, int>& expr) = 0;
 
   virtual void visit(const MulExpr<float, float>& expr) = 0;
+
+  virtual void visit(const MulAddExpr<int>& expr) = 0;
+
+  virtual void visit(const MulAddExpr<float>& expr) = 0;
+
+  virtual void visit(const InputExpr<int>& expr) = 0;
+
+  virtual void visit(const InputExpr<float>& expr) = 0;
 };
 
 class Expr
@@ -67,11 +83,11 @@ class LiteralExpr final : public ExprBase<LiteralExpr<T>>
 
 public:
   explicit LiteralExpr(T value)
-    : value_(value)
+    : value_(std::move(value))
   {
   }
 
-  [[nodiscard]] auto value() const -> T { return value_; }
+  [[nodiscard]] auto value() const -> const T& { return value_; }
 };
 
 template<typename T>
@@ -121,6 +137,57 @@ public:
   using BinaryExpr<MulExpr<A, B>>::BinaryExpr;
 };
 
+/// @brief Computes "a * b + c" as a single operation.
+///
+/// @details These are produced by fusing a multiplication into the addition that consumes it. Unless the expression is
+///          marked as fused, the product is still rounded before the addition, so that the result is exactly the same
+///          as that of the two original operations.
+template<typename T>
+class MulAddExpr final : public ExprBase<MulAddExpr<T>>
+{
+  size_t a_;
+
+  size_t b_;
+
+  size_t c_;
+
+  bool fused_;
+
+public:
+  MulAddExpr(size_t a, size_t b, size_t c, bool fused)
+    : a_(a)
+    , b_(b)
+    , c_(c)
+    , fused_(fused)
+  {
+  }
+
+  [[nodiscard]] auto a() const -> size_t { return a_; }
+
+  [[nodiscard]] auto b() const -> size_t { return b_; }
+
+  [[nodiscard]] auto c() const -> size_t { return c_; }
+
+  /// @brief Indicates whether the result is computed with a single rounding, as done by std::fma.
+  [[nodiscard]] auto fused() const -> bool { return fused_; }
+};
+
+/// @brief Reads a value that is provided by the host each time the module is executed.
+template<typename T>
+class InputExpr final : public ExprBase<InputExpr<T>>
+{
+  size_t slot_;
+
+public:
+  explicit InputExpr(size_t slot)
+    : slot_(slot)
+  {
+  }
+
+  /// @brief The index of the input in @ref Module::inputs.
+  [[nodiscard]] auto slot() const -> size_t { return slot_; }
+};
+
 class AssignStmt;
 class PrintStmt;
 class PrintEndStmt;
@@ -137,12 +204,27 @@ public:
   virtual void visit(const PrintEndStmt&) = 0;
 };
 
+/// @brief Where in the source code a statement came from.
+struct SourceLocation final
+{
+  /// @brief The line number, starting at one. Zero means that the location is unknown.
+  size_t line{ 0 };
+
+  size_t column{ 0 };
+};
+
 class Stmt
 {
+  SourceLocation location_;
+
 public:
   virtual ~Stmt() = default;
 
   virtual void accept(StmtVisitor& visitor) const = 0;
+
+  [[nodiscard]] auto location() const -> const SourceLocation& { return location_; }
+
+  void set_location(const SourceLocation& location) { location_ = location; }
 };
 
 using StmtPtr = std::unique_ptr<Stmt>;
@@ -184,7 +266,7 @@ public:
   {
   }
 
-  [[nodiscard]] auto id() const -> int { return id_; }
+  [[nodiscard]] auto id() const -> size_t { return id_; }
 };
 
 class PrintEndStmt final : public StmtBase<PrintEndStmt>
@@ -192,9 +274,91 @@ class PrintEndStmt final : public StmtBase<PrintEndStmt>
 public:
 };
 
+/// @brief Untyped storage for a scalar value. Which member is active is known from the expression that reads it.
+union Scalar
+{
+  int int_value;
+
+  float float_value;
+};
+
+enum class ScalarType
+{
+  int_,
+  float_
+};
+
+/// @brief Describes a value that the host binds before executing a module.
+struct Input final
+{
+  std::string name;
+
+  ScalarType type{ ScalarType::int_ };
+
+  /// @brief The value used when the host does not bind the input.
+  Scalar default_value{ 0 };
+};
+
+/// @brief A number that identifies one module in one state, for backends to key what they derive from it on.
+///
+/// @details No two modules ever get the same generation, and a module gets a new one when it is moved or when passes
+///          have run on it. The address of a module is not enough, since another module may later be built at the
+///          same address.
+class Generation final
+{
+  uint64_t value_;
+
+  [[nodiscard]] static auto next() -> uint64_t
+  {
+    static std::atomic<uint64_t> counter{ 0 };
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+public:
+  Generation()
+    : value_(next())
+  {
+  }
+
+  Generation(const Generation&) = delete;
+
+  Generation(Generation&& other) noexcept
+    : value_(next())
+  {
+    other.renew();
+  }
+
+  auto operator=(const Generation&) -> Generation& = delete;
+
+  auto operator=(Generation&& other) noexcept -> Generation&
+  {
+    renew();
+    other.renew();
+    return *this;
+  }
+
+  /// @brief Gives the module a new generation, for code that modifies a module after it may have been executed.
+  void renew() { value_ = next(); }
+
+  [[nodiscard]] auto value() const -> uint64_t { return value_; }
+};
+
+/// @brief A flat list of statements, where each computed value is identified by the ID of the assignment that produced
+///        it.
+///
+/// @note Assignment IDs are dense and appear in increasing order, so that the N-th assignment always produces the value
+///       with ID N. Passes that remove assignments are expected to renumber the remaining ones.
 struct Module final
 {
+  /// @brief The path of the file that the module was built from, for tools that map code back to its source.
+  std::string filename;
+
   std::vector<StmtPtr> stmts;
+
+  /// @brief The inputs read by @ref InputExpr, indexed by slot.
+  std::vector<Input> inputs;
+
+  Generation generation;
 };
 
 } // namespace ast
@@ -12,6 +12,29 @@ namespace nabla {
 
 namespace {
 
+/// @brief Used to find out whether an expression is a numeric literal.
+class NumericLiteralFinder final : public ExprVisitor
+{
+public:
+  const IntLiteralExpr* int_literal{ nullptr };
+
+  const FloatLiteralExpr* float_literal{ nullptr };
+
+  void visit(const IntLiteralExpr& expr) override { int_literal = &expr; }
+
+  void visit(const FloatLiteralExpr& expr) override { float_literal = &expr; }
+
+  void visit(const StringLiteralExpr&) override {}
+
+  void visit(const VarExpr&) override {}
+
+  void visit(const CallExpr&) override {}
+
+  void visit(const AddExpr&) override {}
+
+  void visit(const MulExpr&) override {}
+};
+
 class ASTBuilderImpl final
   : public ASTBuilder
   , public NodeVisitor
@@ -27,10 +50,18 @@ class ASTBuilderImpl final
 
   std::map<const DeclNode*, size_t> decl_ids_;
 
+  std::map<const Expr*, size_t>* expr_values_{ nullptr };
+
+  /// @brief The names of the declarations that are inputs, along with their slot.
+  std::map<std::string, size_t, std::less<>> input_slots_;
+
   std::vector<Diagnostic> diagnostics_;
 
   size_t last_expr_id_{ 0 };
 
+  /// @brief The location of the most recently visited token, which is given to the statements built from it.
+  ast::SourceLocation location_;
+
 public:
   ASTBuilderImpl(ast::Module* m, const AnnotationTable* annotations)
     : module_(m)
@@ -38,13 +69,28 @@ public:
   {
   }
 
+  void declare_input(const std::string_view& name) override
+  {
+    if (input_slots_.find(name) != input_slots_.end()) {
+      return;
+    }
+
+    input_slots_.emplace(std::string(name), module_->inputs.size());
+
+    module_->inputs.emplace_back(ast::Input{ std::string(name) });
+  }
+
+  void set_expr_values(std::map<const Expr*, size_t>* values) override { expr_values_ = values; }
+
   [[nodiscard]] auto build(const Node& node) -> bool override
   {
+    const auto num_diagnostics = diagnostics_.size();
     node.accept(*this);
-    //
-    return true;
+    return diagnostics_.size() == num_diagnostics;
   }
 
+  [[nodiscard]] auto get_diagnostics() -> std::vector<Diagnostic> override { return std::move(diagnostics_); }
+
 protected:
   [[nodiscard]] static auto unescape_string_literal(const Token& token) -> std::string
   {
@@ -107,19 +153,26 @@ protected:
   void visit(const PrintNode& node) override
   {
     for (const auto& expr : node.args()) {
-      expr->accept(*this);
-      const auto last_expr_id = exprs_.size() - 1;
-      auto stmt = std::make_unique<ast::PrintStmt>(last_expr_id);
+      const auto id = build_expr(*expr);
+      auto stmt = std::make_unique<ast::PrintStmt>(id);
+      stmt->set_location(location_);
       module_->stmts.emplace_back(std::move(stmt));
     }
-    module_->stmts.emplace_back(std::make_unique<ast::PrintEndStmt>());
+    auto stmt = std::make_unique<ast::PrintEndStmt>();
+    stmt->set_location(location_);
+    module_->stmts.emplace_back(std::move(stmt));
   }
 
   void visit(const DeclNode& node) override
   {
-    node.get_value().accept(*this);
+    locate(node.get_name());
+
+    if (const auto it = input_slots_.find(node.get_name().data); it != input_slots_.end()) {
+      build_input(node, it->second);
+      return;
+    }
 
-    const auto id = exprs_.size() - 1;
+    const auto id = build_expr(node.get_value());
 
     decl_ids_.emplace(&node, id);
   }
@@ -134,11 +187,15 @@ protected:
 
   void visit(const ReturnNode&) override {}
 
+  // The declarations of imported modules are copied into the tree, so the import itself builds nothing.
+  void visit(const ImportNode&) override {}
+
   // expressions
 
   void visit(const StringLiteralExpr& expr) override
   {
     const auto& token = expr.token();
+    locate(token);
     auto value = unescape_string_literal(token);
     auto ast_expr = std::make_unique<ast::LiteralExpr<std::string>>(std::move(value));
     push_assign_expr(std::move(ast_expr));
@@ -146,36 +203,26 @@ protected:
 
   void visit(const IntLiteralExpr& expr) override
   {
-    const auto& token = expr.token();
+    locate(expr.token());
 
-    int value{ 0 };
-
-    const auto result = std::from_chars(token.data.data(), token.data.data() + token.data.size(), value);
-    if (result.ptr != (token.data.data() + token.data.size())) {
-      add_diagnostic("unable to parse integer", &token);
-    }
-
-    auto ast_expr = std::make_unique<ast::LiteralExpr<int>>(value);
+    auto ast_expr = std::make_unique<ast::LiteralExpr<int>>(parse_int(expr.token()));
 
     push_assign_expr(std::move(ast_expr));
   }
 
   void visit(const FloatLiteralExpr& expr) override
   {
-    const auto& token = expr.token();
+    locate(expr.token());
 
-    // TODO : this is really inefficient, but compiler support for from_chars for floats is not great (yet).
-    std::istringstream tmp_stream(std::string(token.data));
-    float value{ 0.0F };
-    tmp_stream >> value;
-
-    auto ast_expr = std::make_unique<ast::LiteralExpr<float>>(value);
+    auto ast_expr = std::make_unique<ast::LiteralExpr<float>>(parse_float(expr.token()));
 
     push_assign_expr(std::move(ast_expr));
   }
 
   void visit(const VarExpr& expr) override
   {
+    locate(expr.get_name());
+
     auto& annotation = annotations_->var_expr.at(&expr);
 
     const auto* decl = annotation.decl;
@@ -185,17 +232,16 @@ protected:
     last_expr_id_ = id;
   }
 
-  void visit(const CallExpr& expr) override
-  {
-    (void)expr;
-    // TODO
-  }
+  // Functions are only compiled to C++, so a call has no value here to refer to.
+  void visit(const CallExpr& expr) override { add_diagnostic("function calls are not supported here", &expr.name()); }
 
   void visit(const AddExpr& expr) override
   {
     const auto l = build_expr(expr.left());
     const auto r = build_expr(expr.right());
 
+    locate(expr.op_token());
+
     const auto& annotation = annotations_->add_expr.at(&expr);
 
     switch (annotation.op) {
@@ -208,6 +254,8 @@ protected:
         last_expr_id_ = push_assign_expr(std::make_unique<ast::AddExpr<float>>(l, r));
         break;
     }
+
+    record_value(expr, annotation.op != Annotation<AddExpr>::Op::none);
   }
 
   void visit(const MulExpr& expr) override
@@ -215,6 +263,8 @@ protected:
     const auto l = build_expr(expr.left());
     const auto r = build_expr(expr.right());
 
+    locate(expr.op_token());
+
     const auto& annotation = annotations_->mul_expr.at(&expr);
 
     switch (annotation.op) {
@@ -227,6 +277,57 @@ protected:
         push_assign_expr(std::make_unique<ast::MulExpr<float, float>>(l, r));
         break;
     }
+
+    record_value(expr, annotation.op != Annotation<MulExpr>::Op::none);
+  }
+
+  void record_value(const Expr& expr, const bool built)
+  {
+    if (expr_values_ && built) {
+      expr_values_->emplace(&expr, last_expr_id_);
+    }
+  }
+
+  void build_input(const DeclNode& node, const size_t slot)
+  {
+    NumericLiteralFinder finder;
+
+    node.get_value().accept(finder);
+
+    auto& input = module_->inputs.at(slot);
+
+    if (finder.int_literal) {
+      input.type = ast::ScalarType::int_;
+      input.default_value.int_value = parse_int(finder.int_literal->token());
+      decl_ids_.emplace(&node, push_assign_expr(std::make_unique<ast::InputExpr<int>>(slot)));
+    } else if (finder.float_literal) {
+      input.type = ast::ScalarType::float_;
+      input.default_value.float_value = parse_float(finder.float_literal->token());
+      decl_ids_.emplace(&node, push_assign_expr(std::make_unique<ast::InputExpr<float>>(slot)));
+    } else {
+      add_diagnostic("inputs must be initialized with an int or float literal", &node.get_name());
+    }
+  }
+
+  [[nodiscard]] auto parse_int(const Token& token) -> int
+  {
+    int value{ 0 };
+
+    const auto result = std::from_chars(token.data.data(), token.data.data() + token.data.size(), value);
+    if (result.ptr != (token.data.data() + token.data.size())) {
+      add_diagnostic("unable to parse integer", &token);
+    }
+
+    return value;
+  }
+
+  [[nodiscard]] static auto parse_float(const Token& token) -> float
+  {
+    // TODO : this is really inefficient, but compiler support for from_chars for floats is not great (yet).
+    std::istringstream tmp_stream(std::string(token.data));
+    float value{ 0.0F };
+    tmp_stream >> value;
+    return value;
   }
 
   [[nodiscard]] auto build_expr(const Expr& expr) -> size_t
@@ -244,11 +345,14 @@ protected:
   {
     exprs_.emplace_back(expr.get());
     auto stmt = std::make_unique<ast::AssignStmt>(expr_id, std::move(expr));
+    stmt->set_location(location_);
     module_->stmts.emplace_back(std::move(stmt));
     last_expr_id_ = expr_id;
     return expr_id;
   }
 
+  void locate(const Token& token) { location_ = ast::SourceLocation{ token.line, token.column }; }
+
   void add_diagnostic(const std::string& what, const Token* token)
   {
     diagnostics_.emplace_back(Diagnostic{ what, token });
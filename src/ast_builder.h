@@ -2,8 +2,13 @@
 
 #include "annotations.h"
 #include "ast.h"
+#include "diagnostics.h"
 #include "syntax_tree.h"
 
+#include <map>
+#include <string_view>
+#include <vector>
+
 namespace nabla {
 
 class ASTBuilder
@@ -13,7 +18,21 @@ public:
 
   virtual ~ASTBuilder() = default;
 
+  /// @brief Marks the top-level declaration with the given name as an input of the module.
+  ///
+  /// @details Instead of being computed, the value of the declaration is then provided by the host each time the module
+  ///          is executed. The declaration has to be initialized with a literal, which is used as the default value.
+  ///          Inputs are assigned slots in the order they are declared with this function.
+  virtual void declare_input(const std::string_view& name) = 0;
+
+  /// @brief Makes the builder record the ID of the value computed by each addition and multiplication that it builds,
+  ///        so that what passes decide about those values can be related back to the syntax tree.
+  virtual void set_expr_values(std::map<const Expr*, size_t>* values) = 0;
+
+  /// @return False if the node could not be converted, in which case there are diagnostics explaining why.
   [[nodiscard]] virtual auto build(const Node& node) -> bool = 0;
+
+  [[nodiscard]] virtual auto get_diagnostics() -> std::vector<Diagnostic> = 0;
 };
 
 } // namespace nabla
@@ -0,0 +1,670 @@
+#include "batch_interpreter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NABLA_X86 1
+#endif
+
+namespace nabla {
+
+namespace {
+
+using Column = ast::Scalar*;
+
+using ConstColumn = const ast::Scalar*;
+
+/// @brief Kernels that compute a column from whole columns of operands.
+///
+/// @note Integer arithmetic wraps around, which is what the SIMD instructions do.
+struct Kernels final
+{
+  void (*add_int)(Column dst, ConstColumn a, ConstColumn b, size_t n);
+
+  void (*add_float)(Column dst, ConstColumn a, ConstColumn b, size_t n);
+
+  void (*mul_int)(Column dst, ConstColumn a, ConstColumn b, size_t n);
+
+  void (*mul_float)(Column dst, ConstColumn a, ConstColumn b, size_t n);
+
+  void (*mul_add_int)(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, size_t n);
+
+  /// @brief Rounds the product before adding, like the scalar interpreter does for unfused mul-adds.
+  void (*mul_add_float)(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, size_t n);
+
+  void (*fma_float)(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, size_t n);
+};
+
+namespace portable {
+
+[[nodiscard]] auto
+wrap(const uint32_t value) -> int
+{
+  return static_cast<int>(value);
+}
+
+void
+add_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    dst[i].int_value = wrap(static_cast<uint32_t>(a[i].int_value) + static_cast<uint32_t>(b[i].int_value));
+  }
+}
+
+void
+add_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    dst[i].float_value = a[i].float_value + b[i].float_value;
+  }
+}
+
+void
+mul_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    dst[i].int_value = wrap(static_cast<uint32_t>(a[i].int_value) * static_cast<uint32_t>(b[i].int_value));
+  }
+}
+
+void
+mul_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    dst[i].float_value = a[i].float_value * b[i].float_value;
+  }
+}
+
+void
+mul_add_int(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    const auto product = static_cast<uint32_t>(a[i].int_value) * static_cast<uint32_t>(b[i].int_value);
+    dst[i].int_value = wrap(product + static_cast<uint32_t>(c[i].int_value));
+  }
+}
+
+void
+mul_add_float(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    const float product = a[i].float_value * b[i].float_value;
+    dst[i].float_value = product + c[i].float_value;
+  }
+}
+
+void
+fma_float(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    dst[i].float_value = std::fma(a[i].float_value, b[i].float_value, c[i].float_value);
+  }
+}
+
+constexpr Kernels kernels{ add_int, add_float, mul_int, mul_float, mul_add_int, mul_add_float, fma_float };
+
+} // namespace portable
+
+#ifdef NABLA_X86
+
+// The SIMD kernels handle as many lanes as fit in whole vectors, and leave the rest to the portable kernels.
+
+namespace sse {
+
+[[nodiscard]] __attribute__((target("sse4.1"))) auto
+load_int(ConstColumn column) -> __m128i
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(column));
+}
+
+__attribute__((target("sse4.1"))) void
+store_int(Column column, const __m128i value)
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(column), value);
+}
+
+[[nodiscard]] __attribute__((target("sse4.1"))) auto
+load_float(ConstColumn column) -> __m128
+{
+  return _mm_loadu_ps(&column->float_value);
+}
+
+__attribute__((target("sse4.1"))) void
+store_float(Column column, const __m128 value)
+{
+  _mm_storeu_ps(&column->float_value, value);
+}
+
+__attribute__((target("sse4.1"))) void
+add_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_int(dst + i, _mm_add_epi32(load_int(a + i), load_int(b + i)));
+  }
+  portable::add_int(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+add_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_float(dst + i, _mm_add_ps(load_float(a + i), load_float(b + i)));
+  }
+  portable::add_float(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+mul_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_int(dst + i, _mm_mullo_epi32(load_int(a + i), load_int(b + i)));
+  }
+  portable::mul_int(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+mul_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_float(dst + i, _mm_mul_ps(load_float(a + i), load_float(b + i)));
+  }
+  portable::mul_float(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+mul_add_int(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_int(dst + i, _mm_add_epi32(_mm_mullo_epi32(load_int(a + i), load_int(b + i)), load_int(c + i)));
+  }
+  portable::mul_add_int(dst + i, a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("sse4.1"))) void
+mul_add_float(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 4) <= n; i += 4) {
+    store_float(dst + i, _mm_add_ps(_mm_mul_ps(load_float(a + i), load_float(b + i)), load_float(c + i)));
+  }
+  portable::mul_add_float(dst + i, a + i, b + i, c + i, n - i);
+}
+
+/// @note Fused mul-adds need FMA instructions, which come with AVX2, so they are left to the portable kernel here.
+constexpr Kernels kernels{ add_int, add_float, mul_int, mul_float, mul_add_int, mul_add_float, portable::fma_float };
+
+} // namespace sse
+
+namespace avx2 {
+
+[[nodiscard]] __attribute__((target("avx2,fma"))) auto
+load_int(ConstColumn column) -> __m256i
+{
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(column));
+}
+
+__attribute__((target("avx2,fma"))) void
+store_int(Column column, const __m256i value)
+{
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(column), value);
+}
+
+[[nodiscard]] __attribute__((target("avx2,fma"))) auto
+load_float(ConstColumn column) -> __m256
+{
+  return _mm256_loadu_ps(&column->float_value);
+}
+
+__attribute__((target("avx2,fma"))) void
+store_float(Column column, const __m256 value)
+{
+  _mm256_storeu_ps(&column->float_value, value);
+}
+
+__attribute__((target("avx2,fma"))) void
+add_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_int(dst + i, _mm256_add_epi32(load_int(a + i), load_int(b + i)));
+  }
+  portable::add_int(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+add_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_float(dst + i, _mm256_add_ps(load_float(a + i), load_float(b + i)));
+  }
+  portable::add_float(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+mul_int(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_int(dst + i, _mm256_mullo_epi32(load_int(a + i), load_int(b + i)));
+  }
+  portable::mul_int(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+mul_float(Column dst, ConstColumn a, ConstColumn b, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_float(dst + i, _mm256_mul_ps(load_float(a + i), load_float(b + i)));
+  }
+  portable::mul_float(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+mul_add_int(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_int(dst + i, _mm256_add_epi32(_mm256_mullo_epi32(load_int(a + i), load_int(b + i)), load_int(c + i)));
+  }
+  portable::mul_add_int(dst + i, a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+mul_add_float(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_float(dst + i, _mm256_add_ps(_mm256_mul_ps(load_float(a + i), load_float(b + i)), load_float(c + i)));
+  }
+  portable::mul_add_float(dst + i, a + i, b + i, c + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) void
+fma_float(Column dst, ConstColumn a, ConstColumn b, ConstColumn c, const size_t n)
+{
+  size_t i = 0;
+  for (; (i + 8) <= n; i += 8) {
+    store_float(dst + i, _mm256_fmadd_ps(load_float(a + i), load_float(b + i), load_float(c + i)));
+  }
+  portable::fma_float(dst + i, a + i, b + i, c + i, n - i);
+}
+
+constexpr Kernels kernels{ add_int, add_float, mul_int, mul_float, mul_add_int, mul_add_float, fma_float };
+
+} // namespace avx2
+
+#endif
+
+/// @brief Picks the widest kernels that the CPU supports.
+[[nodiscard]] auto
+select_kernels() -> const Kernels&
+{
+#ifdef NABLA_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return avx2::kernels;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return sse::kernels;
+  }
+#endif
+  return portable::kernels;
+}
+
+/// @return Null if the CPU does not support the kernels.
+[[nodiscard]] auto
+find_kernels(const BatchKernels kernels) -> const Kernels*
+{
+#ifdef NABLA_X86
+  __builtin_cpu_init();
+#endif
+
+  switch (kernels) {
+    case BatchKernels::best:
+      return &select_kernels();
+    case BatchKernels::portable:
+      return &portable::kernels;
+    case BatchKernels::sse4_1:
+#ifdef NABLA_X86
+      if (__builtin_cpu_supports("sse4.1")) {
+        return &sse::kernels;
+      }
+#endif
+      break;
+    case BatchKernels::avx2:
+#ifdef NABLA_X86
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return &avx2::kernels;
+      }
+#endif
+      break;
+  }
+
+  return nullptr;
+}
+
+/// @brief An operation that computes one column.
+struct ColumnOp final
+{
+  enum class Code : uint8_t
+  {
+    input,
+    add_int,
+    add_float,
+    mul_int,
+    mul_float,
+    mul_add_int,
+    mul_add_float,
+    fma_float
+  };
+
+  Code code{ Code::input };
+
+  size_t dst{ 0 };
+
+  /// @brief The operands, or the input slot for inputs.
+  size_t a{ 0 };
+
+  size_t b{ 0 };
+
+  size_t c{ 0 };
+};
+
+struct PrintOp final
+{
+  enum class Kind : uint8_t
+  {
+    int_,
+    float_,
+    string,
+    end
+  };
+
+  Kind kind{ Kind::end };
+
+  size_t id{ 0 };
+
+  const std::string* string{ nullptr };
+};
+
+struct Literal final
+{
+  size_t id{ 0 };
+
+  ast::Scalar value{ 0 };
+};
+
+/// @brief A module lowered to operations on columns.
+struct Program final
+{
+  std::vector<Literal> literals;
+
+  std::vector<ColumnOp> ops;
+
+  /// @brief The prints of the module, in order. These are done for each row after all columns are computed, which
+  ///        gives the same output since printing is the only side effect.
+  std::vector<PrintOp> prints;
+
+  size_t num_values{ 0 };
+};
+
+class Lowering final
+  : public ast::StmtVisitor
+  , public ast::ExprVisitor
+{
+  Program program_;
+
+  std::vector<PrintOp::Kind> kinds_;
+
+  std::vector<const std::string*> strings_;
+
+  size_t id_{ 0 };
+
+public:
+  [[nodiscard]] auto lower(const ast::Module& m) -> Program
+  {
+    for (const auto& stmt : m.stmts) {
+      stmt->accept(*this);
+    }
+    program_.num_values = kinds_.size();
+    return std::move(program_);
+  }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    id_ = stmt.id();
+    if (kinds_.size() <= id_) {
+      kinds_.resize(id_ + 1, PrintOp::Kind::int_);
+      strings_.resize(id_ + 1, nullptr);
+    }
+    stmt.value().accept(*this);
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    program_.prints.emplace_back(PrintOp{ kinds_.at(stmt.id()), stmt.id(), strings_.at(stmt.id()) });
+  }
+
+  void visit(const ast::PrintEndStmt&) override { program_.prints.emplace_back(PrintOp{}); }
+
+  void visit(const ast::LiteralExpr<int>& expr) override
+  {
+    ast::Scalar value{ 0 };
+    value.int_value = expr.value();
+    program_.literals.emplace_back(Literal{ id_, value });
+  }
+
+  void visit(const ast::LiteralExpr<float>& expr) override
+  {
+    ast::Scalar value{ 0 };
+    value.float_value = expr.value();
+    program_.literals.emplace_back(Literal{ id_, value });
+    kinds_[id_] = PrintOp::Kind::float_;
+  }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override
+  {
+    kinds_[id_] = PrintOp::Kind::string;
+    strings_[id_] = &expr.value();
+  }
+
+  void visit(const ast::AddExpr<int>& expr) override { binary(ColumnOp::Code::add_int, expr); }
+
+  void visit(const ast::AddExpr<float>& expr) override { binary(ColumnOp::Code::add_float, expr); }
+
+  void visit(const ast::AddExpr<std::string>&) override {}
+
+  void visit(const ast::MulExpr<int, int>& expr) override { binary(ColumnOp::Code::mul_int, expr); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { binary(ColumnOp::Code::mul_float, expr); }
+
+  void visit(const ast::MulAddExpr<int>& expr) override
+  {
+    program_.ops.emplace_back(ColumnOp{ ColumnOp::Code::mul_add_int, id_, expr.a(), expr.b(), expr.c() });
+  }
+
+  void visit(const ast::MulAddExpr<float>& expr) override
+  {
+    const auto code = expr.fused() ? ColumnOp::Code::fma_float : ColumnOp::Code::mul_add_float;
+    program_.ops.emplace_back(ColumnOp{ code, id_, expr.a(), expr.b(), expr.c() });
+    kinds_[id_] = PrintOp::Kind::float_;
+  }
+
+  void visit(const ast::InputExpr<int>& expr) override
+  {
+    program_.ops.emplace_back(ColumnOp{ ColumnOp::Code::input, id_, expr.slot() });
+  }
+
+  void visit(const ast::InputExpr<float>& expr) override
+  {
+    program_.ops.emplace_back(ColumnOp{ ColumnOp::Code::input, id_, expr.slot() });
+    kinds_[id_] = PrintOp::Kind::float_;
+  }
+
+protected:
+  template<typename Derived>
+  void binary(const ColumnOp::Code code, const ast::BinaryExpr<Derived>& expr)
+  {
+    program_.ops.emplace_back(ColumnOp{ code, id_, expr.left(), expr.right() });
+    if ((code == ColumnOp::Code::add_float) || (code == ColumnOp::Code::mul_float)) {
+      kinds_[id_] = PrintOp::Kind::float_;
+    }
+  }
+};
+
+class BatchInterpreter final : public Interpreter
+{
+  /// @brief The most lanes per column. Fewer are used for large modules, to bound the memory used by the columns.
+  static constexpr size_t max_lanes = 256;
+
+  /// @brief The most scalars that all columns together may take up, unless a module needs more for 8 lanes.
+  static constexpr size_t max_storage = size_t(1) << 22;
+
+  Runtime* runtime_;
+
+  const Kernels* kernels_;
+
+  /// @brief The generation of the module that the program was lowered from, or zero if none was lowered yet.
+  uint64_t generation_{ 0 };
+
+  Program program_;
+
+  size_t lanes_{ 0 };
+
+  std::vector<ast::Scalar> columns_;
+
+public:
+  BatchInterpreter(Runtime* runtime, const Kernels* kernels)
+    : runtime_(runtime)
+    , kernels_(kernels)
+  {
+  }
+
+  void exec(const ast::Module& m, const ast::Scalar* inputs) override { exec_batch(m, inputs, 1); }
+
+  void exec_batch(const ast::Module& m, const ast::Scalar* rows, const size_t num_rows) override
+  {
+    if (generation_ != m.generation.value()) {
+      prepare(m);
+    }
+
+    // Literals are the same in every row, and nothing else writes to their columns.
+    for (const auto& literal : program_.literals) {
+      std::fill_n(column(literal.id), lanes_, literal.value);
+    }
+
+    for (size_t first = 0; first < num_rows; first += lanes_) {
+      const auto num_lanes = std::min(lanes_, num_rows - first);
+      compute(m, rows, first, num_lanes);
+      print(num_lanes);
+    }
+  }
+
+protected:
+  void prepare(const ast::Module& m)
+  {
+    generation_ = m.generation.value();
+    program_ = Lowering().lower(m);
+
+    const auto num_values = std::max<size_t>(program_.num_values, 1);
+    lanes_ = std::clamp<size_t>((max_storage / num_values) & ~size_t(7), 8, max_lanes);
+    columns_.resize(num_values * lanes_);
+  }
+
+  [[nodiscard]] auto column(const size_t id) -> Column { return columns_.data() + (id * lanes_); }
+
+  void compute(const ast::Module& m, const ast::Scalar* rows, const size_t first, const size_t n)
+  {
+    const auto& k = *kernels_;
+
+    const auto num_inputs = m.inputs.size();
+
+    for (const auto& op : program_.ops) {
+      auto* dst = column(op.dst);
+      switch (op.code) {
+        case ColumnOp::Code::input:
+          for (size_t lane = 0; lane < n; lane++) {
+            dst[lane] = rows ? rows[((first + lane) * num_inputs) + op.a] : m.inputs[op.a].default_value;
+          }
+          break;
+        case ColumnOp::Code::add_int:
+          k.add_int(dst, column(op.a), column(op.b), n);
+          break;
+        case ColumnOp::Code::add_float:
+          k.add_float(dst, column(op.a), column(op.b), n);
+          break;
+        case ColumnOp::Code::mul_int:
+          k.mul_int(dst, column(op.a), column(op.b), n);
+          break;
+        case ColumnOp::Code::mul_float:
+          k.mul_float(dst, column(op.a), column(op.b), n);
+          break;
+        case ColumnOp::Code::mul_add_int:
+          k.mul_add_int(dst, column(op.a), column(op.b), column(op.c), n);
+          break;
+        case ColumnOp::Code::mul_add_float:
+          k.mul_add_float(dst, column(op.a), column(op.b), column(op.c), n);
+          break;
+        case ColumnOp::Code::fma_float:
+          k.fma_float(dst, column(op.a), column(op.b), column(op.c), n);
+          break;
+      }
+    }
+  }
+
+  void print(const size_t n)
+  {
+    if (program_.prints.empty()) {
+      return;
+    }
+
+    for (size_t lane = 0; lane < n; lane++) {
+      for (const auto& op : program_.prints) {
+        switch (op.kind) {
+          case PrintOp::Kind::int_:
+            runtime_->print(column(op.id)[lane].int_value);
+            break;
+          case PrintOp::Kind::float_:
+            runtime_->print(column(op.id)[lane].float_value);
+            break;
+          case PrintOp::Kind::string:
+            runtime_->print(*op.string);
+            break;
+          case PrintOp::Kind::end:
+            runtime_->print_end();
+            break;
+        }
+      }
+    }
+  }
+};
+
+} // namespace
+
+auto
+create_batch_interpreter(Runtime* runtime, const BatchKernels kernels) -> std::unique_ptr<Interpreter>
+{
+  const auto* found = find_kernels(kernels);
+
+  return std::make_unique<BatchInterpreter>(runtime, found ? found : &select_kernels());
+}
+
+auto
+batch_kernels_supported(const BatchKernels kernels) -> bool
+{
+  return find_kernels(kernels) != nullptr;
+}
+
+} // namespace nabla
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "interpreter.h"
+
+#include <memory>
+
+namespace nabla {
+
+/// @brief Creates an interpreter that executes a module over many rows of inputs at once.
+///
+/// @details Each value of the module gets a column with one lane per row, and every statement is executed for a block
+///          of rows at a time. Arithmetic runs as AVX2 or SSE kernels over whole columns, depending on what the CPU
+///          supports. Once a block has been computed, its output is printed row by row.
+///
+///          The module is lowered to a list of column operations when it is first executed. That list is cached, keyed
+///          on the generation of the module.
+///
+/// @param kernels The kernels to use, if the CPU supports them. Otherwise, the best kernels that it supports are used.
+[[nodiscard]] auto
+create_batch_interpreter(Runtime* runtime, BatchKernels kernels = BatchKernels::best) -> std::unique_ptr<Interpreter>;
+
+/// @brief Checks whether the CPU supports a set of batch kernels.
+[[nodiscard]] auto
+batch_kernels_supported(BatchKernels kernels) -> bool;
+
+} // namespace nabla
@@ -0,0 +1,159 @@
+#include "buffered_runtime.h"
+
+#include <algorithm>
+#include <charconv>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace nabla {
+
+namespace {
+
+/// @brief Enough room for any int.
+constexpr size_t max_int_size = 16;
+
+/// @brief Enough room for any float, when formatted with 6 significant digits in the general format.
+constexpr size_t max_float_size = 32;
+
+/// @brief The precision that std::ostream uses by default.
+constexpr int stream_precision = 6;
+
+[[nodiscard]] auto
+clamp_capacity(const size_t capacity) -> size_t
+{
+  return std::max(capacity, max_float_size);
+}
+
+} // namespace
+
+BufferedRuntime::BufferedRuntime()
+  : BufferedRuntime(STDOUT_FILENO)
+{
+}
+
+BufferedRuntime::BufferedRuntime(const int fd, const size_t capacity)
+  : buffer_(new char[clamp_capacity(capacity)])
+  , capacity_(clamp_capacity(capacity))
+  , fd_(fd)
+{
+}
+
+BufferedRuntime::BufferedRuntime(ByteSink* sink, const size_t capacity)
+  : buffer_(new char[clamp_capacity(capacity)])
+  , capacity_(clamp_capacity(capacity))
+  , sink_(sink)
+{
+}
+
+BufferedRuntime::~BufferedRuntime()
+{
+  flush();
+}
+
+void
+BufferedRuntime::print(const std::string& data)
+{
+  if ((size_ + data.size()) <= capacity_) {
+    memcpy(buffer_.get() + size_, data.data(), data.size());
+    size_ += data.size();
+    return;
+  }
+
+  if (sink_) {
+    flush();
+    sink_->write(data.data(), data.size());
+    return;
+  }
+
+  // Write the pending output and the string together, without copying the string.
+
+  iovec vec[2]{ { buffer_.get(), size_ }, { const_cast<char*>(data.data()), data.size() } };
+
+  int index = 0;
+
+  while (!failed_ && (index < 2)) {
+    const auto result = writev(fd_, vec + index, 2 - index);
+    if (result < 0) {
+      failed_ = (errno != EINTR);
+      continue;
+    }
+    auto written = static_cast<size_t>(result);
+    while ((index < 2) && (written >= vec[index].iov_len)) {
+      written -= vec[index].iov_len;
+      index++;
+    }
+    if (index < 2) {
+      vec[index].iov_base = static_cast<char*>(vec[index].iov_base) + written;
+      vec[index].iov_len -= written;
+    }
+  }
+
+  size_ = 0;
+}
+
+void
+BufferedRuntime::print(const int data)
+{
+  reserve(max_int_size);
+  const auto result = std::to_chars(buffer_.get() + size_, buffer_.get() + capacity_, data);
+  size_ = static_cast<size_t>(result.ptr - buffer_.get());
+}
+
+void
+BufferedRuntime::print(const float data)
+{
+  reserve(max_float_size);
+  const auto result =
+    std::to_chars(buffer_.get() + size_, buffer_.get() + capacity_, data, std::chars_format::general, stream_precision);
+  size_ = static_cast<size_t>(result.ptr - buffer_.get());
+}
+
+void
+BufferedRuntime::print_end()
+{
+  reserve(1);
+  buffer_[size_++] = '\n';
+}
+
+void
+BufferedRuntime::flush()
+{
+  if (size_ == 0) {
+    return;
+  }
+
+  if (sink_) {
+    sink_->write(buffer_.get(), size_);
+  } else {
+    write_fd(buffer_.get(), size_);
+  }
+
+  size_ = 0;
+}
+
+void
+BufferedRuntime::reserve(const size_t size)
+{
+  if ((size_ + size) > capacity_) {
+    flush();
+  }
+}
+
+void
+BufferedRuntime::write_fd(const char* data, size_t size)
+{
+  while (!failed_ && (size > 0)) {
+    const auto result = ::write(fd_, data, size);
+    if (result < 0) {
+      failed_ = (errno != EINTR);
+      continue;
+    }
+    data += result;
+    size -= static_cast<size_t>(result);
+  }
+}
+
+} // namespace nabla
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "byte_sink.h"
+#include "interpreter.h"
+
+#include <memory>
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief A runtime that formats output into a large buffer, instead of going through an output stream.
+///
+/// @details Numbers are formatted with std::to_chars, using the same format that std::ostream uses by default. The
+///          buffer is written out only when it fills up, when @ref BufferedRuntime::flush is called, or when the
+///          runtime is destroyed. When writing to a file descriptor, large strings are written along with the pending
+///          buffer using a single call to writev, instead of being copied into the buffer.
+class BufferedRuntime final : public Runtime
+{
+public:
+  static constexpr size_t default_capacity = 64 * 1024;
+
+  /// @brief Constructs a runtime that writes to standard output.
+  BufferedRuntime();
+
+  /// @brief Constructs a runtime that writes to a file descriptor. The file descriptor is not closed by the runtime.
+  explicit BufferedRuntime(int fd, size_t capacity = default_capacity);
+
+  /// @brief Constructs a runtime that writes to a caller-supplied sink. The sink must outlive the runtime.
+  explicit BufferedRuntime(ByteSink* sink, size_t capacity = default_capacity);
+
+  BufferedRuntime(const BufferedRuntime&) = delete;
+
+  auto operator=(const BufferedRuntime&) -> BufferedRuntime& = delete;
+
+  ~BufferedRuntime() override;
+
+  void print(const std::string& data) override;
+
+  void print(int data) override;
+
+  void print(float data) override;
+
+  void print_end() override;
+
+  /// @brief Writes all buffered output.
+  void flush();
+
+  /// @brief Indicates whether writing to the file descriptor has failed. Once it fails, output is discarded.
+  [[nodiscard]] auto failed() const -> bool { return failed_; }
+
+private:
+  void reserve(size_t size);
+
+  void write_fd(const char* data, size_t size);
+
+  std::unique_ptr<char[]> buffer_;
+
+  size_t capacity_{ 0 };
+
+  size_t size_{ 0 };
+
+  int fd_{ -1 };
+
+  ByteSink* sink_{ nullptr };
+
+  bool failed_{ false };
+};
+
+} // namespace nabla
@@ -0,0 +1,420 @@
+#include "build_cache.h"
+
+#include "hash.h"
+#include "module_interface.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <link.h>
+#endif
+
+namespace nabla {
+
+namespace {
+
+/// @brief Starts every entry. The last byte is the version of the format.
+constexpr std::string_view magic{ "NABLAC\0\1", 8 };
+
+/// @brief Temporary files start with this, so that they are never mistaken for entries.
+constexpr std::string_view temp_prefix{ ".tmp-" };
+
+/// @brief Temporary files older than this are left over from interrupted builds.
+constexpr auto temp_max_age = std::chrono::hours(1);
+
+[[nodiscard]] auto
+read_file(const std::filesystem::path& path, std::string& data) -> bool
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.good()) {
+    return false;
+  }
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  data = stream.str();
+  return true;
+}
+
+#ifdef __linux__
+
+/// @brief Finds the build ID that the linker wrote into the executable, which is a hash of its contents.
+[[nodiscard]] auto
+find_build_id(std::string& id) -> bool
+{
+  const auto visit = [](dl_phdr_info* info, size_t, void* data) -> int {
+    auto& build_id = *static_cast<std::string*>(data);
+    for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+      const auto& header = info->dlpi_phdr[i];
+      if (header.p_type != PT_NOTE) {
+        continue;
+      }
+      const auto align = std::max<size_t>(header.p_align, 4);
+      const auto padded = [align](const size_t size) { return (size + align - 1) & ~(align - 1); };
+      const auto* p = reinterpret_cast<const char*>(info->dlpi_addr + header.p_vaddr);
+      const auto* end = p + header.p_memsz;
+      while ((p + sizeof(ElfW(Nhdr))) <= end) {
+        const auto* note = reinterpret_cast<const ElfW(Nhdr)*>(p);
+        const auto* name = p + sizeof(ElfW(Nhdr));
+        const auto* desc = name + padded(note->n_namesz);
+        if ((desc + note->n_descsz) > end) {
+          break;
+        }
+        if ((note->n_type == NT_GNU_BUILD_ID) && (note->n_namesz == 4) && (memcmp(name, "GNU", 4) == 0)) {
+          build_id.assign(desc, note->n_descsz);
+          break;
+        }
+        p = desc + padded(note->n_descsz);
+      }
+    }
+    // The executable is visited first, and the libraries after it don't matter.
+    return 1;
+  };
+
+  (void)dl_iterate_phdr(visit, &id);
+
+  return !id.empty();
+}
+
+#endif
+
+/// @brief Hashes the executable, without copying it into memory.
+[[nodiscard]] auto
+hash_executable(uint64_t& hash) -> bool
+{
+  const auto fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info
+  {};
+
+  void* mapping{ MAP_FAILED };
+
+  if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+    mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  hash = xxhash64(std::string_view(static_cast<const char*>(mapping), static_cast<size_t>(info.st_size)));
+
+  munmap(mapping, static_cast<size_t>(info.st_size));
+
+  return true;
+}
+
+/// @brief Identifies the compiler, so that a new build of it does not use entries written by an old one.
+///
+/// @details This is the build ID of the executable if the linker wrote one, since reading it costs nothing, and a hash
+///          of the executable otherwise. Either is found once per process.
+[[nodiscard]] auto
+compiler_id() -> const std::string&
+{
+  static const std::string id = []() {
+#ifdef __linux__
+    if (std::string build_id; find_build_id(build_id)) {
+      return "build-id " + hash_to_hex(xxhash64(build_id));
+    }
+#endif
+    if (uint64_t hash{}; hash_executable(hash)) {
+      return hash_to_hex(hash);
+    }
+    // Without the executable, the time this file was compiled is the best approximation of the version.
+    return std::string(__DATE__ " " __TIME__);
+  }();
+
+  return id;
+}
+
+void
+put_u64(std::string& out, const uint64_t value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void
+put_buffer(std::string& out, const codegen::ChunkedBuffer& buffer)
+{
+  put_u64(out, buffer.size());
+  for (const auto& chunk : buffer.chunks()) {
+    out += chunk;
+  }
+}
+
+/// @brief Reads the fields of an entry, checking that they stay within it.
+class Reader final
+{
+  std::string_view data_;
+
+public:
+  explicit Reader(const std::string_view& data)
+    : data_(data)
+  {
+  }
+
+  [[nodiscard]] auto u64(uint64_t& value) -> bool
+  {
+    if (data_.size() < sizeof(value)) {
+      return false;
+    }
+    memcpy(&value, data_.data(), sizeof(value));
+    data_.remove_prefix(sizeof(value));
+    return true;
+  }
+
+  [[nodiscard]] auto bytes(std::string_view& value) -> bool
+  {
+    uint64_t size{};
+    if (!u64(size) || (data_.size() < size)) {
+      return false;
+    }
+    value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  [[nodiscard]] auto buffer(codegen::ChunkedBuffer& value) -> bool
+  {
+    std::string_view data;
+    if (!bytes(data)) {
+      return false;
+    }
+    value.append(data);
+    return true;
+  }
+
+  [[nodiscard]] auto done() const -> bool { return data_.empty(); }
+};
+
+} // namespace
+
+BuildCache::BuildCache(std::filesystem::path dir, const uint64_t max_size)
+  : dir_(std::move(dir))
+  , max_size_(max_size)
+{
+  std::error_code error;
+  std::filesystem::create_directories(dir_, error);
+}
+
+auto
+BuildCache::make_key(const std::string_view& source, const std::string_view& config) -> CacheKey
+{
+  // The fields are hashed separately, so that moving bytes from one to another changes the key.
+  uint64_t prefix = xxhash64(magic);
+  prefix = xxhash64(compiler_id(), prefix);
+  prefix = xxhash64(config, prefix);
+
+  return CacheKey{ xxhash64(source, prefix), xxhash64(source, ~prefix) };
+}
+
+auto
+BuildCache::entry_path(const CacheKey& key) const -> std::filesystem::path
+{
+  return dir_ / (hash_to_hex(key.high) + hash_to_hex(key.low));
+}
+
+auto
+BuildCache::interface_path(const CacheKey& key) const -> std::filesystem::path
+{
+  return dir_ / (hash_to_hex(key.high) + hash_to_hex(key.low) + ".interface");
+}
+
+auto
+BuildCache::load(const CacheKey& key, CompileOutput& output) -> bool
+{
+  const auto path = entry_path(key);
+
+  std::string data;
+
+  if (!read_file(path, data) || (data.size() < (magic.size() + sizeof(uint64_t))) ||
+      (std::string_view(data).substr(0, magic.size()) != magic)) {
+    misses_++;
+    return false;
+  }
+
+  const auto body = std::string_view(data).substr(0, data.size() - sizeof(uint64_t));
+
+  uint64_t checksum{};
+
+  memcpy(&checksum, data.data() + body.size(), sizeof(checksum));
+
+  if (xxhash64(body) != checksum) {
+    misses_++;
+    return false;
+  }
+
+  Reader reader(body.substr(magic.size()));
+
+  CompileOutput result;
+
+  uint64_t success{};
+
+  uint64_t num_units{};
+
+  std::string_view messages;
+
+  auto valid = reader.u64(success) && reader.bytes(messages) && reader.buffer(result.header) && reader.u64(num_units);
+
+  for (uint64_t i = 0; valid && (i < num_units); i++) {
+    valid = reader.buffer(result.units.emplace_back());
+  }
+
+  if (!valid || !reader.done()) {
+    misses_++;
+    return false;
+  }
+
+  result.success = success != 0;
+
+  result.messages = messages;
+
+  output = std::move(result);
+
+  // Another build may have evicted the entry since, in which case it just won't be touched.
+  std::error_code error;
+  std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+  hits_++;
+
+  return true;
+}
+
+auto
+BuildCache::store(const CacheKey& key, const CompileOutput& output) -> bool
+{
+  std::string data(magic);
+
+  put_u64(data, output.success ? 1 : 0);
+  put_u64(data, output.messages.size());
+  data += output.messages;
+  put_buffer(data, output.header);
+  put_u64(data, output.units.size());
+  for (const auto& unit : output.units) {
+    put_buffer(data, unit);
+  }
+  put_u64(data, xxhash64(data));
+
+  return write_file(entry_path(key), data);
+}
+
+auto
+BuildCache::load_interface(const CacheKey& key) -> std::shared_ptr<const ModuleInterface>
+{
+  const auto path = interface_path(key);
+
+  auto interface = ModuleInterface::map(path);
+
+  if (interface) {
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+  }
+
+  return interface;
+}
+
+auto
+BuildCache::store_interface(const CacheKey& key, const std::string_view& data) -> bool
+{
+  return write_file(interface_path(key), data);
+}
+
+auto
+BuildCache::write_file(const std::filesystem::path& path, const std::string_view& data) -> bool
+{
+  auto temp = dir_;
+  temp /= std::string(temp_prefix) + std::to_string(getpid()) + "-" + std::to_string(temp_counter_++);
+
+  {
+    std::ofstream file(temp, std::ios::binary);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    file.close();
+    if (!file.good()) {
+      std::error_code error;
+      std::filesystem::remove(temp, error);
+      return false;
+    }
+  }
+
+  // Renaming replaces the entry atomically, so readers get either the old entry or the new one.
+  std::error_code error;
+  std::filesystem::rename(temp, path, error);
+  if (error) {
+    std::filesystem::remove(temp, error);
+    return false;
+  }
+
+  return true;
+}
+
+void
+BuildCache::evict()
+{
+  struct Entry final
+  {
+    std::filesystem::path path;
+
+    uint64_t size{ 0 };
+
+    std::filesystem::file_time_type time;
+  };
+
+  std::vector<Entry> entries;
+
+  uint64_t total_size{ 0 };
+
+  const auto now = std::filesystem::file_time_type::clock::now();
+
+  std::error_code error;
+
+  for (std::filesystem::directory_iterator it(dir_, error), end; !error && (it != end); it.increment(error)) {
+    // Files can disappear at any point, since other builds evict too, so errors are only skipped over.
+    std::error_code entry_error;
+    if (!it->is_regular_file(entry_error)) {
+      continue;
+    }
+    Entry entry{ it->path(), it->file_size(entry_error), it->last_write_time(entry_error) };
+    if (entry_error) {
+      continue;
+    }
+    if (entry.path.filename().string().compare(0, temp_prefix.size(), temp_prefix) == 0) {
+      if ((now - entry.time) > temp_max_age) {
+        std::filesystem::remove(entry.path, entry_error);
+      }
+      continue;
+    }
+    total_size += entry.size;
+    entries.emplace_back(std::move(entry));
+  }
+
+  if (total_size <= max_size_) {
+    return;
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.time < b.time; });
+
+  for (const auto& entry : entries) {
+    if (total_size <= max_size_) {
+      break;
+    }
+    std::error_code entry_error;
+    std::filesystem::remove(entry.path, entry_error);
+    total_size -= entry.size;
+  }
+}
+
+} // namespace nabla
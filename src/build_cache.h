@@ -0,0 +1,110 @@
+#pragma once
+
+#include "codegen/chunked_buffer.h"
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla {
+
+class ModuleInterface;
+
+/// @brief What compiling one source file produces, which is what the build cache stores for it.
+struct CompileOutput final
+{
+  bool success{ false };
+
+  /// @brief The diagnostics printed while compiling the file.
+  std::string messages;
+
+  /// @brief The header that the translation units share, which is empty unless the code was split.
+  codegen::ChunkedBuffer header;
+
+  /// @brief The generated translation units, which there are none of if compiling failed.
+  std::vector<codegen::ChunkedBuffer> units;
+};
+
+struct CacheKey final
+{
+  uint64_t high{ 0 };
+
+  uint64_t low{ 0 };
+};
+
+/// @brief A directory of compile outputs, keyed by a hash of the source file, the compiler and its options.
+///
+/// @details Modules that other modules import also have their interface stored, in a file next to the entry, which is
+///          evicted like any other. Each entry is one file, which is written to a temporary file first and then
+///          renamed into place, so that builds running at the same time only ever see complete entries. Entries end
+///          with a checksum, and one that does not match is treated as missing. Loading an entry updates its
+///          modification time, and @ref BuildCache::evict removes the least recently used entries once the cache grows
+///          past its size limit.
+class BuildCache final
+{
+public:
+  static constexpr uint64_t default_max_size = 256 * 1024 * 1024;
+
+  explicit BuildCache(std::filesystem::path dir, uint64_t max_size = default_max_size);
+
+  /// @brief Computes the key of a source file.
+  ///
+  /// @param config Describes everything other than the source and the compiler that affects the output, such as the
+  ///               path of the file and the code generation options.
+  [[nodiscard]] static auto make_key(const std::string_view& source, const std::string_view& config) -> CacheKey;
+
+  /// @brief Loads an entry.
+  ///
+  /// @return False if there is no valid entry for the key.
+  [[nodiscard]] auto load(const CacheKey& key, CompileOutput& output) -> bool;
+
+  /// @brief Stores an entry, replacing any existing one.
+  ///
+  /// @return False if the entry could not be written, which leaves the cache as it was.
+  [[nodiscard]] auto store(const CacheKey& key, const CompileOutput& output) -> bool;
+
+  /// @brief Loads the interface of a module, which is mapped into memory rather than read.
+  ///
+  /// @return Null if there is no valid interface for the key.
+  [[nodiscard]] auto load_interface(const CacheKey& key) -> std::shared_ptr<const ModuleInterface>;
+
+  /// @brief Stores the interface of a module, as encoded by @ref ModuleInterface::encode, replacing any existing one.
+  ///
+  /// @return False if the interface could not be written, which leaves the cache as it was.
+  [[nodiscard]] auto store_interface(const CacheKey& key, const std::string_view& data) -> bool;
+
+  /// @brief Removes the least recently used entries until the cache fits in its size limit, along with temporary files
+  ///        left behind by builds that were interrupted.
+  void evict();
+
+  [[nodiscard]] auto num_hits() const -> size_t { return hits_.load(); }
+
+  [[nodiscard]] auto num_misses() const -> size_t { return misses_.load(); }
+
+private:
+  [[nodiscard]] auto entry_path(const CacheKey& key) const -> std::filesystem::path;
+
+  [[nodiscard]] auto interface_path(const CacheKey& key) const -> std::filesystem::path;
+
+  /// @brief Writes a file through a temporary one, so that it is replaced atomically.
+  [[nodiscard]] auto write_file(const std::filesystem::path& path, const std::string_view& data) -> bool;
+
+  std::filesystem::path dir_;
+
+  uint64_t max_size_{ default_max_size };
+
+  std::atomic<size_t> hits_{ 0 };
+
+  std::atomic<size_t> misses_{ 0 };
+
+  /// @brief Makes the names of temporary files unique within the process.
+  std::atomic<uint64_t> temp_counter_{ 0 };
+};
+
+} // namespace nabla
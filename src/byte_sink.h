@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief Receives output in batches, such as the output of a @ref BufferedRuntime or of the code generator.
+class ByteSink
+{
+public:
+  virtual ~ByteSink() = default;
+
+  virtual void write(const char* data, size_t size) = 0;
+};
+
+} // namespace nabla
@@ -0,0 +1,177 @@
+#include "chunked_buffer.h"
+
+#include "../byte_sink.h"
+
+#include <algorithm>
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+
+namespace nabla::codegen {
+
+namespace {
+
+constexpr size_t max_indent_level = 32;
+
+/// @brief Enough spaces for the indentation of most lines, so that it can be appended with a single copy.
+constexpr std::string_view indentation{ "                                                                " };
+
+static_assert(indentation.size() == (max_indent_level * 2));
+
+} // namespace
+
+auto
+ChunkedBuffer::last_chunk_space() const -> size_t
+{
+  return chunks_.empty() ? 0 : (chunk_size - chunks_.back().size);
+}
+
+void
+ChunkedBuffer::add_chunk()
+{
+  // The chunk is not zeroed, since only the bytes that have been written to are read.
+  chunks_.push_back(Chunk{ std::unique_ptr<char[]>(new char[chunk_size]), 0 });
+}
+
+void
+ChunkedBuffer::append(std::string_view data)
+{
+  size_ += data.size();
+
+  while (!data.empty()) {
+    if (last_chunk_space() == 0) {
+      add_chunk();
+    }
+    auto& chunk = chunks_.back();
+    const auto n = std::min(data.size(), chunk_size - chunk.size);
+    memcpy(chunk.data.get() + chunk.size, data.data(), n);
+    chunk.size += n;
+    data.remove_prefix(n);
+  }
+}
+
+void
+ChunkedBuffer::append(const char c)
+{
+  if (last_chunk_space() == 0) {
+    add_chunk();
+  }
+
+  auto& chunk = chunks_.back();
+
+  chunk.data[chunk.size++] = c;
+
+  size_++;
+}
+
+void
+ChunkedBuffer::append(ChunkedBuffer&& other)
+{
+  for (auto& chunk : other.chunks_) {
+    if (chunk.size > 0) {
+      chunks_.emplace_back(std::move(chunk));
+    }
+  }
+
+  size_ += other.size_;
+
+  other.chunks_.clear();
+
+  other.size_ = 0;
+}
+
+void
+ChunkedBuffer::append_indent(size_t level)
+{
+  while (level > 0) {
+    const auto n = std::min(level, max_indent_level);
+    append(indentation.substr(0, n * 2));
+    level -= n;
+  }
+}
+
+auto
+ChunkedBuffer::chunks() const -> std::vector<std::string_view>
+{
+  std::vector<std::string_view> result;
+
+  result.reserve(chunks_.size());
+
+  for (const auto& chunk : chunks_) {
+    result.emplace_back(chunk.data.get(), chunk.size);
+  }
+
+  return result;
+}
+
+auto
+ChunkedBuffer::count_lines() const -> size_t
+{
+  size_t count{ 0 };
+
+  for (const auto& chunk : chunks_) {
+    count += static_cast<size_t>(std::count(chunk.data.get(), chunk.data.get() + chunk.size, '\n'));
+  }
+
+  return count;
+}
+
+auto
+ChunkedBuffer::str() const -> std::string
+{
+  std::string result;
+
+  result.reserve(size_);
+
+  for (const auto& chunk : chunks()) {
+    result += chunk;
+  }
+
+  return result;
+}
+
+auto
+ChunkedBuffer::write_to(const int fd) const -> bool
+{
+  std::vector<iovec> vec;
+
+  for (const auto& chunk : chunks()) {
+    vec.push_back(iovec{ const_cast<char*>(chunk.data()), chunk.size() });
+  }
+
+  size_t index = 0;
+
+  while (index < vec.size()) {
+    const auto count = std::min(vec.size() - index, static_cast<size_t>(IOV_MAX));
+    const auto result = writev(fd, vec.data() + index, static_cast<int>(count));
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    auto written = static_cast<size_t>(result);
+    while ((index < vec.size()) && (written >= vec[index].iov_len)) {
+      written -= vec[index].iov_len;
+      index++;
+    }
+    if (index < vec.size()) {
+      vec[index].iov_base = static_cast<char*>(vec[index].iov_base) + written;
+      vec[index].iov_len -= written;
+    }
+  }
+
+  return true;
+}
+
+void
+ChunkedBuffer::write_to(ByteSink& sink) const
+{
+  for (const auto& chunk : chunks()) {
+    sink.write(chunk.data(), chunk.size());
+  }
+}
+
+} // namespace nabla::codegen
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class ByteSink;
+
+} // namespace nabla
+
+namespace nabla::codegen {
+
+/// @brief An append-only buffer for generated source code.
+///
+/// @details Text is appended into a list of fixed-size chunks, so that growing the buffer never moves what has already
+///          been written. The chunks can be written out with a single call to writev, or read in place through
+///          @ref ChunkedBuffer::chunks, without joining them into one string first. Buffers are concatenated by moving
+///          their chunks, so the chunks before the last one are not necessarily full.
+class ChunkedBuffer final
+{
+public:
+  static constexpr size_t chunk_size = 64 * 1024;
+
+  void append(std::string_view data);
+
+  void append(char c);
+
+  /// @brief Moves the contents of another buffer to the end of this one, without copying them.
+  void append(ChunkedBuffer&& other);
+
+  /// @brief Appends the indentation for the given level, two spaces per level.
+  void append_indent(size_t level);
+
+  [[nodiscard]] auto size() const -> size_t { return size_; }
+
+  [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+
+  /// @brief Counts the newlines in the buffer, which is the number of complete lines.
+  [[nodiscard]] auto count_lines() const -> size_t;
+
+  /// @brief Gets the contents of the buffer, in order, as views into the chunks.
+  ///
+  /// @note The views are invalidated by the next call that appends to the buffer.
+  [[nodiscard]] auto chunks() const -> std::vector<std::string_view>;
+
+  /// @brief Joins the contents of the buffer into one string.
+  [[nodiscard]] auto str() const -> std::string;
+
+  /// @brief Writes the contents of the buffer to a file descriptor, which is not closed.
+  ///
+  /// @return False if writing failed, in which case errno describes the error.
+  [[nodiscard]] auto write_to(int fd) const -> bool;
+
+  /// @brief Passes the contents of the buffer to a sink, one chunk at a time.
+  void write_to(ByteSink& sink) const;
+
+private:
+  struct Chunk final
+  {
+    std::unique_ptr<char[]> data;
+
+    /// @brief The number of bytes used, out of @ref ChunkedBuffer::chunk_size.
+    size_t size{ 0 };
+  };
+
+  [[nodiscard]] auto last_chunk_space() const -> size_t;
+
+  void add_chunk();
+
+  std::vector<Chunk> chunks_;
+
+  size_t size_{ 0 };
+};
+
+} // namespace nabla::codegen
@@ -3,6 +3,7 @@
 #include "../lexer.h"
 
 #include <sstream>
+#include <utility>
 
 #include <assert.h>
 
@@ -11,7 +12,29 @@ namespace nabla::codegen {
 auto
 CodeWriter::source() const -> std::string
 {
-  return source_;
+  return buffer_.str();
+}
+
+auto
+CodeWriter::create_shard() const -> std::unique_ptr<CodeWriter>
+{
+  auto shard = create_empty();
+  shard->indent_ = indent_;
+  shard->assign_declarations_ = assign_declarations_;
+  shard->fused_products_ = fused_products_;
+  return shard;
+}
+
+void
+CodeWriter::append(ChunkedBuffer&& code)
+{
+  buffer_.append(std::move(code));
+}
+
+auto
+CodeWriter::take_buffer() -> ChunkedBuffer
+{
+  return std::exchange(buffer_, ChunkedBuffer{});
 }
 
 void
@@ -31,44 +54,146 @@ CodeWriter::dedent()
 void
 CodeWriter::add_line(const std::string_view& line)
 {
-  for (size_t i = 0; i < indent_; i++) {
-    source_ += "  ";
-  }
+  buffer_.append_indent(indent_);
 
-  source_ += line;
+  buffer_.append(line);
 
-  source_ += '\n';
+  buffer_.append('\n');
+}
+
+void
+CodeWriter::begin_line()
+{
+  buffer_.append_indent(indent_);
 }
 
 void
 CodeWriter::write(const std::string_view& str)
 {
-  source_ += str;
+  buffer_.append(str);
 }
 
 void
 CodeWriter::newline()
 {
-  source_ += '\n';
+  buffer_.append('\n');
+}
+
+namespace {
+
+/// @brief Finds the token that an expression starts with.
+class FirstTokenFinder final : public ExprVisitor
+{
+public:
+  const Token* token{ nullptr };
+
+  void visit(const IntLiteralExpr& expr) override { token = &expr.token(); }
+
+  void visit(const FloatLiteralExpr& expr) override { token = &expr.token(); }
+
+  void visit(const StringLiteralExpr& expr) override { token = &expr.token(); }
+
+  void visit(const VarExpr& expr) override { token = &expr.get_name(); }
+
+  void visit(const CallExpr& expr) override { token = &expr.name(); }
+
+  void visit(const AddExpr& expr) override { expr.left().accept(*this); }
+
+  void visit(const MulExpr& expr) override { expr.left().accept(*this); }
+};
+
+} // namespace
+
+void
+CodeWriter::write_line_directive(const Token& token)
+{
+  if (!options_.line_directives || options_.filename.empty()) {
+    return;
+  }
+
+  const auto* filename = &options_.filename;
+
+  for (const auto& [source, path] : options_.imported_sources) {
+    if ((token.data.data() >= source.data()) && (token.data.data() < (source.data() + source.size()))) {
+      filename = &path;
+    }
+  }
+
+  write_line_directive(token.line, *filename);
+}
+
+void
+CodeWriter::write_output_line_directive(const std::string& name)
+{
+  if (!options_.line_directives || options_.filename.empty()) {
+    return;
+  }
+
+  const auto path = options_.output_dir.empty() ? name : (options_.output_dir + "/" + name);
+
+  // The directive is on the line after the last one written, and applies to the line after itself.
+  write_line_directive(buffer_.count_lines() + 2, path);
+}
+
+void
+CodeWriter::write_line_directive(const size_t line, const std::string& filename)
+{
+  // Directives must start at the beginning of a line, so they are not indented.
+  buffer_.append("#line ");
+  buffer_.append(std::to_string(line));
+  buffer_.append(" \"");
+
+  for (const auto c : filename) {
+    if ((c == '\\') || (c == '"')) {
+      buffer_.append('\\');
+    }
+    buffer_.append(c);
+  }
+
+  buffer_.append("\"\n");
+}
+
+void
+CodeWriter::write_line_directive(const Expr& expr)
+{
+  FirstTokenFinder finder;
+
+  expr.accept(finder);
+
+  if (finder.token) {
+    write_line_directive(*finder.token);
+  }
+}
+
+auto
+CodeWriter::fused_product(const AddExpr& expr) const -> const FusedProduct*
+{
+  if (!fused_products_) {
+    return nullptr;
+  }
+
+  const auto it = fused_products_->find(&expr);
+
+  return (it != fused_products_->end()) ? &it->second : nullptr;
 }
 
 void
 CodeWriter::visit(const IntLiteralExpr& expr)
 {
-  source_ += expr.token().data;
+  buffer_.append(expr.token().data);
 }
 
 void
 CodeWriter::visit(const FloatLiteralExpr& expr)
 {
-  source_ += expr.token().data;
+  buffer_.append(expr.token().data);
 }
 
 void
 CodeWriter::visit(const AddExpr& expr)
 {
   expr.left().accept(*this);
-  source_ += " + ";
+  buffer_.append(" + ");
   expr.right().accept(*this);
 }
 
@@ -76,21 +201,21 @@ void
 CodeWriter::visit(const MulExpr& expr)
 {
   expr.left().accept(*this);
-  source_ += " * ";
+  buffer_.append(" * ");
   expr.right().accept(*this);
 }
 
 void
 CodeWriter::visit(const VarExpr& expr)
 {
-  source_ += expr.get_name().data;
+  buffer_.append(expr.get_name().data);
 }
 
 void
 CodeWriter::visit(const CallExpr& expr)
 {
-  source_ += expr.name().data;
-  source_ += "(";
+  buffer_.append(expr.name().data);
+  buffer_.append("(");
   const auto& args = expr.args();
   for (size_t i = 0; i < args.size(); i++) {
 
@@ -100,32 +225,129 @@ CodeWriter::visit(const CallExpr& expr)
     args[i].second->accept(*this);
     const auto last = (i + 1) == args.size();
     if (!last) {
-      source_ += ", ";
+      buffer_.append(", ");
     }
   }
 
-  source_ += ")";
+  buffer_.append(")");
 }
 
 namespace {
 
-#if 0
-class CXXTypeWriter final : public TypeVisitor
-  {
-    public:
-  };
-#endif
+[[nodiscard]] auto
+cxx_type_name(const TypeID type_id) -> const char*
+{
+  switch (type_id) {
+    case TypeID::float_:
+      return "float";
+    case TypeID::int_:
+      return "int";
+    case TypeID::string:
+      return "std::string_view";
+    case TypeID::struct_:
+      break;
+  }
+
+  return nullptr;
+}
+
+/// @brief Gets the C++ type for a type written in the source, which is either a built-in type or a struct.
+///
+/// @note The validator has made sure that names that aren't built-in types name a struct.
+[[nodiscard]] auto
+cxx_type_name(const TypeInstance& type) -> std::string
+{
+  const auto name = type.name().data;
+
+  if (TypeID type_id{}; find_builtin_type(name, type_id)) {
+    return cxx_type_name(type_id);
+  }
+
+  return std::string(name);
+}
 
 } // namespace
 
+auto
+CXXCodeWriter::create_empty() const -> std::unique_ptr<CodeWriter>
+{
+  return std::make_unique<CXXCodeWriter>(&annotations(), options());
+}
+
+void
+CXXCodeWriter::write_prologue()
+{
+  // The runtime header also includes <string_view>, which string constants need.
+  add_line("#include \"nabla_rt.h\"");
+  add_line("");
+
+  if (options().fma) {
+    add_line("#include <cmath>");
+  }
+}
+
+void
+CXXCodeWriter::visit(const FloatLiteralExpr& expr)
+{
+  // Floats are single precision, and the literal must be too, or the expression would be evaluated as a double.
+  CodeWriter::visit(expr);
+  write("f");
+}
+
+void
+CXXCodeWriter::visit(const StringLiteralExpr& expr)
+{
+  // The escape sequences of nabla are a subset of those of C++, so the literal can be copied as is.
+  write(expr.token().data);
+}
+
+void
+CXXCodeWriter::visit(const PrintNode& node)
+{
+  if (!node.args().empty()) {
+    write_line_directive(*node.args().front());
+  }
+
+  for (const auto& arg : node.args()) {
+    begin_line();
+    write("nabla::rt::print(");
+    arg->accept(*this);
+    write(");");
+    newline();
+  }
+
+  add_line("nabla::rt::print_end();");
+}
+
+void
+CXXCodeWriter::visit(const AddExpr& expr)
+{
+  const auto* fused = fused_product(expr);
+  if (!fused) {
+    CodeWriter::visit(expr);
+    return;
+  }
+
+  // The product may be the value of a declaration, whose operands are written here instead, since the declaration
+  // holds the rounded product.
+  write("std::fma(");
+  fused->product->left().accept(*this);
+  write(", ");
+  fused->product->right().accept(*this);
+  write(", ");
+  fused->addend->accept(*this);
+  write(")");
+}
+
 void
 CXXCodeWriter::visit(const StructNode& node)
 {
+  write_line_directive(node.name());
   add_line("struct " + std::string(node.name().data) + " final {");
   indent();
   for (const auto& field : node.fields()) {
     std::ostringstream stream;
-    stream << field->get_type().name().data;
+    stream << cxx_type_name(field->get_type());
     stream << ' ';
     stream << field->get_name().data;
     stream << "{};";
@@ -138,17 +360,198 @@ CXXCodeWriter::visit(const StructNode& node)
 void
 CXXCodeWriter::visit(const FuncNode& node)
 {
+  // Parameters without a type accept any type, which C++17 can only express with a template.
+  std::string template_params;
+
+  std::string params;
+
+  const auto& func_params = node.params();
+
+  for (size_t i = 0; i < func_params.size(); i++) {
+    const auto& param = *func_params[i];
+
+    std::string type;
+
+    if (param.has_type()) {
+      type = cxx_type_name(param.get_type());
+    } else {
+      type = "T" + std::to_string(i);
+      template_params += template_params.empty() ? "template<" : ", ";
+      template_params += "typename " + type;
+    }
+
+    if (i > 0) {
+      params += ", ";
+    }
+
+    params += "const " + type + " " + std::string(param.get_name().data);
+
+    if (param.has_value()) {
+      CXXCodeWriter value_writer(&annotations(), options());
+      param.get_value().accept(value_writer);
+      params += " = " + value_writer.source();
+    }
+  }
+
+  if (!template_params.empty()) {
+    add_line(template_params + ">");
+  }
+
+  // The return type is deduced from the return statements, so it is void if there are none.
+  add_line("inline auto");
+  // The directive goes right before the name, so that the function is reported on the line that names it.
+  write_line_directive(node.name());
+  add_line(std::string(node.name().data) + "(" + params + ")");
+  add_line("{");
+  indent();
+
+  for (const auto& inner : node.body()) {
+    inner->accept(*this);
+  }
+
+  dedent();
+  add_line("}");
+}
+
+void
+CXXCodeWriter::visit(const ReturnNode& node)
+{
+  write_line_directive(node.value());
+  begin_line();
+  write("return ");
+  node.value().accept(*this);
+  write(";");
+  newline();
+}
+
+void
+CXXCodeWriter::visit(const ImportNode&)
+{
+  // The declarations of the imported module are copied into the tree, and are generated where they were copied to.
+}
+
+auto
+CXXCodeWriter::decl_type(const DeclNode& node) const -> std::string
+{
+  const auto& table = annotations();
+
+  if (const auto it = table.decl_node.find(&node); (it != table.decl_node.end()) && it->second.type) {
+    if (const auto* name = cxx_type_name(it->second.type->id())) {
+      return name;
+    }
+  }
+
+  if (node.has_type()) {
+    return cxx_type_name(node.get_type());
+  }
+
+  // Values that the annotator could not type, such as calls, are left to the C++ compiler.
+  return "auto";
+}
+
+auto
+CXXCodeWriter::global_type(const DeclNode& node) const -> std::string
+{
+  auto type = decl_type(node);
+
+  // A deduced type needs an initializer, which a global that is assigned later does not have.
+  if (type == "auto") {
+    type.clear();
+  }
+
+  return type;
+}
+
+auto
+CXXCodeWriter::is_constant(const DeclNode& node) -> bool
+{
+  if (!node.is_immutable() || !node.has_value()) {
+    return false;
+  }
+
+  if (const auto it = constants_.find(&node); it != constants_.end()) {
+    return it->second;
+  }
+
+  // Declarations can't refer to themselves, so this can't recurse into the same declaration.
+  const auto constant = is_constant(node.get_value());
+
+  constants_.emplace(&node, constant);
+
+  return constant;
+}
+
+auto
+CXXCodeWriter::is_constant(const Expr& expr) -> bool
+{
+  class Checker final : public ExprVisitor
+  {
+    CXXCodeWriter* writer_;
+
+  public:
+    bool constant{ true };
+
+    explicit Checker(CXXCodeWriter* writer)
+      : writer_(writer)
+    {
+    }
+
+    void visit(const IntLiteralExpr&) override {}
+
+    void visit(const FloatLiteralExpr&) override {}
+
+    void visit(const StringLiteralExpr&) override {}
+
+    // Arithmetic that overflows is an error in a C++ constant expression, while in nabla integers wrap around and
+    // floats become infinite. The C++ compiler still folds arithmetic on constants, it just isn't constexpr.
+
+    void visit(const AddExpr&) override { constant = false; }
+
+    void visit(const MulExpr&) override { constant = false; }
+
+    void visit(const VarExpr& expr) override
+    {
+      const auto& table = writer_->annotations();
+      const auto it = table.var_expr.find(&expr);
+      if ((it == table.var_expr.end()) || !it->second.decl || !writer_->is_constant(*it->second.decl)) {
+        constant = false;
+      }
+    }
+
+    void visit(const CallExpr&) override { constant = false; }
+  };
+
+  Checker checker(this);
+
+  expr.accept(checker);
+
+  return checker.constant;
 }
 
 void
 CXXCodeWriter::visit(const DeclNode& node)
 {
-  if (node.is_immutable()) {
+  write_line_directive(node.get_name());
+  begin_line();
+
+  if (assign_declarations() && node.has_value()) {
+    write(node.get_name().data);
+    write(" = ");
+    node.get_value().accept(*this);
+    write(";");
+    newline();
+    return;
+  }
+
+  if (is_constant(node)) {
+    write("constexpr ");
+  } else if (node.is_immutable()) {
     write("const ");
   }
 
-  // TODO : type
-  write("int ");
+  write(decl_type(node));
+
+  write(" ");
 
   write(node.get_name().data);
 
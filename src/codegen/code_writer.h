@@ -2,7 +2,12 @@
 
 #include "../annotations.h"
 #include "../syntax_tree.h"
+#include "chunked_buffer.h"
+#include "fused_products.h"
+#include "options.h"
 
+#include <map>
+#include <memory>
 #include <string>
 #include <string_view>
 
@@ -16,33 +21,95 @@ class CodeWriter
 {
   size_t indent_{ 0 };
 
-  std::string source_;
+  ChunkedBuffer buffer_;
 
   const AnnotationTable* annotations_{ nullptr };
 
+  Options options_;
+
+  bool assign_declarations_{ false };
+
+  const FusedProducts* fused_products_{ nullptr };
+
 public:
-  CodeWriter(const AnnotationTable* annotations)
+  CodeWriter(const AnnotationTable* annotations, const Options& options)
     : annotations_(annotations)
+    , options_(options)
   {
   }
 
   virtual ~CodeWriter() = default;
 
+  /// @brief Writes whatever has to precede the code generated for the nodes of a syntax tree.
+  virtual void write_prologue() {}
+
+  /// @brief Whether a declaration is a compile-time constant, which can be placed outside of the function that the
+  ///        statements of a unit are run in.
+  [[nodiscard]] virtual auto is_constant(const DeclNode&) -> bool { return false; }
+
+  /// @brief Gets the type that a declaration has as a global variable, or an empty string if it can't be one.
+  [[nodiscard]] virtual auto global_type(const DeclNode&) const -> std::string { return {}; }
+
+  /// @brief Creates an empty writer of the same kind, with the same annotations, options and indentation. Code can be
+  ///        generated into it on another thread, and then appended to this writer.
+  [[nodiscard]] auto create_shard() const -> std::unique_ptr<CodeWriter>;
+
+  /// @brief Makes declarations be written as assignments to global variables, which are defined separately.
+  void set_assign_declarations(const bool enabled) { assign_declarations_ = enabled; }
+
+  /// @brief Sets the additions that are written as fused multiply-adds, which must outlive the writer and its shards.
+  void set_fused_products(const FusedProducts* products) { fused_products_ = products; }
+
+  /// @brief Appends code that was generated by another writer.
+  void append(ChunkedBuffer&& code);
+
+  /// @brief Takes the generated code, leaving the writer empty.
+  [[nodiscard]] auto take_buffer() -> ChunkedBuffer;
+
   [[nodiscard]] auto source() const -> std::string;
 
+  /// @brief Gets the generated code without copying it.
+  [[nodiscard]] auto buffer() const -> const ChunkedBuffer& { return buffer_; }
+
   void indent();
 
   void dedent();
 
   void add_line(const std::string_view& line);
 
+  /// @brief Writes the indentation for a line that is then written piece by piece.
+  void begin_line();
+
   void write(const std::string_view& str);
 
   void newline();
 
+  /// @brief If line directives are enabled, writes one that maps the next line to the line of the given token.
+  void write_line_directive(const Token& token);
+
+  /// @brief Writes a line directive for the first token of an expression.
+  void write_line_directive(const Expr& expr);
+
+  /// @brief If line directives are enabled, writes one that maps the next line back to the file that the code is
+  ///        written to, so that the code that follows is not taken for the last line of the nabla source.
+  ///
+  /// @param name The name of the generated file, within @ref Options::output_dir.
+  void write_output_line_directive(const std::string& name);
+
 protected:
+  [[nodiscard]] virtual auto create_empty() const -> std::unique_ptr<CodeWriter> = 0;
+
+  void write_line_directive(size_t line, const std::string& filename);
+
+  [[nodiscard]] auto assign_declarations() const -> bool { return assign_declarations_; }
+
   [[nodiscard]] auto annotations() const -> const AnnotationTable& { return *annotations_; }
 
+  [[nodiscard]] auto options() const -> const Options& { return options_; }
+
+  /// @brief If an addition is written as a fused multiply-add, gets the product that is fused into it.
+  [[nodiscard]] auto fused_product(const AddExpr& expr) const -> const FusedProduct*;
+
   void visit(const IntLiteralExpr& expr) override;
 
   void visit(const FloatLiteralExpr& expr) override;
@@ -60,22 +127,48 @@ protected:
 
 class CXXCodeWriter final : public CodeWriter
 {
+  /// @brief Whether each immutable declaration that has been looked at is a compile-time constant.
+  std::map<const DeclNode*, bool> constants_;
+
 public:
-  CXXCodeWriter(const AnnotationTable* annotations)
-    : CodeWriter(annotations)
+  CXXCodeWriter(const AnnotationTable* annotations, const Options& options)
+    : CodeWriter(annotations, options)
   {
   }
 
+  void write_prologue() override;
+
+  /// @note Constants are declared as constexpr.
+  [[nodiscard]] auto is_constant(const DeclNode& node) -> bool override;
+
+  [[nodiscard]] auto global_type(const DeclNode& node) const -> std::string override;
+
 protected:
+  [[nodiscard]] auto create_empty() const -> std::unique_ptr<CodeWriter> override;
+
+  void visit(const FloatLiteralExpr& expr) override;
+
+  void visit(const AddExpr& expr) override;
+
   void visit(const FuncNode& node) override;
 
   void visit(const DeclNode& node) override;
 
   void visit(const StructNode& node) override;
 
-  void visit(const PrintNode&) override {}
+  void visit(const PrintNode& node) override;
+
+  void visit(const ReturnNode& node) override;
+
+  void visit(const ImportNode& node) override;
+
+  void visit(const StringLiteralExpr& expr) override;
+
+  /// @brief Gets the C++ type of a declaration, or "auto" if its type is not known.
+  [[nodiscard]] auto decl_type(const DeclNode& node) const -> std::string;
 
-  void visit(const ReturnNode&) override {}
+  /// @brief Whether an expression only refers to literals and constant declarations.
+  [[nodiscard]] auto is_constant(const Expr& expr) -> bool;
 };
 
 } // namespace nabla::codegen
@@ -0,0 +1,252 @@
+#include "fused_products.h"
+
+#include "../ast_builder.h"
+#include "../lexer.h"
+#include "../passes/dead_code.h"
+#include "../passes/mul_add_fusion.h"
+#include "../passes/value_numbering.h"
+
+#include <set>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace nabla::codegen {
+
+namespace {
+
+/// @brief Finds the multiplication that an expression evaluates to, looking through the declarations that it refers to.
+class ProductFinder final : public ExprVisitor
+{
+  const AnnotationTable* annotations_;
+
+public:
+  const MulExpr* product{ nullptr };
+
+  explicit ProductFinder(const AnnotationTable* annotations)
+    : annotations_(annotations)
+  {
+  }
+
+  void visit(const IntLiteralExpr&) override {}
+
+  void visit(const FloatLiteralExpr&) override {}
+
+  void visit(const StringLiteralExpr&) override {}
+
+  void visit(const VarExpr& expr) override
+  {
+    const auto it = annotations_->var_expr.find(&expr);
+    if ((it != annotations_->var_expr.end()) && it->second.decl && it->second.decl->has_value()) {
+      it->second.decl->get_value().accept(*this);
+    }
+  }
+
+  void visit(const CallExpr&) override {}
+
+  void visit(const AddExpr&) override {}
+
+  void visit(const MulExpr& expr) override { product = &expr; }
+};
+
+/// @brief The top-level declarations seen so far, by name.
+using DeclsByName = std::map<std::string_view, const DeclNode*>;
+
+/// @brief Finds out whether a top-level statement calls a function, which the AST builder does not build, either itself
+///        or through a declaration that was left out for calling one.
+class CallFinder final
+  : public NodeVisitor
+  , public ExprVisitor
+{
+  const AnnotationTable* annotations_;
+
+  const DeclsByName* decls_;
+
+  const std::set<const DeclNode*>* skipped_;
+
+public:
+  bool calls{ false };
+
+  /// @brief The statement, if it is a declaration.
+  const DeclNode* decl{ nullptr };
+
+  /// @brief The declarations that the statement refers to.
+  std::vector<const DeclNode*> refs;
+
+  CallFinder(const AnnotationTable* annotations, const DeclsByName* decls, const std::set<const DeclNode*>* skipped)
+    : annotations_(annotations)
+    , decls_(decls)
+    , skipped_(skipped)
+  {
+  }
+
+  void visit(const PrintNode& node) override
+  {
+    for (const auto& arg : node.args()) {
+      arg->accept(*this);
+    }
+  }
+
+  void visit(const DeclNode& node) override
+  {
+    decl = &node;
+    if (node.has_value()) {
+      node.get_value().accept(*this);
+    }
+  }
+
+  void visit(const FuncNode&) override {}
+
+  void visit(const StructNode&) override {}
+
+  void visit(const ReturnNode&) override {}
+
+  void visit(const ImportNode&) override {}
+
+  void visit(const IntLiteralExpr&) override {}
+
+  void visit(const FloatLiteralExpr&) override {}
+
+  void visit(const StringLiteralExpr&) override {}
+
+  void visit(const VarExpr& expr) override
+  {
+    // The arguments of calls are not annotated, so variables are looked up by name if need be.
+    const DeclNode* ref{ nullptr };
+    if (const auto it = annotations_->var_expr.find(&expr); it != annotations_->var_expr.end()) {
+      ref = it->second.decl;
+    } else if (const auto found = decls_->find(expr.get_name().data); found != decls_->end()) {
+      ref = found->second;
+    }
+    if (ref) {
+      calls |= skipped_->count(ref) != 0;
+      refs.emplace_back(ref);
+    }
+  }
+
+  void visit(const CallExpr& expr) override
+  {
+    calls = true;
+    for (const auto& arg : expr.args()) {
+      arg.second->accept(*this);
+    }
+  }
+
+  void visit(const AddExpr& expr) override
+  {
+    expr.left().accept(*this);
+    expr.right().accept(*this);
+  }
+
+  void visit(const MulExpr& expr) override
+  {
+    expr.left().accept(*this);
+    expr.right().accept(*this);
+  }
+};
+
+} // namespace
+
+auto
+find_fused_products(const SyntaxTree& tree, const AnnotationTable& annotations) -> FusedProducts
+{
+  ast::Module m;
+
+  std::map<const Expr*, size_t> expr_values;
+
+  auto builder = ASTBuilder::create(&m, &annotations);
+
+  builder->set_expr_values(&expr_values);
+
+  // Statements that call functions are left out, along with those that refer to them, so that the rest is still fused.
+  std::set<const DeclNode*> skipped;
+
+  DeclsByName decls;
+
+  for (const auto& node : tree.nodes) {
+    CallFinder call_finder(&annotations, &decls, &skipped);
+    node->accept(call_finder);
+    if (call_finder.decl) {
+      decls[call_finder.decl->get_name().data] = call_finder.decl;
+    }
+    if (!call_finder.calls) {
+      if (!builder->build(*node)) {
+        return {};
+      }
+      continue;
+    }
+    if (call_finder.decl) {
+      skipped.emplace(call_finder.decl);
+    }
+    // A product that such a statement refers to is used there too, so it must not be fused into another addition.
+    for (const auto* ref : call_finder.refs) {
+      if (!ref->has_value()) {
+        continue;
+      }
+      ProductFinder product_finder(&annotations);
+      ref->get_value().accept(product_finder);
+      const auto it = product_finder.product ? expr_values.find(product_finder.product) : expr_values.end();
+      if (it != expr_values.end()) {
+        m.stmts.emplace_back(std::make_unique<ast::PrintStmt>(it->second));
+      }
+    }
+  }
+
+  // The same passes as the engine runs before fusing, since they decide how often each product is used.
+  ValueMap gvn_values;
+  ValueNumberingPass gvn;
+  gvn.set_value_map(&gvn_values);
+
+  ValueMap dce_values;
+  DeadCodePass dce;
+  dce.set_value_map(&dce_values);
+
+  PassStatistics stats;
+
+  gvn.run(m, stats);
+
+  dce.run(m, stats);
+
+  const auto fusions = plan_mul_add_fusion(m);
+
+  const auto value_of = [&](const Expr& expr) -> size_t {
+    const auto it = expr_values.find(&expr);
+    if (it == expr_values.end()) {
+      return removed_value;
+    }
+    // Value numbering only merges values, so every value has a number that dead code elimination knows of.
+    return dce_values.at(gvn_values.at(it->second));
+  };
+
+  FusedProducts products;
+
+  for (const auto& [add, annotation] : annotations.add_expr) {
+    if (annotation.op != Annotation<AddExpr>::Op::add_float) {
+      continue;
+    }
+
+    const auto id = value_of(*add);
+    if ((id >= fusions.size()) || !fusions[id].fused) {
+      continue;
+    }
+
+    // The plan names the product by value, which tells the operands apart even if both of them are products.
+    const std::pair<const Expr*, const Expr*> sides[]{
+      { &add->left(), &add->right() },
+      { &add->right(), &add->left() },
+    };
+
+    for (const auto& [operand, addend] : sides) {
+      ProductFinder finder(&annotations);
+      operand->accept(finder);
+      if (finder.product && (value_of(*finder.product) == fusions[id].mul)) {
+        products.emplace(add, FusedProduct{ finder.product, addend });
+        break;
+      }
+    }
+  }
+
+  return products;
+}
+
+} // namespace nabla::codegen
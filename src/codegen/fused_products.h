@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../annotations.h"
+#include "../syntax_tree.h"
+
+#include <map>
+
+namespace nabla::codegen {
+
+/// @brief How an addition is written as a fused multiply-add.
+struct FusedProduct final
+{
+  const MulExpr* product{ nullptr };
+
+  /// @brief The operand of the addition that is not the product.
+  const Expr* addend{ nullptr };
+};
+
+/// @brief The product that is fused into each addition that is written as a fused multiply-add.
+using FusedProducts = std::map<const AddExpr*, FusedProduct>;
+
+/// @brief Finds the float additions that the mul-add fusion pass fuses a product into, so that generated code rounds
+///        the same way as a module that is run with FMA contraction enabled.
+///
+/// @details The top-level statements are built into a module and optimized the way the engine does it before fusing,
+///          and @ref plan_mul_add_fusion decides what is fused. The product may be the operand of the addition, or the
+///          value of a declaration that the operand refers to, as in `let p = a * b; print(p + c);`.
+///
+/// @note Statements that call functions can't be built into a module, so they are left out, along with those that
+///       refer to declarations that were left out. Products that they refer to count as used by them. Nothing is fused
+///       if the rest of the tree can't be built into a module either.
+[[nodiscard]] auto
+find_fused_products(const SyntaxTree& tree, const AnnotationTable& annotations) -> FusedProducts;
+
+} // namespace nabla::codegen
@@ -1,6 +1,13 @@
 #include "generator.h"
 
+#include "../lexer.h"
+#include "../thread_pool.h"
+#include "../time_trace.h"
 #include "code_writer.h"
+#include "fused_products.h"
+
+#include <algorithm>
+#include <utility>
 
 #include <string.h>
 
@@ -8,38 +15,311 @@ namespace nabla::codegen {
 
 namespace {
 
+/// @brief Tells the nodes that define something apart from the statements that are executed.
+class DefinitionFinder final : public NodeVisitor
+{
+  CodeWriter* writer_;
+
+public:
+  bool is_definition{ false };
+
+  explicit DefinitionFinder(CodeWriter* writer)
+    : writer_(writer)
+  {
+  }
+
+  void visit(const PrintNode&) override { is_definition = false; }
+
+  // Constants are defined along with functions, so that functions can refer to them.
+  void visit(const DeclNode& node) override { is_definition = writer_->is_constant(node); }
+
+  void visit(const FuncNode&) override { is_definition = true; }
+
+  void visit(const StructNode&) override { is_definition = true; }
+
+  void visit(const ReturnNode&) override { is_definition = false; }
+
+  void visit(const ImportNode&) override { is_definition = false; }
+};
+
+/// @brief Finds the declaration of a top-level statement, if it is one.
+class GlobalFinder final : public NodeVisitor
+{
+public:
+  const DeclNode* decl{ nullptr };
+
+  void visit(const PrintNode&) override { decl = nullptr; }
+
+  void visit(const DeclNode& node) override { decl = &node; }
+
+  void visit(const FuncNode&) override { decl = nullptr; }
+
+  void visit(const StructNode&) override { decl = nullptr; }
+
+  void visit(const ReturnNode&) override { decl = nullptr; }
+
+  void visit(const ImportNode&) override { decl = nullptr; }
+};
+
+/// @brief The fewest top-level nodes that are worth generating as a separate task.
+constexpr size_t min_shard_nodes = 256;
+
 class GeneratorImpl final : public Generator
 {
   std::unique_ptr<CodeWriter> writer_;
 
+  const AnnotationTable* annotations_{ nullptr };
+
+  Options options_;
+
+  FusedProducts fused_products_;
+
+  std::vector<ChunkedBuffer> units_;
+
+  ChunkedBuffer header_;
+
 public:
-  GeneratorImpl(std::unique_ptr<CodeWriter> writer)
+  GeneratorImpl(std::unique_ptr<CodeWriter> writer, const AnnotationTable* annotations, const Options& options)
     : writer_(std::move(writer))
+    , annotations_(annotations)
+    , options_(options)
   {
   }
 
   void generate(const SyntaxTree& tree) override
   {
+    units_.clear();
+
+    // Products are fused where running the unit would fuse them, so that both round the same way.
+    if (options_.fma) {
+      fused_products_ = find_fused_products(tree, *annotations_);
+      writer_->set_fused_products(&fused_products_);
+    }
+
+    header_ = ChunkedBuffer{};
+
+    std::vector<const Node*> definitions;
+
+    std::vector<const Node*> statements;
+
+    DefinitionFinder finder(writer_.get());
+
     for (const auto& node : tree.nodes) {
-      node->accept(*writer_);
+      node->accept(finder);
+      (finder.is_definition ? definitions : statements).emplace_back(node.get());
+    }
+
+    const auto& ns = options_.unit_namespace;
+
+    // Code without a namespace is not part of a native program, so it is not split into units.
+    if (!ns.empty() && (options_.max_units > 1) && (statements.size() > 1) &&
+        generate_split(definitions, statements)) {
+      return;
+    }
+
+    // Code without a namespace is not written to a file, which line directives could map back to.
+    const auto filename = ns.empty() ? std::string() : (unit_name(ns, 0, 1) + ".cpp");
+
+    const auto write_output_line_directive = [this, &filename]() {
+      if (!filename.empty()) {
+        writer_->write_output_line_directive(filename);
+      }
+    };
+
+    writer_->write_prologue();
+
+    if (!ns.empty()) {
+      writer_->add_line("namespace " + ns + " {");
+    }
+
+    write_nodes(*writer_, definitions);
+    write_output_line_directive();
+    writer_->add_line("void");
+    writer_->add_line("entry()");
+    writer_->add_line("{");
+    writer_->indent();
+    write_nodes(*writer_, statements);
+    write_output_line_directive();
+    writer_->dedent();
+    writer_->add_line("}");
+
+    if (!ns.empty()) {
+      writer_->add_line("} // namespace " + ns);
+    }
+
+    units_.emplace_back(writer_->take_buffer());
+  }
+
+  auto source() const -> std::string override { return output().str(); }
+
+  auto output() const -> const ChunkedBuffer& override { return units_.at(0); }
+
+  auto units() const -> const std::vector<ChunkedBuffer>& override { return units_; }
+
+  auto header() const -> const ChunkedBuffer& override { return header_; }
+
+  auto take_units() -> std::vector<ChunkedBuffer> override { return std::exchange(units_, {}); }
+
+  auto take_header() -> ChunkedBuffer override { return std::exchange(header_, {}); }
+
+protected:
+  /// @brief Writes a list of nodes, in parallel if there is a thread pool and enough nodes to be worth it.
+  void write_nodes(CodeWriter& writer, const std::vector<const Node*>& nodes)
+  {
+    auto* pool = options_.thread_pool;
+
+    const auto num_shards = pool ? std::min(nodes.size() / min_shard_nodes, (pool->num_threads() + 1) * 4) : 0;
+
+    if (num_shards < 2) {
+      for (const auto* node : nodes) {
+        node->accept(writer);
+      }
+      return;
+    }
+
+    // Each shard is a contiguous run of nodes, and the shards are appended in order, so the output is the same as when
+    // writing the nodes one after another.
+    std::vector<ChunkedBuffer> shards(num_shards);
+
+    TaskGroup group;
+
+    for (size_t i = 0; i < num_shards; i++) {
+      const auto first = (nodes.size() * i) / num_shards;
+      const auto last = (nodes.size() * (i + 1)) / num_shards;
+      pool->submit(group, [this, &writer, &nodes, &shards, i, first, last]() {
+        TimeTrace::Scope scope(options_.trace, TimeTrace::Phase::codegen_shard, options_.filename);
+        auto shard = writer.create_shard();
+        for (auto j = first; j < last; j++) {
+          nodes[j]->accept(*shard);
+        }
+        shards[i] = shard->take_buffer();
+      });
+    }
+
+    pool->wait(group);
+
+    for (auto& shard : shards) {
+      writer.append(std::move(shard));
     }
   }
 
-  auto source() const -> std::string override { return writer_->source(); }
+  /// @brief Splits the statements into several translation units. Top-level values become global variables, which are
+  ///        declared in a header along with the definitions, and are assigned by the unit that computes them.
+  ///
+  /// @return False if the code can't be split, in which case nothing is generated.
+  [[nodiscard]] auto generate_split(const std::vector<const Node*>& definitions,
+                                    const std::vector<const Node*>& statements) -> bool
+  {
+    GlobalFinder global_finder;
+
+    std::vector<std::string> global_types(statements.size());
+
+    for (size_t i = 0; i < statements.size(); i++) {
+      statements[i]->accept(global_finder);
+      if (!global_finder.decl) {
+        continue;
+      }
+      global_types[i] = writer_->global_type(*global_finder.decl);
+      if (global_types[i].empty()) {
+        return false;
+      }
+    }
+
+    const auto& ns = options_.unit_namespace;
+
+    const auto num_units = std::min(options_.max_units, statements.size());
+
+    auto segment_name = [](const size_t i) { return "segment_" + std::to_string(i); };
+
+    writer_->add_line("#pragma once");
+    writer_->write_prologue();
+    writer_->add_line("namespace " + ns + " {");
+    write_nodes(*writer_, definitions);
+    writer_->write_output_line_directive(ns + ".h");
+
+    for (size_t i = 0; i < statements.size(); i++) {
+      statements[i]->accept(global_finder);
+      if (global_finder.decl) {
+        writer_->add_line("extern " + global_types[i] + " " + std::string(global_finder.decl->get_name().data) + ";");
+      }
+    }
+
+    for (size_t i = 0; i < num_units; i++) {
+      writer_->add_line("void");
+      writer_->add_line(segment_name(i) + "();");
+    }
+
+    writer_->add_line("} // namespace " + ns);
+
+    header_ = writer_->take_buffer();
+
+    for (size_t i = 0; i < num_units; i++) {
+      const auto first = (statements.size() * i) / num_units;
+      const auto last = (statements.size() * (i + 1)) / num_units;
+
+      auto unit = writer_->create_shard();
+      unit->add_line("#include \"" + ns + ".h\"");
+      unit->add_line("");
+      unit->add_line("namespace " + ns + " {");
+
+      for (auto j = first; j < last; j++) {
+        statements[j]->accept(global_finder);
+        if (global_finder.decl) {
+          unit->add_line(global_types[j] + " " + std::string(global_finder.decl->get_name().data) + ";");
+        }
+      }
+
+      unit->add_line("void");
+      unit->add_line(segment_name(i) + "()");
+      unit->add_line("{");
+      unit->indent();
+      unit->set_assign_declarations(true);
+      write_nodes(*unit, std::vector<const Node*>(statements.begin() + first, statements.begin() + last));
+      unit->write_output_line_directive(unit_name(ns, i, num_units) + ".cpp");
+      unit->set_assign_declarations(false);
+      unit->dedent();
+      unit->add_line("}");
+
+      if (i == 0) {
+        unit->add_line("void");
+        unit->add_line("entry()");
+        unit->add_line("{");
+        unit->indent();
+        for (size_t j = 0; j < num_units; j++) {
+          unit->add_line(segment_name(j) + "();");
+        }
+        unit->dedent();
+        unit->add_line("}");
+      }
+
+      unit->add_line("} // namespace " + ns);
+
+      units_.emplace_back(unit->take_buffer());
+    }
+
+    return true;
+  }
 };
 
 } // namespace
 
 auto
-Generator::create(const char* lang, const AnnotationTable* annotations) -> std::unique_ptr<Generator>
+unit_name(const std::string& unit_namespace, const size_t index, const size_t num_units) -> std::string
+{
+  return (num_units == 1) ? unit_namespace : (unit_namespace + "_" + std::to_string(index));
+}
+
+auto
+Generator::create(const char* lang, const AnnotationTable* annotations, const Options& options)
+  -> std::unique_ptr<Generator>
 {
   std::unique_ptr<CodeWriter> writer;
 
   if ((strcmp(lang, "cxx") == 0) || (strcmp(lang, "c++") == 0) || (strcmp(lang, "cpp") == 0)) {
-    writer = std::make_unique<CXXCodeWriter>(annotations);
+    writer = std::make_unique<CXXCodeWriter>(annotations, options);
   }
 
-  return std::make_unique<GeneratorImpl>(std::move(writer));
+  return std::make_unique<GeneratorImpl>(std::move(writer), annotations, options);
 }
 
 } // namespace nabla::codegen
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "chunked_buffer.h"
+#include "options.h"
+
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace nabla {
 
@@ -12,16 +16,41 @@ struct AnnotationTable;
 
 namespace nabla::codegen {
 
+/// @brief Gets the name, without an extension, of the file that a translation unit of the given namespace is written
+///        to. The header that the units include is named after the namespace.
+[[nodiscard]] auto
+unit_name(const std::string& unit_namespace, size_t index, size_t num_units) -> std::string;
+
 class Generator
 {
 public:
-  static auto create(const char* lang, const AnnotationTable* annotations) -> std::unique_ptr<Generator>;
+  static auto create(const char* lang, const AnnotationTable* annotations, const Options& options = Options{})
+    -> std::unique_ptr<Generator>;
 
   virtual ~Generator() = default;
 
   virtual void generate(const SyntaxTree& m) = 0;
 
   virtual auto source() const -> std::string = 0;
+
+  /// @brief Gets the generated code without joining it into one string. It can be read in place, or written to a file
+  ///        descriptor or a sink.
+  ///
+  /// @note If the code was split into several translation units, this is the first of them.
+  virtual auto output() const -> const ChunkedBuffer& = 0;
+
+  /// @brief Gets the translation units that the code was split into. There is only one, unless it is split as
+  ///        described by @ref Options::max_units.
+  virtual auto units() const -> const std::vector<ChunkedBuffer>& = 0;
+
+  /// @brief Gets the header that the translation units include. This is empty if the code was not split.
+  virtual auto header() const -> const ChunkedBuffer& = 0;
+
+  /// @brief Moves the translation units out of the generator, leaving none.
+  virtual auto take_units() -> std::vector<ChunkedBuffer> = 0;
+
+  /// @brief Moves the header out of the generator, leaving it empty.
+  virtual auto take_header() -> ChunkedBuffer = 0;
 };
 
 } // namespace nabla::codegen
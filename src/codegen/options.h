@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class ThreadPool;
+class TimeTrace;
+
+} // namespace nabla
+
+namespace nabla::codegen {
+
+/// @brief Options that control the code generated for a syntax tree.
+struct Options final
+{
+  /// @brief Whether floating point expressions of the form "a * b + c" are contracted into a fused multiply-add. The
+  ///        same ones are contracted as when the unit is run, see @ref find_fused_products.
+  ///
+  /// @note This is opt-in, since skipping the rounding of the product changes the result.
+  bool fma{ false };
+
+  /// @brief If not empty, the code is generated as one unit of a native program, and is placed in a namespace of this
+  ///        name, whose `entry()` the program calls on startup.
+  ///
+  /// @note Either way, top-level statements go into a function `void entry()`, and printing is done through the nabla
+  ///       runtime library.
+  std::string unit_namespace;
+
+  /// @brief Whether a `#line` directive is written before the code of each node, so that debuggers and profilers of the
+  ///        generated code report locations in the nabla source instead.
+  bool line_directives{ false };
+
+  /// @brief The path of the nabla source, which line directives refer to.
+  std::string filename;
+
+  /// @brief The directory that the generated files are written to. After the code of the nodes, a line directive maps
+  ///        the code that the generator wraps them in back to the generated file, which is named by @ref unit_name.
+  std::string output_dir;
+
+  /// @brief The text that the tokens of each imported module point into (its interface), along with its path, so that
+  ///        line directives for the declarations copied from it refer to the file that they came from.
+  std::vector<std::pair<std::string_view, std::string>> imported_sources;
+
+  /// @brief If not null, runs of top-level nodes are generated in parallel on this pool. The output is the same as
+  ///        when generating on one thread.
+  ThreadPool* thread_pool{ nullptr };
+
+  /// @brief If not null, the runs of nodes that are generated in parallel are timed in this.
+  TimeTrace* trace{ nullptr };
+
+  /// @brief The most translation units that a unit of a native program is split into, so that they can be compiled in
+  ///        parallel. The units include a shared header, named after the unit namespace, with the definitions of the
+  ///        program.
+  ///
+  /// @note The code is not split if a top-level value has a type that can't be spelled out, such as the result of a
+  ///       call, since those can't be declared in the header.
+  size_t max_units{ 1 };
+};
+
+} // namespace nabla::codegen
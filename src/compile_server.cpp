@@ -0,0 +1,535 @@
+#include "compile_server.h"
+
+#include "console.h"
+
+#include <cstdio>
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace nabla {
+
+namespace {
+
+/// @brief Requests larger than this are rejected, since no command line comes close to it.
+constexpr uint64_t max_request_size = 16 * 1024 * 1024;
+
+/// @brief The number of descriptors that a client sends: its standard output and its standard error.
+constexpr int num_request_fds = 2;
+
+[[nodiscard]] auto
+to_ns(const struct timespec& time) -> uint64_t
+{
+  return (static_cast<uint64_t>(time.tv_sec) * 1000000000ULL) + static_cast<uint64_t>(time.tv_nsec);
+}
+
+[[nodiscard]] auto
+write_all(const int fd, const void* data, size_t size) -> bool
+{
+  const auto* bytes = static_cast<const char*>(data);
+
+  while (size > 0) {
+    const auto n = ::send(fd, bytes, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+  }
+
+  return true;
+}
+
+[[nodiscard]] auto
+read_all(const int fd, void* data, size_t size) -> bool
+{
+  auto* bytes = static_cast<char*>(data);
+
+  while (size > 0) {
+    const auto n = ::read(fd, bytes, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    bytes += n;
+    size -= static_cast<size_t>(n);
+  }
+
+  return true;
+}
+
+void
+put_string(std::string& out, const std::string_view& value)
+{
+  const auto size = static_cast<uint32_t>(value.size());
+  out.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.append(value);
+}
+
+[[nodiscard]] auto
+get_string(const std::string& in, size_t& offset, std::string& value) -> bool
+{
+  uint32_t size{ 0 };
+  if ((in.size() - offset) < sizeof(size)) {
+    return false;
+  }
+  memcpy(&size, in.data() + offset, sizeof(size));
+  offset += sizeof(size);
+  if ((in.size() - offset) < size) {
+    return false;
+  }
+  value.assign(in, offset, size);
+  offset += size;
+  return true;
+}
+
+[[nodiscard]] auto
+make_address(const std::string& socket_path, sockaddr_un& address) -> bool
+{
+  address = sockaddr_un{};
+  address.sun_family = AF_UNIX;
+
+  // The path has to fit along with its terminator.
+  if (socket_path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+  return true;
+}
+
+/// @brief Connects to the socket of a server.
+///
+/// @return The socket, or -1 if no server is listening on the path.
+[[nodiscard]] auto
+connect_to(const std::string& socket_path) -> int
+{
+  sockaddr_un address;
+  if (!make_address(socket_path, address)) {
+    return -1;
+  }
+
+  const auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+    ::close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+/// @brief Receives the header of a request, which is the size of the rest of it, along with the descriptors of the
+///        client.
+[[nodiscard]] auto
+receive_header(const int fd, uint64_t& size, int (&fds)[num_request_fds]) -> bool
+{
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * num_request_fds)]{};
+
+  iovec data{ &size, sizeof(size) };
+
+  msghdr message{};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  ssize_t n{ -1 };
+
+  do {
+    n = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+  } while ((n < 0) && (errno == EINTR));
+
+  if (n <= 0) {
+    return false;
+  }
+
+  auto received{ false };
+
+  for (auto* header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+    if ((header->cmsg_level != SOL_SOCKET) || (header->cmsg_type != SCM_RIGHTS)) {
+      continue;
+    }
+    const auto count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (count == num_request_fds) {
+      memcpy(fds, CMSG_DATA(header), sizeof(fds));
+      received = true;
+    } else {
+      // Descriptors that aren't used still have to be closed.
+      for (size_t i = 0; i < count; i++) {
+        int unused{ -1 };
+        memcpy(&unused, CMSG_DATA(header) + (i * sizeof(int)), sizeof(int));
+        ::close(unused);
+      }
+    }
+  }
+
+  // The descriptors come with the first byte, but the rest of the header may come separately.
+  if (!read_all(fd, reinterpret_cast<char*>(&size) + n, sizeof(size) - static_cast<size_t>(n)) || !received) {
+    if (received) {
+      ::close(fds[0]);
+      ::close(fds[1]);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Runs the handler with the working directory and descriptors of a client, and puts back those of the server
+///        afterwards.
+[[nodiscard]] auto
+run_handler(const RequestHandler& handler,
+            const std::string& cwd,
+            const std::vector<std::string>& args,
+            const int (&fds)[num_request_fds]) -> int
+{
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(nullptr);
+
+  const auto saved_cwd = ::open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  const auto saved_out = ::fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+  const auto saved_err = ::fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+
+  ::dup2(fds[0], STDOUT_FILENO);
+  ::dup2(fds[1], STDERR_FILENO);
+
+  auto status{ EXIT_FAILURE };
+
+  if (::chdir(cwd.c_str()) != 0) {
+    std::cerr << args.at(0) << ": failed to enter directory '" << cwd << "': " << strerror(errno) << std::endl;
+  } else {
+    try {
+      status = handler(args);
+    } catch (const std::exception& e) {
+      std::cerr << args.at(0) << ": " << e.what() << std::endl;
+    }
+  }
+
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(nullptr);
+
+  // A client that went away leaves the streams in a failed state, which must not carry over to the next one.
+  std::cout.clear();
+  std::cerr.clear();
+
+  if (saved_cwd >= 0) {
+    (void)::fchdir(saved_cwd);
+    ::close(saved_cwd);
+  }
+
+  if (saved_out >= 0) {
+    ::dup2(saved_out, STDOUT_FILENO);
+    ::close(saved_out);
+  }
+
+  if (saved_err >= 0) {
+    ::dup2(saved_err, STDERR_FILENO);
+    ::close(saved_err);
+  }
+
+  return status;
+}
+
+void
+handle_request(const int client, const RequestHandler& handler)
+{
+  uint64_t size{ 0 };
+
+  int fds[num_request_fds]{ -1, -1 };
+
+  if (!receive_header(client, size, fds)) {
+    return;
+  }
+
+  std::string payload;
+
+  std::string cwd;
+
+  std::vector<std::string> args;
+
+  auto valid = (size <= max_request_size);
+
+  if (valid) {
+    payload.resize(size);
+    valid = read_all(client, payload.data(), payload.size());
+  }
+
+  size_t offset{ 0 };
+
+  valid = valid && get_string(payload, offset, cwd);
+
+  while (valid && (offset < payload.size())) {
+    valid = get_string(payload, offset, args.emplace_back());
+  }
+
+  valid = valid && !args.empty();
+
+  int32_t status{ EXIT_FAILURE };
+
+  if (valid) {
+    status = run_handler(handler, cwd, args, fds);
+  }
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+
+  // The client may have gone away, in which case there is no one to tell.
+  (void)write_all(client, &status, sizeof(status));
+}
+
+} // namespace
+
+auto
+FileSignature::read(const std::filesystem::path& path, FileSignature& signature) -> bool
+{
+  struct stat info
+  {};
+
+  if (::stat(path.c_str(), &info) != 0) {
+    return false;
+  }
+
+  signature.device = info.st_dev;
+  signature.inode = info.st_ino;
+  signature.size = static_cast<uint64_t>(info.st_size);
+  signature.mtime_ns = to_ns(info.st_mtim);
+  signature.ctime_ns = to_ns(info.st_ctim);
+
+  return true;
+}
+
+auto
+FileSignature::operator==(const FileSignature& other) const -> bool
+{
+  return (device == other.device) && (inode == other.inode) && (size == other.size) && (mtime_ns == other.mtime_ns) &&
+         (ctime_ns == other.ctime_ns);
+}
+
+auto
+WarmCache::find(const CacheKey& key, Entry& entry) const -> bool
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = entries_.find(key);
+
+  if (it == entries_.end()) {
+    misses_++;
+    return false;
+  }
+
+  entry = it->second;
+
+  hits_++;
+
+  return true;
+}
+
+void
+WarmCache::insert(const CacheKey& key, Entry entry)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  entries_[key] = std::move(entry);
+}
+
+void
+WarmCache::prune()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    FileSignature signature;
+    if (!FileSignature::read(it->second.path, signature) || !(signature == it->second.signature)) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+auto
+WarmCache::size() const -> size_t
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  return entries_.size();
+}
+
+auto
+default_server_socket() -> std::string
+{
+  if (const auto* runtime_dir = getenv("XDG_RUNTIME_DIR"); runtime_dir && (runtime_dir[0] != 0)) {
+    return std::string(runtime_dir) + "/nabla.sock";
+  }
+
+  return "/tmp/nabla-" + std::to_string(getuid()) + ".sock";
+}
+
+auto
+serve(const std::string& socket_path, const RequestHandler& handler, Console& console) -> bool
+{
+  sockaddr_un address;
+
+  if (!make_address(socket_path, address)) {
+    console.print_error("socket path '" + socket_path + "' is too long");
+    return false;
+  }
+
+  if (const auto other = connect_to(socket_path); other >= 0) {
+    ::close(other);
+    console.print_error("a server is already listening on '" + socket_path + "'");
+    return false;
+  }
+
+  // Nothing is listening on the socket, so it was left behind by a server that did not exit cleanly.
+  ::unlink(socket_path.c_str());
+
+  const auto fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (fd < 0) {
+    console.print_error(std::string("failed to create socket: ") + strerror(errno));
+    return false;
+  }
+
+  // Clients hand over their output to the server, so only the user that started it may connect.
+  const auto old_mask = ::umask(0077);
+
+  const auto bound = ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+  ::umask(old_mask);
+
+  if (!bound || (::listen(fd, SOMAXCONN) != 0)) {
+    console.print_error("failed to listen on '" + socket_path + "': " + strerror(errno));
+    ::close(fd);
+    return false;
+  }
+
+  // Writing to a client that went away should fail the write, not end the server.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  std::cerr << "listening on " << socket_path << std::endl;
+
+  while (true) {
+    const auto client = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0) {
+      if ((errno == EINTR) || (errno == ECONNABORTED)) {
+        continue;
+      }
+      console.print_error(std::string("failed to accept connection: ") + strerror(errno));
+      break;
+    }
+    handle_request(client, handler);
+    ::close(client);
+  }
+
+  ::close(fd);
+
+  ::unlink(socket_path.c_str());
+
+  return false;
+}
+
+auto
+send_request(const std::string& socket_path, const std::vector<std::string>& args, Console& console)
+  -> std::optional<int>
+{
+  // The server writes to the descriptors that it is given, so it has to belong to this user.
+  struct stat info
+  {};
+
+  if ((::lstat(socket_path.c_str(), &info) != 0) || !S_ISSOCK(info.st_mode) || (info.st_uid != getuid())) {
+    return std::nullopt;
+  }
+
+  std::error_code error;
+
+  const auto cwd = std::filesystem::current_path(error);
+
+  if (error) {
+    return std::nullopt;
+  }
+
+  const auto fd = connect_to(socket_path);
+
+  if (fd < 0) {
+    return std::nullopt;
+  }
+
+  std::string payload;
+
+  put_string(payload, cwd.string());
+
+  for (const auto& arg : args) {
+    put_string(payload, arg);
+  }
+
+  uint64_t size = payload.size();
+
+  iovec data{ &size, sizeof(size) };
+
+  const int fds[num_request_fds]{ STDOUT_FILENO, STDERR_FILENO };
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))]{};
+
+  msghdr message{};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+
+  auto* header = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type = SCM_RIGHTS;
+  header->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+  ssize_t n{ -1 };
+
+  do {
+    n = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+  } while ((n < 0) && (errno == EINTR));
+
+  // Nothing has run yet if the request could not be sent, so the caller can still handle it itself.
+  if ((n < 0) || !write_all(fd, reinterpret_cast<const char*>(&size) + n, sizeof(size) - static_cast<size_t>(n)) ||
+      !write_all(fd, payload.data(), payload.size())) {
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  int32_t status{ EXIT_FAILURE };
+
+  if (!read_all(fd, &status, sizeof(status))) {
+    // The request may have printed something already, so it would not be right to handle it again here.
+    console.print_error("the server at '" + socket_path + "' did not finish the request");
+    status = EXIT_FAILURE;
+  }
+
+  ::close(fd);
+
+  return status;
+}
+
+} // namespace nabla
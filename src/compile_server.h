@@ -0,0 +1,133 @@
+#pragma once
+
+#include "build_cache.h"
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla {
+
+class CompiledModule;
+class Console;
+class ModuleInterface;
+
+/// @brief Identifies a version of a file by what stat() reports about it, so that it can be checked for changes
+///        without being read.
+struct FileSignature final
+{
+  uint64_t device{ 0 };
+
+  uint64_t inode{ 0 };
+
+  uint64_t size{ 0 };
+
+  uint64_t mtime_ns{ 0 };
+
+  uint64_t ctime_ns{ 0 };
+
+  /// @return False if the file could not be stat'ed, such as when it does not exist.
+  [[nodiscard]] static auto read(const std::filesystem::path& path, FileSignature& signature) -> bool;
+
+  [[nodiscard]] auto operator==(const FileSignature& other) const -> bool;
+};
+
+/// @brief The compile results that a server keeps in memory between requests.
+///
+/// @details Entries have the same keys as those of the build cache, which cover the source of a file, the interfaces
+///          of the modules that it imports, and the options it was compiled with. Each entry also holds the signature
+///          that its file had when it was read, so that entries of files that have since changed can be pruned. An
+///          entry whose imports changed is simply not found again, and goes once its own file changes. This may be
+///          used by several threads at the same time.
+class WarmCache final
+{
+public:
+  struct Entry final
+  {
+    std::filesystem::path path;
+
+    FileSignature signature;
+
+    std::shared_ptr<const CompileOutput> output;
+
+    /// @brief The module to run, when the file was compiled to be run.
+    std::shared_ptr<const CompiledModule> module;
+
+    /// @brief The interface of the module, when other modules import it.
+    std::shared_ptr<const ModuleInterface> interface;
+  };
+
+  [[nodiscard]] auto find(const CacheKey& key, Entry& entry) const -> bool;
+
+  /// @brief Stores an entry, replacing any existing one.
+  void insert(const CacheKey& key, Entry entry);
+
+  /// @brief Removes the entries whose files have changed or been removed, since they won't be found again.
+  void prune();
+
+  [[nodiscard]] auto size() const -> size_t;
+
+  [[nodiscard]] auto num_hits() const -> size_t { return hits_.load(); }
+
+  [[nodiscard]] auto num_misses() const -> size_t { return misses_.load(); }
+
+private:
+  mutable std::mutex mutex_;
+
+  mutable std::atomic<size_t> hits_{ 0 };
+
+  mutable std::atomic<size_t> misses_{ 0 };
+
+  struct KeyHash final
+  {
+    [[nodiscard]] auto operator()(const CacheKey& key) const -> size_t { return static_cast<size_t>(key.low); }
+  };
+
+  struct KeyEqual final
+  {
+    [[nodiscard]] auto operator()(const CacheKey& a, const CacheKey& b) const -> bool
+    {
+      return (a.high == b.high) && (a.low == b.low);
+    }
+  };
+
+  std::unordered_map<CacheKey, Entry, KeyHash, KeyEqual> entries_;
+};
+
+/// @brief Runs the driver for a request. The arguments start with the program name, like the arguments of main().
+///
+/// @return The exit code to send back to the client.
+using RequestHandler = std::function<int(const std::vector<std::string>& args)>;
+
+/// @brief The socket that servers listen on and clients connect to by default.
+[[nodiscard]] auto
+default_server_socket() -> std::string;
+
+/// @brief Listens on a Unix domain socket and handles requests one at a time, until the process is killed.
+///
+/// @details Clients send their working directory, their arguments and their standard output and error. For the length
+///          of a request the server moves into that directory and writes to those descriptors, so the handler can print
+///          as usual and the output goes straight to the client, just as if the client had compiled it itself.
+///
+/// @return False if the server could not listen on the socket.
+[[nodiscard]] auto
+serve(const std::string& socket_path, const RequestHandler& handler, Console& console) -> bool;
+
+/// @brief Sends a request to a server and waits for it to be handled.
+///
+/// @return The exit code of the request, or nothing if there is no server to send it to, in which case the caller can
+///         handle the request itself.
+[[nodiscard]] auto
+send_request(const std::string& socket_path, const std::vector<std::string>& args, Console& console)
+  -> std::optional<int>;
+
+} // namespace nabla
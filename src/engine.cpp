@@ -0,0 +1,208 @@
+#include "engine.h"
+
+#include "ast_builder.h"
+#include "console.h"
+#include "frontend.h"
+#include "pass_manager.h"
+#include "passes/dead_code.h"
+#include "passes/mul_add_fusion.h"
+#include "passes/value_numbering.h"
+#include "time_trace.h"
+
+#include <stdexcept>
+
+namespace nabla {
+
+CompiledModule::CompiledModule(std::shared_ptr<const TranslationUnit> unit, ast::Module m, PassStatistics statistics)
+  : unit_(std::move(unit))
+  , module_(std::move(m))
+  , statistics_(std::move(statistics))
+{
+}
+
+CompiledModule::~CompiledModule() = default;
+
+auto
+CompiledModule::find_input(const std::string_view& name) const -> size_t
+{
+  for (size_t i = 0; i < module_.inputs.size(); i++) {
+    if (module_.inputs[i].name == name) {
+      return i;
+    }
+  }
+
+  return npos;
+}
+
+ExecutionContext::ExecutionContext(std::shared_ptr<const CompiledModule> m,
+                                   Runtime* runtime,
+                                   const InterpreterOptions& options)
+  : module_(std::move(m))
+  , interpreter_(Interpreter::create(runtime, options))
+{
+  reset_inputs();
+}
+
+void
+ExecutionContext::set_input(const size_t slot, const int value)
+{
+  input_at(slot, ast::ScalarType::int_).int_value = value;
+}
+
+void
+ExecutionContext::set_input(const size_t slot, const float value)
+{
+  input_at(slot, ast::ScalarType::float_).float_value = value;
+}
+
+void
+ExecutionContext::set_input(const std::string_view& name, const int value)
+{
+  set_input(slot_of(name), value);
+}
+
+void
+ExecutionContext::set_input(const std::string_view& name, const float value)
+{
+  set_input(slot_of(name), value);
+}
+
+void
+ExecutionContext::reset_inputs()
+{
+  const auto& inputs = module_->module().inputs;
+
+  inputs_.resize(inputs.size());
+
+  for (size_t i = 0; i < inputs.size(); i++) {
+    inputs_[i] = inputs[i].default_value;
+  }
+}
+
+void
+ExecutionContext::run()
+{
+  interpreter_->exec(module_->module(), inputs_.data());
+}
+
+void
+ExecutionContext::run_batch(const ast::Scalar* rows, const size_t num_rows)
+{
+  interpreter_->exec_batch(module_->module(), rows, num_rows);
+}
+
+auto
+ExecutionContext::input_at(const size_t slot, const ast::ScalarType type) -> ast::Scalar&
+{
+  if (module_->module().inputs.at(slot).type != type) {
+    throw std::invalid_argument("input '" + module_->module().inputs[slot].name + "' is of a different type");
+  }
+
+  return inputs_[slot];
+}
+
+auto
+ExecutionContext::slot_of(const std::string_view& name) const -> size_t
+{
+  const auto slot = module_->find_input(name);
+  if (slot == CompiledModule::npos) {
+    throw std::out_of_range("no input named '" + std::string(name) + "'");
+  }
+  return slot;
+}
+
+namespace {
+
+class EngineImpl final : public Engine
+{
+  EngineOptions options_;
+
+public:
+  explicit EngineImpl(const EngineOptions& options)
+    : options_(options)
+  {
+  }
+
+  auto compile(const std::string_view& filename, std::string source, Console& console)
+    -> std::shared_ptr<const CompiledModule> override
+  {
+    auto unit = std::make_shared<TranslationUnit>();
+    unit->filename = filename;
+    unit->source = std::move(source);
+
+    if (!parse_unit(*unit, console, options_.trace)) {
+      return nullptr;
+    }
+
+    return compile(std::move(unit), console);
+  }
+
+  auto compile(std::shared_ptr<TranslationUnit> unit, Console& console)
+    -> std::shared_ptr<const CompiledModule> override
+  {
+    if (!analyze_unit(*unit, console, options_.trace)) {
+      return nullptr;
+    }
+
+    const auto num_nodes = options_.trace ? count_nodes(unit->tree) : 0;
+
+    TimeTrace::Scope build_scope(options_.trace, TimeTrace::Phase::build_ast, unit->filename);
+
+    build_scope.set_nodes(num_nodes);
+
+    ast::Module m;
+    m.filename = unit->filename;
+
+    auto builder = ASTBuilder::create(&m, &unit->annotations);
+
+    for (const auto& name : options_.inputs) {
+      builder->declare_input(name);
+    }
+
+    auto failed{ false };
+
+    // Later nodes may refer to whatever failed to build, so stop at the first failure.
+    for (const auto& node : unit->tree.nodes) {
+      if (!builder->build(*node)) {
+        failed = true;
+        break;
+      }
+    }
+
+    for (const auto& diagnostic : builder->get_diagnostics()) {
+      console.print_diagnostic(unit->filename, diagnostic, unit->source);
+    }
+
+    if (failed) {
+      return nullptr;
+    }
+
+    build_scope.stop();
+
+    TimeTrace::Scope optimize_scope(options_.trace, TimeTrace::Phase::optimize, unit->filename);
+
+    auto pass_manager = PassManager::create();
+
+    if (options_.optimize) {
+      // Dead code is removed before fusing, since dead uses of a product would prevent it from being fused. The code
+      // generator runs the same passes to decide what to fuse (see codegen::find_fused_products), so keep them in sync.
+      pass_manager->add(std::make_unique<ValueNumberingPass>());
+      pass_manager->add(std::make_unique<DeadCodePass>());
+      pass_manager->add(std::make_unique<MulAddFusionPass>(options_.fma));
+    }
+
+    pass_manager->run(m);
+
+    return std::make_shared<const CompiledModule>(std::move(unit), std::move(m), pass_manager->statistics());
+  }
+};
+
+} // namespace
+
+auto
+Engine::create(const EngineOptions& options) -> std::unique_ptr<Engine>
+{
+  return std::make_unique<EngineImpl>(options);
+}
+
+} // namespace nabla
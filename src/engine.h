@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+#include "pass.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class Console;
+class TimeTrace;
+struct TranslationUnit;
+
+/// @brief A program that has been compiled once, so that it can be executed any number of times.
+///
+/// @note A compiled module is immutable, so it may be shared between threads. Each thread executes it through its own
+///       @ref ExecutionContext.
+class CompiledModule final
+{
+  /// @brief Shared, since modules that import this one refer to its tokens.
+  std::shared_ptr<const TranslationUnit> unit_;
+
+  ast::Module module_;
+
+  PassStatistics statistics_;
+
+public:
+  CompiledModule(std::shared_ptr<const TranslationUnit> unit, ast::Module m, PassStatistics statistics);
+
+  ~CompiledModule();
+
+  [[nodiscard]] auto module() const -> const ast::Module& { return module_; }
+
+  [[nodiscard]] auto unit() const -> const TranslationUnit& { return *unit_; }
+
+  [[nodiscard]] auto statistics() const -> const PassStatistics& { return statistics_; }
+
+  /// @return The slot of the input with the given name, or @ref CompiledModule::npos if there is no such input.
+  [[nodiscard]] auto find_input(const std::string_view& name) const -> size_t;
+
+  static constexpr size_t npos = static_cast<size_t>(-1);
+};
+
+/// @brief Executes a compiled module, keeping the values of its inputs and the storage of its computed values between
+///        runs.
+///
+/// @note An execution context is cheap to create, but it is not thread safe. Use one per thread.
+class ExecutionContext final
+{
+  std::shared_ptr<const CompiledModule> module_;
+
+  std::unique_ptr<Interpreter> interpreter_;
+
+  std::vector<ast::Scalar> inputs_;
+
+public:
+  ExecutionContext(std::shared_ptr<const CompiledModule> m,
+                   Runtime* runtime,
+                   const InterpreterOptions& options = InterpreterOptions{});
+
+  /// @brief Sets the value of an input.
+  ///
+  /// @note An exception is thrown if there is no such input, or if the input is not of the same type as the value.
+  void set_input(size_t slot, int value);
+
+  void set_input(size_t slot, float value);
+
+  void set_input(const std::string_view& name, int value);
+
+  void set_input(const std::string_view& name, float value);
+
+  /// @brief Sets all inputs back to their default value.
+  void reset_inputs();
+
+  void run();
+
+  /// @brief Runs the module once for each row of inputs, ignoring the inputs that were set on the context.
+  ///
+  /// @note See @ref Interpreter::exec_batch for the layout of the rows.
+  void run_batch(const ast::Scalar* rows, size_t num_rows);
+
+protected:
+  [[nodiscard]] auto input_at(size_t slot, ast::ScalarType type) -> ast::Scalar&;
+
+  [[nodiscard]] auto slot_of(const std::string_view& name) const -> size_t;
+};
+
+struct EngineOptions final
+{
+  /// @brief The names of the top-level declarations that are provided by the host.
+  std::vector<std::string> inputs;
+
+  /// @brief Whether to run the optimization passes over compiled modules.
+  bool optimize{ true };
+
+  /// @brief Whether floating point multiply-adds may skip the rounding of the product.
+  bool fma{ false };
+
+  /// @brief If not null, the phases of compiling are timed in this.
+  TimeTrace* trace{ nullptr };
+};
+
+/// @brief The entry point for programs that embed nabla.
+class Engine
+{
+public:
+  static auto create(const EngineOptions& options = EngineOptions{}) -> std::unique_ptr<Engine>;
+
+  virtual ~Engine() = default;
+
+  /// @brief Compiles a program.
+  ///
+  /// @return The compiled module, or null if the program has errors. All diagnostics are printed to the console.
+  [[nodiscard]] virtual auto compile(const std::string_view& filename, std::string source, Console& console)
+    -> std::shared_ptr<const CompiledModule> = 0;
+
+  /// @brief Compiles a translation unit that has already been parsed, such as one that imports other modules.
+  ///
+  /// @return The compiled module, or null if the program has errors. All diagnostics are printed to the console.
+  [[nodiscard]] virtual auto compile(std::shared_ptr<TranslationUnit> unit, Console& console)
+    -> std::shared_ptr<const CompiledModule> = 0;
+};
+
+} // namespace nabla
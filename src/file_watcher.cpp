@@ -0,0 +1,163 @@
+#include "file_watcher.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace nabla {
+
+namespace {
+
+/// @brief The events that may change a tree of source files. Files are seen once they are closed after writing, so
+///        a file being written in several steps is not reported in the middle of it.
+constexpr uint32_t tree_events = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+[[nodiscard]] auto
+is_source_file(const std::filesystem::path& name) -> bool
+{
+  return name.extension() == ".nabla";
+}
+
+} // namespace
+
+FileWatcher::FileWatcher(std::vector<std::filesystem::path> roots)
+  : fd_(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+  , roots_(std::move(roots))
+{
+  if (fd_ < 0) {
+    return;
+  }
+
+  cwd_watch_ = inotify_add_watch(fd_, ".", IN_CREATE | IN_MOVED_TO | IN_ONLYDIR);
+
+  for (const auto& root : roots_) {
+    add_tree(root);
+  }
+}
+
+FileWatcher::~FileWatcher()
+{
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+auto
+FileWatcher::wait(const std::chrono::milliseconds debounce) -> bool
+{
+  pollfd events{ fd_, POLLIN, 0 };
+
+  auto changed{ false };
+
+  while (true) {
+    // Until something changes there is nothing to debounce, so this waits for as long as it takes.
+    const auto ready = ::poll(&events, 1, changed ? static_cast<int>(debounce.count()) : -1);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (ready == 0) {
+      return true;
+    }
+    const auto result = read_events();
+    if (result < 0) {
+      return false;
+    }
+    changed |= (result > 0);
+  }
+}
+
+void
+FileWatcher::add_tree(const std::filesystem::path& dir)
+{
+  const auto watch = inotify_add_watch(fd_, dir.c_str(), tree_events);
+  if (watch < 0) {
+    return;
+  }
+
+  dirs_[watch] = dir;
+
+  // Watching a directory again is harmless, so a tree that is added twice (for example after an overflow) is fine.
+  std::error_code error;
+  for (std::filesystem::directory_iterator it(dir, error); !error && (it != std::filesystem::directory_iterator());
+       it.increment(error)) {
+    if (it->is_directory(error) && !it->is_symlink(error)) {
+      add_tree(it->path());
+    }
+  }
+}
+
+auto
+FileWatcher::read_events() -> int
+{
+  alignas(inotify_event) char buffer[64 * 1024];
+
+  auto relevant{ false };
+
+  while (true) {
+    const auto size = ::read(fd_, buffer, sizeof(buffer));
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN) {
+        break;
+      }
+      return -1;
+    }
+
+    for (ssize_t offset = 0; offset < size;) {
+      const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+
+      offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost, which may include the creation of directories.
+        for (const auto& root : roots_) {
+          add_tree(root);
+        }
+        relevant = true;
+        continue;
+      }
+
+      if (event->mask & IN_IGNORED) {
+        dirs_.erase(event->wd);
+        continue;
+      }
+
+      const std::filesystem::path name((event->len > 0) ? event->name : "");
+
+      if (event->wd == cwd_watch_) {
+        for (const auto& root : roots_) {
+          if (name == root) {
+            add_tree(root);
+            relevant = true;
+          }
+        }
+        continue;
+      }
+
+      const auto dir = dirs_.find(event->wd);
+      if (dir == dirs_.end()) {
+        continue;
+      }
+
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          add_tree(dir->second / name);
+        }
+        // A directory that was moved or removed may have had source files in it.
+        relevant = true;
+      } else if (is_source_file(name)) {
+        relevant = true;
+      }
+    }
+  }
+
+  return relevant ? 1 : 0;
+}
+
+} // namespace nabla
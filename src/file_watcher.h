@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace nabla {
+
+/// @brief Watches directory trees for changes to source files, using inotify.
+///
+/// @details Every directory in the trees is watched, including ones that are created later. A root that does not
+///          exist yet is watched for in the current directory. The watcher only reports that something changed, since
+///          the driver checks every file against its signature anyway, which is how it finds which files to compile.
+class FileWatcher final
+{
+public:
+  explicit FileWatcher(std::vector<std::filesystem::path> roots);
+
+  FileWatcher(const FileWatcher&) = delete;
+
+  auto operator=(const FileWatcher&) -> FileWatcher& = delete;
+
+  ~FileWatcher();
+
+  /// @brief Whether inotify could be set up.
+  [[nodiscard]] auto valid() const -> bool { return fd_ >= 0; }
+
+  /// @brief Blocks until a source file changes, and then until no more events arrive for the debounce period, so that
+  ///        a burst of events (such as an editor writing a file and renaming it into place) is handled once.
+  ///
+  /// @return False if the events could not be read.
+  [[nodiscard]] auto wait(std::chrono::milliseconds debounce) -> bool;
+
+private:
+  void add_tree(const std::filesystem::path& dir);
+
+  /// @brief Reads the pending events.
+  ///
+  /// @return Whether any of them were about source files, or -1 if reading failed.
+  [[nodiscard]] auto read_events() -> int;
+
+  int fd_{ -1 };
+
+  /// @brief The watch on the current directory, which is there to see roots being created.
+  int cwd_watch_{ -1 };
+
+  std::vector<std::filesystem::path> roots_;
+
+  /// @brief The directory of each watch.
+  std::unordered_map<int, std::filesystem::path> dirs_;
+};
+
+} // namespace nabla
@@ -0,0 +1,236 @@
+#include "frontend.h"
+
+#include "annotate.h"
+#include "console.h"
+#include "module_interface.h"
+#include "parser.h"
+#include "time_trace.h"
+#include "validator.h"
+
+#include <map>
+
+namespace nabla {
+
+namespace {
+
+/// @brief Copies the nodes of an interface, along with the names that they declare.
+class NodeCopier final : public NodeVisitor
+{
+public:
+  NodePtr copy;
+
+  std::string_view name;
+
+  void visit(const PrintNode&) override {}
+
+  void visit(const DeclNode& node) override
+  {
+    name = node.get_name().data;
+    copy = clone(node);
+  }
+
+  void visit(const FuncNode&) override {}
+
+  void visit(const StructNode& node) override
+  {
+    name = node.name().data;
+    copy = clone(node);
+  }
+
+  void visit(const ReturnNode&) override {}
+
+  void visit(const ImportNode&) override {}
+};
+
+/// @brief Copies the declarations of the imported modules into the start of the tree, in the order of the modules.
+///
+/// @return False if two modules declare the same name, since the copies would then conflict.
+[[nodiscard]] auto
+copy_imported_decls(TranslationUnit& unit, Console& console) -> bool
+{
+  std::vector<NodePtr> copies;
+
+  std::map<std::string_view, const ModuleInterface*> owners;
+
+  auto success{ true };
+
+  for (const auto& imported : unit.imports) {
+    // An interface only has the module's own declarations, since those it imported come from their own modules.
+    for (const auto& node : imported->nodes()) {
+      NodeCopier copier;
+      node->accept(copier);
+      if (!copier.copy) {
+        continue;
+      }
+      const auto [it, inserted] = owners.emplace(copier.name, imported.get());
+      if (!inserted) {
+        console.print_file_error(unit.filename,
+                                 "'" + std::string(copier.name) + "' is declared by both '" +
+                                   std::string(it->second->module_name()) + "' and '" +
+                                   std::string(imported->module_name()) + "', which are imported");
+        success = false;
+        continue;
+      }
+      copies.emplace_back(std::move(copier.copy));
+    }
+  }
+
+  unit.num_imported_nodes = copies.size();
+
+  for (auto& node : unit.tree.nodes) {
+    copies.emplace_back(std::move(node));
+  }
+
+  unit.tree.nodes = std::move(copies);
+
+  return success;
+}
+
+} // namespace
+
+auto
+parse_unit(TranslationUnit& unit, Console& console, TimeTrace* trace) -> bool
+{
+  TimeTrace::Scope lex_scope(trace, TimeTrace::Phase::lex, unit.filename);
+
+  Lexer lexer(unit.source);
+
+  while (!lexer.eof()) {
+    const auto token = lexer.scan();
+    if ((token == TK::comment) || (token == TK::space)) {
+      continue;
+    }
+    if (token == TK::incomplete_string_literal) {
+      Diagnostic diagnostic{ "unterminated string", &token };
+      console.print_diagnostic(unit.filename, diagnostic, unit.source);
+      return false;
+    }
+    if (token == TK::incomplete_comment) {
+      Diagnostic diagnostic{ "unterminated comment", &token };
+      console.print_diagnostic(unit.filename, diagnostic, unit.source);
+      return false;
+    }
+    unit.tokens.emplace_back(token);
+  }
+
+  lex_scope.set_tokens(unit.tokens.size());
+
+  lex_scope.stop();
+
+  TimeTrace::Scope parse_scope(trace, TimeTrace::Phase::parse, unit.filename);
+
+  parse_scope.set_tokens(unit.tokens.size());
+
+  auto parser = Parser::create(unit.tokens.data(), unit.tokens.size());
+
+  while (!parser->eof()) {
+    try {
+      auto node = parser->parse();
+      unit.tree.nodes.emplace_back(std::move(node));
+    } catch (const FatalError& error) {
+      const auto& diagnostic = error.diagnostic();
+      console.print_diagnostic(unit.filename, diagnostic, unit.source);
+      return false;
+    }
+  }
+
+  if (trace) {
+    parse_scope.stop();
+    parse_scope.set_nodes(count_nodes(unit.tree));
+  }
+
+  return true;
+}
+
+auto
+analyze_unit(TranslationUnit& unit, Console& console, TimeTrace* trace) -> bool
+{
+  {
+    TimeTrace::Scope scope(trace, TimeTrace::Phase::import, unit.filename);
+    if (!copy_imported_decls(unit, console)) {
+      return false;
+    }
+  }
+
+  const auto num_nodes = trace ? count_nodes(unit.tree) : 0;
+
+  {
+    TimeTrace::Scope scope(trace, TimeTrace::Phase::annotate, unit.filename);
+    scope.set_nodes(num_nodes);
+    unit.annotations = annotate(unit.tree);
+  }
+
+  TimeTrace::Scope scope(trace, TimeTrace::Phase::validate, unit.filename);
+
+  scope.set_nodes(num_nodes);
+
+  auto validator = Validator::create();
+
+  validator->validate(unit.tree.nodes, unit.annotations);
+
+  for (const auto& diagnostic : validator->get_diagnostics()) {
+    console.print_diagnostic(unit.filename, diagnostic, unit.source);
+  }
+
+  return !validator->failed();
+}
+
+auto
+run_frontend(TranslationUnit& unit, Console& console, TimeTrace* trace) -> bool
+{
+  return parse_unit(unit, console, trace) && analyze_unit(unit, console, trace);
+}
+
+auto
+scan_imports(const std::string_view& source) -> std::vector<ImportRef>
+{
+  std::vector<ImportRef> imports;
+
+  Lexer lexer(source);
+
+  const auto next = [&lexer]() -> Token {
+    while (!lexer.eof()) {
+      const auto token = lexer.scan();
+      if ((token != TK::space) && (token != TK::comment)) {
+        return token;
+      }
+    }
+    return Token();
+  };
+
+  while (next() == "import") {
+    const auto name = next();
+    if (name != TK::identifier) {
+      break;
+    }
+
+    ImportRef import{ std::string(name.data), name };
+
+    auto token = next();
+
+    while (token == '.') {
+      const auto part = next();
+      if (part != TK::identifier) {
+        return imports;
+      }
+      import.module_name += '.';
+      import.module_name += part.data;
+      token = next();
+    }
+
+    // Like any statement, the last one in the file doesn't need to be terminated.
+    if ((token != ';') && (token != TK::none)) {
+      break;
+    }
+
+    imports.emplace_back(std::move(import));
+
+    if (token == TK::none) {
+      break;
+    }
+  }
+
+  return imports;
+}
+
+} // namespace nabla
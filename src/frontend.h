@@ -0,0 +1,95 @@
+#pragma once
+
+#include "annotations.h"
+#include "lexer.h"
+#include "syntax_tree.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class Console;
+class ModuleInterface;
+class TimeTrace;
+
+/// @brief A source file, along with everything that the front end derives from it.
+///
+/// @note The tokens point into the source and the syntax tree points to the tokens, so a translation unit cannot be
+///       copied or moved once the front end has run on it.
+struct TranslationUnit final
+{
+  std::string filename;
+
+  /// @brief The name that other modules import this one by, such as "geometry.vec" for "src/geometry/vec.nabla".
+  std::string module_name;
+
+  std::string source;
+
+  std::vector<Token> tokens;
+
+  SyntaxTree tree;
+
+  AnnotationTable annotations;
+
+  /// @brief The interfaces of the modules that this one imports, directly or through other modules, with every module
+  ///        coming after the ones that it imports. Their declarations are copied into the tree, and the copies refer to
+  ///        their tokens.
+  std::vector<std::shared_ptr<const ModuleInterface>> imports;
+
+  /// @brief The number of nodes at the start of the tree that were copied from imported modules.
+  size_t num_imported_nodes{ 0 };
+
+  TranslationUnit() = default;
+
+  TranslationUnit(const TranslationUnit&) = delete;
+
+  auto operator=(const TranslationUnit&) -> TranslationUnit& = delete;
+};
+
+/// @brief Lexes and parses a translation unit.
+///
+/// @param trace If not null, the phases are timed in this.
+///
+/// @return True on success, false if the unit has errors. All diagnostics are printed to the console.
+[[nodiscard]] auto
+parse_unit(TranslationUnit& unit, Console& console, TimeTrace* trace = nullptr) -> bool;
+
+/// @brief Copies the declarations of the imported modules into a parsed translation unit, and then annotates and
+///        validates it.
+///
+/// @param trace If not null, the phases are timed in this.
+///
+/// @return True on success, false if the unit has errors. All diagnostics are printed to the console.
+[[nodiscard]] auto
+analyze_unit(TranslationUnit& unit, Console& console, TimeTrace* trace = nullptr) -> bool;
+
+/// @brief Lexes, parses, annotates and validates a translation unit.
+///
+/// @param trace If not null, the phases are timed in this.
+///
+/// @return True on success, false if the unit has errors. All diagnostics are printed to the console.
+[[nodiscard]] auto
+run_frontend(TranslationUnit& unit, Console& console, TimeTrace* trace = nullptr) -> bool;
+
+/// @brief An import found by @ref scan_imports.
+struct ImportRef final
+{
+  std::string module_name;
+
+  /// @brief The first part of the module name, which points into the source.
+  Token token;
+};
+
+/// @brief Finds the imports at the start of a source without parsing the rest of it, which is enough to know the order
+///        that modules have to be compiled in.
+///
+/// @note The scan stops at the first thing that isn't a well-formed import, so a malformed import is left out, and is
+///       reported by the parser instead.
+[[nodiscard]] auto
+scan_imports(const std::string_view& source) -> std::vector<ImportRef>;
+
+} // namespace nabla
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace nabla {
+
+constexpr uint64_t hash_seed = 0xcbf29ce484222325ULL;
+
+/// @brief Hashes data with 64-bit FNV-1a.
+///
+/// @details This is used to tell whether content has changed, such as for caching build outputs. It is not meant to
+///          withstand deliberate collisions. Hashes can be chained by passing the previous hash as the seed.
+[[nodiscard]] constexpr auto
+hash64(const std::string_view& data, uint64_t seed = hash_seed) -> uint64_t
+{
+  for (const auto c : data) {
+    seed ^= static_cast<uint8_t>(c);
+    seed *= 0x100000001b3ULL;
+  }
+  return seed;
+}
+
+namespace detail {
+
+constexpr uint64_t xxh_prime1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t xxh_prime2 = 0xc2b2ae3d27d4eb4fULL;
+constexpr uint64_t xxh_prime3 = 0x165667b19e3779f9ULL;
+constexpr uint64_t xxh_prime4 = 0x85ebca77c2b2ae63ULL;
+constexpr uint64_t xxh_prime5 = 0x27d4eb2f165667c5ULL;
+
+[[nodiscard]] constexpr auto
+rotl64(const uint64_t x, const int r) -> uint64_t
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+[[nodiscard]] constexpr auto
+xxh_round(uint64_t acc, const uint64_t input) -> uint64_t
+{
+  acc += input * xxh_prime2;
+  acc = rotl64(acc, 31);
+  return acc * xxh_prime1;
+}
+
+[[nodiscard]] constexpr auto
+xxh_merge(uint64_t acc, const uint64_t value) -> uint64_t
+{
+  acc ^= xxh_round(0, value);
+  return (acc * xxh_prime1) + xxh_prime4;
+}
+
+/// @note Reads are little-endian on little-endian hosts only, which is fine for hashes that never leave the machine.
+[[nodiscard]] inline auto
+read64(const char* p) -> uint64_t
+{
+  uint64_t value{};
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+[[nodiscard]] inline auto
+read32(const char* p) -> uint32_t
+{
+  uint32_t value{};
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+} // namespace detail
+
+/// @brief Hashes data with XXH64.
+///
+/// @details This is much faster than @ref hash64 on large inputs, such as whole source files, since it consumes eight
+///          bytes at a time in four independent lanes.
+[[nodiscard]] inline auto
+xxhash64(const std::string_view& data, const uint64_t seed = 0) -> uint64_t
+{
+  using namespace detail;
+
+  const char* p = data.data();
+  const char* const end = p + data.size();
+
+  uint64_t h{};
+
+  if (data.size() >= 32) {
+    uint64_t v1 = seed + xxh_prime1 + xxh_prime2;
+    uint64_t v2 = seed + xxh_prime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - xxh_prime1;
+    while ((end - p) >= 32) {
+      v1 = xxh_round(v1, read64(p));
+      v2 = xxh_round(v2, read64(p + 8));
+      v3 = xxh_round(v3, read64(p + 16));
+      v4 = xxh_round(v4, read64(p + 24));
+      p += 32;
+    }
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxh_merge(h, v1);
+    h = xxh_merge(h, v2);
+    h = xxh_merge(h, v3);
+    h = xxh_merge(h, v4);
+  } else {
+    h = seed + xxh_prime5;
+  }
+
+  h += static_cast<uint64_t>(data.size());
+
+  while ((end - p) >= 8) {
+    h ^= xxh_round(0, read64(p));
+    h = (rotl64(h, 27) * xxh_prime1) + xxh_prime4;
+    p += 8;
+  }
+
+  if ((end - p) >= 4) {
+    h ^= static_cast<uint64_t>(read32(p)) * xxh_prime1;
+    h = (rotl64(h, 23) * xxh_prime2) + xxh_prime3;
+    p += 4;
+  }
+
+  while (p < end) {
+    h ^= static_cast<uint64_t>(static_cast<uint8_t>(*p)) * xxh_prime5;
+    h = rotl64(h, 11) * xxh_prime1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= xxh_prime2;
+  h ^= h >> 29;
+  h *= xxh_prime3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/// @brief Formats a hash as 16 hexadecimal digits.
+[[nodiscard]] inline auto
+hash_to_hex(uint64_t hash) -> std::string
+{
+  std::string result(16, '0');
+  for (size_t i = 0; i < 16; i++) {
+    result[15 - i] = "0123456789abcdef"[hash & 0xf];
+    hash >>= 4;
+  }
+  return result;
+}
+
+} // namespace nabla
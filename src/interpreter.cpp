@@ -1,53 +1,29 @@
 #include "interpreter.h"
 
-namespace nabla {
-
-namespace {
-
-class Value
-{
-public:
-  virtual ~Value() = default;
-
-  virtual void print(Runtime& runtime) const = 0;
-};
-
-template<typename T>
-class ValueImpl final : public Value
-{
-  T value_;
-
-public:
-  explicit ValueImpl(T value)
-    : value_(value)
-  {
-  }
-
-  [[nodiscard]] auto value() const -> const T& { return value_; }
-
-  void print(Runtime& runtime) const override { runtime.print(value_); }
-};
+#include "batch_interpreter.h"
+#include "jit/jit_interpreter.h"
+#include "parallel_interpreter.h"
+#include "value.h"
 
-using IntValue = ValueImpl<int>;
+#include <cmath>
 
-using FloatValue = ValueImpl<float>;
+#include <stdint.h>
 
-using StringValue = ValueImpl<std::string>;
+namespace nabla {
 
-using ValuePtr = std::unique_ptr<Value>;
+namespace {
 
 struct Context final
 {
-  Runtime* runtime;
+  Runtime* runtime{ nullptr };
 
-  std::vector<ValuePtr> values;
+  /// @brief The values computed so far, indexed by value ID.
+  std::vector<Value> values;
 
-  /// @brief This is the ID of the value generated by the last expression.
-  ///        A lot of the time, it is the last generated value in the list.
-  ///        Sometimes, when a variable is references, this member will be
-  ///        assigned to the value being referenced (which may not be the
-  ///        last value in the list).
-  size_t last_value_index{ 0 };
+  const ast::Module* module{ nullptr };
+
+  /// @brief The values of the module inputs, or null if the defaults are used.
+  const ast::Scalar* inputs{ nullptr };
 };
 
 class InterpreterImpl final
@@ -57,20 +33,61 @@ class InterpreterImpl final
 {
   Context context_;
 
+  Profile* profile_{ nullptr };
+
+  uint32_t countdown_{ 1 };
+
 public:
-  explicit InterpreterImpl(Runtime* runtime)
-    : context_{ runtime }
+  InterpreterImpl(Runtime* runtime, Profile* profile)
+    : profile_(profile)
   {
+    context_.runtime = runtime;
   }
 
-  void exec(const ast::Module& mod) override
+  using Interpreter::exec;
+
+  void exec(const ast::Module& mod, const ast::Scalar* inputs) override
   {
+    // clearing keeps the capacity, so repeated executions reuse the storage.
+    context_.values.clear();
+    context_.module = &mod;
+    context_.inputs = inputs;
+
+    // The profiling loop is kept separate, so that the regular loop pays nothing for it.
+    if (profile_) {
+      exec_profiled(mod);
+      return;
+    }
+
     for (const auto& stmt : mod.stmts) {
       stmt->accept(*this);
     }
   }
 
 protected:
+  void exec_profiled(const ast::Module& mod)
+  {
+    auto* counters = profile_->counters(mod);
+
+    for (size_t i = 0; i < mod.stmts.size(); i++) {
+      auto& stmt_counters = counters[i];
+
+      stmt_counters.executions++;
+
+      if (--countdown_ > 0) {
+        mod.stmts[i]->accept(*this);
+        continue;
+      }
+
+      const auto start = Profile::now();
+      mod.stmts[i]->accept(*this);
+      stmt_counters.ticks += Profile::now() - start;
+      stmt_counters.samples++;
+
+      countdown_ = profile_->next_countdown();
+    }
+  }
+
   void visit(const ast::AssignStmt& stmt) override
   {
     // since we build the value table the same way the expressions are layed out in the AST, we do not need to map them
@@ -78,73 +95,99 @@ protected:
     stmt.value().accept(*this);
   }
 
-  void visit(const ast::PrintStmt& stmt) override
-  {
-    const auto id = stmt.id();
-    context_.values.at(id)->print(*context_.runtime);
-  }
+  void visit(const ast::PrintStmt& stmt) override { context_.values.at(stmt.id()).print(*context_.runtime); }
 
   void visit(const ast::PrintEndStmt&) override { context_.runtime->print_end(); }
 
-  void visit(const ast::LiteralExpr<int>& expr) override
-  {
-    context_.values.emplace_back(std::make_unique<IntValue>(expr.value()));
-  }
+  void visit(const ast::LiteralExpr<int>& expr) override { push_value(expr.value()); }
 
-  void visit(const ast::LiteralExpr<float>& expr) override
+  void visit(const ast::LiteralExpr<float>& expr) override { push_value(expr.value()); }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override { push_value(&expr.value()); }
+
+  void visit(const ast::AddExpr<int>& expr) override { push_value(int_at(expr.left()) + int_at(expr.right())); }
+
+  void visit(const ast::AddExpr<float>& expr) override
   {
-    context_.values.emplace_back(std::make_unique<FloatValue>(expr.value()));
+    push_value(float_at(expr.left()) + float_at(expr.right()));
   }
 
-  void visit(const ast::LiteralExpr<std::string>& expr) override
+  void visit(const ast::AddExpr<std::string>&) override {}
+
+  void visit(const ast::MulExpr<int, int>& expr) override { push_value(int_at(expr.left()) * int_at(expr.right())); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override
   {
-    context_.values.emplace_back(std::make_unique<StringValue>(expr.value()));
+    push_value(float_at(expr.left()) * float_at(expr.right()));
   }
 
-  void visit(const ast::AddExpr<int>& expr) override
+  void visit(const ast::MulAddExpr<int>& expr) override
   {
-    const auto* l = static_cast<const IntValue*>(context_.values.at(expr.left()).get());
-    const auto* r = static_cast<const IntValue*>(context_.values.at(expr.right()).get());
-    push_value(std::make_unique<IntValue>(l->value() + r->value()));
+    push_value(int_at(expr.a()) * int_at(expr.b()) + int_at(expr.c()));
   }
 
-  void visit(const ast::AddExpr<float>& expr) override
+  void visit(const ast::MulAddExpr<float>& expr) override
   {
-    const auto* l = static_cast<const FloatValue*>(context_.values.at(expr.left()).get());
-    const auto* r = static_cast<const FloatValue*>(context_.values.at(expr.right()).get());
-    push_value(std::make_unique<FloatValue>(l->value() + r->value()));
+    const auto a = float_at(expr.a());
+    const auto b = float_at(expr.b());
+    const auto c = float_at(expr.c());
+    if (expr.fused()) {
+      push_value(std::fma(a, b, c));
+    } else {
+      const float product = a * b;
+      push_value(product + c);
+    }
   }
 
-  void visit(const ast::AddExpr<std::string>&) override {}
+  void visit(const ast::InputExpr<int>& expr) override { push_value(input_at(expr.slot()).int_value); }
 
-  void visit(const ast::MulExpr<int, int>& expr) override
-  {
-    const auto* l = static_cast<const IntValue*>(context_.values.at(expr.left()).get());
-    const auto* r = static_cast<const IntValue*>(context_.values.at(expr.right()).get());
-    push_value(std::make_unique<IntValue>(l->value() * r->value()));
-  }
+  void visit(const ast::InputExpr<float>& expr) override { push_value(input_at(expr.slot()).float_value); }
 
-  void visit(const ast::MulExpr<float, float>& expr) override
+  [[nodiscard]] auto int_at(const size_t id) const -> int { return context_.values.at(id).int_value; }
+
+  [[nodiscard]] auto float_at(const size_t id) const -> float { return context_.values.at(id).float_value; }
+
+  [[nodiscard]] auto input_at(const size_t slot) const -> const ast::Scalar&
   {
-    const auto* l = static_cast<const FloatValue*>(context_.values.at(expr.left()).get());
-    const auto* r = static_cast<const FloatValue*>(context_.values.at(expr.right()).get());
-    push_value(std::make_unique<FloatValue>(l->value() * r->value()));
+    if (context_.inputs) {
+      return context_.inputs[slot];
+    }
+    return context_.module->inputs.at(slot).default_value;
   }
 
-  void push_value(std::unique_ptr<Value> value)
+  template<typename T>
+  void push_value(T value)
   {
-    context_.values.emplace_back(std::move(value));
-
-    context_.last_value_index = context_.values.size() - 1;
+    context_.values.emplace_back(Value::from(value));
   }
 };
 
 } // namespace
 
+void
+Interpreter::exec_batch(const ast::Module& m, const ast::Scalar* rows, const size_t num_rows)
+{
+  for (size_t row = 0; row < num_rows; row++) {
+    exec(m, rows ? (rows + (row * m.inputs.size())) : nullptr);
+  }
+}
+
 auto
-Interpreter::create(Runtime* runtime) -> std::unique_ptr<Interpreter>
+Interpreter::create(Runtime* runtime, const InterpreterOptions& options) -> std::unique_ptr<Interpreter>
 {
-  return std::make_unique<InterpreterImpl>(runtime);
+  if ((options.backend == Backend::jit) && !options.profile) {
+    return jit::create_interpreter(runtime, options);
+  }
+
+  if ((options.backend == Backend::parallel) && !options.profile) {
+    return create_parallel_interpreter(runtime, options);
+  }
+
+  if ((options.backend == Backend::batch) && !options.profile) {
+    return create_batch_interpreter(runtime, options.batch_kernels);
+  }
+
+  return std::make_unique<InterpreterImpl>(runtime, options.profile);
 }
 
 } // namespace nabla
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ast.h"
+#include "profile.h"
+#include "thread_pool.h"
 
 #include <iostream>
 #include <memory>
@@ -22,14 +24,82 @@ public:
   virtual void print_end() { std::cout << std::endl; }
 };
 
+/// @brief The ways that a module can be executed.
+enum class Backend
+{
+  /// @brief Walks the statements of the module.
+  interpreter,
+  /// @brief Compiles the module to machine code first. Falls back to the interpreter where that is not possible.
+  jit,
+  /// @brief Executes independent statements concurrently on a thread pool.
+  parallel,
+  /// @brief Executes many rows of inputs at once, computing each value for all rows with SIMD instructions.
+  batch
+};
+
+/// @brief The kernels that the batch backend computes columns with.
+enum class BatchKernels
+{
+  /// @brief The widest kernels that the CPU supports.
+  best,
+  portable,
+  sse4_1,
+  /// @brief AVX2 and FMA kernels.
+  avx2
+};
+
+struct InterpreterOptions final
+{
+  Backend backend{ Backend::interpreter };
+
+  /// @brief Whether the JIT appends its code ranges to `/tmp/perf-<pid>.map`, for profilers to symbolize them.
+  bool perf_map{ false };
+
+  /// @brief Whether the JIT records its code in `/tmp/jit-<pid>.dump`, for `perf inject --jit`.
+  bool jitdump{ false };
+
+  /// @brief If not null, statement executions are counted and timed into this profile.
+  ///
+  /// @note Only the interpreter backend collects profiles, so this takes precedence over the backend option.
+  Profile* profile{ nullptr };
+
+  /// @brief The pool that the parallel backend runs on. If this is null, the backend runs on @ref ThreadPool::shared.
+  ThreadPool* thread_pool{ nullptr };
+
+  /// @brief The number of statements that the parallel backend groups into a single task.
+  size_t task_cost{ 1024 };
+
+  /// @brief The kernels that the batch backend uses. The best kernels are used instead if the CPU lacks these.
+  BatchKernels batch_kernels{ BatchKernels::best };
+};
+
 class Interpreter
 {
 public:
-  static auto create(Runtime* runtime) -> std::unique_ptr<Interpreter>;
+  static auto create(Runtime* runtime, const InterpreterOptions& options = InterpreterOptions{})
+    -> std::unique_ptr<Interpreter>;
 
   virtual ~Interpreter() = default;
 
-  virtual void exec(const ast::Module& m) = 0;
+  /// @brief Executes a module, using the default values of its inputs.
+  void exec(const ast::Module& m) { exec(m, nullptr); }
+
+  /// @brief Executes a module.
+  ///
+  /// @param inputs The values of the module inputs, indexed by slot. If this is null, the default values are used.
+  ///
+  /// @note The storage for computed values is kept between calls, so that executing modules repeatedly does not
+  ///       allocate memory once the storage has grown large enough.
+  virtual void exec(const ast::Module& m, const ast::Scalar* inputs) = 0;
+
+  /// @brief Executes a module once for each row of inputs.
+  ///
+  /// @param rows The values of the module inputs, with the inputs of each row being contiguous. That is, the input in
+  ///             slot S of row R is at `rows[R * m.inputs.size() + S]`. If this is null, each row uses the default
+  ///             values of the inputs.
+  ///
+  /// @note The output of each row is printed before that of the next row, as if the module was executed row by row.
+  virtual void exec_batch(const ast::Module& m, const ast::Scalar* rows, size_t num_rows);
 };
 
 } // namespace nabla
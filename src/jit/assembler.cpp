@@ -0,0 +1,221 @@
+#include "assembler.h"
+
+namespace nabla::jit {
+
+namespace {
+
+[[nodiscard]] auto
+num(const Reg reg) -> uint8_t
+{
+  return static_cast<uint8_t>(reg);
+}
+
+[[nodiscard]] auto
+num(const XmmReg reg) -> uint8_t
+{
+  return static_cast<uint8_t>(reg);
+}
+
+} // namespace
+
+void
+Assembler::push(const Reg reg)
+{
+  rex(false, 0, num(reg));
+  emit(0x50 + (num(reg) & 7));
+}
+
+void
+Assembler::pop(const Reg reg)
+{
+  rex(false, 0, num(reg));
+  emit(0x58 + (num(reg) & 7));
+}
+
+void
+Assembler::ret()
+{
+  emit(0xc3);
+}
+
+void
+Assembler::mov64(const Reg dst, const Reg src)
+{
+  rex(true, num(dst), num(src));
+  emit(0x8b);
+  modrm_reg(num(dst), num(src));
+}
+
+void
+Assembler::mov64(const Reg dst, const uint64_t imm)
+{
+  rex(true, 0, num(dst));
+  emit(0xb8 + (num(dst) & 7));
+  emit64(imm);
+}
+
+void
+Assembler::call(const Reg reg)
+{
+  rex(false, 0, num(reg));
+  emit(0xff);
+  modrm_reg(2, num(reg));
+}
+
+void
+Assembler::mov32(const Reg dst, const Reg src)
+{
+  rex(false, num(dst), num(src));
+  emit(0x8b);
+  modrm_reg(num(dst), num(src));
+}
+
+void
+Assembler::load32(const Reg dst, const Reg base, const int32_t disp)
+{
+  rex(false, num(dst), num(base));
+  emit(0x8b);
+  modrm_mem(num(dst), num(base), disp);
+}
+
+void
+Assembler::store32(const Reg base, const int32_t disp, const Reg src)
+{
+  rex(false, num(src), num(base));
+  emit(0x89);
+  modrm_mem(num(src), num(base), disp);
+}
+
+void
+Assembler::store32(const Reg base, const int32_t disp, const uint32_t imm)
+{
+  rex(false, 0, num(base));
+  emit(0xc7);
+  modrm_mem(0, num(base), disp);
+  emit32(imm);
+}
+
+void
+Assembler::add32(const Reg dst, const Reg src)
+{
+  rex(false, num(dst), num(src));
+  emit(0x03);
+  modrm_reg(num(dst), num(src));
+}
+
+void
+Assembler::imul32(const Reg dst, const Reg src)
+{
+  rex(false, num(dst), num(src));
+  emit(0x0f);
+  emit(0xaf);
+  modrm_reg(num(dst), num(src));
+}
+
+void
+Assembler::movss(const XmmReg dst, const XmmReg src)
+{
+  sse_reg(0x10, num(dst), num(src));
+}
+
+void
+Assembler::load_ss(const XmmReg dst, const Reg base, const int32_t disp)
+{
+  sse_mem(0x10, num(dst), num(base), disp);
+}
+
+void
+Assembler::store_ss(const Reg base, const int32_t disp, const XmmReg src)
+{
+  sse_mem(0x11, num(src), num(base), disp);
+}
+
+void
+Assembler::addss(const XmmReg dst, const XmmReg src)
+{
+  sse_reg(0x58, num(dst), num(src));
+}
+
+void
+Assembler::mulss(const XmmReg dst, const XmmReg src)
+{
+  sse_reg(0x59, num(dst), num(src));
+}
+
+void
+Assembler::vfmadd231ss(const XmmReg dst, const XmmReg a, const XmmReg b)
+{
+  // VEX.LIG.66.0F38.W0 B9 /r
+  const auto d = num(dst);
+  const auto v = num(a);
+  const auto r = num(b);
+  emit(0xc4);
+  emit(static_cast<uint8_t>(((d & 8) ? 0 : 0x80) | 0x40 | ((r & 8) ? 0 : 0x20) | 0x02));
+  emit(static_cast<uint8_t>(((~v & 15) << 3) | 0x01));
+  emit(0xb9);
+  modrm_reg(d, r);
+}
+
+void
+Assembler::emit32(const uint32_t value)
+{
+  for (int i = 0; i < 4; i++) {
+    emit(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+void
+Assembler::emit64(const uint64_t value)
+{
+  for (int i = 0; i < 8; i++) {
+    emit(static_cast<uint8_t>(value >> (i * 8)));
+  }
+}
+
+void
+Assembler::rex(const bool w, const uint8_t reg, const uint8_t rm)
+{
+  const uint8_t prefix = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+  if (prefix != 0x40) {
+    emit(prefix);
+  }
+}
+
+void
+Assembler::modrm_reg(const uint8_t reg, const uint8_t rm)
+{
+  emit(static_cast<uint8_t>(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+void
+Assembler::modrm_mem(const uint8_t reg, const uint8_t base, const int32_t disp)
+{
+  emit(static_cast<uint8_t>(0x80 | ((reg & 7) << 3) | (base & 7)));
+  if ((base & 7) == 4) {
+    // rsp and r12 can only be used as a base through a SIB byte.
+    emit(0x24);
+  }
+  emit32(static_cast<uint32_t>(disp));
+}
+
+void
+Assembler::sse_reg(const uint8_t op, const uint8_t dst, const uint8_t src)
+{
+  emit(0xf3);
+  rex(false, dst, src);
+  emit(0x0f);
+  emit(op);
+  modrm_reg(dst, src);
+}
+
+void
+Assembler::sse_mem(const uint8_t op, const uint8_t reg, const uint8_t base, const int32_t disp)
+{
+  emit(0xf3);
+  rex(false, reg, base);
+  emit(0x0f);
+  emit(op);
+  modrm_mem(reg, base, disp);
+}
+
+} // namespace nabla::jit
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla::jit {
+
+enum class Reg : uint8_t
+{
+  rax,
+  rcx,
+  rdx,
+  rbx,
+  rsp,
+  rbp,
+  rsi,
+  rdi,
+  r8,
+  r9,
+  r10,
+  r11,
+  r12,
+  r13,
+  r14,
+  r15
+};
+
+enum class XmmReg : uint8_t
+{
+  xmm0,
+  xmm1,
+  xmm2,
+  xmm3,
+  xmm4,
+  xmm5,
+  xmm6,
+  xmm7,
+  xmm8,
+  xmm9,
+  xmm10,
+  xmm11,
+  xmm12,
+  xmm13,
+  xmm14,
+  xmm15
+};
+
+/// @brief Encodes the small subset of x86-64 instructions used by the JIT compiler.
+///
+/// @details Memory operands are always of the form [base + disp32]. Integer operations are 32-bit, since the only
+///          integer type in the language is a 32-bit int.
+class Assembler final
+{
+  std::vector<uint8_t> code_;
+
+public:
+  [[nodiscard]] auto code() const -> const std::vector<uint8_t>& { return code_; }
+
+  [[nodiscard]] auto size() const -> size_t { return code_.size(); }
+
+  void push(Reg reg);
+
+  void pop(Reg reg);
+
+  void ret();
+
+  /// @brief mov dst, src (64-bit)
+  void mov64(Reg dst, Reg src);
+
+  /// @brief movabs dst, imm64
+  void mov64(Reg dst, uint64_t imm);
+
+  /// @brief call reg
+  void call(Reg reg);
+
+  /// @brief mov dst, src (32-bit)
+  void mov32(Reg dst, Reg src);
+
+  /// @brief mov dst, [base + disp]
+  void load32(Reg dst, Reg base, int32_t disp);
+
+  /// @brief mov [base + disp], src
+  void store32(Reg base, int32_t disp, Reg src);
+
+  /// @brief mov dword [base + disp], imm
+  void store32(Reg base, int32_t disp, uint32_t imm);
+
+  /// @brief add dst, src (32-bit)
+  void add32(Reg dst, Reg src);
+
+  /// @brief imul dst, src (32-bit)
+  void imul32(Reg dst, Reg src);
+
+  /// @brief movss dst, src
+  void movss(XmmReg dst, XmmReg src);
+
+  /// @brief movss dst, [base + disp]
+  void load_ss(XmmReg dst, Reg base, int32_t disp);
+
+  /// @brief movss [base + disp], src
+  void store_ss(Reg base, int32_t disp, XmmReg src);
+
+  /// @brief addss dst, src
+  void addss(XmmReg dst, XmmReg src);
+
+  /// @brief mulss dst, src
+  void mulss(XmmReg dst, XmmReg src);
+
+  /// @brief vfmadd231ss dst, a, b (dst = a * b + dst, with a single rounding)
+  ///
+  /// @note This requires a CPU with FMA3 support.
+  void vfmadd231ss(XmmReg dst, XmmReg a, XmmReg b);
+
+protected:
+  void emit(uint8_t byte) { code_.emplace_back(byte); }
+
+  void emit32(uint32_t value);
+
+  void emit64(uint64_t value);
+
+  /// @brief Emits a REX prefix, if one is needed.
+  void rex(bool w, uint8_t reg, uint8_t rm);
+
+  /// @brief Emits a ModRM byte for a register-to-register operation.
+  void modrm_reg(uint8_t reg, uint8_t rm);
+
+  /// @brief Emits a ModRM byte (and SIB byte, if needed) for a [base + disp32] operand.
+  void modrm_mem(uint8_t reg, uint8_t base, int32_t disp);
+
+  /// @brief Emits an SSE scalar single instruction (F3 0F op) on two registers.
+  void sse_reg(uint8_t op, uint8_t dst, uint8_t src);
+
+  /// @brief Emits an SSE scalar single instruction (F3 0F op) with a memory operand.
+  void sse_mem(uint8_t op, uint8_t reg, uint8_t base, int32_t disp);
+};
+
+} // namespace nabla::jit
@@ -0,0 +1,693 @@
+#include "compiler.h"
+
+#include "../interpreter.h"
+#include "assembler.h"
+
+#include <array>
+#include <limits>
+#include <vector>
+
+#include <string.h>
+
+namespace nabla::jit {
+
+namespace {
+
+void
+print_int(Runtime* runtime, const int value)
+{
+  runtime->print(value);
+}
+
+void
+print_float(Runtime* runtime, const float value)
+{
+  runtime->print(value);
+}
+
+void
+print_string(Runtime* runtime, const std::string* value)
+{
+  runtime->print(*value);
+}
+
+void
+print_end(Runtime* runtime)
+{
+  runtime->print_end();
+}
+
+// The arguments of the entry point are moved into callee-saved registers in the prologue.
+
+constexpr Reg runtime_reg = Reg::rbx;
+
+constexpr Reg inputs_reg = Reg::r12;
+
+constexpr Reg values_reg = Reg::r13;
+
+/// @brief The registers that values may be allocated to. These are all caller-saved, since values are spilled before
+///        calling into the runtime anyway.
+constexpr std::array<Reg, 9> int_regs{ Reg::rax, Reg::rcx, Reg::rdx, Reg::rsi, Reg::rdi,
+                                       Reg::r8,  Reg::r9,  Reg::r10, Reg::r11 };
+
+constexpr std::array<XmmReg, 16> float_regs{ XmmReg::xmm0,  XmmReg::xmm1,  XmmReg::xmm2,  XmmReg::xmm3,
+                                             XmmReg::xmm4,  XmmReg::xmm5,  XmmReg::xmm6,  XmmReg::xmm7,
+                                             XmmReg::xmm8,  XmmReg::xmm9,  XmmReg::xmm10, XmmReg::xmm11,
+                                             XmmReg::xmm12, XmmReg::xmm13, XmmReg::xmm14, XmmReg::xmm15 };
+
+constexpr size_t no_value = std::numeric_limits<size_t>::max();
+
+enum class Kind
+{
+  int_,
+  float_,
+  string
+};
+
+struct ValueInfo final
+{
+  Kind kind{ Kind::int_ };
+
+  /// @brief The index of the last statement that reads the value.
+  size_t last_use{ 0 };
+
+  /// @brief The index of the register holding the value, or -1 if it is not in a register.
+  int reg{ -1 };
+
+  /// @brief Whether the home slot of the value holds its current value.
+  bool in_memory{ false };
+
+  /// @brief For string values, the literal that the value refers to.
+  const std::string* string{ nullptr };
+};
+
+/// @brief Finds the kind and last use of each value, and whether the module can be compiled at all.
+class Analyzer final
+  : public ast::StmtVisitor
+  , public ast::ExprVisitor
+{
+  std::vector<ValueInfo>* values_;
+
+  size_t stmt_index_{ 0 };
+
+  size_t id_{ 0 };
+
+  bool supported_{ true };
+
+  bool has_fma_{ false };
+
+public:
+  explicit Analyzer(std::vector<ValueInfo>* values)
+    : values_(values)
+  {
+    __builtin_cpu_init();
+    has_fma_ = __builtin_cpu_supports("fma");
+  }
+
+  [[nodiscard]] auto supported() const -> bool { return supported_; }
+
+  void analyze(const ast::Stmt& stmt, const size_t index)
+  {
+    stmt_index_ = index;
+    stmt.accept(*this);
+  }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    id_ = stmt.id();
+    if (values_->size() <= id_) {
+      values_->resize(id_ + 1);
+    }
+    values_->at(id_).last_use = stmt_index_;
+    stmt.value().accept(*this);
+  }
+
+  void visit(const ast::PrintStmt& stmt) override { use(stmt.id()); }
+
+  void visit(const ast::PrintEndStmt&) override {}
+
+  void visit(const ast::LiteralExpr<int>&) override { define(Kind::int_); }
+
+  void visit(const ast::LiteralExpr<float>&) override { define(Kind::float_); }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override
+  {
+    define(Kind::string);
+    values_->at(id_).string = &expr.value();
+  }
+
+  void visit(const ast::AddExpr<int>& expr) override { define_binary(Kind::int_, expr); }
+
+  void visit(const ast::AddExpr<float>& expr) override { define_binary(Kind::float_, expr); }
+
+  void visit(const ast::AddExpr<std::string>&) override { supported_ = false; }
+
+  void visit(const ast::MulExpr<int, int>& expr) override { define_binary(Kind::int_, expr); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { define_binary(Kind::float_, expr); }
+
+  void visit(const ast::MulAddExpr<int>& expr) override { define_mul_add(Kind::int_, expr); }
+
+  void visit(const ast::MulAddExpr<float>& expr) override
+  {
+    if (expr.fused() && !has_fma_) {
+      supported_ = false;
+    }
+    define_mul_add(Kind::float_, expr);
+  }
+
+  void visit(const ast::InputExpr<int>&) override { define(Kind::int_); }
+
+  void visit(const ast::InputExpr<float>&) override { define(Kind::float_); }
+
+protected:
+  void define(const Kind kind) { values_->at(id_).kind = kind; }
+
+  template<typename Derived>
+  void define_binary(const Kind kind, const ast::BinaryExpr<Derived>& expr)
+  {
+    define(kind);
+    use(expr.left());
+    use(expr.right());
+  }
+
+  template<typename T>
+  void define_mul_add(const Kind kind, const ast::MulAddExpr<T>& expr)
+  {
+    define(kind);
+    use(expr.a());
+    use(expr.b());
+    use(expr.c());
+  }
+
+  void use(const size_t id) { values_->at(id).last_use = stmt_index_; }
+};
+
+class Emitter final
+  : public ast::StmtVisitor
+  , public ast::ExprVisitor
+{
+  Assembler assembler_;
+
+  std::vector<ValueInfo>* values_;
+
+  std::array<size_t, int_regs.size()> int_owners_;
+
+  std::array<size_t, float_regs.size()> float_owners_;
+
+  /// @brief The registers that may not be evicted while emitting the current statement, as a bit mask.
+  uint32_t pinned_{ 0 };
+
+  size_t stmt_index_{ 0 };
+
+  size_t id_{ 0 };
+
+public:
+  explicit Emitter(std::vector<ValueInfo>* values)
+    : values_(values)
+  {
+    int_owners_.fill(no_value);
+    float_owners_.fill(no_value);
+  }
+
+  [[nodiscard]] auto assembler() const -> const Assembler& { return assembler_; }
+
+  void prologue()
+  {
+    // Three pushes realign the stack to 16 bytes, as required for calls.
+    assembler_.push(runtime_reg);
+    assembler_.push(inputs_reg);
+    assembler_.push(values_reg);
+    assembler_.mov64(runtime_reg, Reg::rdi);
+    assembler_.mov64(inputs_reg, Reg::rsi);
+    assembler_.mov64(values_reg, Reg::rdx);
+  }
+
+  void epilogue()
+  {
+    assembler_.pop(values_reg);
+    assembler_.pop(inputs_reg);
+    assembler_.pop(runtime_reg);
+    assembler_.ret();
+  }
+
+  void emit(const ast::Stmt& stmt, const size_t index)
+  {
+    stmt_index_ = index;
+    pinned_ = 0;
+    stmt.accept(*this);
+    release_dead_values();
+  }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    id_ = stmt.id();
+    stmt.value().accept(*this);
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    // The argument is put in a register before spilling, since spilling only stores registers and leaves them intact.
+    switch (values_->at(stmt.id()).kind) {
+      case Kind::int_: {
+        const auto src = use_int(stmt.id());
+        spill_all();
+        assembler_.mov32(Reg::rsi, src);
+        call(reinterpret_cast<uint64_t>(&print_int));
+      } break;
+      case Kind::float_: {
+        const auto src = use_float(stmt.id());
+        spill_all();
+        assembler_.movss(XmmReg::xmm0, src);
+        call(reinterpret_cast<uint64_t>(&print_float));
+      } break;
+      case Kind::string:
+        spill_all();
+        assembler_.mov64(Reg::rsi, reinterpret_cast<uint64_t>(values_->at(stmt.id()).string));
+        call(reinterpret_cast<uint64_t>(&print_string));
+        break;
+    }
+  }
+
+  void visit(const ast::PrintEndStmt&) override
+  {
+    spill_all();
+    call(reinterpret_cast<uint64_t>(&print_end));
+  }
+
+  void visit(const ast::LiteralExpr<int>& expr) override
+  {
+    assembler_.store32(values_reg, disp(id_), static_cast<uint32_t>(expr.value()));
+    values_->at(id_).in_memory = true;
+  }
+
+  void visit(const ast::LiteralExpr<float>& expr) override
+  {
+    uint32_t bits{ 0 };
+    const auto value = expr.value();
+    memcpy(&bits, &value, sizeof(bits));
+    assembler_.store32(values_reg, disp(id_), bits);
+    values_->at(id_).in_memory = true;
+  }
+
+  void visit(const ast::LiteralExpr<std::string>&) override {}
+
+  void visit(const ast::AddExpr<int>& expr) override
+  {
+    const auto [dst, src] = binary_int(expr.left(), expr.right());
+    assembler_.add32(dst, src);
+  }
+
+  void visit(const ast::AddExpr<float>& expr) override
+  {
+    const auto [dst, src] = binary_float(expr.left(), expr.right());
+    assembler_.addss(dst, src);
+  }
+
+  void visit(const ast::AddExpr<std::string>&) override {}
+
+  void visit(const ast::MulExpr<int, int>& expr) override
+  {
+    const auto [dst, src] = binary_int(expr.left(), expr.right());
+    assembler_.imul32(dst, src);
+  }
+
+  void visit(const ast::MulExpr<float, float>& expr) override
+  {
+    const auto [dst, src] = binary_float(expr.left(), expr.right());
+    assembler_.mulss(dst, src);
+  }
+
+  void visit(const ast::MulAddExpr<int>& expr) override
+  {
+    // The addend is loaded first, so that it is not clobbered by the product.
+    const auto c = use_int(expr.c());
+    const auto [dst, src] = binary_int(expr.a(), expr.b(), expr.c());
+    assembler_.imul32(dst, src);
+    assembler_.add32(dst, c);
+  }
+
+  void visit(const ast::MulAddExpr<float>& expr) override
+  {
+    if (!expr.fused()) {
+      const auto c = use_float(expr.c());
+      const auto [dst, src] = binary_float(expr.a(), expr.b(), expr.c());
+      assembler_.mulss(dst, src);
+      assembler_.addss(dst, c);
+      return;
+    }
+
+    const auto a = use_float(expr.a());
+    const auto b = use_float(expr.b());
+    const auto c = use_float(expr.c());
+
+    XmmReg dst{ XmmReg::xmm0 };
+
+    if (dies_here(expr.c()) && (expr.c() != expr.a()) && (expr.c() != expr.b())) {
+      dst = take_float(expr.c());
+    } else {
+      dst = alloc_float();
+      assembler_.movss(dst, c);
+    }
+
+    assembler_.vfmadd231ss(dst, a, b);
+
+    define_float(dst);
+  }
+
+  void visit(const ast::InputExpr<int>& expr) override
+  {
+    const auto dst = alloc_int();
+    assembler_.load32(dst, inputs_reg, disp(expr.slot()));
+    define_int(dst);
+  }
+
+  void visit(const ast::InputExpr<float>& expr) override
+  {
+    const auto dst = alloc_float();
+    assembler_.load_ss(dst, inputs_reg, disp(expr.slot()));
+    define_float(dst);
+  }
+
+protected:
+  [[nodiscard]] static auto disp(const size_t index) -> int32_t
+  {
+    return static_cast<int32_t>(index * sizeof(ast::Scalar));
+  }
+
+  void call(const uint64_t function)
+  {
+    assembler_.mov64(Reg::rdi, runtime_reg);
+    assembler_.mov64(Reg::rax, function);
+    assembler_.call(Reg::rax);
+  }
+
+  [[nodiscard]] auto dies_here(const size_t id) const -> bool { return values_->at(id).last_use <= stmt_index_; }
+
+  /// @brief Loads the operands of a binary operation and picks the register that the result is computed into.
+  ///
+  /// @param keep A value that must not be overwritten by the result, because it is read afterwards.
+  ///
+  /// @return The destination register, which holds the left operand, and the register holding the right operand.
+  [[nodiscard]] auto binary_int(const size_t l, const size_t r, const size_t keep = no_value) -> std::pair<Reg, Reg>
+  {
+    const auto lr = use_int(l);
+    const auto rr = use_int(r);
+
+    // Both operations are commutative, so the operands may be swapped in order to reuse the register of either one.
+    if (dies_here(l) && (l != keep)) {
+      return { take_int(l), rr };
+    }
+    if (dies_here(r) && (r != keep) && (r != l)) {
+      return { take_int(r), lr };
+    }
+
+    const auto dst = alloc_int();
+    assembler_.mov32(dst, lr);
+    define_int(dst);
+    return { dst, rr };
+  }
+
+  [[nodiscard]] auto binary_float(const size_t l, const size_t r, const size_t keep = no_value)
+    -> std::pair<XmmReg, XmmReg>
+  {
+    const auto lr = use_float(l);
+    const auto rr = use_float(r);
+
+    if (dies_here(l) && (l != keep)) {
+      const auto dst = take_float(l);
+      define_float(dst);
+      return { dst, rr };
+    }
+    if (dies_here(r) && (r != keep) && (r != l)) {
+      const auto dst = take_float(r);
+      define_float(dst);
+      return { dst, lr };
+    }
+
+    const auto dst = alloc_float();
+    assembler_.movss(dst, lr);
+    define_float(dst);
+    return { dst, rr };
+  }
+
+  /// @brief Makes sure that a value is in a register, loading it from memory if needed.
+  [[nodiscard]] auto use_int(const size_t id) -> Reg
+  {
+    auto& value = values_->at(id);
+    if (value.reg < 0) {
+      const auto reg = alloc_int();
+      assembler_.load32(reg, values_reg, disp(id));
+      assign(int_owners_, id, reg_index(reg));
+    }
+    pinned_ |= 1U << value.reg;
+    return int_regs[value.reg];
+  }
+
+  [[nodiscard]] auto use_float(const size_t id) -> XmmReg
+  {
+    auto& value = values_->at(id);
+    if (value.reg < 0) {
+      const auto reg = alloc_float();
+      assembler_.load_ss(reg, values_reg, disp(id));
+      assign(float_owners_, id, reg_index(reg));
+    }
+    pinned_ |= 1U << (16 + value.reg);
+    return float_regs[value.reg];
+  }
+
+  /// @brief Takes over the register of a value that is no longer needed, so that the result can be computed into it.
+  [[nodiscard]] auto take_int(const size_t id) -> Reg
+  {
+    auto& value = values_->at(id);
+    const auto index = value.reg;
+    int_owners_[index] = no_value;
+    value.reg = -1;
+    define_int_at(index);
+    return int_regs[index];
+  }
+
+  [[nodiscard]] auto take_float(const size_t id) -> XmmReg
+  {
+    auto& value = values_->at(id);
+    const auto index = value.reg;
+    float_owners_[index] = no_value;
+    value.reg = -1;
+    return float_regs[index];
+  }
+
+  void define_int(const Reg reg) { define_int_at(reg_index(reg)); }
+
+  void define_int_at(const int index)
+  {
+    assign(int_owners_, id_, index);
+    pinned_ |= 1U << index;
+  }
+
+  void define_float(const XmmReg reg)
+  {
+    const auto index = reg_index(reg);
+    assign(float_owners_, id_, index);
+    pinned_ |= 1U << (16 + index);
+  }
+
+  template<size_t N>
+  void assign(std::array<size_t, N>& owners, const size_t id, const int index)
+  {
+    owners[index] = id;
+    auto& value = values_->at(id);
+    value.reg = index;
+  }
+
+  [[nodiscard]] static auto reg_index(const Reg reg) -> int
+  {
+    for (size_t i = 0; i < int_regs.size(); i++) {
+      if (int_regs[i] == reg) {
+        return static_cast<int>(i);
+      }
+    }
+    return -1;
+  }
+
+  [[nodiscard]] static auto reg_index(const XmmReg reg) -> int { return static_cast<int>(reg); }
+
+  [[nodiscard]] auto alloc_int() -> Reg { return int_regs[alloc(int_owners_, 0)]; }
+
+  [[nodiscard]] auto alloc_float() -> XmmReg { return float_regs[alloc(float_owners_, 16)]; }
+
+  /// @brief Finds a free register, evicting the value whose last use is furthest away if there is none.
+  template<size_t N>
+  [[nodiscard]] auto alloc(std::array<size_t, N>& owners, const int pin_shift) -> size_t
+  {
+    size_t victim = N;
+
+    for (size_t i = 0; i < N; i++) {
+      if (pinned_ & (1U << (pin_shift + i))) {
+        continue;
+      }
+      if (owners[i] == no_value) {
+        return i;
+      }
+      if ((victim == N) || (values_->at(owners[i]).last_use > values_->at(owners[victim]).last_use)) {
+        victim = i;
+      }
+    }
+
+    spill(owners[victim]);
+
+    return victim;
+  }
+
+  /// @brief Writes a value to its home slot if needed, and frees its register.
+  void spill(const size_t id)
+  {
+    auto& value = values_->at(id);
+
+    if (!value.in_memory && (value.last_use > stmt_index_)) {
+      if (value.kind == Kind::int_) {
+        assembler_.store32(values_reg, disp(id), int_regs[value.reg]);
+      } else {
+        assembler_.store_ss(values_reg, disp(id), float_regs[value.reg]);
+      }
+      value.in_memory = true;
+    }
+
+    free_reg(id);
+  }
+
+  void free_reg(const size_t id)
+  {
+    auto& value = values_->at(id);
+    if (value.reg < 0) {
+      return;
+    }
+    if (value.kind == Kind::int_) {
+      int_owners_[value.reg] = no_value;
+    } else {
+      float_owners_[value.reg] = no_value;
+    }
+    value.reg = -1;
+  }
+
+  /// @brief Spills every value that is held in a register, since all of them are clobbered by calls.
+  void spill_all()
+  {
+    for (const auto id : int_owners_) {
+      if (id != no_value) {
+        spill(id);
+      }
+    }
+
+    for (const auto id : float_owners_) {
+      if (id != no_value) {
+        spill(id);
+      }
+    }
+  }
+
+  void release_dead_values()
+  {
+    for (const auto id : int_owners_) {
+      if ((id != no_value) && dies_here(id)) {
+        free_reg(id);
+      }
+    }
+
+    for (const auto id : float_owners_) {
+      if ((id != no_value) && dies_here(id)) {
+        free_reg(id);
+      }
+    }
+  }
+};
+
+/// @brief Splits the code into ranges, starting a new range whenever the source line changes.
+class RangeRecorder final
+{
+  const Assembler* assembler_;
+
+  std::vector<CodeRange>* ranges_;
+
+public:
+  RangeRecorder(const Assembler* assembler, std::vector<CodeRange>* ranges)
+    : assembler_(assembler)
+    , ranges_(ranges)
+  {
+    ranges_->emplace_back();
+  }
+
+  void begin(const ast::SourceLocation& location)
+  {
+    if (ranges_->back().location.line == location.line) {
+      return;
+    }
+
+    finish();
+
+    // Statements that generate no code, such as string literals, leave empty ranges behind.
+    if (ranges_->back().size == 0) {
+      ranges_->pop_back();
+    }
+
+    ranges_->emplace_back(CodeRange{ assembler_->size(), 0, location });
+  }
+
+  void finish()
+  {
+    auto& range = ranges_->back();
+    range.size = assembler_->size() - range.offset;
+  }
+};
+
+} // namespace
+
+auto
+compile(const ast::Module& m) -> std::unique_ptr<CompiledCode>
+{
+  std::vector<ValueInfo> values;
+
+  Analyzer analyzer(&values);
+
+  for (size_t i = 0; i < m.stmts.size(); i++) {
+    analyzer.analyze(*m.stmts[i], i);
+  }
+
+  const auto max_values = static_cast<size_t>(std::numeric_limits<int32_t>::max()) / sizeof(ast::Scalar);
+
+  if (!analyzer.supported() || (values.size() > max_values) || (m.inputs.size() > max_values)) {
+    return nullptr;
+  }
+
+  auto code = std::make_unique<CompiledCode>();
+
+  code->num_values = values.size();
+
+  code->filename = m.filename;
+
+  Emitter emitter(&values);
+
+  RangeRecorder ranges(&emitter.assembler(), &code->ranges);
+
+  emitter.prologue();
+
+  for (size_t i = 0; i < m.stmts.size(); i++) {
+    ranges.begin(m.stmts[i]->location());
+    emitter.emit(*m.stmts[i], i);
+  }
+
+  ranges.begin(ast::SourceLocation{});
+
+  emitter.epilogue();
+
+  ranges.finish();
+
+  const auto& bytes = emitter.assembler().code();
+
+  if (!code->memory.load(bytes.data(), bytes.size())) {
+    return nullptr;
+  }
+
+  return code;
+}
+
+} // namespace nabla::jit
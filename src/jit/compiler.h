@@ -0,0 +1,68 @@
+#pragma once
+
+#include "../ast.h"
+#include "executable_memory.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class Runtime;
+
+} // namespace nabla
+
+namespace nabla::jit {
+
+/// @brief The signature of the machine code compiled from a module.
+///
+/// @param inputs The values of the module inputs, indexed by slot.
+/// @param values The storage for the computed values. It must have room for @ref CompiledCode::num_values elements.
+using EntryPoint = void (*)(Runtime* runtime, const ast::Scalar* inputs, ast::Scalar* values);
+
+/// @brief A range of machine code generated for consecutive statements on the same source line.
+struct CodeRange final
+{
+  /// @brief The offset of the range from the start of the code.
+  size_t offset{ 0 };
+
+  size_t size{ 0 };
+
+  /// @brief The location of the first statement in the range. The prologue and epilogue have no location.
+  ast::SourceLocation location;
+};
+
+/// @brief Machine code compiled from a module.
+struct CompiledCode final
+{
+  ExecutableMemory memory;
+
+  /// @brief The number of values that the code needs storage for.
+  size_t num_values{ 0 };
+
+  /// @brief The file that the module was built from.
+  std::string filename;
+
+  /// @brief Covers the code from start to end, in order.
+  std::vector<CodeRange> ranges;
+
+  [[nodiscard]] auto entry() const -> EntryPoint { return reinterpret_cast<EntryPoint>(memory.data()); }
+};
+
+/// @brief Compiles a module to x86-64 machine code.
+///
+/// @details Each value has a home slot in the value storage, but values are kept in registers for as long as possible.
+///          Registers are allocated greedily in statement order and freed after the last use of a value. When no
+///          register is free, the value whose last use is furthest away is spilled. Printing is done by calling into
+///          the runtime, so all live values are spilled before each print.
+///
+/// @note The generated code has no unwind information, so the runtime must not throw exceptions while printing.
+///
+/// @return Null if the module uses something that cannot be compiled, in which case it has to be interpreted.
+[[nodiscard]] auto
+compile(const ast::Module& m) -> std::unique_ptr<CompiledCode>;
+
+} // namespace nabla::jit
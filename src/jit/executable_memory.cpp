@@ -0,0 +1,45 @@
+#include "executable_memory.h"
+
+#include <string.h>
+#include <sys/mman.h>
+
+namespace nabla::jit {
+
+ExecutableMemory::~ExecutableMemory()
+{
+  release();
+}
+
+auto
+ExecutableMemory::load(const uint8_t* code, const size_t size) -> bool
+{
+  release();
+
+  auto* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  memcpy(data, code, size);
+
+  if (mprotect(data, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(data, size);
+    return false;
+  }
+
+  data_ = data;
+  size_ = size;
+  return true;
+}
+
+void
+ExecutableMemory::release()
+{
+  if (data_) {
+    munmap(data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+} // namespace nabla::jit
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla::jit {
+
+/// @brief A block of memory that machine code can be executed from.
+///
+/// @details The memory is mapped as writable while the code is copied into it, and is then remapped as read-only and
+///          executable, so that it is never writable and executable at the same time.
+class ExecutableMemory final
+{
+  void* data_{ nullptr };
+
+  size_t size_{ 0 };
+
+public:
+  ExecutableMemory() = default;
+
+  ExecutableMemory(const ExecutableMemory&) = delete;
+
+  auto operator=(const ExecutableMemory&) -> ExecutableMemory& = delete;
+
+  ~ExecutableMemory();
+
+  /// @brief Replaces the contents of the memory with the given code.
+  ///
+  /// @return False if the memory could not be mapped.
+  [[nodiscard]] auto load(const uint8_t* code, size_t size) -> bool;
+
+  [[nodiscard]] auto data() const -> const void* { return data_; }
+
+  [[nodiscard]] auto size() const -> size_t { return size_; }
+
+protected:
+  void release();
+};
+
+} // namespace nabla::jit
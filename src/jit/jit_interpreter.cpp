@@ -0,0 +1,93 @@
+#include "jit_interpreter.h"
+
+#include "compiler.h"
+#include "perf_support.h"
+
+#include <vector>
+
+namespace nabla::jit {
+
+namespace {
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+class JitInterpreter final : public Interpreter
+{
+  Runtime* runtime_;
+
+  InterpreterOptions options_;
+
+  std::unique_ptr<Interpreter> fallback_;
+
+  /// @brief The generation of the module that the code was compiled from, or zero if nothing was compiled yet.
+  uint64_t generation_{ 0 };
+
+  std::unique_ptr<CompiledCode> code_;
+
+  std::vector<ast::Scalar> default_inputs_;
+
+  std::vector<ast::Scalar> values_;
+
+public:
+  JitInterpreter(Runtime* runtime, const InterpreterOptions& options)
+    : runtime_(runtime)
+    , options_(options)
+    , fallback_(Interpreter::create(runtime))
+  {
+  }
+
+  void exec(const ast::Module& m, const ast::Scalar* inputs) override
+  {
+    if (generation_ != m.generation.value()) {
+      prepare(m);
+    }
+
+    if (!code_) {
+      fallback_->exec(m, inputs);
+      return;
+    }
+
+    values_.resize(code_->num_values);
+
+    code_->entry()(runtime_, inputs ? inputs : default_inputs_.data(), values_.data());
+  }
+
+protected:
+  void prepare(const ast::Module& m)
+  {
+    generation_ = m.generation.value();
+
+    code_ = compile(m);
+
+    if (code_ && options_.perf_map) {
+      write_perf_map(*code_);
+    }
+
+    if (code_ && options_.jitdump) {
+      write_jitdump(*code_);
+    }
+
+    default_inputs_.clear();
+
+    for (const auto& input : m.inputs) {
+      default_inputs_.emplace_back(input.default_value);
+    }
+  }
+};
+
+#endif
+
+} // namespace
+
+auto
+create_interpreter(Runtime* runtime, const InterpreterOptions& options) -> std::unique_ptr<Interpreter>
+{
+#if defined(__x86_64__) && !defined(_WIN32)
+  return std::make_unique<JitInterpreter>(runtime, options);
+#else
+  (void)options;
+  return Interpreter::create(runtime);
+#endif
+}
+
+} // namespace nabla::jit
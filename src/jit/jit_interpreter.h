@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../interpreter.h"
+
+#include <memory>
+
+namespace nabla::jit {
+
+/// @brief Creates an interpreter that compiles modules to machine code before executing them.
+///
+/// @details The code for the most recently executed module is cached, so executing the same module repeatedly only
+///          compiles it once. The cache is keyed on the generation of the module, so a module that passes have run on,
+///          or another module built at the same address, is compiled again. Modules that cannot be compiled are
+///          interpreted instead.
+///
+/// @note On targets other than x86-64, this always returns the regular interpreter.
+[[nodiscard]] auto
+create_interpreter(Runtime* runtime, const InterpreterOptions& options) -> std::unique_ptr<Interpreter>;
+
+} // namespace nabla::jit
@@ -0,0 +1,244 @@
+#include "perf_support.h"
+
+#include "compiler.h"
+
+#include <mutex>
+#include <string>
+
+#include <elf.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace nabla::jit {
+
+namespace {
+
+[[nodiscard]] auto
+symbol_name(const CompiledCode& code, const CodeRange& range) -> std::string
+{
+  auto name = "nabla:" + code.filename;
+  if (range.location.line > 0) {
+    name += ':' + std::to_string(range.location.line);
+  }
+  return name;
+}
+
+/// @brief Serializes the writers, since every execution context on every thread writes to the same files.
+std::mutex file_mutex;
+
+// See tools/perf/Documentation/jitdump-specification.txt in the Linux source tree.
+
+constexpr uint32_t jitdump_magic = 0x4A695444;
+
+constexpr uint32_t jitdump_version = 1;
+
+enum RecordType : uint32_t
+{
+  jit_code_load = 0,
+  jit_code_debug_info = 2
+};
+
+struct FileHeader final
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t total_size;
+  uint32_t elf_mach;
+  uint32_t pad1;
+  uint32_t pid;
+  uint64_t timestamp;
+  uint64_t flags;
+};
+
+struct RecordHeader final
+{
+  uint32_t id;
+  uint32_t total_size;
+  uint64_t timestamp;
+};
+
+struct CodeLoad final
+{
+  RecordHeader header;
+  uint32_t pid;
+  uint32_t tid;
+  uint64_t vma;
+  uint64_t code_addr;
+  uint64_t code_size;
+  uint64_t code_index;
+};
+
+struct DebugInfo final
+{
+  RecordHeader header;
+  uint64_t code_addr;
+  uint64_t nr_entry;
+};
+
+struct DebugEntry final
+{
+  uint64_t addr;
+  int32_t lineno;
+  int32_t discrim;
+};
+
+[[nodiscard]] auto
+timestamp() -> uint64_t
+{
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL) + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+/// @brief The process-wide jitdump file.
+class JitDump final
+{
+  FILE* file_{ nullptr };
+
+  /// @brief perf finds the dump by looking for an executable mapping of it, so it stays mapped while the file is open.
+  void* marker_{ MAP_FAILED };
+
+  uint64_t code_index_{ 0 };
+
+public:
+  JitDump()
+  {
+    const auto path = "/tmp/jit-" + std::to_string(getpid()) + ".dump";
+
+    file_ = fopen(path.c_str(), "w+");
+    if (!file_) {
+      return;
+    }
+
+    marker_ = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(file_), 0);
+
+    FileHeader header{};
+    header.magic = jitdump_magic;
+    header.version = jitdump_version;
+    header.total_size = sizeof(FileHeader);
+    header.elf_mach = EM_X86_64;
+    header.pid = static_cast<uint32_t>(getpid());
+    header.timestamp = timestamp();
+    fwrite(&header, sizeof(header), 1, file_);
+  }
+
+  JitDump(const JitDump&) = delete;
+
+  auto operator=(const JitDump&) -> JitDump& = delete;
+
+  ~JitDump()
+  {
+    if (marker_ != MAP_FAILED) {
+      munmap(marker_, sysconf(_SC_PAGESIZE));
+    }
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  void write(const CompiledCode& code)
+  {
+    if (!file_) {
+      return;
+    }
+
+    const auto base = reinterpret_cast<uint64_t>(code.memory.data());
+
+    write_debug_info(code, base);
+
+    const auto name = symbol_name(code, CodeRange{});
+
+    CodeLoad load{};
+    load.header.id = jit_code_load;
+    load.header.total_size = static_cast<uint32_t>(sizeof(CodeLoad) + name.size() + 1 + code.memory.size());
+    load.header.timestamp = timestamp();
+    load.pid = static_cast<uint32_t>(getpid());
+    load.tid = static_cast<uint32_t>(syscall(SYS_gettid));
+    load.vma = base;
+    load.code_addr = base;
+    load.code_size = code.memory.size();
+    load.code_index = code_index_++;
+    fwrite(&load, sizeof(load), 1, file_);
+    fwrite(name.c_str(), name.size() + 1, 1, file_);
+    fwrite(code.memory.data(), code.memory.size(), 1, file_);
+
+    fflush(file_);
+  }
+
+protected:
+  /// @brief Writes the line table of the code, which has to come before the code itself.
+  void write_debug_info(const CompiledCode& code, const uint64_t base)
+  {
+    uint64_t num_entries{ 0 };
+    size_t size{ sizeof(DebugInfo) };
+
+    for (const auto& range : code.ranges) {
+      if (range.location.line > 0) {
+        num_entries++;
+        size += sizeof(DebugEntry) + code.filename.size() + 1;
+      }
+    }
+
+    if (num_entries == 0) {
+      return;
+    }
+
+    DebugInfo info{};
+    info.header.id = jit_code_debug_info;
+    info.header.total_size = static_cast<uint32_t>(size);
+    info.header.timestamp = timestamp();
+    info.code_addr = base;
+    info.nr_entry = num_entries;
+    fwrite(&info, sizeof(info), 1, file_);
+
+    for (const auto& range : code.ranges) {
+      if (range.location.line == 0) {
+        continue;
+      }
+      DebugEntry entry{};
+      entry.addr = base + range.offset;
+      entry.lineno = static_cast<int32_t>(range.location.line);
+      fwrite(&entry, sizeof(entry), 1, file_);
+      fwrite(code.filename.c_str(), code.filename.size() + 1, 1, file_);
+    }
+  }
+};
+
+} // namespace
+
+void
+write_perf_map(const CompiledCode& code)
+{
+  std::lock_guard<std::mutex> lock(file_mutex);
+
+  const auto path = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+
+  auto* file = fopen(path.c_str(), "a");
+  if (!file) {
+    return;
+  }
+
+  const auto base = reinterpret_cast<uintptr_t>(code.memory.data());
+
+  for (const auto& range : code.ranges) {
+    fprintf(file, "%zx %zx %s\n", base + range.offset, range.size, symbol_name(code, range).c_str());
+  }
+
+  fclose(file);
+}
+
+void
+write_jitdump(const CompiledCode& code)
+{
+  std::lock_guard<std::mutex> lock(file_mutex);
+
+  static JitDump dump;
+
+  dump.write(code);
+}
+
+} // namespace nabla::jit
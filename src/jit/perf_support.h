@@ -0,0 +1,24 @@
+#pragma once
+
+namespace nabla::jit {
+
+struct CompiledCode;
+
+/// @brief Appends an entry for each code range to `/tmp/perf-<pid>.map`.
+///
+/// @details This is the format that perf uses to symbolize addresses in JIT code. Each range is named after the source
+///          line it was generated for, as `nabla:<file>:<line>`, so that samples can be attributed to nabla source.
+void
+write_perf_map(const CompiledCode& code);
+
+/// @brief Appends the code to `/tmp/jit-<pid>.dump`, in the jitdump format.
+///
+/// @details Unlike the perf map, a jitdump also contains the code itself and a line table, so that `perf inject --jit`
+///          can turn it into shared objects that annotate and symbolize like native code. The whole module is recorded
+///          as a single function named `nabla:<file>`.
+///
+/// @note For perf to find the dump, the program has to be recorded with `perf record -k mono`.
+void
+write_jitdump(const CompiledCode& code);
+
+} // namespace nabla::jit
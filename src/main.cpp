@@ -1,93 +1,521 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include <stdlib.h>
+#include <unistd.h>
 
-#include "annotate.h"
+#include "buffered_runtime.h"
+#include "build_cache.h"
 #include "codegen/generator.h"
+#include "compile_server.h"
 #include "console.h"
-#include "lexer.h"
-#include "parser.h"
-#include "validator.h"
+#include "engine.h"
+#include "file_watcher.h"
+#include "frontend.h"
+#include "hash.h"
+#include "memory_usage.h"
+#include "module_graph.h"
+#include "module_interface.h"
+#include "native_build.h"
+#include "profile.h"
+#include "thread_pool.h"
+#include "time_trace.h"
 
 namespace {
 
+/// @brief A source file of the program, and the result of compiling it. Results are finished in the order of the
+///        modules, regardless of the order that they were compiled in, so that the output does not depend on
+///        scheduling.
+struct FileResult final
+{
+  /// @brief Whether the file was skipped, because an earlier file or a module that it imports failed to compile.
+  bool skipped{ false };
+
+  /// @brief Whether the file compiled, which is kept after the output has been finished, for modules that import it.
+  bool succeeded{ false };
+
+  /// @brief The file, or null if it could not be read.
+  std::shared_ptr<nabla::TranslationUnit> unit;
+
+  /// @brief Whether the file has been parsed, which is only done when it has to be compiled, since the caches don't
+  ///        need it, and neither do modules that import it when its interface is in the build cache.
+  bool parsed{ false };
+
+  /// @brief The imports at the start of the file, which point into its source.
+  std::vector<nabla::ImportRef> imports;
+
+  /// @brief What the file looked like before it was read, for the warm cache.
+  nabla::FileSignature signature;
+
+  /// @brief The diagnostics, and the generated code unless running programs. This may be shared with the warm cache.
+  std::shared_ptr<const nabla::CompileOutput> output;
+
+  /// @brief The module to run, when running programs.
+  std::shared_ptr<const nabla::CompiledModule> module;
+
+  /// @brief What modules that import this one get from it, which is only made when there are any.
+  std::shared_ptr<const nabla::ModuleInterface> interface;
+
+  /// @brief The namespace of the code, when building an executable.
+  std::string unit_namespace;
+};
+
+/// @brief The name that a file is imported by, which is its path within src/ or deps/ without the extension, with dots
+///        in place of the slashes. For example, "src/geometry/vec.nabla" is "geometry.vec".
+[[nodiscard]] auto
+module_name_of(const std::filesystem::path& path) -> std::string
+{
+  std::string name;
+
+  const auto last = std::prev(path.end());
+
+  for (auto it = std::next(path.begin()); it != path.end(); ++it) {
+    if (!name.empty()) {
+      name += '.';
+    }
+    name += ((it == last) ? it->stem() : *it).string();
+  }
+
+  return name;
+}
+
 class Program final
 {
+  nabla::codegen::Options codegen_options_;
+
+  /// @brief Whether to execute programs instead of generating code for them.
+  bool run_{ false };
+
+  nabla::InterpreterOptions interpreter_options_;
+
+  /// @brief The modules that were profiled, which are kept alive for the profile to refer to.
+  std::vector<std::shared_ptr<const nabla::CompiledModule>> profiled_modules_;
+
+  /// @brief If not null, the generated code is built into an executable instead of being printed.
+  nabla::NativeBuild* native_build_{ nullptr };
+
+  /// @brief The namespaces of the units added to the native build, in the order that they are run.
+  std::vector<std::string> unit_namespaces_;
+
+  /// @brief If not null, generated code is cached here. Programs that are run are always compiled.
+  nabla::BuildCache* cache_{ nullptr };
+
+  /// @brief If not null, results are kept here in memory and reused for as long as their files don't change. This is
+  ///        only set when running as a server or watching for changes.
+  nabla::WarmCache* warm_cache_{ nullptr };
+
+  /// @brief If not null, the phases of compiling each file are timed in this.
+  nabla::TimeTrace* trace_{ nullptr };
+
+  /// @brief Whether the diagnostics of each file are colored. They are cached as they are printed, so this is part of
+  ///        the cache key, along with the program name that they start with.
+  static constexpr bool color_diagnostics = true;
+
 public:
-  [[nodiscard]] auto compile(const std::filesystem::path& filename, nabla::Console& console) -> bool
+  Program(const nabla::codegen::Options& codegen_options,
+          const bool run,
+          const nabla::InterpreterOptions& interpreter_options,
+          nabla::NativeBuild* native_build,
+          nabla::BuildCache* cache,
+          nabla::WarmCache* warm_cache,
+          nabla::TimeTrace* trace)
+    : codegen_options_(codegen_options)
+    , run_(run)
+    , interpreter_options_(interpreter_options)
+    , native_build_(native_build)
+    , cache_(cache)
+    , warm_cache_(warm_cache)
+    , trace_(trace)
+  {
+  }
+
+  /// @brief Reads a file and finds what it imports.
+  ///
+  /// @note This may be called for several files at the same time.
+  [[nodiscard]] auto load(const std::filesystem::path& filename, const std::string_view& program_name) const
+    -> FileResult
   {
+    nabla::TimeTrace::Scope file_scope(trace_, nabla::TimeTrace::Phase::file, filename.string());
+
+    FileResult result;
+
+    if (native_build_) {
+      // The namespace is derived from the path, so that it does not change (and invalidate the cached object) when
+      // other files are added to the program.
+      result.unit_namespace = "nabla_unit_" + nabla::hash_to_hex(nabla::hash64(filename.string()));
+    }
+
+    // The file is stat'ed before it is read, so that a change made while reading it is seen by the next build.
+    if (warm_cache_) {
+      (void)nabla::FileSignature::read(filename, result.signature);
+    }
+
+    std::ostringstream messages;
+
+    auto console = make_console(&messages, program_name);
+
+    nabla::TimeTrace::Scope read_scope(trace_, nabla::TimeTrace::Phase::read, filename.string());
+
     std::ifstream file(filename);
     if (!file.good()) {
-      return false;
+      console->print_file_error(filename.string(), "failed to open file");
+      result.output = make_failure(messages.str());
+      return result;
     }
 
-    const auto source = read_file(file);
+    auto unit = std::make_shared<nabla::TranslationUnit>();
+    unit->filename = filename.string();
+    unit->module_name = module_name_of(filename);
+    unit->source = read_file(file);
+
+    result.imports = nabla::scan_imports(unit->source);
 
-    nabla::Lexer lexer(source);
+    result.unit = std::move(unit);
 
-    std::vector<nabla::Token> tokens;
+    return result;
+  }
+
+  /// @brief Compiles a file that was loaded, without printing anything or changing the program.
+  ///
+  /// @param imports The modules that the file imports, directly or through other modules, in the order of the graph.
+  ///                They must have compiled, and have their interfaces.
+  ///
+  /// @param exported Whether other modules import this one, in which case its interface is made too, unless it fails
+  ///                 to compile.
+  ///
+  /// @note This may be called for several files at the same time, as long as the files that a file imports are not
+  ///       compiled at the same time as it.
+  void compile(FileResult& result,
+               const std::vector<const FileResult*>& imports,
+               const bool exported,
+               const std::string_view& program_name) const
+  {
+    auto& unit = *result.unit;
 
-    while (!lexer.eof()) {
-      const auto token = lexer.scan();
-      if ((token == nabla::TK::comment) || (token == nabla::TK::space)) {
-        continue;
+    // The code of a module depends on the interfaces of the modules that it imports, since their declarations are
+    // copied into it, but not on the rest of those modules. Where the declarations are only matters to line directives.
+    // Without a cache, there is nothing to look the key up in, so it isn't worth making. Programs that are run have no
+    // disk cache either.
+    nabla::CacheKey key{};
+
+    if (cache_ || warm_cache_) {
+      auto config = cache_config(unit.filename, program_name);
+
+      for (const auto* imported : imports) {
+        config += "import=" + imported->unit->filename + ' ' + nabla::hash_to_hex(imported->interface->hash());
+        if (codegen_options_.line_directives) {
+          config += ' ' + nabla::hash_to_hex(imported->interface->position_hash());
+        }
+        config += '\n';
       }
-      if (token == nabla::TK::incomplete_string_literal) {
-        nabla::Diagnostic diagnostic{ "unterminated string", &token };
-        console.print_diagnostic(filename.string(), diagnostic, source);
-        return false;
+
+      key = nabla::BuildCache::make_key(unit.source, config);
+    }
+
+    if (warm_cache_) {
+      nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::cache, unit.filename);
+      nabla::WarmCache::Entry entry;
+      if (warm_cache_->find(key, entry)) {
+        result.output = std::move(entry.output);
+        result.module = std::move(entry.module);
+        result.interface = std::move(entry.interface);
+        if (!exported || result.interface || !result.output->success) {
+          return;
+        }
+        // The module was compiled before anything imported it.
+        export_interface(result, key);
+        warm_cache_->insert(key, { unit.filename, result.signature, result.output, result.module, result.interface });
+        return;
       }
-      if (token == nabla::TK::incomplete_comment) {
-        nabla::Diagnostic diagnostic{ "unterminated comment", &token };
-        console.print_diagnostic(filename.string(), diagnostic, source);
-        return false;
+    }
+
+    auto output = std::make_shared<nabla::CompileOutput>();
+
+    result.output = output;
+
+    if (run_ || !cache_ || !load_cached(key, *output, unit.filename)) {
+      for (const auto* imported : imports) {
+        unit.imports.emplace_back(imported->interface);
       }
-      tokens.emplace_back(token);
+
+      std::ostringstream messages;
+
+      auto console = make_console(&messages, program_name);
+
+      output->success = compile(result, *output, *console);
+      output->messages = messages.str();
+
+      if (!run_ && cache_) {
+        nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::cache, unit.filename);
+        // A cache that can't be written to only makes the next build slower.
+        (void)cache_->store(key, *output);
+      }
+    }
+
+    if (exported && output->success) {
+      export_interface(result, key);
     }
 
-    auto parser = nabla::Parser::create(tokens.data(), tokens.size());
+    if (warm_cache_) {
+      warm_cache_->insert(key, { unit.filename, result.signature, output, result.module, result.interface });
+    }
+  }
 
-    nabla::SyntaxTree tree;
+  /// @brief Adds a diagnostic to a file that was loaded, which then fails to compile.
+  static void add_error(FileResult& result, const nabla::Diagnostic& diagnostic, const std::string_view& program_name)
+  {
+    std::ostringstream messages;
 
-    while (!parser->eof()) {
-      try {
-        auto node = parser->parse();
-        tree.nodes.emplace_back(std::move(node));
-      } catch (const nabla::FatalError& error) {
-        const auto& diagnostic = error.diagnostic();
-        console.print_diagnostic(filename.string(), diagnostic, source);
+    if (result.output) {
+      messages << result.output->messages;
+    }
+
+    auto console = make_console(&messages, program_name);
+
+    console->print_diagnostic(result.unit->filename, diagnostic, result.unit->source);
+
+    result.output = make_failure(messages.str());
+  }
+
+  /// @brief Prints the diagnostics of a file, and then runs it, prints its code, or adds it to the native build.
+  ///
+  /// @note This is called for one file at a time, in the order of the files.
+  [[nodiscard]] auto finish(FileResult& result, nabla::Console& console) -> bool
+  {
+    // The generated code and the output of programs are written straight to the file descriptor, so anything printed
+    // before them has to be flushed first.
+    std::cout << result.output->messages;
+
+    std::cout.flush();
+
+    if (!result.output->success) {
+      return false;
+    }
+
+    if (result.module) {
+      nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::run, result.unit->filename);
+      run(std::move(result.module));
+      return true;
+    }
+
+    if (native_build_) {
+      add_native_unit(*result.output, result.unit_namespace);
+      return true;
+    }
+
+    if (!result.output->units.at(0).write_to(STDOUT_FILENO)) {
+      console.print_error("failed to write generated code to standard output");
+      return false;
+    }
+
+    return true;
+  }
+
+  /// @brief Adds the entry point of the program to the native build, and links it.
+  [[nodiscard]] auto link(const std::filesystem::path& output, nabla::Console& console) -> bool
+  {
+    std::ostringstream main_source;
+
+    main_source << "#include \"nabla_rt.h\"\n\n";
+
+    for (const auto& name : unit_namespaces_) {
+      main_source << "namespace " << name << " {\nvoid\nentry();\n}\n\n";
+    }
+
+    main_source << "int\nmain()\n{\n";
+
+    for (const auto& name : unit_namespaces_) {
+      main_source << "  " << name << "::entry();\n";
+    }
+
+    main_source << "  nabla::rt::flush();\n  return 0;\n}\n";
+
+    native_build_->add_unit("main", main_source.str());
+
+    nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::link, output.string());
+
+    return native_build_->link(output, console);
+  }
+
+protected:
+  /// @brief Makes the interface of a module that compiled. It is mapped from the build cache when it is there, which
+  ///        saves parsing a module whose output came from the cache.
+  ///
+  /// @note The interface is left null if the module can't be parsed, which only happens if a cache is wrong about it.
+  void export_interface(FileResult& result, const nabla::CacheKey& key) const
+  {
+    nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::import, result.unit->filename);
+
+    if (cache_ && !result.parsed) {
+      result.interface = cache_->load_interface(key);
+      if (result.interface) {
+        return;
+      }
+    }
+
+    if (!result.parsed) {
+      // The module compiled, so parsing it has nothing to report.
+      std::ostringstream messages;
+      auto console = nabla::Console::create(&messages);
+      if (!nabla::parse_unit(*result.unit, *console, trace_)) {
+        return;
+      }
+      result.parsed = true;
+    }
+
+    auto data = nabla::ModuleInterface::encode(*result.unit);
+
+    if (cache_) {
+      // Without the interface in the cache, the next build parses the module again, which is only slower.
+      (void)cache_->store_interface(key, data);
+    }
+
+    result.interface = nabla::ModuleInterface::decode(std::move(data));
+  }
+
+  [[nodiscard]] auto compile(FileResult& result, nabla::CompileOutput& output, nabla::Console& console) const -> bool
+  {
+    if (!result.parsed) {
+      if (!nabla::parse_unit(*result.unit, console, trace_)) {
         return false;
       }
+      result.parsed = true;
     }
 
-    const auto annotations = annotate(tree);
+    if (run_) {
+      nabla::EngineOptions options;
+      options.fma = codegen_options_.fma;
+      options.trace = trace_;
 
-    auto validator = nabla::Validator::create();
+      auto engine = nabla::Engine::create(options);
 
-    validator->validate(tree.nodes, annotations);
+      result.module = engine->compile(result.unit, console);
 
-    for (const auto& diagnostic : validator->get_diagnostics()) {
-      console.print_diagnostic(filename.string(), diagnostic, source);
+      return result.module != nullptr;
     }
 
-    if (validator->failed()) {
+    auto& unit = *result.unit;
+
+    if (!nabla::analyze_unit(unit, console, trace_)) {
       return false;
     }
 
-    auto generator = nabla::codegen::Generator::create("c++", &annotations);
+    const auto num_nodes = trace_ ? nabla::count_nodes(unit.tree) : 0;
+
+    nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::codegen, unit.filename);
+
+    scope.set_nodes(num_nodes);
+
+    auto options = codegen_options_;
+    options.filename = unit.filename;
+    options.unit_namespace = result.unit_namespace;
+    options.trace = trace_;
+
+    for (const auto& imported : unit.imports) {
+      options.imported_sources.emplace_back(imported->text(), imported->filename());
+    }
+
+    auto generator = nabla::codegen::Generator::create("c++", &unit.annotations, options);
+
+    generator->generate(unit.tree);
 
-    generator->generate(tree);
+    output.header = generator->take_header();
 
-    std::cout << generator->source();
+    output.units = generator->take_units();
 
     return true;
   }
 
-protected:
+  [[nodiscard]] auto load_cached(const nabla::CacheKey& key, nabla::CompileOutput& output, const std::string& filename)
+    const -> bool
+  {
+    nabla::TimeTrace::Scope scope(trace_, nabla::TimeTrace::Phase::cache, filename);
+
+    return cache_->load(key, output);
+  }
+
+  /// @brief Describes everything other than the source of a file that affects the code generated for it, and the
+  ///        diagnostics printed for it.
+  [[nodiscard]] auto cache_config(const std::filesystem::path& filename, const std::string_view& program_name) const
+    -> std::string
+  {
+    std::ostringstream config;
+    config << "file=" << filename.string() << '\n';
+    config << "program=" << program_name << '\n';
+    config << "color=" << color_diagnostics << '\n';
+    config << "run=" << run_ << '\n';
+    config << "exe=" << (native_build_ != nullptr) << '\n';
+    config << "fma=" << codegen_options_.fma << '\n';
+    config << "line_directives=" << codegen_options_.line_directives << '\n';
+    if (codegen_options_.line_directives) {
+      config << "output_dir=" << codegen_options_.output_dir << '\n';
+    }
+    config << "max_units=" << codegen_options_.max_units << '\n';
+    return config.str();
+  }
+
+  void add_native_unit(const nabla::CompileOutput& output, const std::string& name)
+  {
+    if (!output.header.empty()) {
+      native_build_->add_header(name + ".h", output.header.str());
+    }
+
+    const auto& units = output.units;
+
+    for (size_t i = 0; i < units.size(); i++) {
+      native_build_->add_unit(nabla::codegen::unit_name(name, i, units.size()), units[i].str());
+    }
+
+    unit_namespaces_.emplace_back(name);
+  }
+
+  void run(std::shared_ptr<const nabla::CompiledModule> m)
+  {
+    nabla::BufferedRuntime runtime;
+
+    if (interpreter_options_.profile) {
+      profiled_modules_.emplace_back(m);
+    }
+
+    nabla::ExecutionContext context(std::move(m), &runtime, interpreter_options_);
+
+    context.run();
+  }
+
+  [[nodiscard]] static auto make_console(std::ostream* output, const std::string_view& program_name)
+    -> std::unique_ptr<nabla::Console>
+  {
+    auto console = nabla::Console::create(output);
+
+    console->set_program_name(program_name);
+
+    console->set_color_enabled(color_diagnostics);
+
+    return console;
+  }
+
+  [[nodiscard]] static auto make_failure(std::string messages) -> std::shared_ptr<const nabla::CompileOutput>
+  {
+    auto output = std::make_shared<nabla::CompileOutput>();
+
+    output->messages = std::move(messages);
+
+    return output;
+  }
+
   [[nodiscard]] static auto read_file(std::ifstream& file) -> std::string
   {
     file.seekg(0, std::ios::end);
@@ -106,51 +534,521 @@ protected:
   }
 };
 
-} // namespace
+/// @brief Finds the source files of the program, in a fixed order.
+[[nodiscard]] auto
+find_source_files() -> std::vector<std::filesystem::path>
+{
+  std::vector<std::filesystem::path> files;
 
-auto
-main(int, char** argv) -> int
+  for (const auto* root : { "src", "deps" }) {
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(root, error);
+    for (; !error && (it != std::filesystem::recursive_directory_iterator()); it.increment(error)) {
+      if (it->is_regular_file(error) && (it->path().extension() == ".nabla")) {
+        files.emplace_back(it->path());
+      }
+    }
+  }
+
+  // Directory iteration order is unspecified, so the files are sorted to make the output reproducible.
+  std::sort(files.begin(), files.end());
+
+  return files;
+}
+
+/// @brief Writes the report of a profile to a file, and its collapsed stacks next to it.
+[[nodiscard]] auto
+write_profile(const nabla::Profile& profile, const std::string& path, nabla::Console& console) -> bool
 {
-  Program program;
+  std::ofstream report(path);
+  profile.write_report(report);
+
+  std::ofstream collapsed(path + ".folded");
+  profile.write_collapsed(collapsed);
+
+  if (!report.good() || !collapsed.good()) {
+    console.print_file_error(path, "failed to write profile");
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Writes the scopes of a time trace to a file, as Chrome trace events.
+[[nodiscard]] auto
+write_trace(const nabla::TimeTrace& trace, const std::string& path, nabla::Console& console) -> bool
+{
+  std::ofstream file(path);
+  trace.write_trace(file);
+
+  if (!file.good()) {
+    console.print_file_error(path, "failed to write trace");
+    return false;
+  }
+
+  return true;
+}
 
+/// @brief How long the watch mode waits for a burst of changes to end before building.
+constexpr std::chrono::milliseconds watch_debounce{ 25 };
+
+/// @brief Compiles the program in the current directory.
+///
+/// @param args The arguments of the command, starting with the program name.
+///
+/// @param warm_cache If not null, compile results are kept here between calls.
+[[nodiscard]] auto
+drive(const std::vector<std::string>& args, nabla::WarmCache* warm_cache) -> int
+{
   auto console = nabla::Console::create(&std::cout);
 
-  console->set_program_name(argv[0]);
+  console->set_program_name(args.at(0));
 
   console->set_color_enabled(true);
 
+  nabla::codegen::Options codegen_options;
+
+  auto run{ false };
+
+  nabla::InterpreterOptions interpreter_options;
+
+  std::string profile_path;
+
+  uint32_t profile_period{ 1 };
+
+  auto emit_exe{ false };
+
+  auto fail_fast{ false };
+
+  auto time_report{ false };
+
+  auto mem_report{ false };
+
+  std::string trace_path;
+
+  std::filesystem::path cache_dir{ ".nabla-cache" };
+
+  uint64_t cache_size_mb{ nabla::BuildCache::default_max_size >> 20 };
+
+  std::filesystem::path output_path{ "a.out" };
+
+  nabla::NativeBuildOptions native_build_options;
+
+  native_build_options.jobs = std::max(std::thread::hardware_concurrency(), 1u);
+
+  for (size_t i = 1; i < args.size(); i++) {
+    const std::string_view arg(args[i]);
+    if (arg == "--fma") {
+      codegen_options.fma = true;
+    } else if (arg == "--line-directives") {
+      codegen_options.line_directives = true;
+    } else if (arg == "--run") {
+      run = true;
+    } else if (arg == "--backend=interpreter") {
+      interpreter_options.backend = nabla::Backend::interpreter;
+    } else if (arg == "--backend=jit") {
+      interpreter_options.backend = nabla::Backend::jit;
+    } else if (arg == "--backend=parallel") {
+      interpreter_options.backend = nabla::Backend::parallel;
+    } else if (arg == "--backend=batch") {
+      interpreter_options.backend = nabla::Backend::batch;
+    } else if (arg == "--perf-map") {
+      interpreter_options.perf_map = true;
+    } else if (arg == "--jitdump") {
+      interpreter_options.jitdump = true;
+    } else if (arg.substr(0, 10) == "--profile=") {
+      profile_path = arg.substr(10);
+    } else if (arg.substr(0, 17) == "--profile-period=") {
+      const auto value = arg.substr(17);
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), profile_period);
+      const auto valid = (profile_period > 0) && (profile_period <= nabla::Profile::max_sample_period);
+      if ((result.ptr != (value.data() + value.size())) || !valid) {
+        console->print_error("invalid profile period '" + std::string(value) + "'");
+        return EXIT_FAILURE;
+      }
+    } else if (arg == "--emit=exe") {
+      emit_exe = true;
+    } else if (arg == "--fail-fast") {
+      fail_fast = true;
+    } else if (arg == "--time-report") {
+      time_report = true;
+    } else if (arg == "--mem-report") {
+      mem_report = true;
+    } else if (arg.substr(0, 8) == "--trace=") {
+      trace_path = arg.substr(8);
+    } else if (arg.substr(0, 14) == "--split-units=") {
+      const auto value = arg.substr(14);
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), codegen_options.max_units);
+      if ((result.ptr != (value.data() + value.size())) || (codegen_options.max_units == 0)) {
+        console->print_error("invalid unit count '" + std::string(value) + "'");
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 9) == "--output=") {
+      output_path = arg.substr(9);
+    } else if (arg.substr(0, 12) == "--cache-dir=") {
+      cache_dir = arg.substr(12);
+    } else if (arg == "--no-cache") {
+      cache_dir.clear();
+    } else if (arg.substr(0, 13) == "--cache-size=") {
+      const auto value = arg.substr(13);
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), cache_size_mb);
+      if (result.ptr != (value.data() + value.size())) {
+        console->print_error("invalid cache size '" + std::string(value) + "'");
+        return EXIT_FAILURE;
+      }
+    } else if (arg.substr(0, 12) == "--build-dir=") {
+      native_build_options.build_dir = arg.substr(12);
+    } else if (arg.substr(0, 6) == "--cxx=") {
+      native_build_options.compiler = arg.substr(6);
+    } else if (arg.substr(0, 11) == "--cxxflags=") {
+      native_build_options.flags.clear();
+      std::istringstream flags{ std::string(arg.substr(11)) };
+      for (std::string flag; flags >> flag;) {
+        native_build_options.flags.emplace_back(std::move(flag));
+      }
+    } else if ((arg.substr(0, 7) == "--jobs=") || (arg.substr(0, 2) == "-j")) {
+      // The count may also be the next argument, as in "-j 4".
+      std::string_view value;
+      if (arg == "-j") {
+        if ((i + 1) == args.size()) {
+          console->print_error("missing job count after '-j'");
+          return EXIT_FAILURE;
+        }
+        value = args[++i];
+      } else {
+        value = arg.substr(arg[1] == 'j' ? 2 : 7);
+      }
+      const auto result = std::from_chars(value.data(), value.data() + value.size(), native_build_options.jobs);
+      if ((result.ptr != (value.data() + value.size())) || (native_build_options.jobs == 0)) {
+        console->print_error("invalid job count '" + std::string(value) + "'");
+        return EXIT_FAILURE;
+      }
+    } else {
+      console->print_error("unknown option '" + std::string(arg) + "'");
+      return EXIT_FAILURE;
+    }
+  }
+
+  nabla::Profile profile(profile_period);
+
+  if (!profile_path.empty()) {
+    interpreter_options.profile = &profile;
+  }
+
+  // Allocations are only counted for the memory report, since counting makes every allocation update shared counters.
+  std::unique_ptr<nabla::AllocationCounter> allocation_counter;
+
+  if (mem_report) {
+    allocation_counter = std::make_unique<nabla::AllocationCounter>();
+  }
+
+  const nabla::ScopedAllocationHook allocation_hook(allocation_counter.get());
+
+  // Without a trace, every scope is a branch on a null pointer.
+  std::unique_ptr<nabla::TimeTrace> trace;
+
+  if (time_report || mem_report || !trace_path.empty()) {
+    trace = std::make_unique<nabla::TimeTrace>(allocation_counter.get());
+  }
+
+  // The jobs that the native build runs are processes, while this pool is for work within the compiler itself.
+  std::unique_ptr<nabla::ThreadPool> thread_pool;
+
+  if (native_build_options.jobs > 1) {
+    thread_pool = std::make_unique<nabla::ThreadPool>(native_build_options.jobs - 1);
+    codegen_options.thread_pool = thread_pool.get();
+    // Programs that are run with the parallel backend share it too, rather than each starting a pool of their own.
+    interpreter_options.thread_pool = thread_pool.get();
+  }
+
+  // Line directives map the code around the nodes back to the generated files, which the native build writes here.
+  codegen_options.output_dir = (native_build_options.build_dir / "src").string();
+
+  nabla::NativeBuild native_build(native_build_options);
+
   if (!std::filesystem::exists("src")) {
     console->print_error("no src/ directory exists in the current directory");
     return EXIT_FAILURE;
   }
 
-  std::vector<std::filesystem::path> directory_queue{ "src", "deps" };
+  // Compiled modules can't be stored, so programs that are run don't use the cache.
+  std::unique_ptr<nabla::BuildCache> cache;
 
-  while (!directory_queue.empty()) {
+  if (!run && !cache_dir.empty()) {
+    cache = std::make_unique<nabla::BuildCache>(cache_dir, cache_size_mb << 20);
+  }
 
-    std::filesystem::path current = directory_queue[0];
+  Program program(codegen_options,
+                  run,
+                  interpreter_options,
+                  emit_exe ? &native_build : nullptr,
+                  cache.get(),
+                  warm_cache,
+                  trace.get());
 
-    directory_queue.erase(directory_queue.begin());
+  const auto files = find_source_files();
 
-    if (!std::filesystem::exists(current)) {
-      continue;
+  std::vector<FileResult> results(files.size());
+
+  // Files are read first, since what they import decides the order that they are compiled in.
+  {
+    nabla::TaskGroup group;
+
+    for (size_t i = 0; i < files.size(); i++) {
+      auto task = [&, i]() { results[i] = program.load(files[i], args[0]); };
+      if (thread_pool) {
+        thread_pool->submit(group, std::move(task));
+      } else {
+        task();
+      }
     }
 
-    for (const auto& entry : std::filesystem::directory_iterator(current)) {
-      if (entry.is_regular_file()) {
-        if (entry.path().extension() != ".nabla") {
-          continue;
-        }
-        if (!program.compile(entry, *console)) {
-          return EXIT_FAILURE;
+    if (thread_pool) {
+      thread_pool->wait(group);
+    }
+  }
+
+  nabla::ModuleGraph graph;
+
+  for (const auto& path : files) {
+    (void)graph.add_module(module_name_of(path));
+  }
+
+  for (size_t i = 0; i < files.size(); i++) {
+    for (const auto& import : results[i].imports) {
+      graph.add_import(i, import.module_name, &import.token);
+    }
+  }
+
+  for (const auto& error : graph.resolve()) {
+    Program::add_error(results[error.module], error.diagnostic, args[0]);
+  }
+
+  const auto& order = graph.order();
+
+  // The position of each file in the order, which is what failing fast goes by.
+  std::vector<size_t> positions(files.size());
+
+  for (size_t i = 0; i < order.size(); i++) {
+    positions[order[i]] = i;
+  }
+
+  // The position of the first file that failed. When failing fast, the files after it are skipped.
+  std::atomic<size_t> first_failure{ files.size() };
+
+  const auto compile_file = [&](const size_t i) {
+    auto& result = results[i];
+    if (fail_fast && (first_failure.load() < positions[i])) {
+      result.skipped = true;
+      return;
+    }
+    if (!result.output) {
+      // A module whose imports failed is not compiled, and there is nothing to say about it that the errors of the
+      // imports don't already say. The same goes for the modules of a cycle, which is reported on one of them.
+      result.skipped = graph.failed(i);
+      for (const auto m : graph.imports(i)) {
+        result.skipped |= !results[m].succeeded;
+      }
+      if (result.skipped) {
+        return;
+      }
+      nabla::TimeTrace::Scope scope(trace.get(), nabla::TimeTrace::Phase::file, files[i].string());
+      std::vector<const FileResult*> imports;
+      for (const auto m : graph.transitive_imports(i)) {
+        imports.emplace_back(&results[m]);
+      }
+      program.compile(result, imports, !graph.importers(i).empty(), args[0]);
+    }
+    result.succeeded = result.output->success && (graph.importers(i).empty() || result.interface);
+    if (!result.succeeded) {
+      auto failure = first_failure.load();
+      while ((positions[i] < failure) && !first_failure.compare_exchange_weak(failure, positions[i])) {
+      }
+    }
+  };
+
+  // One group per file, so that the driver can wait for the files one at a time, in order.
+  std::vector<nabla::TaskGroup> groups(files.size());
+
+  // The number of imports of each file that have yet to be compiled. A file is compiled as soon as this reaches zero,
+  // so modules are compiled in parallel wherever their imports allow it.
+  std::unique_ptr<std::atomic<size_t>[]> num_pending(new std::atomic<size_t>[files.size()]);
+
+  std::function<void(size_t)> submit = [&](const size_t i) {
+    thread_pool->submit(groups[i], [&, i]() {
+      compile_file(i);
+      // Importers are submitted before this task finishes, so they are in their groups by the time the driver gets to
+      // them, since the driver waits for the imports of a file first.
+      for (const auto importer : graph.importers(i)) {
+        if (num_pending[importer].fetch_sub(1) == 1) {
+          submit(importer);
         }
       }
+    });
+  };
+
+  if (thread_pool) {
+    for (size_t i = 0; i < files.size(); i++) {
+      num_pending[i].store(graph.imports(i).size());
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+      if (graph.imports(i).empty()) {
+        submit(i);
+      }
+    }
+  }
+
+  auto success{ true };
+
+  // Files are finished in the order of the graph, so each module runs after the modules that it imports.
+  for (const auto i : order) {
+    // Waiting on a group runs other tasks in the meantime, so this thread compiles files too.
+    if (thread_pool) {
+      thread_pool->wait(groups[i]);
+    } else {
+      compile_file(i);
+    }
+    if (results[i].skipped || (!success && fail_fast)) {
+      continue;
+    }
+    success &= program.finish(results[i], *console);
+    // The parsed file is kept, since modules that import it may still be compiling.
+    results[i].output.reset();
+    results[i].module.reset();
+  }
+
+  if (cache) {
+    cache->evict();
+  }
+
+  if (success && emit_exe) {
+    success = program.link(output_path, *console);
+    if (success) {
+      std::cerr << "built " << output_path.string() << " (" << native_build.num_compiled() << " compiled, "
+                << native_build.num_cached() << " cached)" << std::endl;
+    }
+  }
+
+  if (success && !profile_path.empty()) {
+    success = write_profile(profile, profile_path, *console);
+  }
+
+  // Reports are written even when compiling failed, since they can still say where the time and memory went.
+  if (time_report) {
+    trace->write_report(std::cerr);
+  }
+
+  if (mem_report) {
+    if (time_report) {
+      std::cerr << '\n';
+    }
+    trace->write_memory_report(std::cerr);
+  }
+
+  if (!trace_path.empty() && !write_trace(*trace, trace_path, *console)) {
+    success = false;
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  std::vector<std::string> args(argv, argv + argc);
+
+  std::optional<std::string> server_socket;
+
+  std::optional<std::string> connect_socket;
+
+  auto watch{ false };
+
+  for (auto it = args.begin() + 1; it != args.end();) {
+    if ((*it == "--server") || (it->substr(0, 9) == "--server=")) {
+      server_socket = (it->size() > 8) ? it->substr(9) : nabla::default_server_socket();
+    } else if ((*it == "--connect") || (it->substr(0, 10) == "--connect=")) {
+      connect_socket = (it->size() > 9) ? it->substr(10) : nabla::default_server_socket();
+    } else if (*it == "--watch") {
+      watch = true;
+    } else {
+      ++it;
+      continue;
+    }
+    it = args.erase(it);
+  }
+
+  auto console = nabla::Console::create(&std::cerr);
+
+  console->set_program_name(args[0]);
+
+  console->set_color_enabled(true);
+
+  if (server_socket) {
+    if (args.size() > 1) {
+      console->print_error("options are given by clients, not to the server");
+      return EXIT_FAILURE;
+    }
+
+    nabla::WarmCache warm_cache;
+
+    const auto handler = [&warm_cache](const std::vector<std::string>& request) {
+      const auto status = drive(request, &warm_cache);
+      // Results of files that have changed since would never be used again.
+      warm_cache.prune();
+      return status;
+    };
+
+    return nabla::serve(*server_socket, handler, *console) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (watch) {
+    // The watcher is set up first, so that changes made during the first build are not missed.
+    nabla::FileWatcher watcher({ "src", "deps" });
+
+    if (!watcher.valid()) {
+      console->print_error("failed to watch for changes");
+      return EXIT_FAILURE;
+    }
+
+    nabla::WarmCache warm_cache;
+
+    while (true) {
+      const auto start = std::chrono::steady_clock::now();
+
+      const auto hits = warm_cache.num_hits();
+
+      const auto misses = warm_cache.num_misses();
+
+      try {
+        (void)drive(args, &warm_cache);
+      } catch (const std::exception& e) {
+        console->print_error(e.what());
+      }
+
+      warm_cache.prune();
+
+      const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
 
-      if (entry.is_directory()) {
-        directory_queue.emplace_back(current / entry);
+      const auto compiled = warm_cache.num_misses() - misses;
+
+      std::cerr << "compiled " << compiled << " of " << (compiled + (warm_cache.num_hits() - hits)) << " files in "
+                << elapsed.count() << " ms, waiting for changes" << std::endl;
+
+      if (!watcher.wait(watch_debounce)) {
+        console->print_error("failed to watch for changes");
+        return EXIT_FAILURE;
       }
     }
   }
 
-  return EXIT_FAILURE;
+  if (connect_socket) {
+    // Without a server to connect to, the program is compiled here instead, which gives the same output.
+    if (const auto status = nabla::send_request(*connect_socket, args, *console)) {
+      return *status;
+    }
+  }
+
+  return drive(args, nullptr);
 }
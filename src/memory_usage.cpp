@@ -0,0 +1,166 @@
+#include "memory_usage.h"
+
+#include <new>
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+namespace nabla {
+
+namespace {
+
+/// @brief Loaded on every allocation, so that an allocation without a hook costs a load and a branch.
+std::atomic<AllocationHook*> current_hook{ nullptr };
+
+/// @brief Plain data, so that it needs no allocation of its own when a thread first touches it.
+thread_local AllocationCounts thread_allocations;
+
+[[nodiscard]] auto
+allocate(size_t size) -> void*
+{
+  if (size == 0) {
+    size = 1;
+  }
+
+  for (;;) {
+    auto* block = malloc(size);
+    if (block) {
+      if (auto* hook = current_hook.load(std::memory_order_acquire)) {
+        hook->allocated(malloc_usable_size(block));
+      }
+      return block;
+    }
+    const auto handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void
+deallocate(void* block) noexcept
+{
+  if (!block) {
+    return;
+  }
+
+  if (auto* hook = current_hook.load(std::memory_order_acquire)) {
+    hook->freed(malloc_usable_size(block));
+  }
+
+  free(block);
+}
+
+} // namespace
+
+void
+set_allocation_hook(AllocationHook* hook)
+{
+  current_hook.store(hook, std::memory_order_release);
+}
+
+void
+AllocationCounter::allocated(const size_t size)
+{
+  thread_allocations.allocations++;
+  thread_allocations.allocated_bytes += size;
+
+  allocations_.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes_.fetch_add(size, std::memory_order_relaxed);
+
+  const auto live = live_bytes_.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) +
+                    static_cast<int64_t>(size);
+
+  if (live <= 0) {
+    return;
+  }
+
+  auto peak = peak_live_bytes_.load(std::memory_order_relaxed);
+
+  while ((static_cast<uint64_t>(live) > peak) &&
+         !peak_live_bytes_.compare_exchange_weak(peak, static_cast<uint64_t>(live), std::memory_order_relaxed)) {
+  }
+}
+
+void
+AllocationCounter::freed(const size_t size)
+{
+  thread_allocations.freed_bytes += size;
+
+  freed_bytes_.fetch_add(size, std::memory_order_relaxed);
+
+  live_bytes_.fetch_sub(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+auto
+AllocationCounter::thread_counts() -> AllocationCounts
+{
+  return thread_allocations;
+}
+
+auto
+AllocationCounter::totals() const -> AllocationCounts
+{
+  AllocationCounts counts;
+  counts.allocations = allocations_.load(std::memory_order_relaxed);
+  counts.allocated_bytes = allocated_bytes_.load(std::memory_order_relaxed);
+  counts.freed_bytes = freed_bytes_.load(std::memory_order_relaxed);
+  return counts;
+}
+
+auto
+peak_rss() -> uint64_t
+{
+  rusage usage{};
+
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+
+  // Linux reports this in kilobytes.
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+}
+
+} // namespace nabla
+
+// Every allocation goes through these, so that a hook can be installed at any time. The sized and array forms are
+// replaced too, since the standard library is free to call them without going through the plain ones. Aligned
+// allocations are left to the standard library, and are not counted.
+
+auto
+operator new(const size_t size) -> void*
+{
+  return nabla::allocate(size);
+}
+
+auto
+operator new[](const size_t size) -> void*
+{
+  return nabla::allocate(size);
+}
+
+void
+operator delete(void* block) noexcept
+{
+  nabla::deallocate(block);
+}
+
+void
+operator delete[](void* block) noexcept
+{
+  nabla::deallocate(block);
+}
+
+void
+operator delete(void* block, size_t /* size */) noexcept
+{
+  nabla::deallocate(block);
+}
+
+void
+operator delete[](void* block, size_t /* size */) noexcept
+{
+  nabla::deallocate(block);
+}
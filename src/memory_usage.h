@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla {
+
+/// @brief Is told about every allocation made through operator new and delete, once installed with @ref
+///        set_allocation_hook.
+///
+/// @note Hooks are called from within operator new and delete, on whichever thread allocates, so they must be thread
+///       safe and must not allocate themselves.
+class AllocationHook
+{
+public:
+  virtual ~AllocationHook() = default;
+
+  /// @param size The usable size of the block, which may be more than was asked for.
+  virtual void allocated(size_t size) = 0;
+
+  /// @param size The usable size of the block.
+  virtual void freed(size_t size) = 0;
+};
+
+/// @brief Installs a hook, or removes the current one if null.
+///
+/// @note Blocks allocated before a hook is installed may be freed while it is, so a hook may see more bytes freed
+///       than allocated.
+void
+set_allocation_hook(AllocationHook* hook);
+
+/// @brief Installs a hook for as long as it exists, and removes it afterwards.
+class ScopedAllocationHook final
+{
+public:
+  /// @param hook The hook to install, or null to leave things as they are.
+  explicit ScopedAllocationHook(AllocationHook* hook)
+    : hook_(hook)
+  {
+    if (hook_) {
+      set_allocation_hook(hook_);
+    }
+  }
+
+  ScopedAllocationHook(const ScopedAllocationHook&) = delete;
+
+  auto operator=(const ScopedAllocationHook&) -> ScopedAllocationHook& = delete;
+
+  ~ScopedAllocationHook()
+  {
+    if (hook_) {
+      set_allocation_hook(nullptr);
+    }
+  }
+
+private:
+  AllocationHook* hook_{ nullptr };
+};
+
+/// @brief The allocations made by one thread, or by all of them.
+struct AllocationCounts final
+{
+  uint64_t allocations{ 0 };
+
+  uint64_t allocated_bytes{ 0 };
+
+  uint64_t freed_bytes{ 0 };
+};
+
+/// @brief A hook that counts allocations, both per thread and for the whole process.
+///
+/// @details The per-thread counts only ever grow, so the allocations made by a piece of code are the difference between
+///          the counts of its thread before and after it. Code that hands blocks to other threads makes their counts
+///          look as though they freed more than they allocated.
+class AllocationCounter final : public AllocationHook
+{
+public:
+  void allocated(size_t size) override;
+
+  void freed(size_t size) override;
+
+  /// @brief The allocations made so far by the calling thread, while any counter was installed.
+  [[nodiscard]] static auto thread_counts() -> AllocationCounts;
+
+  /// @brief The allocations made so far by all threads, while this counter was installed.
+  [[nodiscard]] auto totals() const -> AllocationCounts;
+
+  /// @brief The most bytes that were allocated and not yet freed at any one time, while this counter was installed.
+  [[nodiscard]] auto peak_live_bytes() const -> uint64_t { return peak_live_bytes_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> allocations_{ 0 };
+
+  std::atomic<uint64_t> allocated_bytes_{ 0 };
+
+  std::atomic<uint64_t> freed_bytes_{ 0 };
+
+  /// @brief Signed, since blocks allocated before the counter was installed may be freed while it is.
+  std::atomic<int64_t> live_bytes_{ 0 };
+
+  std::atomic<uint64_t> peak_live_bytes_{ 0 };
+};
+
+/// @brief The most memory that the process has had resident at any one time so far, in bytes.
+[[nodiscard]] auto
+peak_rss() -> uint64_t;
+
+} // namespace nabla
@@ -0,0 +1,280 @@
+#include "module_graph.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+
+namespace nabla {
+
+namespace {
+
+constexpr auto npos = static_cast<size_t>(-1);
+
+} // namespace
+
+auto
+ModuleGraph::add_module(std::string name) -> size_t
+{
+  modules_.emplace_back(Module{ std::move(name), {}, {}, {}, {}, false });
+  return modules_.size() - 1;
+}
+
+void
+ModuleGraph::add_import(const size_t module, std::string name, const Token* token)
+{
+  modules_.at(module).unresolved.emplace_back(Import{ std::move(name), token });
+}
+
+auto
+ModuleGraph::resolve() -> std::vector<ModuleError>
+{
+  std::vector<ModuleError> errors;
+
+  std::map<std::string_view, std::vector<size_t>> by_name;
+
+  for (size_t i = 0; i < modules_.size(); i++) {
+    by_name[modules_[i].name].emplace_back(i);
+  }
+
+  for (size_t i = 0; i < modules_.size(); i++) {
+    auto& m = modules_[i];
+    for (const auto& import : m.unresolved) {
+      const auto it = by_name.find(import.name);
+      if (it == by_name.end()) {
+        errors.emplace_back(ModuleError{ i, Diagnostic{ "no module named '" + import.name + "'", import.token } });
+        m.failed = true;
+      } else if (it->second.size() > 1) {
+        errors.emplace_back(
+          ModuleError{ i, Diagnostic{ "more than one file defines module '" + import.name + "'", import.token } });
+        m.failed = true;
+      } else if (std::find(m.imports.begin(), m.imports.end(), it->second[0]) == m.imports.end()) {
+        m.imports.emplace_back(it->second[0]);
+        m.import_tokens.emplace_back(import.token);
+      }
+    }
+    m.unresolved.clear();
+  }
+
+  const auto components = find_components();
+
+  std::vector<size_t> component_of(modules_.size());
+
+  for (size_t i = 0; i < components.size(); i++) {
+    for (const auto m : components[i]) {
+      component_of[m] = i;
+    }
+  }
+
+  for (const auto& component : components) {
+    const auto start = *std::min_element(component.begin(), component.end());
+
+    const auto& imports = modules_[start].imports;
+
+    const auto self_import = std::find(imports.begin(), imports.end(), start) != imports.end();
+
+    if ((component.size() == 1) && !self_import) {
+      continue;
+    }
+
+    const auto cycle = find_cycle(start, component_of);
+
+    std::string path;
+
+    for (const auto m : cycle) {
+      path += modules_[m].name + " -> ";
+    }
+
+    path += modules_[start].name;
+
+    const auto next = cycle.at(1 % cycle.size());
+
+    const auto edge = std::find(imports.begin(), imports.end(), next) - imports.begin();
+
+    const auto* token = modules_[start].import_tokens[edge];
+
+    errors.emplace_back(ModuleError{ start, Diagnostic{ "import cycle: " + path, token } });
+
+    // The imports within the cycle are dropped, so that the rest of the graph can still be ordered.
+    for (const auto m : component) {
+      auto& member = modules_[m];
+      member.failed = true;
+      for (size_t i = member.imports.size(); i > 0; i--) {
+        if (component_of[member.imports[i - 1]] == component_of[m]) {
+          member.imports.erase(member.imports.begin() + static_cast<std::ptrdiff_t>(i - 1));
+          member.import_tokens.erase(member.import_tokens.begin() + static_cast<std::ptrdiff_t>(i - 1));
+        }
+      }
+    }
+  }
+
+  std::vector<size_t> num_pending(modules_.size());
+
+  for (size_t i = 0; i < modules_.size(); i++) {
+    num_pending[i] = modules_[i].imports.size();
+    for (const auto m : modules_[i].imports) {
+      modules_[m].importers.emplace_back(i);
+    }
+  }
+
+  // Of the modules that are ready, the one that was added first goes next.
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<>> ready;
+
+  for (size_t i = 0; i < modules_.size(); i++) {
+    if (num_pending[i] == 0) {
+      ready.push(i);
+    }
+  }
+
+  order_.clear();
+
+  while (!ready.empty()) {
+    const auto m = ready.top();
+    ready.pop();
+    order_.emplace_back(m);
+    for (const auto importer : modules_[m].importers) {
+      if (--num_pending[importer] == 0) {
+        ready.push(importer);
+      }
+    }
+  }
+
+  std::stable_sort(
+    errors.begin(), errors.end(), [](const ModuleError& a, const ModuleError& b) { return a.module < b.module; });
+
+  return errors;
+}
+
+auto
+ModuleGraph::transitive_imports(const size_t module) const -> std::vector<size_t>
+{
+  std::vector<bool> found(modules_.size());
+
+  std::vector<size_t> pending{ module };
+
+  while (!pending.empty()) {
+    const auto m = pending.back();
+    pending.pop_back();
+    for (const auto i : modules_[m].imports) {
+      if (!found[i]) {
+        found[i] = true;
+        pending.emplace_back(i);
+      }
+    }
+  }
+
+  std::vector<size_t> result;
+
+  for (const auto m : order_) {
+    if (found[m]) {
+      result.emplace_back(m);
+    }
+  }
+
+  return result;
+}
+
+auto
+ModuleGraph::find_components() const -> std::vector<std::vector<size_t>>
+{
+  std::vector<std::vector<size_t>> components;
+
+  std::vector<size_t> index(modules_.size(), npos);
+
+  std::vector<size_t> low_link(modules_.size());
+
+  std::vector<bool> on_stack(modules_.size());
+
+  std::vector<size_t> stack;
+
+  size_t next_index{ 0 };
+
+  // Each frame is a module and the position of the next import of it to visit.
+  std::vector<std::pair<size_t, size_t>> frames;
+
+  const auto enter = [&](const size_t m) {
+    index[m] = low_link[m] = next_index++;
+    stack.emplace_back(m);
+    on_stack[m] = true;
+    frames.emplace_back(m, 0);
+  };
+
+  for (size_t root = 0; root < modules_.size(); root++) {
+    if (index[root] != npos) {
+      continue;
+    }
+
+    enter(root);
+
+    while (!frames.empty()) {
+      const auto m = frames.back().first;
+
+      const auto& imports = modules_[m].imports;
+
+      if (frames.back().second < imports.size()) {
+        const auto next = imports[frames.back().second++];
+        if (index[next] == npos) {
+          enter(next);
+        } else if (on_stack[next]) {
+          low_link[m] = std::min(low_link[m], index[next]);
+        }
+        continue;
+      }
+
+      if (low_link[m] == index[m]) {
+        auto& component = components.emplace_back();
+        while (true) {
+          const auto member = stack.back();
+          stack.pop_back();
+          on_stack[member] = false;
+          component.emplace_back(member);
+          if (member == m) {
+            break;
+          }
+        }
+      }
+
+      frames.pop_back();
+
+      if (!frames.empty()) {
+        const auto parent = frames.back().first;
+        low_link[parent] = std::min(low_link[parent], low_link[m]);
+      }
+    }
+  }
+
+  return components;
+}
+
+auto
+ModuleGraph::find_cycle(const size_t start, const std::vector<size_t>& component_of) const -> std::vector<size_t>
+{
+  std::vector<size_t> parent(modules_.size(), npos);
+
+  std::queue<size_t> pending;
+
+  pending.push(start);
+
+  while (!pending.empty()) {
+    const auto m = pending.front();
+    pending.pop();
+    for (const auto next : modules_[m].imports) {
+      if (next == start) {
+        std::vector<size_t> cycle;
+        for (auto i = m; i != npos; i = parent[i]) {
+          cycle.emplace_back(i);
+        }
+        std::reverse(cycle.begin(), cycle.end());
+        return cycle;
+      }
+      if ((component_of[next] == component_of[start]) && (parent[next] == npos)) {
+        parent[next] = m;
+        pending.push(next);
+      }
+    }
+  }
+
+  return { start };
+}
+
+} // namespace nabla
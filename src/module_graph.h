@@ -0,0 +1,101 @@
+#pragma once
+
+#include "diagnostics.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class Token;
+
+/// @brief A problem with the imports of a module.
+struct ModuleError final
+{
+  size_t module{ 0 };
+
+  Diagnostic diagnostic;
+};
+
+/// @brief The modules of a program and the imports between them.
+///
+/// @details Modules are numbered in the order that they are added, which is kept to wherever the imports allow, so that
+///          the order of the modules only depends on the program.
+class ModuleGraph final
+{
+  struct Import final
+  {
+    std::string name;
+
+    const Token* token{ nullptr };
+  };
+
+  struct Module final
+  {
+    std::string name;
+
+    std::vector<Import> unresolved;
+
+    /// @brief The modules that this one imports, each one once.
+    std::vector<size_t> imports;
+
+    /// @brief The token of the first import of each module in @ref Module::imports.
+    std::vector<const Token*> import_tokens;
+
+    std::vector<size_t> importers;
+
+    /// @brief Whether the imports of this module are broken, in which case it should not be compiled.
+    bool failed{ false };
+  };
+
+  std::vector<Module> modules_;
+
+  std::vector<size_t> order_;
+
+public:
+  /// @return The number of the module.
+  [[nodiscard]] auto add_module(std::string name) -> size_t;
+
+  /// @param token The token that diagnostics about the import point to.
+  void add_import(size_t module, std::string name, const Token* token);
+
+  /// @brief Resolves the imports by name and orders the modules, so that each module comes after those it imports.
+  ///
+  /// @details Importing a module that doesn't exist, or that more than one module has the name of, is an error. So is
+  ///          each cycle of imports, which is reported once, and which the modules on it are taken out of.
+  ///
+  /// @return The errors, in the order of the modules that they are about. Those modules are marked as failed.
+  [[nodiscard]] auto resolve() -> std::vector<ModuleError>;
+
+  [[nodiscard]] auto size() const -> size_t { return modules_.size(); }
+
+  [[nodiscard]] auto name(size_t module) const -> const std::string& { return modules_.at(module).name; }
+
+  [[nodiscard]] auto failed(size_t module) const -> bool { return modules_.at(module).failed; }
+
+  /// @brief The modules that a module imports directly.
+  [[nodiscard]] auto imports(size_t module) const -> const std::vector<size_t>& { return modules_.at(module).imports; }
+
+  /// @brief The modules that import a module directly.
+  [[nodiscard]] auto importers(size_t module) const -> const std::vector<size_t>&
+  {
+    return modules_.at(module).importers;
+  }
+
+  /// @brief The modules that a module imports directly or through other modules, in the order of @ref order.
+  [[nodiscard]] auto transitive_imports(size_t module) const -> std::vector<size_t>;
+
+  /// @brief Every module, with each one after the modules that it imports.
+  [[nodiscard]] auto order() const -> const std::vector<size_t>& { return order_; }
+
+protected:
+  /// @brief Finds the strongly connected components with Tarjan's algorithm, without recursing.
+  [[nodiscard]] auto find_components() const -> std::vector<std::vector<size_t>>;
+
+  /// @brief Finds the shortest cycle through a module, within its component.
+  [[nodiscard]] auto find_cycle(size_t start, const std::vector<size_t>& component_of) const -> std::vector<size_t>;
+};
+
+} // namespace nabla
@@ -0,0 +1,575 @@
+#include "module_interface.h"
+
+#include "frontend.h"
+#include "hash.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nabla {
+
+namespace {
+
+/// @brief Starts every interface. The last byte is the version of the format.
+constexpr std::string_view magic{ "NABLAI\0\1", 8 };
+
+/// @brief How deeply expressions may nest, which keeps a damaged file from exhausting the stack.
+constexpr size_t max_depth = 4096;
+
+enum class NodeTag : uint32_t
+{
+  decl,
+  struct_
+};
+
+enum class ExprTag : uint32_t
+{
+  int_literal,
+  float_literal,
+  string_literal,
+  var,
+  call,
+  add,
+  mul
+};
+
+/// @brief The flags of a declaration.
+enum DeclFlags : uint32_t
+{
+  has_value = 1,
+  has_type = 2,
+  immutable = 4
+};
+
+/// @brief Stands for a missing name of a named argument.
+constexpr uint32_t no_token = ~static_cast<uint32_t>(0);
+
+void
+put_u32(std::string& out, const uint32_t value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void
+put_u64(std::string& out, const uint64_t value)
+{
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/// @brief Encodes the exported nodes into words, collecting the tokens that they refer to.
+class Encoder final
+  : public NodeVisitor
+  , public ExprVisitor
+{
+public:
+  std::vector<uint32_t> words;
+
+  std::vector<const Token*> tokens;
+
+  void visit(const DeclNode& node) override
+  {
+    tag(NodeTag::decl);
+    decl(node);
+  }
+
+  void visit(const StructNode& node) override
+  {
+    tag(NodeTag::struct_);
+    token(node.name());
+    words.emplace_back(static_cast<uint32_t>(node.fields().size()));
+    for (const auto& field : node.fields()) {
+      decl(*field);
+    }
+  }
+
+  void visit(const PrintNode&) override {}
+
+  void visit(const FuncNode&) override {}
+
+  void visit(const ReturnNode&) override {}
+
+  void visit(const ImportNode&) override {}
+
+  void visit(const IntLiteralExpr& expr) override
+  {
+    tag(ExprTag::int_literal);
+    token(expr.token());
+  }
+
+  void visit(const FloatLiteralExpr& expr) override
+  {
+    tag(ExprTag::float_literal);
+    token(expr.token());
+  }
+
+  void visit(const StringLiteralExpr& expr) override
+  {
+    tag(ExprTag::string_literal);
+    token(expr.token());
+  }
+
+  void visit(const VarExpr& expr) override
+  {
+    tag(ExprTag::var);
+    token(expr.get_name());
+  }
+
+  void visit(const CallExpr& expr) override
+  {
+    tag(ExprTag::call);
+    token(expr.name());
+    words.emplace_back(static_cast<uint32_t>(expr.args().size()));
+    for (const auto& [name, value] : expr.args()) {
+      if (name) {
+        token(*name);
+      } else {
+        words.emplace_back(no_token);
+      }
+      value->accept(*this);
+    }
+  }
+
+  void visit(const AddExpr& expr) override
+  {
+    tag(ExprTag::add);
+    binary(expr);
+  }
+
+  void visit(const MulExpr& expr) override
+  {
+    tag(ExprTag::mul);
+    binary(expr);
+  }
+
+protected:
+  template<typename Tag>
+  void tag(const Tag t)
+  {
+    words.emplace_back(static_cast<uint32_t>(t));
+  }
+
+  void token(const Token& t)
+  {
+    words.emplace_back(static_cast<uint32_t>(tokens.size()));
+    tokens.emplace_back(&t);
+  }
+
+  void decl(const DeclNode& node)
+  {
+    token(node.get_name());
+    uint32_t flags{ 0 };
+    flags |= node.has_value() ? static_cast<uint32_t>(DeclFlags::has_value) : 0u;
+    flags |= node.has_type() ? static_cast<uint32_t>(DeclFlags::has_type) : 0u;
+    flags |= node.is_immutable() ? static_cast<uint32_t>(DeclFlags::immutable) : 0u;
+    words.emplace_back(flags);
+    if (node.has_type()) {
+      const auto& type = node.get_type();
+      token(type.name());
+      words.emplace_back(static_cast<uint32_t>(type.args().size()));
+      for (const auto& arg : type.args()) {
+        arg->accept(*this);
+      }
+    }
+    if (node.has_value()) {
+      node.get_value().accept(*this);
+    }
+  }
+
+  template<typename Derived>
+  void binary(const BinaryExpr<Derived>& expr)
+  {
+    token(expr.op_token());
+    expr.left().accept(*this);
+    expr.right().accept(*this);
+  }
+};
+
+/// @brief Reads the fields of an interface, checking that they stay within it.
+class Reader final
+{
+  std::string_view data_;
+
+public:
+  explicit Reader(const std::string_view& data)
+    : data_(data)
+  {
+  }
+
+  template<typename T>
+  [[nodiscard]] auto read(T& value) -> bool
+  {
+    if (data_.size() < sizeof(value)) {
+      return false;
+    }
+    memcpy(&value, data_.data(), sizeof(value));
+    data_.remove_prefix(sizeof(value));
+    return true;
+  }
+
+  [[nodiscard]] auto bytes(const uint64_t size, std::string_view& value) -> bool
+  {
+    if (data_.size() < size) {
+      return false;
+    }
+    value = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+  [[nodiscard]] auto done() const -> bool { return data_.empty(); }
+};
+
+/// @brief Builds nodes from the words of an interface. Once anything is out of range, decoding fails, and the nodes
+///        built so far are only good for being destroyed.
+class Decoder final
+{
+  std::string_view words_;
+
+  const std::vector<Token>* tokens_;
+
+  bool failed_{ false };
+
+  /// @brief What the nodes refer to in place of a token that is out of range.
+  Token invalid_token_;
+
+public:
+  Decoder(const std::string_view& words, const std::vector<Token>* tokens)
+    : words_(words)
+    , tokens_(tokens)
+  {
+  }
+
+  [[nodiscard]] auto failed() const -> bool { return failed_; }
+
+  [[nodiscard]] auto done() const -> bool { return words_.empty(); }
+
+  [[nodiscard]] auto node() -> NodePtr
+  {
+    const auto tag = static_cast<NodeTag>(word());
+
+    switch (tag) {
+      case NodeTag::decl:
+        return decl();
+      case NodeTag::struct_: {
+        const auto& name = token();
+        std::vector<std::unique_ptr<DeclNode>> fields(count());
+        for (auto& field : fields) {
+          field = decl();
+        }
+        return std::make_unique<StructNode>(&name, std::move(fields));
+      }
+    }
+
+    failed_ = true;
+
+    return nullptr;
+  }
+
+protected:
+  [[nodiscard]] auto word() -> uint32_t
+  {
+    uint32_t value{ 0 };
+    if (words_.size() < sizeof(value)) {
+      failed_ = true;
+      return value;
+    }
+    memcpy(&value, words_.data(), sizeof(value));
+    words_.remove_prefix(sizeof(value));
+    return value;
+  }
+
+  /// @brief Reads the number of things that follow, each of which takes at least a word.
+  [[nodiscard]] auto count() -> size_t
+  {
+    const auto value = word();
+    if (value > (words_.size() / sizeof(uint32_t))) {
+      failed_ = true;
+      return 0;
+    }
+    return value;
+  }
+
+  [[nodiscard]] auto token() -> const Token& { return token(word()); }
+
+  [[nodiscard]] auto token(const uint32_t index) -> const Token&
+  {
+    if (index >= tokens_->size()) {
+      failed_ = true;
+      return invalid_token_;
+    }
+    return (*tokens_)[index];
+  }
+
+  [[nodiscard]] auto decl() -> std::unique_ptr<DeclNode>
+  {
+    const auto& name = token();
+
+    const auto flags = word();
+
+    std::unique_ptr<TypeInstance> type;
+
+    if ((flags & static_cast<uint32_t>(DeclFlags::has_type)) != 0u) {
+      const auto& type_name = token();
+      std::vector<ExprPtr> args(count());
+      for (auto& arg : args) {
+        arg = expr(0);
+      }
+      type = std::make_unique<TypeInstance>(&type_name, std::move(args));
+    }
+
+    auto value = ((flags & static_cast<uint32_t>(DeclFlags::has_value)) != 0u) ? expr(0) : nullptr;
+
+    const auto immutable = (flags & static_cast<uint32_t>(DeclFlags::immutable)) != 0u;
+
+    return std::make_unique<DeclNode>(name, std::move(value), immutable, std::move(type));
+  }
+
+  [[nodiscard]] auto expr(const size_t depth) -> ExprPtr
+  {
+    if (failed_ || (depth > max_depth)) {
+      failed_ = true;
+      return std::make_unique<IntLiteralExpr>(&invalid_token_);
+    }
+
+    const auto tag = static_cast<ExprTag>(word());
+
+    switch (tag) {
+      case ExprTag::int_literal:
+        return std::make_unique<IntLiteralExpr>(&token());
+      case ExprTag::float_literal:
+        return std::make_unique<FloatLiteralExpr>(&token());
+      case ExprTag::string_literal:
+        return std::make_unique<StringLiteralExpr>(&token());
+      case ExprTag::var:
+        return std::make_unique<VarExpr>(token());
+      case ExprTag::call: {
+        const auto& name = token();
+        std::vector<CallExpr::NamedArg> args(count());
+        for (auto& [arg_name, value] : args) {
+          const auto index = word();
+          arg_name = (index == no_token) ? nullptr : &token(index);
+          value = expr(depth + 1);
+        }
+        return std::make_unique<CallExpr>(&name, std::move(args));
+      }
+      case ExprTag::add: {
+        const auto& op = token();
+        auto left = expr(depth + 1);
+        auto right = expr(depth + 1);
+        return std::make_unique<AddExpr>(std::move(left), std::move(right), &op);
+      }
+      case ExprTag::mul: {
+        const auto& op = token();
+        auto left = expr(depth + 1);
+        auto right = expr(depth + 1);
+        return std::make_unique<MulExpr>(std::move(left), std::move(right), &op);
+      }
+    }
+
+    failed_ = true;
+
+    return std::make_unique<IntLiteralExpr>(&invalid_token_);
+  }
+};
+
+} // namespace
+
+ModuleInterface::~ModuleInterface()
+{
+  // The nodes refer to the tokens, which refer to the data, so they go first.
+  nodes_.clear();
+
+  if (mapping_) {
+    munmap(mapping_, mapping_size_);
+  }
+}
+
+auto
+ModuleInterface::encode(const TranslationUnit& unit) -> std::string
+{
+  Encoder encoder;
+
+  for (size_t i = unit.num_imported_nodes; i < unit.tree.nodes.size(); i++) {
+    unit.tree.nodes[i]->accept(encoder);
+  }
+
+  // The tokens are split into what they are and where they are, so that the two can be hashed separately.
+  std::string shape;
+
+  std::string positions;
+
+  std::string text;
+
+  for (const auto* token : encoder.tokens) {
+    put_u32(shape, static_cast<uint32_t>(token->kind));
+    put_u32(shape, static_cast<uint32_t>(token->data.size()));
+    put_u32(positions, static_cast<uint32_t>(token->line));
+    put_u32(positions, static_cast<uint32_t>(token->column));
+    text += token->data;
+  }
+
+  const std::string_view words(reinterpret_cast<const char*>(encoder.words.data()),
+                               encoder.words.size() * sizeof(uint32_t));
+
+  const auto hash = xxhash64(text, xxhash64(words, xxhash64(shape)));
+
+  std::string data(magic);
+
+  put_u64(data, hash);
+  put_u64(data, xxhash64(positions));
+  put_u64(data, encoder.tokens.size());
+  put_u64(data, encoder.words.size());
+  put_u64(data, unit.filename.size());
+  put_u64(data, unit.module_name.size());
+  put_u64(data, text.size());
+  data += shape;
+  data += positions;
+  data += words;
+  data += unit.filename;
+  data += unit.module_name;
+  data += text;
+  put_u64(data, xxhash64(data));
+
+  return data;
+}
+
+auto
+ModuleInterface::decode(std::string data) -> std::shared_ptr<const ModuleInterface>
+{
+  std::shared_ptr<ModuleInterface> interface(new ModuleInterface());
+
+  interface->data_ = std::move(data);
+
+  if (!interface->decode_data(interface->data_)) {
+    return nullptr;
+  }
+
+  return interface;
+}
+
+auto
+ModuleInterface::map(const std::filesystem::path& path) -> std::shared_ptr<const ModuleInterface>
+{
+  const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info
+  {};
+
+  void* mapping{ MAP_FAILED };
+
+  if ((fstat(fd, &info) == 0) && (info.st_size > 0)) {
+    mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+
+  // The mapping stays valid after the file is closed, and after it is replaced or removed.
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::shared_ptr<ModuleInterface> interface(new ModuleInterface());
+
+  interface->mapping_ = mapping;
+
+  interface->mapping_size_ = static_cast<size_t>(info.st_size);
+
+  if (!interface->decode_data(std::string_view(static_cast<const char*>(mapping), interface->mapping_size_))) {
+    return nullptr;
+  }
+
+  return interface;
+}
+
+auto
+ModuleInterface::decode_data(const std::string_view data) -> bool
+{
+  if ((data.size() < (magic.size() + sizeof(uint64_t))) || (data.substr(0, magic.size()) != magic)) {
+    return false;
+  }
+
+  const auto body = data.substr(0, data.size() - sizeof(uint64_t));
+
+  uint64_t checksum{};
+
+  memcpy(&checksum, data.data() + body.size(), sizeof(checksum));
+
+  if (xxhash64(body) != checksum) {
+    return false;
+  }
+
+  Reader reader(body.substr(magic.size()));
+
+  uint64_t num_tokens{};
+  uint64_t num_words{};
+  uint64_t filename_size{};
+  uint64_t module_name_size{};
+  uint64_t text_size{};
+
+  if (!reader.read(hash_) || !reader.read(position_hash_) || !reader.read(num_tokens) || !reader.read(num_words) ||
+      !reader.read(filename_size) || !reader.read(module_name_size) || !reader.read(text_size)) {
+    return false;
+  }
+
+  // Each token takes two words of shape and two of position, which bounds the sizes before anything is multiplied.
+  if ((num_tokens > body.size()) || (num_words > body.size())) {
+    return false;
+  }
+
+  std::string_view shape;
+  std::string_view positions;
+  std::string_view words;
+
+  if (!reader.bytes(num_tokens * 2 * sizeof(uint32_t), shape) ||
+      !reader.bytes(num_tokens * 2 * sizeof(uint32_t), positions) ||
+      !reader.bytes(num_words * sizeof(uint32_t), words) || !reader.bytes(filename_size, filename_) ||
+      !reader.bytes(module_name_size, module_name_) || !reader.bytes(text_size, text_) || !reader.done()) {
+    return false;
+  }
+
+  Reader shape_reader(shape);
+
+  Reader position_reader(positions);
+
+  tokens_.resize(num_tokens);
+
+  size_t offset{ 0 };
+
+  for (auto& token : tokens_) {
+    uint32_t kind{};
+    uint32_t size{};
+    uint32_t line{};
+    uint32_t column{};
+    (void)shape_reader.read(kind);
+    (void)shape_reader.read(size);
+    (void)position_reader.read(line);
+    (void)position_reader.read(column);
+    if ((kind > static_cast<uint32_t>(TK::symbol)) || (size > (text_.size() - offset))) {
+      return false;
+    }
+    token.kind = static_cast<TokenKind>(kind);
+    token.data = text_.substr(offset, size);
+    token.line = line;
+    token.column = column;
+    offset += size;
+  }
+
+  Decoder decoder(words, &tokens_);
+
+  while (!decoder.done() && !decoder.failed()) {
+    auto node = decoder.node();
+    if (node) {
+      nodes_.emplace_back(std::move(node));
+    }
+  }
+
+  return !decoder.failed();
+}
+
+} // namespace nabla
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "lexer.h"
+#include "syntax_tree.h"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla {
+
+struct TranslationUnit;
+
+/// @brief What a module makes visible to the modules that import it, which is the layouts of its structs and its
+///        global declarations.
+///
+/// @details An interface is stored as a compact binary file, made of a table of the tokens that its declarations refer
+///          to and a stream of words that encodes the declarations themselves. Decoding it builds the nodes straight
+///          from that stream, with tokens pointing into the file, so a module is imported without reading or parsing
+///          its source. Interface files are mapped into memory rather than read.
+///
+///          Functions are left out, since their return types are deduced from their bodies, so there is no signature
+///          that could be imported without the body. The types of globals are left out too, since importers annotate
+///          the declarations that they copy, and those types follow from the initializers anyway.
+class ModuleInterface final
+{
+public:
+  ModuleInterface(const ModuleInterface&) = delete;
+
+  auto operator=(const ModuleInterface&) -> ModuleInterface& = delete;
+
+  ~ModuleInterface();
+
+  /// @brief Encodes the interface of a parsed translation unit. Declarations copied from imported modules are left
+  ///        out, since importers get those from the modules that they come from.
+  [[nodiscard]] static auto encode(const TranslationUnit& unit) -> std::string;
+
+  /// @brief Decodes an interface that is held in memory.
+  ///
+  /// @return Null if the data is not a valid interface.
+  [[nodiscard]] static auto decode(std::string data) -> std::shared_ptr<const ModuleInterface>;
+
+  /// @brief Maps an interface file into memory and decodes it.
+  ///
+  /// @return Null if the file does not exist or is not a valid interface.
+  [[nodiscard]] static auto map(const std::filesystem::path& path) -> std::shared_ptr<const ModuleInterface>;
+
+  /// @brief A hash of the declarations, which changes whenever the code of modules that import this one would.
+  ///
+  /// @note This does not cover where the declarations are in the file, which only matters to line directives. See @ref
+  ///       ModuleInterface::position_hash for that.
+  [[nodiscard]] auto hash() const -> uint64_t { return hash_; }
+
+  /// @brief A hash of the lines and columns of the tokens of the declarations.
+  [[nodiscard]] auto position_hash() const -> uint64_t { return position_hash_; }
+
+  [[nodiscard]] auto filename() const -> std::string_view { return filename_; }
+
+  [[nodiscard]] auto module_name() const -> std::string_view { return module_name_; }
+
+  /// @brief The declarations, which are struct and declaration nodes.
+  [[nodiscard]] auto nodes() const -> const std::vector<NodePtr>& { return nodes_; }
+
+  /// @brief The text that the tokens point into, which stands in for the source of the module in line directives.
+  [[nodiscard]] auto text() const -> std::string_view { return text_; }
+
+private:
+  ModuleInterface() = default;
+
+  /// @brief Decodes the data, which must stay where it is for as long as the interface exists.
+  [[nodiscard]] auto decode_data(std::string_view data) -> bool;
+
+  /// @brief The data, when it was decoded from memory.
+  std::string data_;
+
+  /// @brief The mapping, when the data was mapped from a file.
+  void* mapping_{ nullptr };
+
+  size_t mapping_size_{ 0 };
+
+  uint64_t hash_{ 0 };
+
+  uint64_t position_hash_{ 0 };
+
+  std::string_view filename_;
+
+  std::string_view module_name_;
+
+  std::string_view text_;
+
+  /// @brief The tokens that the nodes point to, which is never resized once the nodes are built.
+  std::vector<Token> tokens_;
+
+  std::vector<NodePtr> nodes_;
+};
+
+} // namespace nabla
@@ -0,0 +1,246 @@
+#include "native_build.h"
+
+#include "console.h"
+#include "hash.h"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <system_error>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace nabla {
+
+namespace {
+
+/// @brief Flags that give generated code the semantics of nabla, so they are passed along with any that the user
+///        gives. Integer arithmetic wraps around (so the compiler shouldn't warn about it), and a multiply is only
+///        fused with an add where the code says so.
+const char* const semantic_flags[]{ "-fwrapv", "-Wno-overflow", "-ffp-contract=off" };
+
+[[nodiscard]] auto
+read_file(const std::filesystem::path& path) -> std::string
+{
+  std::ifstream file(path, std::ios::binary);
+  std::ostringstream stream;
+  stream << file.rdbuf();
+  return stream.str();
+}
+
+/// @brief Writes a file, unless it already has the same contents, so that its timestamp only changes with it.
+[[nodiscard]] auto
+update_file(const std::filesystem::path& path, const std::string& contents) -> bool
+{
+  if (std::filesystem::exists(path) && (read_file(path) == contents)) {
+    return true;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  file << contents;
+  return file.good();
+}
+
+/// @brief Starts a process, looking up the program in PATH.
+///
+/// @return The ID of the process, or -1 if it could not be started.
+[[nodiscard]] auto
+spawn(const std::vector<std::string>& args) -> pid_t
+{
+  std::vector<char*> argv;
+
+  for (const auto& arg : args) {
+    argv.emplace_back(const_cast<char*>(arg.c_str()));
+  }
+
+  argv.emplace_back(nullptr);
+
+  pid_t pid{ -1 };
+
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+    return -1;
+  }
+
+  return pid;
+}
+
+[[nodiscard]] auto
+succeeded(const int status) -> bool
+{
+  return WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+} // namespace
+
+NativeBuild::NativeBuild(NativeBuildOptions options)
+  : options_(std::move(options))
+{
+  if (options_.jobs == 0) {
+    options_.jobs = 1;
+  }
+}
+
+void
+NativeBuild::add_unit(std::string name, std::string source)
+{
+  units_.emplace_back(Unit{ std::move(name), std::move(source) });
+}
+
+void
+NativeBuild::add_header(std::string name, std::string source)
+{
+  headers_.emplace_back(Unit{ std::move(name), std::move(source) });
+}
+
+auto
+NativeBuild::link(const std::filesystem::path& output, Console& console) -> bool
+{
+  num_compiled_ = 0;
+  num_cached_ = 0;
+
+  const auto src_dir = options_.build_dir / "src";
+  const auto obj_dir = options_.build_dir / "obj";
+
+  std::error_code error;
+  std::filesystem::create_directories(src_dir, error);
+  std::filesystem::create_directories(obj_dir, error);
+  if (error) {
+    console.print_file_error(options_.build_dir.string(), "failed to create build directory: " + error.message());
+    return false;
+  }
+
+  // Everything other than the source that affects the object file.
+  auto base_hash = hash64(options_.compiler);
+  for (const auto* flag : semantic_flags) {
+    base_hash = hash64(flag, hash64(std::string_view("\0", 1), base_hash));
+  }
+  for (const auto& flag : options_.flags) {
+    base_hash = hash64(flag, hash64(std::string_view("\0", 1), base_hash));
+  }
+  base_hash = hash64(read_file(std::filesystem::path(NABLA_RT_INCLUDE_DIR) / "nabla_rt.h"), base_hash);
+
+  for (const auto& header : headers_) {
+    base_hash = hash64(header.source, hash64(header.name, base_hash));
+
+    const auto path = src_dir / header.name;
+    if (!update_file(path, header.source)) {
+      console.print_file_error(path.string(), "failed to write generated header");
+      return false;
+    }
+  }
+
+  struct Job final
+  {
+    const Unit* unit{ nullptr };
+
+    std::filesystem::path object;
+
+    std::filesystem::path temp;
+  };
+
+  std::vector<Job> pending;
+  std::vector<std::filesystem::path> objects;
+
+  for (const auto& unit : units_) {
+    const auto object = obj_dir / (hash_to_hex(hash64(unit.source, base_hash)) + ".o");
+    objects.emplace_back(object);
+    if (std::filesystem::exists(object)) {
+      num_cached_++;
+      continue;
+    }
+    auto temp = object;
+    temp += ".tmp." + std::to_string(getpid());
+    pending.emplace_back(Job{ &unit, object, temp });
+  }
+
+  auto failed{ false };
+
+  std::vector<std::pair<pid_t, Job>> running;
+
+  while (!pending.empty() || !running.empty()) {
+    while (!failed && !pending.empty() && (running.size() < options_.jobs)) {
+      auto job = std::move(pending.back());
+      pending.pop_back();
+
+      const auto source_path = src_dir / (job.unit->name + ".cpp");
+      if (!update_file(source_path, job.unit->source)) {
+        console.print_file_error(source_path.string(), "failed to write generated source");
+        failed = true;
+        break;
+      }
+
+      std::vector<std::string> args{ options_.compiler };
+      args.insert(args.end(), std::begin(semantic_flags), std::end(semantic_flags));
+      args.insert(args.end(), options_.flags.begin(), options_.flags.end());
+      args.insert(args.end(), { "-I", NABLA_RT_INCLUDE_DIR, "-c", source_path.string(), "-o", job.temp.string() });
+
+      const auto pid = spawn(args);
+      if (pid < 0) {
+        console.print_error("failed to run '" + options_.compiler + "'");
+        failed = true;
+        break;
+      }
+
+      running.emplace_back(pid, std::move(job));
+    }
+
+    if (running.empty()) {
+      break;
+    }
+
+    int status{ 0 };
+    const auto pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      console.print_error("failed to wait for the compiler");
+      return false;
+    }
+
+    for (auto it = running.begin(); it != running.end(); ++it) {
+      if (it->first != pid) {
+        continue;
+      }
+      // Objects are only put in the cache once they are complete, so that an interrupted build cannot poison it.
+      if (succeeded(status)) {
+        std::filesystem::rename(it->second.temp, it->second.object, error);
+        num_compiled_++;
+      }
+      if (!succeeded(status) || error) {
+        std::filesystem::remove(it->second.temp, error);
+        failed = true;
+      }
+      running.erase(it);
+      break;
+    }
+  }
+
+  if (failed) {
+    return false;
+  }
+
+  std::vector<std::string> args{ options_.compiler };
+  args.insert(args.end(), options_.flags.begin(), options_.flags.end());
+  for (const auto& object : objects) {
+    args.emplace_back(object.string());
+  }
+  args.insert(args.end(), { NABLA_RT_LIBRARY, "-o", output.string() });
+
+  const auto pid = spawn(args);
+  if (pid < 0) {
+    console.print_error("failed to run '" + options_.compiler + "'");
+    return false;
+  }
+
+  int status{ 0 };
+  if ((waitpid(pid, &status, 0) < 0) || !succeeded(status)) {
+    console.print_file_error(output.string(), "failed to link");
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace nabla
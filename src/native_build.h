@@ -0,0 +1,77 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+class Console;
+
+struct NativeBuildOptions final
+{
+  /// @brief The C++ compiler to run, which is looked up in PATH unless it is a path.
+  std::string compiler{ "c++" };
+
+  /// @brief Passed to the compiler when compiling and when linking.
+  std::vector<std::string> flags{ "-O2" };
+
+  /// @brief Where translation units and cached object files are written.
+  std::filesystem::path build_dir{ ".nabla-build" };
+
+  /// @brief The most compilers to run at the same time.
+  size_t jobs{ 1 };
+};
+
+/// @brief Builds an executable out of generated C++ translation units, using the system C++ compiler.
+///
+/// @details Object files are cached in the build directory, keyed on a hash of the source, the compiler and its flags,
+///          and the headers. Units whose object is cached are not compiled again. The others are compiled in
+///          parallel, and the objects are linked with the nabla runtime library.
+class NativeBuild final
+{
+  struct Unit final
+  {
+    std::string name;
+
+    std::string source;
+  };
+
+  NativeBuildOptions options_;
+
+  std::vector<Unit> units_;
+
+  std::vector<Unit> headers_;
+
+  size_t num_compiled_{ 0 };
+
+  size_t num_cached_{ 0 };
+
+public:
+  explicit NativeBuild(NativeBuildOptions options);
+
+  /// @brief Adds a translation unit to the program.
+  ///
+  /// @param name A name for the unit that is unique within the program. It is used as the name of its source file.
+  void add_unit(std::string name, std::string source);
+
+  /// @brief Adds a header, which units can include by name since it is written next to them.
+  ///
+  /// @note Every header is part of the cache key of every unit, so changing one compiles all of them again.
+  void add_header(std::string name, std::string source);
+
+  /// @brief Compiles the units that are not cached yet, and links the program.
+  ///
+  /// @return False if compiling or linking failed. The compiler reports its own errors on standard error.
+  [[nodiscard]] auto link(const std::filesystem::path& output, Console& console) -> bool;
+
+  /// @brief The number of units compiled by the last call to @ref NativeBuild::link.
+  [[nodiscard]] auto num_compiled() const -> size_t { return num_compiled_; }
+
+  /// @brief The number of units that the last call to @ref NativeBuild::link found in the cache.
+  [[nodiscard]] auto num_cached() const -> size_t { return num_cached_; }
+};
+
+} // namespace nabla
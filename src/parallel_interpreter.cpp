@@ -0,0 +1,466 @@
+#include "parallel_interpreter.h"
+
+#include "passes/remap.h"
+#include "thread_pool.h"
+#include "value.h"
+
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace nabla {
+
+namespace {
+
+constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+/// @brief A group of statements that are executed in one go.
+struct Task final
+{
+  /// @brief The range of @ref Schedule::order that the statements of this task are in.
+  size_t begin{ 0 };
+
+  size_t end{ 0 };
+
+  /// @brief The tasks that cannot start until this one has finished.
+  std::vector<size_t> successors;
+
+  uint32_t num_predecessors{ 0 };
+};
+
+struct Schedule final
+{
+  /// @brief Statement indices, grouped by task.
+  std::vector<size_t> order;
+
+  std::vector<Task> tasks;
+
+  std::vector<size_t> roots;
+
+  size_t num_values{ 0 };
+};
+
+/// @brief Describes what each statement reads and writes, for building the dependency graph.
+class DependencyCollector final : public ast::StmtVisitor
+{
+public:
+  enum class Kind
+  {
+    assign,
+    print,
+    print_end
+  };
+
+  Kind kind{ Kind::assign };
+
+  /// @brief The value that is assigned or printed.
+  size_t id{ 0 };
+
+  Operands operands;
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    kind = Kind::assign;
+    id = stmt.id();
+    operands = operands_of(stmt.value());
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    kind = Kind::print;
+    id = stmt.id();
+    operands = Operands{};
+  }
+
+  void visit(const ast::PrintEndStmt&) override
+  {
+    kind = Kind::print_end;
+    operands = Operands{};
+  }
+};
+
+class ScheduleBuilder final
+{
+  const ast::Module* module_;
+
+  size_t task_cost_;
+
+  std::vector<DependencyCollector::Kind> kinds_;
+
+  std::vector<Operands> operands_;
+
+  /// @brief The index of the statement that assigns each value.
+  std::vector<size_t> producers_;
+
+  std::vector<size_t> task_of_stmt_;
+
+  Schedule schedule_;
+
+public:
+  ScheduleBuilder(const ast::Module* m, const size_t task_cost)
+    : module_(m)
+    , task_cost_(std::max<size_t>(task_cost, 1))
+  {
+  }
+
+  [[nodiscard]] auto build() -> Schedule
+  {
+    collect();
+    order_values();
+    add_print_tasks();
+    link();
+    return std::move(schedule_);
+  }
+
+protected:
+  void collect()
+  {
+    const auto& stmts = module_->stmts;
+
+    DependencyCollector collector;
+
+    kinds_.resize(stmts.size());
+    operands_.resize(stmts.size());
+    task_of_stmt_.resize(stmts.size(), npos);
+
+    for (size_t i = 0; i < stmts.size(); i++) {
+      stmts[i]->accept(collector);
+      kinds_[i] = collector.kind;
+      operands_[i] = collector.operands;
+      if (collector.kind == DependencyCollector::Kind::assign) {
+        if (producers_.size() <= collector.id) {
+          producers_.resize(collector.id + 1, npos);
+        }
+        producers_[collector.id] = i;
+      } else if (collector.kind == DependencyCollector::Kind::print) {
+        // Printing reads a value, which is a dependency like any other.
+        operands_[i].ids[0] = collector.id;
+        operands_[i].size = 1;
+      }
+    }
+
+    schedule_.num_values = producers_.size();
+  }
+
+  /// @brief Orders the assignments depth first, starting from the values that no other assignment reads.
+  void order_values()
+  {
+    const auto& stmts = module_->stmts;
+
+    std::vector<bool> has_users(stmts.size(), false);
+
+    for (size_t i = 0; i < stmts.size(); i++) {
+      if (kinds_[i] == DependencyCollector::Kind::assign) {
+        for (const auto id : operands_[i]) {
+          has_users[producers_[id]] = true;
+        }
+      }
+    }
+
+    std::vector<bool> visited(stmts.size(), false);
+
+    std::vector<std::pair<size_t, size_t>> stack;
+
+    for (size_t i = 0; i < stmts.size(); i++) {
+      if ((kinds_[i] != DependencyCollector::Kind::assign) || has_users[i]) {
+        continue;
+      }
+
+      // Each entry is a statement and the number of its operands visited so far.
+      stack.emplace_back(i, 0);
+      visited[i] = true;
+
+      while (!stack.empty()) {
+        auto& [stmt, next] = stack.back();
+        if (next < operands_[stmt].size) {
+          const auto operand = producers_[operands_[stmt].ids[next++]];
+          if (!visited[operand]) {
+            visited[operand] = true;
+            stack.emplace_back(operand, 0);
+          }
+          continue;
+        }
+        append(stmt);
+        stack.pop_back();
+      }
+    }
+
+    close_task();
+  }
+
+  /// @brief Groups consecutive prints into tasks, each of which follows the previous one.
+  void add_print_tasks()
+  {
+    const auto& stmts = module_->stmts;
+
+    auto previous = npos;
+
+    for (size_t i = 0; i < stmts.size(); i++) {
+      if (kinds_[i] == DependencyCollector::Kind::assign) {
+        previous = close_task(previous);
+        continue;
+      }
+      append(i);
+    }
+
+    close_task(previous);
+  }
+
+  /// @brief Adds a statement to the open task, opening a new task if needed.
+  void append(const size_t stmt)
+  {
+    if (schedule_.tasks.empty() || (schedule_.tasks.back().end != npos)) {
+      Task task;
+      task.begin = schedule_.order.size();
+      task.end = npos;
+      schedule_.tasks.emplace_back(std::move(task));
+    }
+
+    task_of_stmt_[stmt] = schedule_.tasks.size() - 1;
+
+    schedule_.order.emplace_back(stmt);
+
+    if ((kinds_[stmt] == DependencyCollector::Kind::assign) &&
+        ((schedule_.order.size() - schedule_.tasks.back().begin) >= task_cost_)) {
+      close_task();
+    }
+  }
+
+  /// @brief Ends the open task, if there is one.
+  ///
+  /// @param previous The print task that the open task has to follow, if it is a print task.
+  ///
+  /// @return The index of the task that was closed, or @p previous if no task was open.
+  auto close_task(const size_t previous = npos) -> size_t
+  {
+    if (schedule_.tasks.empty() || (schedule_.tasks.back().end != npos)) {
+      return previous;
+    }
+
+    const auto index = schedule_.tasks.size() - 1;
+
+    schedule_.tasks.back().end = schedule_.order.size();
+
+    if (previous != npos) {
+      add_edge(previous, index);
+    }
+
+    return index;
+  }
+
+  void link()
+  {
+    // Tracks the last task that an edge was added to from each task, to avoid duplicate edges.
+    std::vector<size_t> last_successor(schedule_.tasks.size(), npos);
+
+    for (size_t t = 0; t < schedule_.tasks.size(); t++) {
+      const auto& task = schedule_.tasks[t];
+      for (size_t i = task.begin; i < task.end; i++) {
+        for (const auto id : operands_[schedule_.order[i]]) {
+          const auto producer = task_of_stmt_[producers_[id]];
+          if ((producer != t) && (last_successor[producer] != t)) {
+            last_successor[producer] = t;
+            add_edge(producer, t);
+          }
+        }
+      }
+    }
+
+    for (size_t t = 0; t < schedule_.tasks.size(); t++) {
+      if (schedule_.tasks[t].num_predecessors == 0) {
+        schedule_.roots.emplace_back(t);
+      }
+    }
+  }
+
+  void add_edge(const size_t from, const size_t to)
+  {
+    schedule_.tasks[from].successors.emplace_back(to);
+    schedule_.tasks[to].num_predecessors++;
+  }
+};
+
+/// @brief Evaluates statements into a value table that is indexed by value ID.
+class Evaluator final
+  : public ast::StmtVisitor
+  , public ast::ExprVisitor
+{
+  Runtime* runtime_;
+
+  const ast::Module* module_;
+
+  const ast::Scalar* inputs_;
+
+  Value* values_;
+
+  Value result_;
+
+public:
+  Evaluator(Runtime* runtime, const ast::Module* m, const ast::Scalar* inputs, Value* values)
+    : runtime_(runtime)
+    , module_(m)
+    , inputs_(inputs)
+    , values_(values)
+  {
+  }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    stmt.value().accept(*this);
+    values_[stmt.id()] = result_;
+  }
+
+  void visit(const ast::PrintStmt& stmt) override { values_[stmt.id()].print(*runtime_); }
+
+  void visit(const ast::PrintEndStmt&) override { runtime_->print_end(); }
+
+  void visit(const ast::LiteralExpr<int>& expr) override { result_ = Value::from(expr.value()); }
+
+  void visit(const ast::LiteralExpr<float>& expr) override { result_ = Value::from(expr.value()); }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override { result_ = Value::from(&expr.value()); }
+
+  void visit(const ast::AddExpr<int>& expr) override
+  {
+    result_ = Value::from(values_[expr.left()].int_value + values_[expr.right()].int_value);
+  }
+
+  void visit(const ast::AddExpr<float>& expr) override
+  {
+    result_ = Value::from(values_[expr.left()].float_value + values_[expr.right()].float_value);
+  }
+
+  void visit(const ast::AddExpr<std::string>&) override {}
+
+  void visit(const ast::MulExpr<int, int>& expr) override
+  {
+    result_ = Value::from(values_[expr.left()].int_value * values_[expr.right()].int_value);
+  }
+
+  void visit(const ast::MulExpr<float, float>& expr) override
+  {
+    result_ = Value::from(values_[expr.left()].float_value * values_[expr.right()].float_value);
+  }
+
+  void visit(const ast::MulAddExpr<int>& expr) override
+  {
+    result_ = Value::from(values_[expr.a()].int_value * values_[expr.b()].int_value + values_[expr.c()].int_value);
+  }
+
+  void visit(const ast::MulAddExpr<float>& expr) override
+  {
+    const auto a = values_[expr.a()].float_value;
+    const auto b = values_[expr.b()].float_value;
+    const auto c = values_[expr.c()].float_value;
+    if (expr.fused()) {
+      result_ = Value::from(std::fma(a, b, c));
+    } else {
+      const float product = a * b;
+      result_ = Value::from(product + c);
+    }
+  }
+
+  void visit(const ast::InputExpr<int>& expr) override { result_ = Value::from(input_at(expr.slot()).int_value); }
+
+  void visit(const ast::InputExpr<float>& expr) override
+  {
+    result_ = Value::from(input_at(expr.slot()).float_value);
+  }
+
+protected:
+  [[nodiscard]] auto input_at(const size_t slot) const -> const ast::Scalar&
+  {
+    if (inputs_) {
+      return inputs_[slot];
+    }
+    return module_->inputs.at(slot).default_value;
+  }
+};
+
+class ParallelInterpreter final : public Interpreter
+{
+  Runtime* runtime_;
+
+  ThreadPool* pool_;
+
+  size_t task_cost_;
+
+  const ast::Module* module_{ nullptr };
+
+  /// @brief The generation of the module that the schedule was built for, or zero if none was built yet.
+  uint64_t generation_{ 0 };
+
+  Schedule schedule_;
+
+  /// @brief The number of predecessors of each task that have not finished yet.
+  std::unique_ptr<std::atomic<uint32_t>[]> remaining_;
+
+  std::vector<Value> values_;
+
+  const ast::Scalar* inputs_{ nullptr };
+
+public:
+  ParallelInterpreter(Runtime* runtime, const InterpreterOptions& options)
+    : runtime_(runtime)
+    , pool_(options.thread_pool ? options.thread_pool : &ThreadPool::shared())
+    , task_cost_(options.task_cost)
+  {
+  }
+
+  using Interpreter::exec;
+
+  void exec(const ast::Module& m, const ast::Scalar* inputs) override
+  {
+    if (generation_ != m.generation.value()) {
+      module_ = &m;
+      generation_ = m.generation.value();
+      schedule_ = ScheduleBuilder(&m, task_cost_).build();
+      remaining_ = std::make_unique<std::atomic<uint32_t>[]>(schedule_.tasks.size());
+    }
+
+    values_.resize(schedule_.num_values);
+
+    inputs_ = inputs;
+
+    for (size_t i = 0; i < schedule_.tasks.size(); i++) {
+      remaining_[i].store(schedule_.tasks[i].num_predecessors, std::memory_order_relaxed);
+    }
+
+    TaskGroup group;
+
+    for (const auto root : schedule_.roots) {
+      pool_->submit(group, [this, &group, root] { run_task(group, root); });
+    }
+
+    pool_->wait(group);
+  }
+
+protected:
+  void run_task(TaskGroup& group, const size_t index)
+  {
+    const auto& task = schedule_.tasks[index];
+
+    Evaluator evaluator(runtime_, module_, inputs_, values_.data());
+
+    for (size_t i = task.begin; i < task.end; i++) {
+      module_->stmts[schedule_.order[i]]->accept(evaluator);
+    }
+
+    for (const auto successor : task.successors) {
+      if (remaining_[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pool_->submit(group, [this, &group, successor] { run_task(group, successor); });
+      }
+    }
+  }
+};
+
+} // namespace
+
+auto
+create_parallel_interpreter(Runtime* runtime, const InterpreterOptions& options) -> std::unique_ptr<Interpreter>
+{
+  return std::make_unique<ParallelInterpreter>(runtime, options);
+}
+
+} // namespace nabla
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "interpreter.h"
+
+#include <memory>
+
+namespace nabla {
+
+/// @brief Creates an interpreter that executes the independent statements of a module concurrently.
+///
+/// @details The statements are ordered by a depth-first walk of the value dependency graph, so that each independent
+///          subgraph ends up in one contiguous stretch. That order is cut into tasks of about @ref
+///          InterpreterOptions::task_cost statements, and a task is started once the tasks producing its operands have
+///          finished. Prints are grouped into tasks of their own, each of which waits for the previous one, so output
+///          appears in program order.
+///
+///          The schedule for the most recently executed module is cached, keyed on the generation of the module.
+[[nodiscard]] auto
+create_parallel_interpreter(Runtime* runtime, const InterpreterOptions& options) -> std::unique_ptr<Interpreter>;
+
+} // namespace nabla
@@ -26,6 +26,9 @@ class ParserImpl final : public Parser
 
   size_t offset_{ 0 };
 
+  /// @brief Whether anything other than an import has been parsed, after which imports are no longer allowed.
+  bool past_imports_{ false };
+
 public:
   ParserImpl(const Token* tokens, const size_t num_tokens)
     : tokens_(tokens)
@@ -38,6 +41,16 @@ public:
   [[nodiscard]] auto parse() -> NodePtr override
   {
     const auto& first = at(0);
+    if (first == "import") {
+      if (past_imports_) {
+        throw_error("imports must come before everything else", &first);
+      }
+      next();
+      return parse_import(first);
+    }
+
+    past_imports_ = true;
+
     if (first == "let") {
       next();
       return parse_let_stmt(first);
@@ -94,6 +107,39 @@ protected:
     next();
   }
 
+  [[nodiscard]] auto parse_import(const Token& import_token) -> NodePtr
+  {
+    std::vector<const Token*> path;
+
+    const auto* anchor = &import_token;
+
+    while (true) {
+      if (eof()) {
+        throw_error("expected module name after this", anchor);
+      }
+
+      const auto& name = at(0);
+      if (name != TK::identifier) {
+        throw_error("expected this to be a module name", &name);
+      }
+      next();
+
+      path.emplace_back(&name);
+
+      if (eof() || (at(0) != '.')) {
+        break;
+      }
+
+      anchor = &at(0);
+
+      next();
+    }
+
+    terminate_stmt();
+
+    return std::make_unique<ImportNode>(&import_token, std::move(path));
+  }
+
   [[nodiscard]] auto parse_fn_def(const Token& fn_token) -> NodePtr
   {
     if (eof()) {
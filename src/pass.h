@@ -0,0 +1,52 @@
+#pragma once
+
+#include "ast.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief Counters that passes use to report what they did to a module.
+struct PassStatistics final
+{
+  /// @brief Maps the name of a counter (prefixed with the pass name) to its value.
+  std::map<std::string, size_t, std::less<>> counters;
+
+  void add(const std::string_view& name, size_t amount);
+
+  [[nodiscard]] auto get(const std::string_view& name) const -> size_t;
+};
+
+/// @brief Maps the ID of each value before a pass to its ID after it. Values that were merged into another value map to
+///        the ID of that value, and values that were removed map to @ref removed_value.
+using ValueMap = std::vector<size_t>;
+
+constexpr size_t removed_value = static_cast<size_t>(-1);
+
+/// @brief A transformation applied to an AST module before it gets executed.
+class Pass
+{
+  ValueMap* value_map_{ nullptr };
+
+public:
+  virtual ~Pass() = default;
+
+  [[nodiscard]] virtual auto name() const -> const char* = 0;
+
+  virtual void run(ast::Module& m, PassStatistics& stats) = 0;
+
+  /// @brief Makes the pass record how it renumbers values, so that what is known about the values of a module can be
+  ///        carried through it.
+  void set_value_map(ValueMap* map) { value_map_ = map; }
+
+protected:
+  /// @brief Where to record how values were renumbered, or null if nobody asked.
+  [[nodiscard]] auto value_map() const -> ValueMap* { return value_map_; }
+};
+
+} // namespace nabla
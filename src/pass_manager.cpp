@@ -0,0 +1,56 @@
+#include "pass_manager.h"
+
+#include <vector>
+
+namespace nabla {
+
+void
+PassStatistics::add(const std::string_view& name, const size_t amount)
+{
+  auto it = counters.find(name);
+  if (it == counters.end()) {
+    it = counters.emplace(std::string(name), 0).first;
+  }
+
+  it->second += amount;
+}
+
+auto
+PassStatistics::get(const std::string_view& name) const -> size_t
+{
+  const auto it = counters.find(name);
+  return (it != counters.end()) ? it->second : 0;
+}
+
+namespace {
+
+class PassManagerImpl final : public PassManager
+{
+  std::vector<std::unique_ptr<Pass>> passes_;
+
+  PassStatistics statistics_;
+
+public:
+  void add(std::unique_ptr<Pass> pass) override { passes_.emplace_back(std::move(pass)); }
+
+  void run(ast::Module& m) override
+  {
+    for (auto& pass : passes_) {
+      pass->run(m, statistics_);
+    }
+
+    m.generation.renew();
+  }
+
+  auto statistics() const -> const PassStatistics& override { return statistics_; }
+};
+
+} // namespace
+
+auto
+PassManager::create() -> std::unique_ptr<PassManager>
+{
+  return std::make_unique<PassManagerImpl>();
+}
+
+} // namespace nabla
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "pass.h"
+
+#include <memory>
+
+namespace nabla {
+
+/// @brief Runs a sequence of passes over a module, in the order they were added.
+class PassManager
+{
+public:
+  static auto create() -> std::unique_ptr<PassManager>;
+
+  virtual ~PassManager() = default;
+
+  virtual void add(std::unique_ptr<Pass> pass) = 0;
+
+  virtual void run(ast::Module& m) = 0;
+
+  [[nodiscard]] virtual auto statistics() const -> const PassStatistics& = 0;
+};
+
+} // namespace nabla
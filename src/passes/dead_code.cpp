@@ -0,0 +1,139 @@
+#include "dead_code.h"
+
+#include "remap.h"
+
+#include <algorithm>
+
+namespace nabla {
+
+namespace {
+
+class LivenessMarker final : public ast::StmtVisitor
+{
+  std::vector<bool> live_;
+
+public:
+  explicit LivenessMarker(const size_t num_values)
+    : live_(num_values, false)
+  {
+  }
+
+  [[nodiscard]] auto live() const -> const std::vector<bool>& { return live_; }
+
+  /// @note Since values are always assigned before they are used, the statements must be visited in reverse order for
+  ///       the liveness of a value to be known by the time its assignment is visited.
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    if (!live_.at(stmt.id())) {
+      return;
+    }
+
+    for (const auto id : operands_of(stmt.value())) {
+      live_.at(id) = true;
+    }
+  }
+
+  void visit(const ast::PrintStmt& stmt) override { live_.at(stmt.id()) = true; }
+
+  void visit(const ast::PrintEndStmt&) override {}
+};
+
+class Sweeper final : public ast::StmtVisitor
+{
+  const std::vector<bool>* live_;
+
+  /// @brief Maps the old ID of each value to its new ID.
+  std::vector<size_t> ids_;
+
+  std::vector<ast::StmtPtr> stmts_;
+
+  size_t next_id_{ 0 };
+
+  size_t eliminated_{ 0 };
+
+public:
+  explicit Sweeper(const std::vector<bool>* live)
+    : live_(live)
+    , ids_(live->size(), removed_value)
+  {
+  }
+
+  [[nodiscard]] auto take_stmts() -> std::vector<ast::StmtPtr> { return std::move(stmts_); }
+
+  [[nodiscard]] auto eliminated() const -> size_t { return eliminated_; }
+
+  [[nodiscard]] auto take_ids() -> std::vector<size_t> { return std::move(ids_); }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    if (!live_->at(stmt.id())) {
+      eliminated_++;
+      return;
+    }
+
+    const auto id = next_id_++;
+    ids_.at(stmt.id()) = id;
+    stmts_.emplace_back(std::make_unique<ast::AssignStmt>(id, remap_operands(stmt.value(), ids_)));
+    stmts_.back()->set_location(stmt.location());
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintStmt>(ids_.at(stmt.id())));
+    stmts_.back()->set_location(stmt.location());
+  }
+
+  void visit(const ast::PrintEndStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintEndStmt>());
+    stmts_.back()->set_location(stmt.location());
+  }
+};
+
+class ValueCounter final : public ast::StmtVisitor
+{
+  size_t count_{ 0 };
+
+public:
+  [[nodiscard]] auto count() const -> size_t { return count_; }
+
+  void visit(const ast::AssignStmt& stmt) override { count_ = std::max(count_, stmt.id() + 1); }
+
+  void visit(const ast::PrintStmt&) override {}
+
+  void visit(const ast::PrintEndStmt&) override {}
+};
+
+} // namespace
+
+void
+DeadCodePass::run(ast::Module& m, PassStatistics& stats)
+{
+  ValueCounter counter;
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(counter);
+  }
+
+  LivenessMarker marker(counter.count());
+
+  for (auto it = m.stmts.rbegin(); it != m.stmts.rend(); ++it) {
+    (*it)->accept(marker);
+  }
+
+  Sweeper sweeper(&marker.live());
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(sweeper);
+  }
+
+  m.stmts = sweeper.take_stmts();
+
+  if (value_map()) {
+    *value_map() = sweeper.take_ids();
+  }
+
+  stats.add("dce.eliminated", sweeper.eliminated());
+}
+
+} // namespace nabla
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../pass.h"
+
+namespace nabla {
+
+/// @brief Mark-and-sweep dead code elimination.
+///
+/// @details Statements with an observable effect (currently, printing) are the roots. Every value that a root reads is
+///          marked live, along with the operands of every live value. Assignments that were not marked are removed and
+///          the remaining values are renumbered.
+class DeadCodePass final : public Pass
+{
+public:
+  auto name() const -> const char* override { return "dce"; }
+
+  void run(ast::Module& m, PassStatistics& stats) override;
+};
+
+} // namespace nabla
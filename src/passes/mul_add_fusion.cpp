@@ -0,0 +1,274 @@
+#include "mul_add_fusion.h"
+
+#include "remap.h"
+
+namespace nabla {
+
+namespace {
+
+enum class Shape
+{
+  other,
+  add_int,
+  add_float,
+  mul_int,
+  mul_float
+};
+
+struct Def final
+{
+  Shape shape{ Shape::other };
+
+  size_t left{ 0 };
+
+  size_t right{ 0 };
+};
+
+class ShapeClassifier final : public ast::ExprVisitor
+{
+  Def def_;
+
+public:
+  [[nodiscard]] auto classify(const ast::Expr& expr) -> Def
+  {
+    def_ = Def{};
+    expr.accept(*this);
+    return def_;
+  }
+
+  void visit(const ast::LiteralExpr<int>&) override {}
+
+  void visit(const ast::LiteralExpr<float>&) override {}
+
+  void visit(const ast::LiteralExpr<std::string>&) override {}
+
+  void visit(const ast::AddExpr<int>& expr) override { set(Shape::add_int, expr); }
+
+  void visit(const ast::AddExpr<float>& expr) override { set(Shape::add_float, expr); }
+
+  void visit(const ast::AddExpr<std::string>&) override {}
+
+  void visit(const ast::MulExpr<int, int>& expr) override { set(Shape::mul_int, expr); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { set(Shape::mul_float, expr); }
+
+  void visit(const ast::MulAddExpr<int>&) override {}
+
+  void visit(const ast::MulAddExpr<float>&) override {}
+
+  void visit(const ast::InputExpr<int>&) override {}
+
+  void visit(const ast::InputExpr<float>&) override {}
+
+protected:
+  template<typename Derived>
+  void set(const Shape shape, const ast::BinaryExpr<Derived>& expr)
+  {
+    def_ = Def{ shape, expr.left(), expr.right() };
+  }
+};
+
+class UseCounter final : public ast::StmtVisitor
+{
+  ShapeClassifier classifier_;
+
+public:
+  std::vector<Def> defs;
+
+  std::vector<size_t> uses;
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    if (defs.size() <= stmt.id()) {
+      defs.resize(stmt.id() + 1);
+      uses.resize(stmt.id() + 1, 0);
+    }
+
+    defs[stmt.id()] = classifier_.classify(stmt.value());
+
+    for (const auto id : operands_of(stmt.value())) {
+      uses.at(id)++;
+    }
+  }
+
+  void visit(const ast::PrintStmt& stmt) override { uses.at(stmt.id())++; }
+
+  void visit(const ast::PrintEndStmt&) override {}
+};
+
+class Fuser final : public ast::StmtVisitor
+{
+  const std::vector<Def>* defs_;
+
+  const std::vector<MulAddFusion>* fusions_;
+
+  const std::vector<bool>* absorbed_;
+
+  bool fma_{ false };
+
+  std::vector<size_t> ids_;
+
+  std::vector<ast::StmtPtr> stmts_;
+
+  size_t next_id_{ 0 };
+
+public:
+  Fuser(const std::vector<Def>* defs,
+        const std::vector<MulAddFusion>* fusions,
+        const std::vector<bool>* absorbed,
+        const bool fma)
+    : defs_(defs)
+    , fusions_(fusions)
+    , absorbed_(absorbed)
+    , fma_(fma)
+    , ids_(defs->size(), removed_value)
+  {
+  }
+
+  [[nodiscard]] auto take_stmts() -> std::vector<ast::StmtPtr> { return std::move(stmts_); }
+
+  [[nodiscard]] auto take_ids() -> std::vector<size_t> { return std::move(ids_); }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    if (absorbed_->at(stmt.id())) {
+      return;
+    }
+
+    const auto id = next_id_++;
+
+    ids_.at(stmt.id()) = id;
+
+    const auto& fusion = fusions_->at(stmt.id());
+
+    if (!fusion.fused) {
+      stmts_.emplace_back(std::make_unique<ast::AssignStmt>(id, remap_operands(stmt.value(), ids_)));
+      stmts_.back()->set_location(stmt.location());
+      return;
+    }
+
+    const auto& mul = defs_->at(fusion.mul);
+    const auto a = ids_.at(mul.left);
+    const auto b = ids_.at(mul.right);
+    const auto c = ids_.at(fusion.addend);
+
+    ast::ExprPtr expr;
+    if (mul.shape == Shape::mul_int) {
+      expr = std::make_unique<ast::MulAddExpr<int>>(a, b, c, /*fused=*/false);
+    } else {
+      expr = std::make_unique<ast::MulAddExpr<float>>(a, b, c, fma_);
+    }
+
+    stmts_.emplace_back(std::make_unique<ast::AssignStmt>(id, std::move(expr)));
+
+    stmts_.back()->set_location(stmt.location());
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintStmt>(ids_.at(stmt.id())));
+    stmts_.back()->set_location(stmt.location());
+  }
+
+  void visit(const ast::PrintEndStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintEndStmt>());
+    stmts_.back()->set_location(stmt.location());
+  }
+};
+
+[[nodiscard]] auto
+product_shape(const Shape add_shape) -> Shape
+{
+  return (add_shape == Shape::add_int) ? Shape::mul_int : Shape::mul_float;
+}
+
+[[nodiscard]] auto
+plan(const UseCounter& counter) -> std::vector<MulAddFusion>
+{
+  const auto& defs = counter.defs;
+
+  std::vector<MulAddFusion> fusions(defs.size());
+
+  std::vector<bool> absorbed(defs.size(), false);
+
+  for (size_t id = 0; id < defs.size(); id++) {
+    const auto& add = defs[id];
+    if ((add.shape != Shape::add_int) && (add.shape != Shape::add_float)) {
+      continue;
+    }
+
+    const auto fusable = [&](const size_t operand) -> bool {
+      return (defs.at(operand).shape == product_shape(add.shape)) && (counter.uses.at(operand) == 1) &&
+             !absorbed.at(operand);
+    };
+
+    // Addition is commutative, so the product may be on either side.
+    if (fusable(add.left)) {
+      fusions[id] = MulAddFusion{ add.left, add.right, true };
+    } else if (fusable(add.right)) {
+      fusions[id] = MulAddFusion{ add.right, add.left, true };
+    } else {
+      continue;
+    }
+
+    absorbed.at(fusions[id].mul) = true;
+  }
+
+  return fusions;
+}
+
+} // namespace
+
+auto
+plan_mul_add_fusion(const ast::Module& m) -> std::vector<MulAddFusion>
+{
+  UseCounter counter;
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(counter);
+  }
+
+  return plan(counter);
+}
+
+void
+MulAddFusionPass::run(ast::Module& m, PassStatistics& stats)
+{
+  UseCounter counter;
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(counter);
+  }
+
+  const auto& defs = counter.defs;
+
+  const auto fusions = plan(counter);
+
+  std::vector<bool> absorbed(defs.size(), false);
+
+  size_t fused{ 0 };
+
+  for (const auto& fusion : fusions) {
+    if (fusion.fused) {
+      absorbed.at(fusion.mul) = true;
+      fused++;
+    }
+  }
+
+  Fuser fuser(&defs, &fusions, &absorbed, fma_);
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(fuser);
+  }
+
+  m.stmts = fuser.take_stmts();
+
+  if (value_map()) {
+    *value_map() = fuser.take_ids();
+  }
+
+  stats.add("mul-add.fused", fused);
+}
+
+} // namespace nabla
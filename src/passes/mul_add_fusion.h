@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../pass.h"
+
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief Describes an addition that absorbs a multiplication.
+struct MulAddFusion final
+{
+  /// @brief The ID of the absorbed multiplication, or the ID of the addition itself if nothing is fused.
+  size_t mul{ 0 };
+
+  /// @brief The operand of the addition that is not the product.
+  size_t addend{ 0 };
+
+  bool fused{ false };
+};
+
+/// @brief Decides which multiplications @ref MulAddFusionPass fuses into which additions, without changing the module.
+///
+/// @details This is what other backends use to fuse the same operations as the pass does, such as the code generator,
+///          which writes code for the syntax tree rather than for the module.
+///
+/// @return The fusion of each value, indexed by value ID. Only additions can be fused.
+[[nodiscard]] auto
+plan_mul_add_fusion(const ast::Module& m) -> std::vector<MulAddFusion>;
+
+/// @brief Fuses a multiplication into the addition that consumes it, producing a single multiply-add.
+///
+/// @details A multiplication is only fused when the addition is its only use, since otherwise the product would have
+///          to be computed twice. Floating point multiply-adds only skip the intermediate rounding (like std::fma) when
+///          the pass is created with FMA contraction enabled, which is an explicit opt-in because it changes results.
+class MulAddFusionPass final : public Pass
+{
+  bool fma_{ false };
+
+public:
+  explicit MulAddFusionPass(const bool fma)
+    : fma_(fma)
+  {
+  }
+
+  auto name() const -> const char* override { return "mul-add"; }
+
+  void run(ast::Module& m, PassStatistics& stats) override;
+};
+
+} // namespace nabla
@@ -0,0 +1,137 @@
+#include "remap.h"
+
+namespace nabla {
+
+namespace {
+
+class ExprRemapper final : public ast::ExprVisitor
+{
+  const std::vector<size_t>* ids_;
+
+  ast::ExprPtr result_;
+
+public:
+  explicit ExprRemapper(const std::vector<size_t>* ids)
+    : ids_(ids)
+  {
+  }
+
+  [[nodiscard]] auto take_result() -> ast::ExprPtr { return std::move(result_); }
+
+  void visit(const ast::LiteralExpr<int>& expr) override { copy_literal(expr); }
+
+  void visit(const ast::LiteralExpr<float>& expr) override { copy_literal(expr); }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override { copy_literal(expr); }
+
+  void visit(const ast::AddExpr<int>& expr) override { remap_binary(expr); }
+
+  void visit(const ast::AddExpr<float>& expr) override { remap_binary(expr); }
+
+  void visit(const ast::AddExpr<std::string>& expr) override { remap_binary(expr); }
+
+  void visit(const ast::MulExpr<int, int>& expr) override { remap_binary(expr); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { remap_binary(expr); }
+
+  void visit(const ast::MulAddExpr<int>& expr) override { remap_mul_add(expr); }
+
+  void visit(const ast::MulAddExpr<float>& expr) override { remap_mul_add(expr); }
+
+  void visit(const ast::InputExpr<int>& expr) override { copy_input(expr); }
+
+  void visit(const ast::InputExpr<float>& expr) override { copy_input(expr); }
+
+protected:
+  template<typename T>
+  void copy_literal(const ast::LiteralExpr<T>& expr)
+  {
+    result_ = std::make_unique<ast::LiteralExpr<T>>(expr.value());
+  }
+
+  template<typename T>
+  void copy_input(const ast::InputExpr<T>& expr)
+  {
+    result_ = std::make_unique<ast::InputExpr<T>>(expr.slot());
+  }
+
+  template<typename Derived>
+  void remap_binary(const Derived& expr)
+  {
+    result_ = std::make_unique<Derived>(ids_->at(expr.left()), ids_->at(expr.right()));
+  }
+
+  template<typename T>
+  void remap_mul_add(const ast::MulAddExpr<T>& expr)
+  {
+    result_ =
+      std::make_unique<ast::MulAddExpr<T>>(ids_->at(expr.a()), ids_->at(expr.b()), ids_->at(expr.c()), expr.fused());
+  }
+};
+
+class OperandCollector final : public ast::ExprVisitor
+{
+  Operands operands_;
+
+public:
+  [[nodiscard]] auto result() const -> const Operands& { return operands_; }
+
+  void visit(const ast::LiteralExpr<int>&) override {}
+
+  void visit(const ast::LiteralExpr<float>&) override {}
+
+  void visit(const ast::LiteralExpr<std::string>&) override {}
+
+  void visit(const ast::AddExpr<int>& expr) override { collect_binary(expr); }
+
+  void visit(const ast::AddExpr<float>& expr) override { collect_binary(expr); }
+
+  void visit(const ast::AddExpr<std::string>& expr) override { collect_binary(expr); }
+
+  void visit(const ast::MulExpr<int, int>& expr) override { collect_binary(expr); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { collect_binary(expr); }
+
+  void visit(const ast::MulAddExpr<int>& expr) override { collect_mul_add(expr); }
+
+  void visit(const ast::MulAddExpr<float>& expr) override { collect_mul_add(expr); }
+
+  void visit(const ast::InputExpr<int>&) override {}
+
+  void visit(const ast::InputExpr<float>&) override {}
+
+protected:
+  template<typename Derived>
+  void collect_binary(const ast::BinaryExpr<Derived>& expr)
+  {
+    operands_.ids = { expr.left(), expr.right() };
+    operands_.size = 2;
+  }
+
+  template<typename T>
+  void collect_mul_add(const ast::MulAddExpr<T>& expr)
+  {
+    operands_.ids = { expr.a(), expr.b(), expr.c() };
+    operands_.size = 3;
+  }
+};
+
+} // namespace
+
+auto
+operands_of(const ast::Expr& expr) -> Operands
+{
+  OperandCollector collector;
+  expr.accept(collector);
+  return collector.result();
+}
+
+auto
+remap_operands(const ast::Expr& expr, const std::vector<size_t>& ids) -> ast::ExprPtr
+{
+  ExprRemapper remapper(&ids);
+  expr.accept(remapper);
+  return remapper.take_result();
+}
+
+} // namespace nabla
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../ast.h"
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief The IDs of the values that an expression reads.
+struct Operands final
+{
+  std::array<size_t, 3> ids{};
+
+  size_t size{ 0 };
+
+  [[nodiscard]] auto begin() const -> const size_t* { return ids.data(); }
+
+  [[nodiscard]] auto end() const -> const size_t* { return ids.data() + size; }
+};
+
+[[nodiscard]] auto
+operands_of(const ast::Expr& expr) -> Operands;
+
+/// @brief Creates a copy of an expression, where each operand ID is replaced by its entry in @p ids.
+///
+/// @note Every operand of the expression must have an entry in @p ids.
+[[nodiscard]] auto
+remap_operands(const ast::Expr& expr, const std::vector<size_t>& ids) -> ast::ExprPtr;
+
+} // namespace nabla
@@ -0,0 +1,253 @@
+#include "value_numbering.h"
+
+#include "remap.h"
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace nabla {
+
+namespace {
+
+enum class Opcode : uint8_t
+{
+  literal_int,
+  literal_float,
+  literal_string,
+  add_int,
+  add_float,
+  add_string,
+  mul_int,
+  mul_float,
+  mul_add_int,
+  mul_add_float,
+  input_int,
+  input_float
+};
+
+struct ValueKey final
+{
+  Opcode op{ Opcode::literal_int };
+
+  size_t left{ 0 };
+
+  size_t right{ 0 };
+
+  size_t extra{ 0 };
+
+  /// @brief The bit pattern of a numeric literal.
+  ///
+  /// @note Comparing bits instead of values keeps 0.0 and -0.0 apart.
+  uint64_t bits{ 0 };
+
+  /// @brief The value of a string literal. This points into the first expression that produced the key.
+  std::string_view text;
+
+  [[nodiscard]] auto operator==(const ValueKey& other) const -> bool
+  {
+    return (op == other.op) && (left == other.left) && (right == other.right) && (extra == other.extra) &&
+           (bits == other.bits) && (text == other.text);
+  }
+};
+
+struct ValueKeyHash final
+{
+  [[nodiscard]] auto operator()(const ValueKey& key) const -> size_t
+  {
+    uint64_t h = static_cast<uint64_t>(key.op);
+    h = mix(h, key.left);
+    h = mix(h, key.right);
+    h = mix(h, key.extra);
+    h = mix(h, key.bits);
+    if (!key.text.empty()) {
+      h = mix(h, std::hash<std::string_view>{}(key.text));
+    }
+    return static_cast<size_t>(h);
+  }
+
+  [[nodiscard]] static auto mix(const uint64_t h, const uint64_t v) -> uint64_t
+  {
+    return (h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2))) * 0xff51afd7ed558ccdULL;
+  }
+};
+
+class KeyBuilder final : public ast::ExprVisitor
+{
+  ValueKey key_;
+
+public:
+  [[nodiscard]] auto build(const ast::Expr& expr) -> ValueKey
+  {
+    key_ = ValueKey{};
+    expr.accept(*this);
+    return key_;
+  }
+
+  void visit(const ast::LiteralExpr<int>& expr) override
+  {
+    key_.op = Opcode::literal_int;
+    key_.bits = static_cast<uint32_t>(expr.value());
+  }
+
+  void visit(const ast::LiteralExpr<float>& expr) override
+  {
+    const auto value = expr.value();
+    uint32_t bits{ 0 };
+    memcpy(&bits, &value, sizeof(bits));
+    key_.op = Opcode::literal_float;
+    key_.bits = bits;
+  }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override
+  {
+    key_.op = Opcode::literal_string;
+    key_.text = expr.value();
+  }
+
+  // Integer and floating point addition and multiplication are commutative (including in IEEE 754 arithmetic), so the
+  // operands are sorted in order for "a * b" and "b * a" to get the same value number. String concatenation is not.
+
+  void visit(const ast::AddExpr<int>& expr) override { key_binary(Opcode::add_int, expr, /*commutative=*/true); }
+
+  void visit(const ast::AddExpr<float>& expr) override { key_binary(Opcode::add_float, expr, /*commutative=*/true); }
+
+  void visit(const ast::AddExpr<std::string>& expr) override
+  {
+    key_binary(Opcode::add_string, expr, /*commutative=*/false);
+  }
+
+  void visit(const ast::MulExpr<int, int>& expr) override { key_binary(Opcode::mul_int, expr, /*commutative=*/true); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override
+  {
+    key_binary(Opcode::mul_float, expr, /*commutative=*/true);
+  }
+
+  void visit(const ast::MulAddExpr<int>& expr) override { key_mul_add(Opcode::mul_add_int, expr); }
+
+  void visit(const ast::MulAddExpr<float>& expr) override { key_mul_add(Opcode::mul_add_float, expr); }
+
+  // Inputs do not change while a module executes, so reads of the same slot are equivalent.
+
+  void visit(const ast::InputExpr<int>& expr) override
+  {
+    key_.op = Opcode::input_int;
+    key_.left = expr.slot();
+  }
+
+  void visit(const ast::InputExpr<float>& expr) override
+  {
+    key_.op = Opcode::input_float;
+    key_.left = expr.slot();
+  }
+
+protected:
+  template<typename Derived>
+  void key_binary(const Opcode op, const ast::BinaryExpr<Derived>& expr, const bool commutative)
+  {
+    key_.op = op;
+    key_.left = expr.left();
+    key_.right = expr.right();
+    if (commutative && (key_.left > key_.right)) {
+      std::swap(key_.left, key_.right);
+    }
+  }
+
+  /// @note Only the factors of a multiply-add are commutative.
+  template<typename T>
+  void key_mul_add(const Opcode op, const ast::MulAddExpr<T>& expr)
+  {
+    key_.op = op;
+    key_.left = std::min(expr.a(), expr.b());
+    key_.right = std::max(expr.a(), expr.b());
+    key_.extra = expr.c();
+    key_.bits = expr.fused() ? 1 : 0;
+  }
+};
+
+class ValueNumberer final : public ast::StmtVisitor
+{
+  /// @brief Maps the old ID of each value to its new ID.
+  std::vector<size_t> ids_;
+
+  std::unordered_map<ValueKey, size_t, ValueKeyHash> numbers_;
+
+  std::vector<ast::StmtPtr> stmts_;
+
+  KeyBuilder key_builder_;
+
+  size_t next_id_{ 0 };
+
+  size_t eliminated_{ 0 };
+
+public:
+  [[nodiscard]] auto take_stmts() -> std::vector<ast::StmtPtr> { return std::move(stmts_); }
+
+  [[nodiscard]] auto eliminated() const -> size_t { return eliminated_; }
+
+  [[nodiscard]] auto take_ids() -> std::vector<size_t> { return std::move(ids_); }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    auto expr = remap_operands(stmt.value(), ids_);
+
+    const auto key = key_builder_.build(*expr);
+
+    if (ids_.size() <= stmt.id()) {
+      ids_.resize(stmt.id() + 1);
+    }
+
+    const auto it = numbers_.find(key);
+    if (it != numbers_.end()) {
+      ids_[stmt.id()] = it->second;
+      eliminated_++;
+      return;
+    }
+
+    const auto id = next_id_++;
+    ids_[stmt.id()] = id;
+    stmts_.emplace_back(std::make_unique<ast::AssignStmt>(id, std::move(expr)));
+    stmts_.back()->set_location(stmt.location());
+
+    // The key may point into the expression, which is now owned by the new statement.
+    numbers_.emplace(key, id);
+  }
+
+  void visit(const ast::PrintStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintStmt>(ids_.at(stmt.id())));
+    stmts_.back()->set_location(stmt.location());
+  }
+
+  void visit(const ast::PrintEndStmt& stmt) override
+  {
+    stmts_.emplace_back(std::make_unique<ast::PrintEndStmt>());
+    stmts_.back()->set_location(stmt.location());
+  }
+};
+
+} // namespace
+
+void
+ValueNumberingPass::run(ast::Module& m, PassStatistics& stats)
+{
+  ValueNumberer numberer;
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(numberer);
+  }
+
+  m.stmts = numberer.take_stmts();
+
+  if (value_map()) {
+    *value_map() = numberer.take_ids();
+  }
+
+  stats.add("gvn.eliminated", numberer.eliminated());
+}
+
+} // namespace nabla
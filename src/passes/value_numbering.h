@@ -0,0 +1,21 @@
+#pragma once
+
+#include "../pass.h"
+
+namespace nabla {
+
+/// @brief Global value numbering.
+///
+/// @details Each assignment is keyed by its operation, its type and the value numbers of its operands. When an
+///          assignment computes a key that was already seen, it is removed and all of its uses are redirected to the
+///          first assignment that computed the same key. Since all operations are currently pure, this never changes
+///          the behavior of a program.
+class ValueNumberingPass final : public Pass
+{
+public:
+  auto name() const -> const char* override { return "gvn"; }
+
+  void run(ast::Module& m, PassStatistics& stats) override;
+};
+
+} // namespace nabla
@@ -0,0 +1,131 @@
+#include "profile.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace nabla {
+
+struct Profile::LineCounters final
+{
+  const std::string* filename{ nullptr };
+
+  size_t line{ 0 };
+
+  uint64_t executions{ 0 };
+
+  /// @brief The estimated total, which scales the sampled ticks by the sample period.
+  uint64_t ticks{ 0 };
+};
+
+Profile::Profile(const uint32_t sample_period)
+  : period_(std::clamp<uint32_t>(sample_period, 1, max_sample_period))
+{
+}
+
+auto
+Profile::counters(const ast::Module& m) -> Counters*
+{
+  auto it = std::find_if(
+    modules_.begin(), modules_.end(), [&m](const ModuleCounters& entry) { return entry.module == &m; });
+
+  if (it == modules_.end()) {
+    modules_.emplace_back(ModuleCounters{ &m, {} });
+    it = std::prev(modules_.end());
+  }
+
+  if (it->counters.size() < m.stmts.size()) {
+    it->counters.resize(m.stmts.size());
+  }
+
+  return it->counters.data();
+}
+
+auto
+Profile::per_line() const -> std::vector<LineCounters>
+{
+  std::map<std::pair<std::string, size_t>, LineCounters> lines;
+
+  for (const auto& entry : modules_) {
+    const auto& stmts = entry.module->stmts;
+    for (size_t i = 0; i < stmts.size(); i++) {
+      const auto line = stmts[i]->location().line;
+      auto& counters = lines[{ entry.module->filename, line }];
+      counters.filename = &entry.module->filename;
+      counters.line = line;
+      counters.executions += entry.counters[i].executions;
+      counters.ticks += entry.counters[i].ticks * period_;
+    }
+  }
+
+  std::vector<LineCounters> result;
+
+  for (const auto& line : lines) {
+    if (line.second.executions > 0) {
+      result.emplace_back(line.second);
+    }
+  }
+
+  std::stable_sort(result.begin(), result.end(), [](const LineCounters& a, const LineCounters& b) {
+    return a.ticks > b.ticks;
+  });
+
+  return result;
+}
+
+namespace {
+
+void
+write_location(std::ostream& stream, const std::string& filename, const size_t line)
+{
+  stream << filename << ':';
+  if (line > 0) {
+    stream << line;
+  } else {
+    stream << '?';
+  }
+}
+
+} // namespace
+
+void
+Profile::write_report(std::ostream& stream) const
+{
+  const auto lines = per_line();
+
+  uint64_t total{ 0 };
+
+  for (const auto& line : lines) {
+    total += line.ticks;
+  }
+
+  stream << std::setw(16) << "ticks" << std::setw(8) << "%" << std::setw(16) << "executions"
+         << "  location\n";
+
+  for (const auto& line : lines) {
+    const auto percent = (total > 0) ? (100.0 * static_cast<double>(line.ticks) / static_cast<double>(total)) : 0.0;
+    stream << std::setw(16) << line.ticks << std::setw(8) << std::fixed << std::setprecision(2) << percent
+           << std::setw(16) << line.executions << "  ";
+    write_location(stream, *line.filename, line.line);
+    stream << '\n';
+  }
+}
+
+void
+Profile::write_collapsed(std::ostream& stream) const
+{
+  for (const auto& line : per_line()) {
+    if (line.ticks == 0) {
+      continue;
+    }
+    stream << *line.filename << ';';
+    write_location(stream, *line.filename, line.line);
+    stream << ' ' << line.ticks << '\n';
+  }
+}
+
+} // namespace nabla
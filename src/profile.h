@@ -0,0 +1,99 @@
+#pragma once
+
+#include "ast.h"
+
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace nabla {
+
+/// @brief Execution counts and time spent per statement, as collected by the interpreter.
+///
+/// @details Every statement execution is counted, but only about one in every N statements is timed, where N is the
+///          sample period. The period is jittered, so that programs whose length is a multiple of it are still sampled
+///          evenly. Times are measured in ticks, which are TSC cycles on x86 and nanoseconds elsewhere.
+///
+/// @note The profile refers to the modules it was collected from, so they must outlive it.
+///
+/// @note A profile is not thread-safe, and must only be collected into by one interpreter at a time. This is why the
+///       parallel backend, like the other ones, falls back to the interpreter when a profile is given.
+class Profile final
+{
+public:
+  /// @brief The longest sample period, which keeps the jittered countdown within 32 bits.
+  static constexpr uint32_t max_sample_period = 1U << 30;
+
+  struct Counters final
+  {
+    uint64_t executions{ 0 };
+
+    uint64_t samples{ 0 };
+
+    /// @brief The ticks measured during sampled executions.
+    uint64_t ticks{ 0 };
+  };
+
+  /// @param sample_period The average number of statements per sample, which is clamped to @ref max_sample_period.
+  explicit Profile(uint32_t sample_period = 1);
+
+  [[nodiscard]] static auto now() -> uint64_t
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    const auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+#endif
+  }
+
+  /// @brief Gets the counters of a module, indexed by statement.
+  [[nodiscard]] auto counters(const ast::Module& m) -> Counters*;
+
+  /// @brief Gets the number of statements to execute before taking the next sample.
+  [[nodiscard]] auto next_countdown() -> uint32_t
+  {
+    if (period_ == 1) {
+      return 1;
+    }
+    // xorshift32, which is plenty for spreading out samples.
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    // Uniform in [1, 2 * period - 1], which averages to the period.
+    return 1 + (random_ % ((2 * period_) - 1));
+  }
+
+  /// @brief Writes the source lines that the most time was spent on, in descending order.
+  void write_report(std::ostream& stream) const;
+
+  /// @brief Writes the time spent per source line in the collapsed stack format, as read by flamegraph tools.
+  void write_collapsed(std::ostream& stream) const;
+
+private:
+  struct ModuleCounters final
+  {
+    const ast::Module* module{ nullptr };
+
+    std::vector<Counters> counters;
+  };
+
+  struct LineCounters;
+
+  [[nodiscard]] auto per_line() const -> std::vector<LineCounters>;
+
+  std::vector<ModuleCounters> modules_;
+
+  uint32_t period_{ 1 };
+
+  uint32_t random_{ 0x9e3779b9 };
+};
+
+} // namespace nabla
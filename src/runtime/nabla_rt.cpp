@@ -0,0 +1,51 @@
+#include "nabla_rt.h"
+
+#include "../buffered_runtime.h"
+
+#include <string>
+
+namespace nabla::rt {
+
+namespace {
+
+/// @brief Native programs format their output the same way that the interpreter does.
+auto
+runtime() -> BufferedRuntime&
+{
+  static BufferedRuntime instance;
+  return instance;
+}
+
+} // namespace
+
+void
+print(const int value)
+{
+  runtime().print(value);
+}
+
+void
+print(const float value)
+{
+  runtime().print(value);
+}
+
+void
+print(const std::string_view value)
+{
+  runtime().print(std::string(value));
+}
+
+void
+print_end()
+{
+  runtime().print_end();
+}
+
+void
+flush()
+{
+  runtime().flush();
+}
+
+} // namespace nabla::rt
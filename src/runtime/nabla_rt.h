@@ -0,0 +1,26 @@
+#pragma once
+
+// The runtime library that native nabla programs are linked against. This header is included by generated code, so it
+// must not depend on anything else in the compiler.
+
+#include <string_view>
+
+namespace nabla::rt {
+
+void
+print(int value);
+
+void
+print(float value);
+
+void
+print(std::string_view value);
+
+void
+print_end();
+
+/// @brief Writes all buffered output. This is also done when the program exits normally.
+void
+flush();
+
+} // namespace nabla::rt
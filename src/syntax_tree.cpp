@@ -1,7 +1,134 @@
 #include "syntax_tree.h"
 
+#include "lexer.h"
+
 namespace nabla {
 
+namespace {
+
+class ExprCloner final : public ExprVisitor
+{
+public:
+  ExprPtr result;
+
+  void visit(const IntLiteralExpr& expr) override { result = std::make_unique<IntLiteralExpr>(&expr.token()); }
+
+  void visit(const FloatLiteralExpr& expr) override { result = std::make_unique<FloatLiteralExpr>(&expr.token()); }
+
+  void visit(const StringLiteralExpr& expr) override { result = std::make_unique<StringLiteralExpr>(&expr.token()); }
+
+  void visit(const VarExpr& expr) override { result = std::make_unique<VarExpr>(expr.get_name()); }
+
+  void visit(const CallExpr& expr) override
+  {
+    std::vector<CallExpr::NamedArg> args;
+
+    for (const auto& arg : expr.args()) {
+      args.emplace_back(arg.first, clone(*arg.second));
+    }
+
+    result = std::make_unique<CallExpr>(&expr.name(), std::move(args));
+  }
+
+  void visit(const AddExpr& expr) override
+  {
+    result = std::make_unique<AddExpr>(clone(expr.left()), clone(expr.right()), &expr.op_token());
+  }
+
+  void visit(const MulExpr& expr) override
+  {
+    result = std::make_unique<MulExpr>(clone(expr.left()), clone(expr.right()), &expr.op_token());
+  }
+};
+
+class NodeCounter final
+  : public NodeVisitor
+  , public ExprVisitor
+{
+public:
+  size_t count{ 0 };
+
+  void visit(const PrintNode& node) override
+  {
+    count++;
+    for (const auto& arg : node.args()) {
+      arg->accept(*this);
+    }
+  }
+
+  void visit(const DeclNode& node) override
+  {
+    count++;
+    if (node.has_type()) {
+      for (const auto& arg : node.get_type().args()) {
+        arg->accept(*this);
+      }
+    }
+    if (node.has_value()) {
+      node.get_value().accept(*this);
+    }
+  }
+
+  void visit(const FuncNode& node) override
+  {
+    count++;
+    for (const auto& param : node.params()) {
+      param->accept(*this);
+    }
+    for (const auto& inner : node.body()) {
+      inner->accept(*this);
+    }
+  }
+
+  void visit(const StructNode& node) override
+  {
+    count++;
+    for (const auto& field : node.fields()) {
+      field->accept(*this);
+    }
+  }
+
+  void visit(const ReturnNode& node) override
+  {
+    count++;
+    node.value().accept(*this);
+  }
+
+  void visit(const ImportNode&) override { count++; }
+
+  void visit(const IntLiteralExpr&) override { count++; }
+
+  void visit(const FloatLiteralExpr&) override { count++; }
+
+  void visit(const StringLiteralExpr&) override { count++; }
+
+  void visit(const VarExpr&) override { count++; }
+
+  void visit(const CallExpr& expr) override
+  {
+    count++;
+    for (const auto& arg : expr.args()) {
+      arg.second->accept(*this);
+    }
+  }
+
+  void visit(const AddExpr& expr) override
+  {
+    count++;
+    expr.left().accept(*this);
+    expr.right().accept(*this);
+  }
+
+  void visit(const MulExpr& expr) override
+  {
+    count++;
+    expr.left().accept(*this);
+    expr.right().accept(*this);
+  }
+};
+
+} // namespace
+
 [[nodiscard]] auto
 to_string(TypeID type_id) -> const char*
 {
@@ -19,4 +146,84 @@ to_string(TypeID type_id) -> const char*
   return "";
 }
 
+auto
+find_builtin_type(const std::string_view name, TypeID& type_id) -> bool
+{
+  if ((name == "int") || (name == "i32")) {
+    type_id = TypeID::int_;
+  } else if ((name == "float") || (name == "f32")) {
+    type_id = TypeID::float_;
+  } else if (name == "string") {
+    type_id = TypeID::string;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+auto
+ImportNode::module_name() const -> std::string
+{
+  std::string name;
+
+  for (const auto* part : path_) {
+    if (!name.empty()) {
+      name += '.';
+    }
+    name += part->data;
+  }
+
+  return name;
+}
+
+auto
+count_nodes(const SyntaxTree& tree) -> size_t
+{
+  NodeCounter counter;
+
+  for (const auto& node : tree.nodes) {
+    node->accept(counter);
+  }
+
+  return counter.count;
+}
+
+auto
+clone(const Expr& expr) -> ExprPtr
+{
+  ExprCloner cloner;
+  expr.accept(cloner);
+  return std::move(cloner.result);
+}
+
+auto
+clone(const DeclNode& node) -> std::unique_ptr<DeclNode>
+{
+  std::unique_ptr<TypeInstance> type;
+
+  if (node.has_type()) {
+    std::vector<ExprPtr> args;
+    for (const auto& arg : node.get_type().args()) {
+      args.emplace_back(clone(*arg));
+    }
+    type = std::make_unique<TypeInstance>(&node.get_type().name(), std::move(args));
+  }
+
+  return std::make_unique<DeclNode>(
+    node.get_name(), node.has_value() ? clone(node.get_value()) : nullptr, node.is_immutable(), std::move(type));
+}
+
+auto
+clone(const StructNode& node) -> std::unique_ptr<StructNode>
+{
+  std::vector<std::unique_ptr<DeclNode>> fields;
+
+  for (const auto& field : node.fields()) {
+    fields.emplace_back(clone(*field));
+  }
+
+  return std::make_unique<StructNode>(&node.name(), std::move(fields));
+}
+
 } // namespace nabla
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <stddef.h>
+
 namespace nabla {
 
 class Token;
@@ -20,6 +24,13 @@ enum class TypeID
 [[nodiscard]] auto
 to_string(TypeID type_id) -> const char*;
 
+/// @brief Finds the built-in type that a type name refers to. Besides the names returned by @ref to_string, ints and
+///        floats can be written with their size, as "i32" and "f32".
+///
+/// @return False if the name is not that of a built-in type, in which case it may name a struct.
+[[nodiscard]] auto
+find_builtin_type(std::string_view name, TypeID& type_id) -> bool;
+
 class Type
 {
 public:
@@ -230,6 +241,7 @@ class DeclNode;
 class FuncNode;
 class ReturnNode;
 class StructNode;
+class ImportNode;
 
 class NodeVisitor
 {
@@ -245,6 +257,8 @@ public:
   virtual void visit(const StructNode&) = 0;
 
   virtual void visit(const ReturnNode&) = 0;
+
+  virtual void visit(const ImportNode&) = 0;
 };
 
 class Node
@@ -389,9 +403,48 @@ public:
   [[nodiscard]] auto args() const -> const std::vector<ExprPtr>& { return args_; }
 };
 
+/// @brief Makes the declarations of another module visible, such as "import geometry.vec;".
+class ImportNode final : public NodeBase<ImportNode>
+{
+  const Token* keyword_{ nullptr };
+
+  /// @brief The parts of the module name, which are separated by dots.
+  std::vector<const Token*> path_;
+
+public:
+  ImportNode(const Token* keyword, std::vector<const Token*> path)
+    : keyword_(keyword)
+    , path_(std::move(path))
+  {
+  }
+
+  [[nodiscard]] auto keyword() const -> const Token& { return *keyword_; }
+
+  [[nodiscard]] auto path() const -> const std::vector<const Token*>& { return path_; }
+
+  /// @brief The name of the imported module, with its parts joined by dots.
+  [[nodiscard]] auto module_name() const -> std::string;
+};
+
+/// @brief Copies an expression. The copy refers to the same tokens.
+[[nodiscard]] auto
+clone(const Expr& expr) -> ExprPtr;
+
+/// @brief Copies a declaration. The copy refers to the same tokens.
+[[nodiscard]] auto
+clone(const DeclNode& node) -> std::unique_ptr<DeclNode>;
+
+/// @brief Copies a struct. The copy refers to the same tokens.
+[[nodiscard]] auto
+clone(const StructNode& node) -> std::unique_ptr<StructNode>;
+
 struct SyntaxTree final
 {
   std::vector<NodePtr> nodes;
 };
 
+/// @brief Counts the nodes of a tree, including the ones within other nodes and the expressions.
+[[nodiscard]] auto
+count_nodes(const SyntaxTree& tree) -> size_t;
+
 } // namespace nabla
@@ -0,0 +1,184 @@
+#include "thread_pool.h"
+
+#include <utility>
+
+namespace nabla {
+
+namespace {
+
+/// @brief The pool that the current thread is a worker of, if any.
+thread_local const ThreadPool* current_pool{ nullptr };
+
+thread_local size_t current_worker{ 0 };
+
+} // namespace
+
+void
+TaskGroup::finish(std::exception_ptr error)
+{
+  // The waiter may destroy the group as soon as it sees that no tasks are pending, which it only looks at with the lock
+  // held. So the group must not be touched once the lock is released, and the notification is sent while holding it.
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (error && !error_) {
+    error_ = std::move(error);
+  }
+
+  if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    done_.notify_all();
+  }
+}
+
+ThreadPool::ThreadPool(size_t num_threads)
+{
+  if (num_threads == 0) {
+    const size_t hardware_threads = std::thread::hardware_concurrency();
+    num_threads = (hardware_threads > 1) ? (hardware_threads - 1) : 0;
+  }
+
+  for (size_t i = 0; i <= num_threads; i++) {
+    queues_.emplace_back(std::make_unique<Queue>());
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    threads_.emplace_back([this, i] { run_worker(i); });
+  }
+}
+
+auto
+ThreadPool::shared() -> ThreadPool&
+{
+  static ThreadPool pool;
+
+  return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_ = true;
+  }
+
+  wake_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void
+ThreadPool::submit(TaskGroup& group, std::function<void()> task)
+{
+  group.pending_.fetch_add(1, std::memory_order_relaxed);
+
+  auto wrapper = [&group, task = std::move(task)] {
+    std::exception_ptr error;
+    try {
+      task();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    group.finish(std::move(error));
+  };
+
+  {
+    auto& queue = *queues_[current_queue()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.emplace_back(std::move(wrapper));
+  }
+
+  num_queued_.fetch_add(1, std::memory_order_release);
+
+  // Taking the lock orders this with workers that are about to sleep, so that none of them misses the wake up.
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+
+  wake_.notify_one();
+}
+
+void
+ThreadPool::wait(TaskGroup& group)
+{
+  std::unique_lock<std::mutex> lock(group.mutex_);
+
+  while (group.pending_.load(std::memory_order_acquire) > 0) {
+    lock.unlock();
+    const auto ran_one = try_run_one();
+    lock.lock();
+    if (ran_one) {
+      continue;
+    }
+    // The remaining tasks are running on workers, and any tasks that they submit are left to the workers too.
+    group.done_.wait(lock, [&group] { return group.pending_.load(std::memory_order_acquire) == 0; });
+  }
+
+  if (group.error_) {
+    std::rethrow_exception(std::exchange(group.error_, nullptr));
+  }
+}
+
+void
+ThreadPool::run_worker(const size_t index)
+{
+  current_pool = this;
+  current_worker = index;
+
+  while (true) {
+    if (try_run_one()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+
+    wake_.wait(lock, [this] { return stopping_ || (num_queued_.load(std::memory_order_acquire) > 0); });
+
+    if (stopping_) {
+      return;
+    }
+  }
+}
+
+auto
+ThreadPool::try_run_one() -> bool
+{
+  const auto own = current_queue();
+
+  std::function<void()> task;
+
+  for (size_t i = 0; (i < queues_.size()) && !task; i++) {
+    auto& queue = *queues_[(own + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+    // The owner takes the most recent task, which is likely to use data that is still in its cache. Thieves take the
+    // oldest, which is likely to lead to more work of its own.
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+  }
+
+  if (!task) {
+    return false;
+  }
+
+  num_queued_.fetch_sub(1, std::memory_order_relaxed);
+
+  task();
+
+  return true;
+}
+
+auto
+ThreadPool::current_queue() const -> size_t
+{
+  return (current_pool == this) ? current_worker : threads_.size();
+}
+
+} // namespace nabla
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stddef.h>
+
+namespace nabla {
+
+/// @brief Tracks a set of tasks, so that they can be waited for together.
+class TaskGroup final
+{
+  friend class ThreadPool;
+
+  /// @brief The tasks that have been submitted and not finished. It only reaches zero with the mutex held.
+  std::atomic<size_t> pending_{ 0 };
+
+  std::mutex mutex_;
+
+  std::condition_variable done_;
+
+  /// @brief The first exception thrown by a task in the group.
+  std::exception_ptr error_;
+
+public:
+  TaskGroup() = default;
+
+  TaskGroup(const TaskGroup&) = delete;
+
+  auto operator=(const TaskGroup&) -> TaskGroup& = delete;
+
+  ~TaskGroup() = default;
+
+protected:
+  void finish(std::exception_ptr error);
+};
+
+/// @brief A fixed set of worker threads that execute tasks.
+///
+/// @details Each worker has its own queue. Tasks submitted by a worker go to the back of its own queue and are taken
+///          from there, so related work tends to stay on one thread. Workers that run out of tasks steal from the front
+///          of the other queues. Threads that wait for a group help execute tasks, so waiting from within a task does
+///          not deadlock, and a pool without workers still makes progress.
+class ThreadPool final
+{
+  struct Queue final
+  {
+    std::mutex mutex;
+
+    std::deque<std::function<void()>> tasks;
+  };
+
+  /// @brief One queue per worker, plus one for threads outside of the pool.
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  std::vector<std::thread> threads_;
+
+  /// @brief The number of tasks in all queues, which sleeping workers wait on.
+  std::atomic<size_t> num_queued_{ 0 };
+
+  std::mutex sleep_mutex_;
+
+  std::condition_variable wake_;
+
+  bool stopping_{ false };
+
+public:
+  /// @param num_threads The number of worker threads. Zero uses one per hardware thread, minus the calling thread.
+  explicit ThreadPool(size_t num_threads = 0);
+
+  ThreadPool(const ThreadPool&) = delete;
+
+  auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+  /// @note Tasks that are still queued are not executed.
+  ~ThreadPool();
+
+  /// @brief Gets a pool that the whole process shares, with the default number of workers. It is created when it is
+  ///        first used, for code that is given no pool of its own to run on.
+  [[nodiscard]] static auto shared() -> ThreadPool&;
+
+  [[nodiscard]] auto num_threads() const -> size_t { return threads_.size(); }
+
+  /// @brief Queues a task as part of a group.
+  void submit(TaskGroup& group, std::function<void()> task);
+
+  /// @brief Executes tasks until every task in the group has finished, then sleeps until the tasks that are still
+  ///        running on workers have finished too.
+  ///
+  /// @note If a task in the group threw an exception, the first one is rethrown here.
+  void wait(TaskGroup& group);
+
+protected:
+  void run_worker(size_t index);
+
+  /// @brief Takes a task from the queue of the calling thread, or steals one from another queue.
+  [[nodiscard]] auto try_run_one() -> bool;
+
+  [[nodiscard]] auto current_queue() const -> size_t;
+};
+
+} // namespace nabla
@@ -0,0 +1,478 @@
+#include "time_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+
+#include <time.h>
+
+namespace nabla {
+
+namespace {
+
+[[nodiscard]] auto
+wall_now() -> uint64_t
+{
+  const auto t = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+}
+
+/// @brief The CPU time of the calling thread, which leaves out the time that it spent waiting.
+[[nodiscard]] auto
+cpu_now() -> uint64_t
+{
+  timespec t{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return (static_cast<uint64_t>(t.tv_sec) * 1000000000ULL) + static_cast<uint64_t>(t.tv_nsec);
+}
+
+[[nodiscard]] auto
+to_ms(const uint64_t ns) -> double
+{
+  return static_cast<double>(ns) / 1e6;
+}
+
+template<typename Bytes>
+[[nodiscard]] auto
+to_mb(const Bytes bytes) -> double
+{
+  return static_cast<double>(bytes) / static_cast<double>(1 << 20);
+}
+
+/// @brief What a phase builds, and what it is counted in, for the sizes of data structures in the memory report.
+struct Structure final
+{
+  TimeTrace::Phase phase;
+
+  const char* name;
+
+  /// @brief What the phase counts, or null if it does not.
+  const char* unit;
+};
+
+constexpr Structure structures[]{ { TimeTrace::Phase::lex, "tokens", "token" },
+                                  { TimeTrace::Phase::parse, "syntax tree", "node" },
+                                  { TimeTrace::Phase::import, "imports", nullptr },
+                                  { TimeTrace::Phase::annotate, "annotations", "node" },
+                                  { TimeTrace::Phase::build_ast, "ast", "node" },
+                                  { TimeTrace::Phase::codegen, "generated code", "node" } };
+
+/// @brief Formats a number of things per second, such as "1.25M tokens/s".
+[[nodiscard]] auto
+format_rate(const size_t count, const uint64_t ns, const char* unit) -> std::string
+{
+  if ((count == 0) || (ns == 0)) {
+    return "";
+  }
+
+  auto rate = (static_cast<double>(count) * 1e9) / static_cast<double>(ns);
+
+  const char* suffix = "";
+
+  if (rate >= 1e6) {
+    rate /= 1e6;
+    suffix = "M";
+  } else if (rate >= 1e3) {
+    rate /= 1e3;
+    suffix = "k";
+  }
+
+  std::ostringstream stream;
+  stream << std::fixed << std::setprecision(2) << rate << suffix << ' ' << unit << "/s";
+  return stream.str();
+}
+
+void
+write_json_string(std::ostream& stream, const std::string_view& value)
+{
+  stream << '"';
+
+  for (const auto c : value) {
+    switch (c) {
+      case '"':
+        stream << "\\\"";
+        break;
+      case '\\':
+        stream << "\\\\";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          constexpr const char* digits = "0123456789abcdef";
+          stream << "\\u00" << digits[(c >> 4) & 0xf] << digits[c & 0xf];
+        } else {
+          stream << c;
+        }
+        break;
+    }
+  }
+
+  stream << '"';
+}
+
+} // namespace
+
+void
+TimeTrace::Scope::begin(const Phase phase, const std::string_view& detail)
+{
+  phase_ = phase;
+  detail_ = detail;
+  if (trace_->allocations_) {
+    allocations_start_ = AllocationCounter::thread_counts();
+    peak_rss_start_ = peak_rss();
+  }
+  cpu_start_ = cpu_now();
+  wall_start_ = wall_now();
+}
+
+void
+TimeTrace::Scope::stop_clocks()
+{
+  wall_end_ = wall_now();
+  cpu_end_ = cpu_now();
+  if (trace_->allocations_) {
+    allocations_end_ = AllocationCounter::thread_counts();
+    peak_rss_end_ = peak_rss();
+  }
+  stopped_ = true;
+}
+
+void
+TimeTrace::Scope::end()
+{
+  if (!stopped_) {
+    stop_clocks();
+  }
+
+  Event event;
+  event.phase = phase_;
+  event.detail = std::move(detail_);
+  event.wall_start = wall_start_;
+  event.wall_time = wall_end_ - wall_start_;
+  event.cpu_start = cpu_start_;
+  event.cpu_time = cpu_end_ - cpu_start_;
+  event.tokens = tokens_;
+  event.nodes = nodes_;
+  event.allocations = allocations_end_.allocations - allocations_start_.allocations;
+  event.allocated_bytes = allocations_end_.allocated_bytes - allocations_start_.allocated_bytes;
+  event.retained_bytes = static_cast<int64_t>(event.allocated_bytes) -
+                         static_cast<int64_t>(allocations_end_.freed_bytes - allocations_start_.freed_bytes);
+  event.peak_rss = peak_rss_end_;
+  event.peak_rss_growth = peak_rss_end_ - peak_rss_start_;
+
+  trace_->add(std::move(event));
+}
+
+TimeTrace::TimeTrace(const AllocationCounter* allocations)
+  : allocations_(allocations)
+  , origin_(wall_now())
+  , threads_{ std::this_thread::get_id() }
+{
+}
+
+auto
+TimeTrace::phase_name(const Phase phase) -> const char*
+{
+  switch (phase) {
+    case Phase::file:
+      return "file";
+    case Phase::read:
+      return "read";
+    case Phase::lex:
+      return "lex";
+    case Phase::parse:
+      return "parse";
+    case Phase::import:
+      return "import";
+    case Phase::annotate:
+      return "annotate";
+    case Phase::validate:
+      return "validate";
+    case Phase::build_ast:
+      return "build ast";
+    case Phase::optimize:
+      return "optimize";
+    case Phase::codegen:
+      return "codegen";
+    case Phase::codegen_shard:
+      return "codegen shard";
+    case Phase::cache:
+      return "cache";
+    case Phase::run:
+      return "run";
+    case Phase::link:
+      return "link";
+  }
+  return "";
+}
+
+auto
+TimeTrace::phase_totals() const -> std::map<Phase, PhaseTotals>
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::map<Phase, PhaseTotals> phases;
+
+  for (const auto& event : events_) {
+    auto& phase = phases[event.phase];
+    phase.calls++;
+    phase.wall_time += event.wall_time;
+    phase.cpu_time += event.cpu_time;
+    phase.tokens += event.tokens;
+    phase.nodes += event.nodes;
+  }
+
+  return phases;
+}
+
+void
+TimeTrace::add(Event event)
+{
+  const auto id = std::this_thread::get_id();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  const auto it = std::find(threads_.begin(), threads_.end(), id);
+
+  event.thread = static_cast<size_t>(it - threads_.begin());
+
+  if (it == threads_.end()) {
+    threads_.emplace_back(id);
+  }
+
+  // Scopes started before the trace was created are clamped to it, rather than wrapping around.
+  event.wall_start = (event.wall_start > origin_) ? (event.wall_start - origin_) : 0;
+
+  events_.emplace_back(std::move(event));
+}
+
+void
+TimeTrace::write_report(std::ostream& stream) const
+{
+  // Files get a table of their own.
+  auto phases = phase_totals();
+
+  phases.erase(Phase::file);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::map<std::string_view, PhaseTotals> files;
+
+  uint64_t end{ 0 };
+
+  for (const auto& event : events_) {
+    end = std::max(end, event.wall_start + event.wall_time);
+    if (event.phase == Phase::file) {
+      auto& file = files[event.detail];
+      file.calls++;
+      file.wall_time += event.wall_time;
+      file.cpu_time += event.cpu_time;
+    } else if (event.phase == Phase::lex) {
+      // A file is as big as the front end found it to be.
+      files[event.detail].tokens += event.tokens;
+    } else if (event.phase == Phase::parse) {
+      files[event.detail].nodes += event.nodes;
+    }
+  }
+
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+
+  stream << std::fixed << std::setprecision(2);
+
+  stream << std::left << std::setw(16) << "phase" << std::right << std::setw(8) << "calls" << std::setw(12) << "wall ms"
+         << std::setw(12) << "cpu ms" << "  throughput\n";
+
+  for (const auto& [phase, totals] : phases) {
+    stream << std::left << std::setw(16) << phase_name(phase) << std::right << std::setw(8) << totals.calls
+           << std::setw(12) << to_ms(totals.wall_time) << std::setw(12) << to_ms(totals.cpu_time);
+    const auto rate = (totals.tokens > 0) ? format_rate(totals.tokens, totals.wall_time, "tokens")
+                                          : format_rate(totals.nodes, totals.wall_time, "nodes");
+    if (!rate.empty()) {
+      stream << "  " << rate;
+    }
+    stream << '\n';
+  }
+
+  std::vector<std::pair<std::string_view, PhaseTotals>> slowest(files.begin(), files.end());
+
+  std::stable_sort(slowest.begin(), slowest.end(), [](const auto& a, const auto& b) {
+    return a.second.wall_time > b.second.wall_time;
+  });
+
+  stream << '\n';
+
+  stream << std::left << std::setw(40) << "file" << std::right << std::setw(12) << "wall ms" << std::setw(12)
+         << "cpu ms" << std::setw(10) << "tokens" << std::setw(10) << "nodes" << '\n';
+
+  for (const auto& [name, totals] : slowest) {
+    stream << std::left << std::setw(40) << name << std::right << std::setw(12) << to_ms(totals.wall_time)
+           << std::setw(12) << to_ms(totals.cpu_time) << std::setw(10) << totals.tokens << std::setw(10) << totals.nodes
+           << '\n';
+  }
+
+  stream << '\n' << "total " << to_ms(end) << " ms on " << threads_.size() << " thread(s)\n";
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+void
+TimeTrace::write_memory_report(std::ostream& stream) const
+{
+  if (!allocations_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  struct Totals final
+  {
+    size_t calls{ 0 };
+
+    uint64_t allocations{ 0 };
+
+    uint64_t allocated_bytes{ 0 };
+
+    int64_t retained_bytes{ 0 };
+
+    uint64_t peak_rss{ 0 };
+
+    uint64_t peak_rss_growth{ 0 };
+
+    size_t tokens{ 0 };
+
+    size_t nodes{ 0 };
+  };
+
+  std::map<Phase, Totals> phases;
+
+  for (const auto& event : events_) {
+    auto& phase = phases[event.phase];
+    phase.calls++;
+    phase.allocations += event.allocations;
+    phase.allocated_bytes += event.allocated_bytes;
+    phase.retained_bytes += event.retained_bytes;
+    phase.peak_rss = std::max(phase.peak_rss, event.peak_rss);
+    phase.peak_rss_growth += event.peak_rss_growth;
+    phase.tokens += event.tokens;
+    phase.nodes += event.nodes;
+  }
+
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+
+  stream << std::fixed << std::setprecision(2);
+
+  stream << std::left << std::setw(16) << "phase" << std::right << std::setw(8) << "calls" << std::setw(12) << "allocs"
+         << std::setw(12) << "alloc MB" << std::setw(14) << "retained MB" << std::setw(14) << "peak rss MB"
+         << std::setw(16) << "rss growth MB" << '\n';
+
+  for (const auto& [phase, totals] : phases) {
+    stream << std::left << std::setw(16) << phase_name(phase) << std::right << std::setw(8) << totals.calls
+           << std::setw(12) << totals.allocations << std::setw(12) << to_mb(totals.allocated_bytes) << std::setw(14)
+           << to_mb(totals.retained_bytes) << std::setw(14) << to_mb(totals.peak_rss) << std::setw(16)
+           << to_mb(totals.peak_rss_growth) << '\n';
+  }
+
+  // What a phase retains is what it built, since the structures that the compiler keeps are each built by one phase.
+  stream << '\n';
+
+  stream << std::left << std::setw(16) << "structure" << std::right << std::setw(14) << "retained MB" << std::setw(12)
+         << "count" << std::setw(16) << "bytes each" << '\n';
+
+  for (const auto& structure : structures) {
+    const auto it = phases.find(structure.phase);
+    if (it == phases.end()) {
+      continue;
+    }
+    const auto& totals = it->second;
+    stream << std::left << std::setw(16) << structure.name << std::right << std::setw(14)
+           << to_mb(totals.retained_bytes);
+    const auto count = (structure.phase == Phase::lex) ? totals.tokens : totals.nodes;
+    if (structure.unit && (count > 0)) {
+      stream << std::setw(12) << count << std::setw(16)
+             << (static_cast<double>(totals.retained_bytes) / static_cast<double>(count)) << " per " << structure.unit;
+    }
+    stream << '\n';
+  }
+
+  const auto totals = allocations_->totals();
+
+  stream << '\n'
+         << totals.allocations << " allocations of " << to_mb(totals.allocated_bytes) << " MB, peak heap "
+         << to_mb(allocations_->peak_live_bytes()) << " MB, peak rss " << to_mb(peak_rss()) << " MB\n";
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+void
+TimeTrace::write_trace(std::ostream& stream) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto events = events_;
+
+  // Enclosing scopes go before the scopes within them, which is how viewers expect to find them.
+  std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+    if (a.wall_start != b.wall_start) {
+      return a.wall_start < b.wall_start;
+    }
+    return a.wall_time > b.wall_time;
+  });
+
+  const auto flags = stream.flags();
+  const auto precision = stream.precision();
+
+  // Trace events are in microseconds.
+  stream << std::fixed << std::setprecision(3);
+
+  stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  auto first{ true };
+
+  const auto separate = [&stream, &first]() {
+    stream << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  for (size_t i = 0; i < threads_.size(); i++) {
+    separate();
+    stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+    write_json_string(stream, (i == 0) ? std::string("main") : ("worker " + std::to_string(i)));
+    stream << "}}";
+  }
+
+  for (const auto& event : events) {
+    separate();
+    stream << "{\"name\":";
+    write_json_string(stream, (event.phase == Phase::file) ? std::string_view(event.detail) : phase_name(event.phase));
+    stream << ",\"cat\":\"" << phase_name(event.phase) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+           << ",\"ts\":" << (static_cast<double>(event.wall_start) / 1e3)
+           << ",\"dur\":" << (static_cast<double>(event.wall_time) / 1e3)
+           << ",\"tts\":" << (static_cast<double>(event.cpu_start) / 1e3)
+           << ",\"tdur\":" << (static_cast<double>(event.cpu_time) / 1e3) << ",\"args\":{\"detail\":";
+    write_json_string(stream, event.detail);
+    if (event.tokens > 0) {
+      stream << ",\"tokens\":" << event.tokens;
+    }
+    if (event.nodes > 0) {
+      stream << ",\"nodes\":" << event.nodes;
+    }
+    if (allocations_) {
+      stream << ",\"allocations\":" << event.allocations << ",\"allocated_bytes\":" << event.allocated_bytes
+             << ",\"retained_bytes\":" << event.retained_bytes << ",\"peak_rss\":" << event.peak_rss;
+    }
+    stream << "}}";
+  }
+
+  stream << "\n]}\n";
+
+  stream.flags(flags);
+  stream.precision(precision);
+}
+
+} // namespace nabla
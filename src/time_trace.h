@@ -0,0 +1,215 @@
+#pragma once
+
+#include "memory_usage.h"
+
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla {
+
+/// @brief Records how long each phase of the compiler takes on each file, and optionally how much memory it allocates,
+///        for the time and memory reports and the trace output.
+///
+/// @details Phases are measured with scopes, which record the wall time and the CPU time of the thread that they run
+///          on. Scopes nest, and the time of a scope includes that of the scopes within it. A scope that is given a
+///          null trace does nothing, so the instrumentation costs a branch when it is disabled. This may be used by
+///          several threads at the same time.
+///
+///          When the trace has an allocation counter, scopes also record the allocations made by their thread and the
+///          peak resident memory of the process when they end, and so grow by a system call.
+class TimeTrace final
+{
+public:
+  enum class Phase
+  {
+    /// @brief Everything done for one file, which the per-file report is made of.
+    file,
+    read,
+    lex,
+    parse,
+    /// @brief Copying the declarations of imported modules, and making the interfaces of exported ones.
+    import,
+    annotate,
+    validate,
+    build_ast,
+    optimize,
+    codegen,
+    /// @brief Generating a run of nodes on a worker, which is part of code generation.
+    codegen_shard,
+    cache,
+    run,
+    link
+  };
+
+  /// @brief Measures the time from its construction to its destruction.
+  class Scope final
+  {
+  public:
+    /// @param detail What the scope is about, such as the path of a file.
+    Scope(TimeTrace* trace, const Phase phase, const std::string_view& detail = {})
+      : trace_(trace)
+    {
+      if (trace_) {
+        begin(phase, detail);
+      }
+    }
+
+    Scope(const Scope&) = delete;
+
+    auto operator=(const Scope&) -> Scope& = delete;
+
+    ~Scope()
+    {
+      if (trace_) {
+        end();
+      }
+    }
+
+    /// @brief Sets the number of tokens that the scope went through, for throughput.
+    void set_tokens(const size_t tokens) { tokens_ = tokens; }
+
+    /// @brief Sets the number of syntax tree nodes that the scope went through, for throughput.
+    void set_nodes(const size_t nodes) { nodes_ = nodes; }
+
+    /// @brief Stops the clocks early, so that work done afterwards for the trace itself, such as counting nodes, is
+    ///        not measured. The scope is still recorded when it is destroyed.
+    void stop()
+    {
+      if (trace_ && !stopped_) {
+        stop_clocks();
+      }
+    }
+
+  private:
+    void begin(Phase phase, const std::string_view& detail);
+
+    void stop_clocks();
+
+    void end();
+
+    TimeTrace* trace_{ nullptr };
+
+    Phase phase_{ Phase::file };
+
+    std::string detail_;
+
+    uint64_t wall_start_{ 0 };
+
+    uint64_t cpu_start_{ 0 };
+
+    uint64_t wall_end_{ 0 };
+
+    uint64_t cpu_end_{ 0 };
+
+    AllocationCounts allocations_start_;
+
+    AllocationCounts allocations_end_;
+
+    uint64_t peak_rss_start_{ 0 };
+
+    uint64_t peak_rss_end_{ 0 };
+
+    bool stopped_{ false };
+
+    size_t tokens_{ 0 };
+
+    size_t nodes_{ 0 };
+  };
+
+  /// @brief What the scopes of one phase add up to.
+  struct PhaseTotals final
+  {
+    size_t calls{ 0 };
+
+    uint64_t wall_time{ 0 };
+
+    uint64_t cpu_time{ 0 };
+
+    size_t tokens{ 0 };
+
+    size_t nodes{ 0 };
+  };
+
+  /// @param allocations If not null, the memory used by each scope is recorded too. It must be installed as the
+  ///                    allocation hook for as long as scopes are recorded.
+  explicit TimeTrace(const AllocationCounter* allocations = nullptr);
+
+  [[nodiscard]] static auto phase_name(Phase phase) -> const char*;
+
+  /// @brief Adds up the scopes recorded so far, per phase. Times are in nanoseconds.
+  [[nodiscard]] auto phase_totals() const -> std::map<Phase, PhaseTotals>;
+
+  /// @brief Writes the time spent per phase and per file, with the slowest files first.
+  void write_report(std::ostream& stream) const;
+
+  /// @brief Writes the memory allocated per phase, the size of the data structures that phases build, and the peak
+  ///        memory use.
+  ///
+  /// @note This is empty unless the trace was given an allocation counter.
+  void write_memory_report(std::ostream& stream) const;
+
+  /// @brief Writes the scopes as Chrome trace events, which can be opened in chrome://tracing or Perfetto.
+  void write_trace(std::ostream& stream) const;
+
+private:
+  struct Event final
+  {
+    Phase phase{ Phase::file };
+
+    std::string detail;
+
+    /// @brief The index of the thread in @ref TimeTrace::threads_.
+    size_t thread{ 0 };
+
+    /// @brief When the scope started, relative to when the trace was created.
+    uint64_t wall_start{ 0 };
+
+    uint64_t wall_time{ 0 };
+
+    uint64_t cpu_start{ 0 };
+
+    uint64_t cpu_time{ 0 };
+
+    size_t tokens{ 0 };
+
+    size_t nodes{ 0 };
+
+    uint64_t allocations{ 0 };
+
+    uint64_t allocated_bytes{ 0 };
+
+    /// @brief The bytes that the scope allocated and did not free, which is negative if it freed more than it
+    ///        allocated.
+    int64_t retained_bytes{ 0 };
+
+    uint64_t peak_rss{ 0 };
+
+    /// @brief How much the peak resident memory of the process grew during the scope.
+    uint64_t peak_rss_growth{ 0 };
+  };
+
+  void add(Event event);
+
+  const AllocationCounter* allocations_{ nullptr };
+
+  /// @brief When the trace was created, which the times of events are relative to.
+  uint64_t origin_{ 0 };
+
+  mutable std::mutex mutex_;
+
+  /// @brief The threads that recorded events, in the order that they first did. The first is the one that created
+  ///        the trace.
+  std::vector<std::thread::id> threads_;
+
+  std::vector<Event> events_;
+};
+
+} // namespace nabla
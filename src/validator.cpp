@@ -3,6 +3,8 @@
 #include "lexer.h"
 
 #include <map>
+#include <set>
+#include <string_view>
 
 namespace nabla {
 
@@ -23,6 +25,9 @@ class ValidatorImpl final
 
   std::vector<Scope> scope_;
 
+  /// @brief The names of the structs in the module, which are the type names besides the built-in ones.
+  std::set<std::string_view, std::less<>> struct_names_;
+
 public:
   auto get_diagnostics() -> std::vector<Diagnostic> override { return std::move(diagnostics_); }
 
@@ -32,6 +37,14 @@ public:
 
     scope_ = std::vector<Scope>{ Scope{} };
 
+    // Structs may be used before they are declared, so they are all known before any type is checked.
+    struct_names_.clear();
+    for (const auto& node : nodes) {
+      if (const auto* struct_node = dynamic_cast<const StructNode*>(node.get()); struct_node) {
+        struct_names_.emplace(struct_node->name().data);
+      }
+    }
+
     validate_add_expr(annotations);
 
     validate_mul_expr(annotations);
@@ -61,6 +74,8 @@ protected:
 
   void visit(const DeclNode& node) override
   {
+    validate_type(node);
+
     if (const auto* existing = find_decl(node.get_name()); existing) {
       add_diagnostic("symbol already exists by this name", &node.get_name());
     } else {
@@ -70,14 +85,28 @@ protected:
 
   void visit(const FuncNode& node) override
   {
-    //
-    (void)node;
+    for (const auto& param : node.params()) {
+      validate_type(*param);
+    }
+
+    for (const auto& stmt : node.body()) {
+      if (const auto* decl = dynamic_cast<const DeclNode*>(stmt.get()); decl) {
+        validate_type(*decl);
+      }
+    }
   }
 
-  void visit(const StructNode&) override {}
+  void visit(const StructNode& node) override
+  {
+    for (const auto& field : node.fields()) {
+      validate_type(*field);
+    }
+  }
 
   void visit(const ReturnNode&) override {}
 
+  void visit(const ImportNode&) override {}
+
   void visit(const PrintNode& node) override
   {
     //
@@ -89,6 +118,21 @@ protected:
     failed_ = true;
   }
 
+  void validate_type(const DeclNode& node)
+  {
+    if (!node.has_type()) {
+      return;
+    }
+
+    const auto& name = node.get_type().name();
+
+    TypeID type_id{};
+
+    if (!find_builtin_type(name.data, type_id) && (struct_names_.find(name.data) == struct_names_.end())) {
+      add_diagnostic("unknown type '" + std::string(name.data) + "'", &name);
+    }
+  }
+
   void unresolved_operator(const Token* token)
   {
     add_diagnostic("unresolved operator", token);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "interpreter.h"
+
+#include <string>
+
+#include <stdint.h>
+
+namespace nabla {
+
+/// @brief A computed value.
+///
+/// @note Only printing needs to know the kind of a value, since every other operation knows the types of its operands
+///       from the expression being evaluated.
+struct Value final
+{
+  enum class Kind : uint8_t
+  {
+    int_,
+    float_,
+    string
+  };
+
+  Kind kind{ Kind::int_ };
+
+  union
+  {
+    int int_value;
+
+    float float_value;
+
+    /// @brief Strings only come from literals, so this points into the module being executed.
+    const std::string* string_value;
+  };
+
+  [[nodiscard]] static auto from(const int value) -> Value
+  {
+    Value v;
+    v.kind = Kind::int_;
+    v.int_value = value;
+    return v;
+  }
+
+  [[nodiscard]] static auto from(const float value) -> Value
+  {
+    Value v;
+    v.kind = Kind::float_;
+    v.float_value = value;
+    return v;
+  }
+
+  [[nodiscard]] static auto from(const std::string* value) -> Value
+  {
+    Value v;
+    v.kind = Kind::string;
+    v.string_value = value;
+    return v;
+  }
+
+  void print(Runtime& runtime) const
+  {
+    switch (kind) {
+      case Kind::int_:
+        runtime.print(int_value);
+        break;
+      case Kind::float_:
+        runtime.print(float_value);
+        break;
+      case Kind::string:
+        runtime.print(*string_value);
+        break;
+    }
+  }
+};
+
+} // namespace nabla
@@ -0,0 +1,117 @@
+/// @file
+///
+/// @brief Checks that the batch backend prints exactly what the interpreter prints, on random modules.
+///
+/// @details Modules are executed over a number of rows that varies from one row to several blocks of rows, with inputs
+///          bound by the host and with the default inputs. The interpreter executes the same rows one by one. Each
+///          module is checked with the portable, SSE4.1 and AVX2 kernels, leaving out those that this CPU does not
+///          support, and twice with the same interpreter, since the lowered program is reused. Every tenth module is
+///          then replaced by another one at the same address, which must be lowered again.
+///
+///          Takes the number of modules as an optional argument.
+
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include <stdlib.h>
+
+#include "batch_interpreter.h"
+#include "test_support.h"
+
+namespace {
+
+constexpr nabla::BatchKernels all_kernels[]{ nabla::BatchKernels::portable,
+                                             nabla::BatchKernels::sse4_1,
+                                             nabla::BatchKernels::avx2 };
+
+[[nodiscard]] auto
+kernels_name(const nabla::BatchKernels kernels) -> const char*
+{
+  switch (kernels) {
+    case nabla::BatchKernels::best:
+      return "best";
+    case nabla::BatchKernels::portable:
+      return "portable";
+    case nabla::BatchKernels::sse4_1:
+      return "sse4.1";
+    case nabla::BatchKernels::avx2:
+      return "avx2";
+  }
+  return "";
+}
+
+[[nodiscard]] auto
+check(const uint64_t seed) -> bool
+{
+  nabla::test::RandomModuleOptions module_options;
+  module_options.num_stmts = 1 + (seed % 200);
+
+  const auto m = nabla::test::random_module(seed, module_options);
+
+  // From a single row to more rows than fit in one block, which is 256 rows for modules of this size.
+  const size_t row_counts[]{ 1, 1 + (seed % 31), 300 + (seed % 300) };
+
+  const auto num_rows = row_counts[seed % std::size(row_counts)];
+
+  const auto rows = nabla::test::random_inputs(m, num_rows, seed);
+
+  nabla::InterpreterOptions interpreter_options;
+
+  for (const auto kernels : all_kernels) {
+    if (!nabla::batch_kernels_supported(kernels)) {
+      continue;
+    }
+
+    nabla::InterpreterOptions batch_options;
+    batch_options.backend = nabla::Backend::batch;
+    batch_options.batch_kernels = kernels;
+
+    for (const auto* inputs : { static_cast<const nabla::ast::Scalar*>(nullptr), rows.data() }) {
+      const auto expected = nabla::test::execute(m, interpreter_options, inputs, num_rows, 2);
+      const auto actual = nabla::test::execute(m, batch_options, inputs, num_rows, 2);
+      if (actual != expected) {
+        std::cerr << "seed " << seed << ": the batch backend with the " << kernels_name(kernels) << " kernels printed\n"
+                  << actual << "where the interpreter printed\n"
+                  << expected << "for " << num_rows << " rows of the module\n"
+                  << nabla::test::format_module(m);
+        return false;
+      }
+    }
+
+    if ((seed % 10) == 0) {
+      const auto [actual, expected] = nabla::test::execute_replaced(seed, module_options, batch_options, num_rows);
+      if (actual != expected) {
+        std::cerr << "seed " << seed << ": after replacing the module, the batch backend with the "
+                  << kernels_name(kernels) << " kernels printed\n"
+                  << actual << "where the interpreter printed\n"
+                  << expected;
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  const uint64_t num_modules = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 500;
+
+  auto success{ true };
+
+  for (const auto kernels : all_kernels) {
+    if (!nabla::batch_kernels_supported(kernels)) {
+      std::cerr << "the " << kernels_name(kernels) << " kernels are not supported by this CPU, and are not checked\n";
+    }
+  }
+
+  for (uint64_t seed = 1; seed <= num_modules; seed++) {
+    success &= check(seed);
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+/// @file
+///
+/// @brief Checks that the JIT prints exactly what the interpreter prints, on random modules.
+///
+/// @details Modules are executed with their default inputs and with inputs bound by the host, and executed twice, since
+///          the second execution reuses the compiled code. Some modules keep more values live than there are
+///          registers, so that values are spilled and reloaded. Each module is also checked to have been compiled,
+///          rather than interpreted by the fallback, unless it needs instructions that this CPU does not have.
+///          Every tenth module is then replaced by another one at the same address, which must be compiled again.
+///
+///          Takes the number of modules as an optional argument.
+
+#include <iostream>
+#include <string>
+
+#include <stdlib.h>
+
+#include "jit/compiler.h"
+#include "test_support.h"
+
+namespace {
+
+[[nodiscard]] auto
+has_fused_mul_add(const nabla::ast::Module& m) -> bool
+{
+  for (const auto& stmt : m.stmts) {
+    const auto* assign = dynamic_cast<const nabla::ast::AssignStmt*>(stmt.get());
+    if (!assign) {
+      continue;
+    }
+    const auto* mul_add = dynamic_cast<const nabla::ast::MulAddExpr<float>*>(&assign->value());
+    if (mul_add && mul_add->fused()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+[[nodiscard]] auto
+can_compile(const nabla::ast::Module& m) -> bool
+{
+#if defined(__x86_64__)
+  return __builtin_cpu_supports("fma") || !has_fused_mul_add(m);
+#else
+  (void)m;
+  return false;
+#endif
+}
+
+[[nodiscard]] auto
+check(const uint64_t seed, const nabla::test::RandomModuleOptions& module_options) -> bool
+{
+  const auto m = nabla::test::random_module(seed, module_options);
+
+  const auto rows = nabla::test::random_inputs(m, 1, seed);
+
+  nabla::InterpreterOptions interpreter_options;
+
+  nabla::InterpreterOptions jit_options;
+  jit_options.backend = nabla::Backend::jit;
+
+  if (can_compile(m) && !nabla::jit::compile(m)) {
+    std::cerr << "seed " << seed << ": the module was not compiled\n" << nabla::test::format_module(m);
+    return false;
+  }
+
+  for (const auto* inputs : { static_cast<const nabla::ast::Scalar*>(nullptr), rows.data() }) {
+    const auto expected = nabla::test::execute(m, interpreter_options, inputs, 1, 2);
+    const auto actual = nabla::test::execute(m, jit_options, inputs, 1, 2);
+    if (actual != expected) {
+      std::cerr << "seed " << seed << ": the JIT printed\n"
+                << actual << "where the interpreter printed\n"
+                << expected << "for the module\n"
+                << nabla::test::format_module(m);
+      return false;
+    }
+  }
+
+  if ((seed % 10) == 0) {
+    const auto [actual, expected] = nabla::test::execute_replaced(seed, module_options, jit_options);
+    if (actual != expected) {
+      std::cerr << "seed " << seed << ": after replacing the module, the JIT printed\n"
+                << actual << "where the interpreter printed\n"
+                << expected;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  const uint64_t num_modules = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 3000;
+
+  auto success{ true };
+
+  for (uint64_t seed = 1; seed <= num_modules; seed++) {
+    nabla::test::RandomModuleOptions options;
+    options.num_stmts = 1 + (seed % 200);
+    options.register_pressure = (seed % 3) == 0;
+    success &= check(seed, options);
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
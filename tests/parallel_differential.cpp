@@ -0,0 +1,86 @@
+/// @file
+///
+/// @brief Checks that the parallel backend prints exactly what the interpreter prints, on random modules.
+///
+/// @details Modules are cut into tasks of one to nine statements, so that there are many tasks and much to schedule,
+///          and executed on a pool of three workers, whether or not there are that many cores. Each module is executed
+///          several times with the same interpreter, since the schedule and its counters are reused, with default
+///          inputs and with inputs bound by the host. Every tenth module is then replaced by another one at the same
+///          address, which must get a schedule of its own.
+///
+///          This is also the test to build with ThreadSanitizer, with -DNABLA_SANITIZE=thread. Takes the number of
+///          modules as an optional argument.
+
+#include <iostream>
+#include <string>
+
+#include <stdlib.h>
+
+#include "test_support.h"
+#include "thread_pool.h"
+
+namespace {
+
+[[nodiscard]] auto
+check(const uint64_t seed, nabla::ThreadPool& pool) -> bool
+{
+  nabla::test::RandomModuleOptions module_options;
+  module_options.num_stmts = 1 + (seed % 300);
+  // Operands from all over the module make for more dependencies between tasks.
+  module_options.register_pressure = (seed % 2) == 0;
+
+  const auto m = nabla::test::random_module(seed, module_options);
+
+  const auto rows = nabla::test::random_inputs(m, 1, seed);
+
+  nabla::InterpreterOptions interpreter_options;
+
+  nabla::InterpreterOptions parallel_options;
+  parallel_options.backend = nabla::Backend::parallel;
+  parallel_options.thread_pool = &pool;
+  parallel_options.task_cost = 1 + (seed % 9);
+
+  constexpr size_t repeat = 3;
+
+  for (const auto* inputs : { static_cast<const nabla::ast::Scalar*>(nullptr), rows.data() }) {
+    const auto expected = nabla::test::execute(m, interpreter_options, inputs, 1, repeat);
+    const auto actual = nabla::test::execute(m, parallel_options, inputs, 1, repeat);
+    if (actual != expected) {
+      std::cerr << "seed " << seed << ": the parallel backend printed\n"
+                << actual << "where the interpreter printed\n"
+                << expected << "for the module\n"
+                << nabla::test::format_module(m);
+      return false;
+    }
+  }
+
+  if ((seed % 10) == 0) {
+    const auto [actual, expected] = nabla::test::execute_replaced(seed, module_options, parallel_options);
+    if (actual != expected) {
+      std::cerr << "seed " << seed << ": after replacing the module, the parallel backend printed\n"
+                << actual << "where the interpreter printed\n"
+                << expected;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+main(int argc, char** argv) -> int
+{
+  const uint64_t num_modules = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 1500;
+
+  nabla::ThreadPool pool(3);
+
+  auto success{ true };
+
+  for (uint64_t seed = 1; seed <= num_modules; seed++) {
+    success &= check(seed, pool);
+  }
+
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,405 @@
+#include "test_support.h"
+
+#include "buffered_runtime.h"
+
+#include <cmath>
+#include <optional>
+#include <random>
+#include <sstream>
+
+namespace nabla::test {
+
+namespace {
+
+/// @brief The largest magnitude that a value may reach. Integer products of two such values still fit in an int.
+constexpr double max_magnitude = 30000.0;
+
+enum class Type
+{
+  int_,
+  float_,
+  string
+};
+
+class ModuleGenerator final
+{
+public:
+  ModuleGenerator(const uint64_t seed, const RandomModuleOptions& options)
+    : random_(seed)
+    , options_(options)
+  {
+  }
+
+  [[nodiscard]] auto generate() -> ast::Module
+  {
+    const auto num_inputs = below(options_.max_inputs + 1);
+
+    for (size_t i = 0; i < num_inputs; i++) {
+      ast::Input input;
+      input.name = "in" + std::to_string(i);
+      input.type = below(2) ? ast::ScalarType::float_ : ast::ScalarType::int_;
+      if (input.type == ast::ScalarType::int_) {
+        input.default_value.int_value = static_cast<int>(below(201)) - 100;
+      } else {
+        input.default_value.float_value = static_cast<float>(static_cast<int>(below(2001)) - 1000) / 10.0f;
+      }
+      module_.inputs.emplace_back(input);
+    }
+
+    // A value of each type to start from, so that operands can always be found.
+    add_literal(Type::int_);
+    add_literal(Type::float_);
+
+    while (module_.stmts.size() < options_.num_stmts) {
+      add_stmt();
+    }
+
+    if (options_.register_pressure) {
+      reduce(Type::int_);
+      reduce(Type::float_);
+    }
+
+    print(types_.size() - 1);
+
+    module_.stmts.emplace_back(std::make_unique<ast::PrintEndStmt>());
+
+    return std::move(module_);
+  }
+
+private:
+  [[nodiscard]] auto below(const size_t bound) -> size_t { return static_cast<size_t>(random_() % bound); }
+
+  void add_stmt()
+  {
+    const auto choice = below(options_.register_pressure ? 24 : 16);
+
+    if (choice < 2) {
+      add_literal(below(2) ? Type::float_ : Type::int_);
+    } else if ((choice < 3) && options_.strings) {
+      add_literal(Type::string);
+    } else if ((choice < 4) && !module_.inputs.empty()) {
+      add_input(below(module_.inputs.size()));
+    } else if (choice < 6) {
+      print(below(types_.size()));
+      if (below(2)) {
+        module_.stmts.emplace_back(std::make_unique<ast::PrintEndStmt>());
+      }
+    } else {
+      add_arithmetic(below(2) ? Type::float_ : Type::int_, choice);
+    }
+  }
+
+  void add_literal(const Type type)
+  {
+    switch (type) {
+      case Type::int_:
+        assign(std::make_unique<ast::LiteralExpr<int>>(static_cast<int>(below(201)) - 100), type, 100);
+        break;
+      case Type::float_: {
+        const auto value = static_cast<float>(static_cast<int>(below(20001)) - 10000) / 100.0f;
+        assign(std::make_unique<ast::LiteralExpr<float>>(value), type, std::fabs(value));
+      } break;
+      case Type::string:
+        assign(std::make_unique<ast::LiteralExpr<std::string>>("s" + std::to_string(below(1000))), type, 0);
+        break;
+    }
+  }
+
+  void add_input(const size_t slot)
+  {
+    // Bound inputs are generated in the same range as the defaults.
+    if (module_.inputs[slot].type == ast::ScalarType::int_) {
+      assign(std::make_unique<ast::InputExpr<int>>(slot), Type::int_, 101);
+    } else {
+      assign(std::make_unique<ast::InputExpr<float>>(slot), Type::float_, 101);
+    }
+  }
+
+  void add_arithmetic(const Type type, const size_t choice)
+  {
+    const auto a = pick(type);
+    const auto b = pick(type);
+    const auto c = pick(type);
+
+    const auto sum = magnitudes_[a] + magnitudes_[b];
+    const auto product = magnitudes_[a] * magnitudes_[b];
+    const auto mul_add = product + magnitudes_[c];
+
+    if (options_.mul_adds && (choice % 4 == 0) && (mul_add <= max_magnitude)) {
+      const auto fused = (type == Type::float_) && below(2);
+      if (type == Type::int_) {
+        assign(std::make_unique<ast::MulAddExpr<int>>(a, b, c, false), type, mul_add);
+      } else {
+        assign(std::make_unique<ast::MulAddExpr<float>>(a, b, c, fused), type, mul_add);
+      }
+    } else if ((choice % 2 == 0) && (product <= max_magnitude)) {
+      if (type == Type::int_) {
+        assign(std::make_unique<ast::MulExpr<int, int>>(a, b), type, product);
+      } else {
+        assign(std::make_unique<ast::MulExpr<float, float>>(a, b), type, product);
+      }
+    } else if (sum <= max_magnitude) {
+      if (type == Type::int_) {
+        assign(std::make_unique<ast::AddExpr<int>>(a, b), type, sum);
+      } else {
+        assign(std::make_unique<ast::AddExpr<float>>(a, b), type, sum);
+      }
+    } else {
+      add_literal(type);
+    }
+  }
+
+  /// @brief Adds up all values of a type, so that all of them are live until the end.
+  void reduce(const Type type)
+  {
+    std::vector<size_t> ids;
+
+    for (size_t i = 0; i < types_.size(); i++) {
+      if (types_[i] == type) {
+        ids.emplace_back(i);
+      }
+    }
+
+    auto total = ids.front();
+
+    // Values are added up from the most recent one, so the oldest are read last.
+    for (auto it = ids.rbegin(); it != ids.rend(); ++it) {
+      const auto id = *it;
+      if ((id == total) || ((magnitudes_[total] + magnitudes_[id]) > max_magnitude)) {
+        continue;
+      }
+      if (type == Type::int_) {
+        assign(std::make_unique<ast::AddExpr<int>>(total, id), type, magnitudes_[total] + magnitudes_[id]);
+      } else {
+        assign(std::make_unique<ast::AddExpr<float>>(total, id), type, magnitudes_[total] + magnitudes_[id]);
+      }
+      total = types_.size() - 1;
+    }
+
+    print(total);
+  }
+
+  /// @brief Picks an earlier value of a type, which is one of the most recent ones unless there should be register
+  ///        pressure.
+  [[nodiscard]] auto pick(const Type type) -> size_t
+  {
+    constexpr size_t window = 8;
+
+    std::vector<size_t> candidates;
+
+    for (size_t i = types_.size(); i > 0; i--) {
+      if (types_[i - 1] == type) {
+        candidates.emplace_back(i - 1);
+        if (!options_.register_pressure && (candidates.size() == window)) {
+          break;
+        }
+      }
+    }
+
+    return candidates[below(candidates.size())];
+  }
+
+  void assign(ast::ExprPtr expr, const Type type, const double magnitude)
+  {
+    module_.stmts.emplace_back(std::make_unique<ast::AssignStmt>(types_.size(), std::move(expr)));
+    types_.emplace_back(type);
+    magnitudes_.emplace_back(magnitude);
+  }
+
+  void print(const size_t id) { module_.stmts.emplace_back(std::make_unique<ast::PrintStmt>(id)); }
+
+  std::mt19937_64 random_;
+
+  RandomModuleOptions options_;
+
+  ast::Module module_;
+
+  /// @brief The type of each value, indexed by ID.
+  std::vector<Type> types_;
+
+  /// @brief The largest magnitude that each value can have, whatever the inputs.
+  std::vector<double> magnitudes_;
+};
+
+class StringSink final : public ByteSink
+{
+public:
+  void write(const char* data, const size_t size) override { data_.append(data, size); }
+
+  [[nodiscard]] auto data() const -> const std::string& { return data_; }
+
+private:
+  std::string data_;
+};
+
+class ModuleFormatter final
+  : public ast::StmtVisitor
+  , public ast::ExprVisitor
+{
+public:
+  explicit ModuleFormatter(std::ostringstream* out)
+    : out_(out)
+  {
+  }
+
+  void visit(const ast::AssignStmt& stmt) override
+  {
+    *out_ << '%' << stmt.id() << " = ";
+    stmt.value().accept(*this);
+    *out_ << '\n';
+  }
+
+  void visit(const ast::PrintStmt& stmt) override { *out_ << "print %" << stmt.id() << '\n'; }
+
+  void visit(const ast::PrintEndStmt&) override { *out_ << "print_end\n"; }
+
+  void visit(const ast::LiteralExpr<int>& expr) override { *out_ << "int " << expr.value(); }
+
+  void visit(const ast::LiteralExpr<float>& expr) override { *out_ << "float " << expr.value(); }
+
+  void visit(const ast::LiteralExpr<std::string>& expr) override { *out_ << "string \"" << expr.value() << '"'; }
+
+  void visit(const ast::AddExpr<int>& expr) override { binary("add int", expr.left(), expr.right()); }
+
+  void visit(const ast::AddExpr<float>& expr) override { binary("add float", expr.left(), expr.right()); }
+
+  void visit(const ast::AddExpr<std::string>& expr) override { binary("add string", expr.left(), expr.right()); }
+
+  void visit(const ast::MulExpr<int, int>& expr) override { binary("mul int", expr.left(), expr.right()); }
+
+  void visit(const ast::MulExpr<float, float>& expr) override { binary("mul float", expr.left(), expr.right()); }
+
+  void visit(const ast::MulAddExpr<int>& expr) override { mul_add("int", expr); }
+
+  void visit(const ast::MulAddExpr<float>& expr) override { mul_add("float", expr); }
+
+  void visit(const ast::InputExpr<int>& expr) override { *out_ << "input int " << expr.slot(); }
+
+  void visit(const ast::InputExpr<float>& expr) override { *out_ << "input float " << expr.slot(); }
+
+private:
+  void binary(const char* op, const size_t left, const size_t right)
+  {
+    *out_ << op << " %" << left << ", %" << right;
+  }
+
+  template<typename T>
+  void mul_add(const char* type, const ast::MulAddExpr<T>& expr)
+  {
+    *out_ << (expr.fused() ? "fma " : "muladd ") << type << " %" << expr.a() << ", %" << expr.b() << ", %"
+          << expr.c();
+  }
+
+  std::ostringstream* out_;
+};
+
+} // namespace
+
+auto
+random_module(const uint64_t seed, const RandomModuleOptions& options) -> ast::Module
+{
+  return ModuleGenerator(seed, options).generate();
+}
+
+auto
+random_inputs(const ast::Module& m, const size_t num_rows, const uint64_t seed) -> std::vector<ast::Scalar>
+{
+  std::mt19937_64 random(seed);
+
+  std::vector<ast::Scalar> rows(num_rows * m.inputs.size());
+
+  for (size_t i = 0; i < rows.size(); i++) {
+    const auto value = static_cast<int>(random() % 201) - 100;
+    if (m.inputs[i % m.inputs.size()].type == ast::ScalarType::int_) {
+      rows[i].int_value = value;
+    } else {
+      rows[i].float_value = static_cast<float>(value) + 0.25f;
+    }
+  }
+
+  return rows;
+}
+
+auto
+execute(const ast::Module& m,
+        const InterpreterOptions& options,
+        const ast::Scalar* rows,
+        const size_t num_rows,
+        const size_t repeat) -> std::string
+{
+  StringSink sink;
+
+  {
+    BufferedRuntime runtime(&sink);
+    auto interpreter = Interpreter::create(&runtime, options);
+    for (size_t i = 0; i < repeat; i++) {
+      interpreter->exec_batch(m, rows, num_rows);
+    }
+  }
+
+  return sink.data();
+}
+
+auto
+execute_replaced(const uint64_t seed,
+                 const RandomModuleOptions& module_options,
+                 const InterpreterOptions& options,
+                 const size_t num_rows) -> std::pair<std::string, std::string>
+{
+  std::optional<ast::Module> slot(random_module(seed, module_options));
+
+  const auto num_stmts = slot->stmts.size();
+
+  auto replacement_seed = seed;
+
+  ast::Module replacement;
+
+  do {
+    replacement = random_module(++replacement_seed, module_options);
+  } while (replacement.stmts.size() != num_stmts);
+
+  StringSink sink;
+
+  std::string expected;
+
+  {
+    BufferedRuntime runtime(&sink);
+    auto interpreter = Interpreter::create(&runtime, options);
+
+    const auto run = [&](const uint64_t rows_seed) {
+      const auto rows = random_inputs(*slot, num_rows, rows_seed);
+      expected += execute(*slot, InterpreterOptions{}, rows.data(), num_rows);
+      interpreter->exec_batch(*slot, rows.data(), num_rows);
+    };
+
+    run(seed);
+
+    // Destroying the module first makes its storage free for the replacement.
+    slot.reset();
+    slot.emplace(std::move(replacement));
+
+    run(replacement_seed);
+  }
+
+  return { sink.data(), expected };
+}
+
+auto
+format_module(const ast::Module& m) -> std::string
+{
+  std::ostringstream out;
+
+  for (const auto& input : m.inputs) {
+    out << "input " << input.name << ' ' << ((input.type == ast::ScalarType::int_) ? "int" : "float") << '\n';
+  }
+
+  ModuleFormatter formatter(&out);
+
+  for (const auto& stmt : m.stmts) {
+    stmt->accept(formatter);
+  }
+
+  return out.str();
+}
+
+} // namespace nabla::test
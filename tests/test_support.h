@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace nabla::test {
+
+/// @brief What a random module may be made of.
+struct RandomModuleOptions final
+{
+  size_t num_stmts{ 64 };
+
+  size_t max_inputs{ 4 };
+
+  bool strings{ true };
+
+  bool mul_adds{ true };
+
+  /// @brief Whether operands are picked from all earlier values rather than from the most recent ones, and every value
+  ///        is read once more at the end. This keeps many values live at once, more than there are registers for.
+  bool register_pressure{ false };
+};
+
+/// @brief Generates a module that every backend can execute, as the AST builder and the passes would produce it.
+///
+/// @details Values are kept far from overflowing, so that the result of each operation is the same on every backend.
+///
+/// @return The same module for the same arguments.
+[[nodiscard]] auto
+random_module(uint64_t seed, const RandomModuleOptions& options = RandomModuleOptions{}) -> ast::Module;
+
+/// @brief Generates values for the inputs of a module, for a number of rows.
+[[nodiscard]] auto
+random_inputs(const ast::Module& m, size_t num_rows, uint64_t seed) -> std::vector<ast::Scalar>;
+
+/// @brief Executes a module and returns what it printed.
+///
+/// @param rows The inputs of each row, as for @ref Interpreter::exec_batch, or null to use the defaults.
+///
+/// @param repeat The number of times that the module is executed, with the same interpreter.
+[[nodiscard]] auto
+execute(const ast::Module& m,
+        const InterpreterOptions& options,
+        const ast::Scalar* rows = nullptr,
+        size_t num_rows = 1,
+        size_t repeat = 1) -> std::string;
+
+/// @brief Executes a module and then, with the same interpreter, another module with as many statements that is built
+///        at the same address after the first one is destroyed. Backends that cache what they derive from a module
+///        must notice that it is not the same module.
+///
+/// @return What the interpreter printed, and what two new interpreters with the default options printed for the two
+///         modules, in the same order. Rows of inputs are generated for each module.
+[[nodiscard]] auto
+execute_replaced(uint64_t seed,
+                 const RandomModuleOptions& module_options,
+                 const InterpreterOptions& options,
+                 size_t num_rows = 1) -> std::pair<std::string, std::string>;
+
+/// @brief Formats a module as one statement per line, for reporting modules that fail.
+[[nodiscard]] auto
+format_module(const ast::Module& m) -> std::string;
+
+} // namespace nabla::test